@@ -121,6 +121,18 @@ unsigned M_CONNECTIONS = 0;
 
 static const char* clo_serverpath = ".";
 
+/* Delay, in milliseconds, added before answering each request, so as
+   to simulate a slow network link (--delay=). */
+static int clo_delay_ms = 0;
+
+/* The maximum number of ranges in an RDMV request. */
+#define RDMV_MAX_RANGES 1024
+
+/* After each read, ask the kernel to start reading this much of the
+   file following it, on the basis that clients mostly read debuginfo
+   sections from start to end. */
+#define READAHEAD_BYTES (256 * 1024)
+
 
 /*---------------------------------------------------------------*/
 
@@ -499,6 +511,22 @@ static Bool parse_Frame_le64_le64_le64 ( Frame* fr, const HChar* tag,
    return True;
 }
 
+/* An RDMV frame is a session ID and a count of ranges N, followed by
+   N (offset, length) pairs.  Only the first two are returned; the
+   frame is checked to be the right size for the rest. */
+static Bool parse_Frame_RDMV ( Frame* fr,
+                               /*OUT*/ULong* session_id, /*OUT*/ULong* n )
+{
+   if (!fr || !fr->data) return False;
+   if (fr->n_data < 4 + 2*8) return False;
+   if (memcmp(&fr->data[0], "RDMV", 4) != 0) return False;
+   *session_id = read_ULong_le(&fr->data[4 + 0*8]);
+   *n          = read_ULong_le(&fr->data[4 + 1*8]);
+   if (*n == 0 || *n > RDMV_MAX_RANGES) return False;
+   if (fr->n_data != 4 + 2*8 + *n * 2*8) return False;
+   return True;
+}
+
 static Frame* mk_Frame_le64_le64_le64_bytes ( 
                  const HChar* tag,
                  ULong n1, ULong n2, ULong n3, ULong n_data,
@@ -678,6 +706,126 @@ static UInt calc_gnu_debuglink_crc32(/*OUT*/Bool* ok, int fd, ULong size)
 
 /*---------------------------------------------------------------*/
 
+/* Send a frame to the client.  Returns False if that failed. */
+static Bool send_Frame ( int sd, Frame* res )
+{
+   /* What goes on the wire is:
+         adler(le32) n_data(le32) data[0 .. n_data-1]
+      where the checksum covers n_data as well as data[].
+   */
+   /* The initial Adler-32 value */
+   UInt adler = adler32(0, NULL, 0);
+
+   /* Fold in the length field, encoded as le32. */
+   UChar wr_first8[8];
+   write_UInt_le(&wr_first8[4], res->n_data);
+   adler = adler32(adler, &wr_first8[4], 4);
+   /* Fold in the data values */
+   adler = adler32(adler, res->data, res->n_data);
+   write_UInt_le(&wr_first8[0], adler);
+
+   Int r = my_write(sd, &wr_first8[0], 8);
+   if (r != 8) return False;
+   assert(res->n_data >= 4); // else ill formed -- no KIND field
+   r = my_write(sd, res->data, res->n_data);
+   if (r != res->n_data) return False;
+
+//printf("SERVER: send %c%c%c%c\n", res->data[0], res->data[1], res->data[2], res->data[3]); fflush(stdout);
+   return True;
+}
+
+/* Read [req_offset, +req_len) of the file connected to
+   conn_state[conn_no], and return an RDOK frame containing it, LZO
+   compressed, or a FAIL frame. */
+static Frame* do_READ ( int conn_no, ULong req_session_id,
+                        ULong req_offset, ULong req_len )
+{
+   Frame* res = NULL;
+
+   /* Because each new connection is associated with its own socket
+      descriptor and hence with a particular conn_no, the requested
+      session-ID is redundant -- it must be the one associated with
+      this slot.  But check anyway. */
+   Bool ok = True;
+   if (req_session_id != conn_state[conn_no].session_id) {
+      res = mk_Frame_asciiz("FAIL", "READ: invalid session ID");
+      ok = False;
+   }
+   /* Check we're connected to a file, and if so range-check the
+      request. */
+   if (ok && conn_state[conn_no].file_fd == 0) {
+      res = mk_Frame_asciiz("FAIL", "READ: no associated file");
+      ok = False;
+   }
+   if (ok && (req_len == 0 || req_len > 4*1024*1024)) {
+      res = mk_Frame_asciiz("FAIL", "READ: invalid request size");
+      ok = False;
+   }
+   if (ok && req_len + req_offset > conn_state[conn_no].file_size) {
+      res = mk_Frame_asciiz("FAIL", "READ: request exceeds file size");
+      ok = False;
+   }
+   /* Try to read the file. */
+   if (ok) {
+      /* First, allocate a temp buf and read from the file into it. */
+      /* FIXME: what if pread reads short and we have to redo it? */
+      UChar* unzBuf = my_malloc(req_len);
+      size_t nRead = pread(conn_state[conn_no].file_fd,
+                           unzBuf, req_len, req_offset);
+      if (nRead != req_len) {
+         free_Frame(res);
+         res = mk_Frame_asciiz("FAIL", "READ: I/O error reading file");
+         ok = False;
+      }
+      if (ok) {
+         // Now compress it with LZO.  LZO appears to recommend
+         // the worst-case output size as (in_len + in_len / 16 + 67).
+         // Be more conservative here.
+#        define STACK_ALLOC(var,size) \
+            lzo_align_t __LZO_MMODEL \
+               var [ ((size) \
+                     + (sizeof(lzo_align_t) - 1)) / sizeof(lzo_align_t) ]
+         STACK_ALLOC(wrkmem, LZO1X_1_MEM_COMPRESS);
+#        undef STACK_ALLOC
+         UInt zLenMax = req_len + req_len / 4 + 1024;
+         UChar* zBuf = my_malloc(zLenMax);
+         lzo_uint zLen = zLenMax;
+         Int lzo_rc = lzo1x_1_compress(unzBuf, req_len,
+                                       zBuf, &zLen, wrkmem); 
+         if (lzo_rc == LZO_E_OK) {
+           //printf("XXXXX req_len %u  zLen %u\n", (UInt)req_len, (UInt)zLen);
+            assert(zLen <= zLenMax);
+            /* Make a frame to put the results in.  Bytes 24 and
+               onwards need to be filled from the compressed data,
+               and 'buf' is set to point to the right bit. */
+            UChar* buf = NULL;
+            res = mk_Frame_le64_le64_le64_bytes
+              ("RDOK", req_session_id, req_offset, req_len, zLen, &buf);
+            assert(res);
+            assert(buf);
+            memcpy(buf, zBuf, zLen);
+            // Update stats
+            conn_state[conn_no].stats_n_rdok_frames++;
+            conn_state[conn_no].stats_n_read_unz_bytes += req_len;
+            conn_state[conn_no].stats_n_read_z_bytes   += zLen;
+            // Server-side read-ahead: get the kernel going on what
+            // the client is likely to ask for next.
+            posix_fadvise(conn_state[conn_no].file_fd,
+                          req_offset + req_len, READAHEAD_BYTES,
+                          POSIX_FADV_WILLNEED);
+         } else {
+            ok = False;
+            free_Frame(res);
+            res = mk_Frame_asciiz("FAIL", "READ: LZO failed");
+         }
+         free(zBuf);
+      }
+      free(unzBuf);
+   }
+   assert(res != NULL);
+   return res;
+}
+
 /* Handle a transaction for conn_state[conn_no].  There is incoming
    data available; read it and send back an appropriate response.
    Returns a boolean indicating whether the connection has been
@@ -729,12 +877,26 @@ static Bool handle_transaction ( int conn_no )
    assert(res == NULL);
 
    UChar* filename = NULL;
-   ULong req_session_id = 0, req_offset = 0, req_len = 0;
+   ULong req_session_id = 0, req_offset = 0, req_len = 0, req_n_ranges = 0;
+
+   if (clo_delay_ms > 0) {
+      struct timespec delay;
+      delay.tv_sec  = clo_delay_ms / 1000;
+      delay.tv_nsec = (clo_delay_ms % 1000) * 1000 * 1000;
+      nanosleep(&delay, NULL);
+   }
 
    if (parse_Frame_noargs(req, "VERS")) {
       res = mk_Frame_asciiz("VEOK", "Valgrind Debuginfo Server, Version 1");
    }
    else
+   if (parse_Frame_noargs(req, "CAPS")) {
+      /* The protocol extensions this server supports, space
+         separated.  Clients must not send any of them unless they
+         are listed here.  Older servers answer FAIL. */
+      res = mk_Frame_asciiz("CAOK", "RDMV");
+   }
+   else
    if (parse_Frame_noargs(req, "CRC3")) {
       /* FIXME: add a session ID to this request, and check it */
       if (conn_state[conn_no].file_fd == 0) {
@@ -797,80 +959,23 @@ static Bool handle_transaction ( int conn_no )
    else
    if (parse_Frame_le64_le64_le64(req, "READ", &req_session_id,
                                   &req_offset, &req_len)) {
-      /* Because each new connection is associated with its own socket
-         descriptor and hence with a particular conn_no, the requested
-         session-ID is redundant -- it must be the one associated with
-         this slot.  But check anyway. */
-      Bool ok = True;
-      if (req_session_id != conn_state[conn_no].session_id) {
-         res = mk_Frame_asciiz("FAIL", "READ: invalid session ID");
-         ok = False;
-      }
-      /* Check we're connected to a file, and if so range-check the
-         request. */
-      if (ok && conn_state[conn_no].file_fd == 0) {
-         res = mk_Frame_asciiz("FAIL", "READ: no associated file");
-         ok = False;
-      }
-      if (ok && (req_len == 0 || req_len > 4*1024*1024)) {
-         res = mk_Frame_asciiz("FAIL", "READ: invalid request size");
-         ok = False;
-      }
-      if (ok && req_len + req_offset > conn_state[conn_no].file_size) {
-         res = mk_Frame_asciiz("FAIL", "READ: request exceeds file size");
-         ok = False;
-      }
-      /* Try to read the file. */
-      if (ok) {
-         /* First, allocate a temp buf and read from the file into it. */
-         /* FIXME: what if pread reads short and we have to redo it? */
-         UChar* unzBuf = my_malloc(req_len);
-         size_t nRead = pread(conn_state[conn_no].file_fd,
-                              unzBuf, req_len, req_offset);
-         if (nRead != req_len) {
-            free_Frame(res);
-            res = mk_Frame_asciiz("FAIL", "READ: I/O error reading file");
-            ok = False;
-         }         
-         if (ok) {
-            // Now compress it with LZO.  LZO appears to recommend
-            // the worst-case output size as (in_len + in_len / 16 + 67).
-            // Be more conservative here.
-#           define STACK_ALLOC(var,size) \
-               lzo_align_t __LZO_MMODEL \
-                  var [ ((size) \
-                        + (sizeof(lzo_align_t) - 1)) / sizeof(lzo_align_t) ]
-            STACK_ALLOC(wrkmem, LZO1X_1_MEM_COMPRESS);
-#           undef STACK_ALLOC
-            UInt zLenMax = req_len + req_len / 4 + 1024;
-            UChar* zBuf = my_malloc(zLenMax);
-            lzo_uint zLen = zLenMax;
-            Int lzo_rc = lzo1x_1_compress(unzBuf, req_len,
-                                          zBuf, &zLen, wrkmem); 
-            if (lzo_rc == LZO_E_OK) {
-              //printf("XXXXX req_len %u  zLen %u\n", (UInt)req_len, (UInt)zLen);
-               assert(zLen <= zLenMax);
-               /* Make a frame to put the results in.  Bytes 24 and
-                  onwards need to be filled from the compressed data,
-                  and 'buf' is set to point to the right bit. */
-               UChar* buf = NULL;
-               res = mk_Frame_le64_le64_le64_bytes
-                 ("RDOK", req_session_id, req_offset, req_len, zLen, &buf);
-               assert(res);
-               assert(buf);
-               memcpy(buf, zBuf, zLen);
-               // Update stats
-               conn_state[conn_no].stats_n_rdok_frames++;
-               conn_state[conn_no].stats_n_read_unz_bytes += req_len;
-               conn_state[conn_no].stats_n_read_z_bytes   += zLen;
-            } else {
-               ok = False;
-               free_Frame(res);
-               res = mk_Frame_asciiz("FAIL", "READ: LZO failed");
-            }
-            free(zBuf);
-         }
-         free(unzBuf);
+      res = do_READ(conn_no, req_session_id, req_offset, req_len);
+   }
+   else
+   if (parse_Frame_RDMV(req, &req_session_id, &req_n_ranges)) {
+      /* Answer each range with its own RDOK (or FAIL) frame, exactly
+         as if it had been a READ request.  All but the last are sent
+         here; the last one goes out in the usual way below. */
+      ULong k;
+      for (k = 0; k < req_n_ranges; k++) {
+         req_offset = read_ULong_le(&req->data[4 + (2 + 2*k + 0)*8]);
+         req_len    = read_ULong_le(&req->data[4 + (2 + 2*k + 1)*8]);
+         res = do_READ(conn_no, req_session_id, req_offset, req_len);
+         if (k + 1 == req_n_ranges)
+            break;
+         if (!send_Frame(sd, res)) goto fail;
+         free_Frame(res);
+         res = NULL;
       }
    }
    else {
@@ -881,28 +986,7 @@ static Bool handle_transaction ( int conn_no )
    assert(res != NULL);
 
    /* And send the response frame back to the client. */
-   /* What goes on the wire is:
-         adler(le32) n_data(le32) data[0 .. n_data-1]
-      where the checksum covers n_data as well as data[].
-   */
-   /* The initial Adler-32 value */
-   adler = adler32(0, NULL, 0);
-
-   /* Fold in the length field, encoded as le32. */
-   UChar wr_first8[8];
-   write_UInt_le(&wr_first8[4], res->n_data);
-   adler = adler32(adler, &wr_first8[4], 4);
-   /* Fold in the data values */
-   adler = adler32(adler, res->data, res->n_data);
-   write_UInt_le(&wr_first8[0], adler);
-
-   Int r = my_write(sd, &wr_first8[0], 8);
-   if (r != 8) goto fail;
-   assert(res->n_data >= 4); // else ill formed -- no KIND field
-   r = my_write(sd, res->data, res->n_data);
-   if (r != res->n_data) goto fail;
-
-//printf("SERVER: send %c%c%c%c\n", res->data[0], res->data[1], res->data[2], res->data[3]); fflush(stdout);
+   if (!send_Frame(sd, res)) goto fail;
 
    /* So, success. */
    free_Frame(req);
@@ -1021,7 +1105,8 @@ static void usage ( void )
       "\n"
       "usage is:\n"
       "\n"
-      "   valgrind-di-server [--exit-at-zero|-e] [port-number]\n"
+      "   valgrind-di-server [--exit-at-zero|-e] [--max-connect=INT]\n"
+      "                      [--delay=MS] [port-number]\n"
       "\n"
       "   where   --exit-at-zero or -e causes the listener to exit\n"
       "           when the number of connections falls back to zero\n"
@@ -1031,6 +1116,10 @@ static void usage ( void )
       "           number of connected processes (default = %d).\n"
       "           INT must be positive and less than %d.\n"
       "\n"
+      "           --delay=MS waits MS milliseconds before answering\n"
+      "           each request, to simulate a slow network link\n"
+      "           (default = 0).\n"
+      "\n"
       "           port-number is the default port on which to listen for\n"
       "           connections.  It must be between 1024 and 65535.\n"
       "           Current default is %d.\n"
@@ -1084,6 +1173,11 @@ int main (int argc, char** argv)
          if (M_CONNECTIONS <= 0 || M_CONNECTIONS > M_CONNECTIONS_MAX)
             usage();
       }
+      else if (0 == strncmp(argv[i], "--delay=", 8)) {
+         clo_delay_ms = atoi_with_bound(strchr(argv[i], '=') + 1, 60000);
+         if (clo_delay_ms <= 0)
+            usage();
+      }
       else
       if (atoi_portno(argv[i]) > 0) {
          port = atoi_portno(argv[i]);
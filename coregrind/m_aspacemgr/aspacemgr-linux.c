@@ -353,6 +353,11 @@ static void parse_procselfmaps (
       void (*record_gap)( Addr addr, SizeT len )
    );
 
+#if defined(VGO_linux)
+static void read_smaps_thp ( /*OUT*/ULong* rss_bytes,
+                             /*OUT*/ULong* thp_bytes );
+#endif
+
 /* ----- Hacks to do with the "commpage" on arm-linux ----- */
 /* Not that I have anything against the commpage per se.  It's just
    that it's not listed in /proc/self/maps, which is a royal PITA --
@@ -672,7 +677,8 @@ static Bool maybe_merge_nsegments ( NSegment* s1, const NSegment* s2 )
 
       case SkAnonC: case SkAnonV:
          if (s1->hasR == s2->hasR && s1->hasW == s2->hasW 
-             && s1->hasX == s2->hasX && s1->isCH == s2->isCH) {
+             && s1->hasX == s2->hasX && s1->isCH == s2->isCH
+             && s1->isShared == s2->isShared) {
             s1->end = s2->end;
             s1->hasT |= s2->hasT;
             return True;
@@ -894,6 +900,15 @@ static void sync_check_mapping_callback ( Addr addr, SizeT len, UInt prot,
          seg_prot |= VKI_PROT_READ;
       }
 
+      /* With --smc-check=protect, pages of anonymous segments which
+         code has been translated from may have been write-protected
+         without telling us (see m_smcprotect.c). */
+      if (VG_(clo_smc_check) == Vg_SmcProtect
+          && nsegments[i].kind == SkAnonC && nsegments[i].hasT
+          && (prot & VKI_PROT_WRITE) == 0) {
+         seg_prot &= ~VKI_PROT_WRITE;
+      }
+
       same = same
              && seg_prot == prot
              && (cmp_devino
@@ -1493,6 +1508,7 @@ static void init_nsegment ( /*OUT*/NSegment* seg )
    seg->offset   = 0;
    seg->fnIdx    = -1;
    seg->hasR = seg->hasW = seg->hasX = seg->hasT = seg->isCH = False;
+   seg->isShared = False;
 }
 
 /* Make an NSegment which holds a reservation. */
@@ -2168,6 +2184,8 @@ VG_(am_notify_client_mmap)( Addr a, SizeT len, UInt prot, UInt flags,
    seg.hasR   = toBool(prot & VKI_PROT_READ);
    seg.hasW   = toBool(prot & VKI_PROT_WRITE);
    seg.hasX   = toBool(prot & VKI_PROT_EXEC);
+   if (flags & VKI_MAP_ANONYMOUS)
+      seg.isShared = toBool(flags & VKI_MAP_SHARED);
    if (!(flags & VKI_MAP_ANONYMOUS)) {
       // Nb: We ignore offset requests in anonymous mmaps (see bug #126722)
       seg.offset = offset;
@@ -2241,8 +2259,12 @@ Bool VG_(am_notify_mprotect)( Addr start, SizeT len, UInt prot )
    newW = toBool(prot & VKI_PROT_WRITE);
    newX = toBool(prot & VKI_PROT_EXEC);
 
-   /* Discard is needed if we're dumping X permission */
-   needDiscard = any_Ts_in_range( start, len ) && !newX;
+   /* Discard is needed if we're dumping X permission.  With
+      --smc-check=protect, it's needed regardless: translations taken
+      from memory that can't be written are given neither a self-check
+      nor write protection. */
+   needDiscard = any_Ts_in_range( start, len )
+                 && (!newX || VG_(clo_smc_check) == Vg_SmcProtect);
 
    split_nsegments_lo_and_hi( start, start+len-1, &iLo, &iHi );
 
@@ -2645,14 +2667,101 @@ SysRes VG_(am_mmap_anon_float_valgrind)( SizeT length )
    return sres;
 }
 
-/* Really just a wrapper around VG_(am_mmap_anon_float_valgrind). */
+/* Shadow memory.  Normally each VG_(am_shadow_alloc) call gets its own
+   mapping.  Tools make many small ones (64KB SecMaps for memcheck, for
+   example), and the pages they are spread over cost a lot of TLB
+   misses.  With --shadow-thp=yes, allocations are instead carved out
+   of 2MB-aligned regions which the kernel is asked to back with
+   transparent huge pages.  Allocations of half a region or more get
+   regions of their own.  Nothing is ever freed, so a simple bump
+   pointer will do. */
+
+#define SHADOW_REGION_SZB  (2 * 1024 * 1024)
+
+static AmShadowThpStats shadow_stats;
+
+#if defined(VGO_linux)
+static Addr shadow_next  = 0;   /* free space in the current region */
+static Addr shadow_limit = 0;
+
+/* Map LEN bytes, a multiple of SHADOW_REGION_SZB, at an address
+   aligned to SHADOW_REGION_SZB, and advise huge pages for them.
+   Returns 0 on failure. */
+static Addr shadow_map_region ( SizeT len )
+{
+   SysRes sres;
+   Addr   base, start, end;
+
+   sres = VG_(am_mmap_anon_float_valgrind)( len + SHADOW_REGION_SZB );
+   if (sr_isError(sres))
+      return 0;
+
+   /* Give back the misaligned ends. */
+   base  = sr_Res(sres);
+   start = VG_ROUNDUP(base, SHADOW_REGION_SZB);
+   end   = base + len + SHADOW_REGION_SZB;
+   if (start > base)
+      (void)VG_(am_munmap_valgrind)( base, start - base );
+   if (end > start + len)
+      (void)VG_(am_munmap_valgrind)( start + len, end - (start + len) );
+
+   sres = VG_(do_syscall3)( __NR_madvise, start, len, VKI_MADV_HUGEPAGE );
+   if (sr_isError(sres))
+      shadow_stats.n_madv_fails++;
+
+   shadow_stats.n_regions    += len / SHADOW_REGION_SZB;
+   shadow_stats.region_bytes += len;
+   return start;
+}
+#endif
 
 void* VG_(am_shadow_alloc)(SizeT size)
 {
-   SysRes sres = VG_(am_mmap_anon_float_valgrind)( size );
+   SysRes sres;
+
+#  if defined(VGO_linux)
+   if (VG_(clo_shadow_thp) && size > 0) {
+      Addr a = 0;
+      size = VG_PGROUNDUP(size);
+      if (size >= SHADOW_REGION_SZB / 2) {
+         a = shadow_map_region( VG_ROUNDUP(size, SHADOW_REGION_SZB) );
+      } else {
+         if (shadow_limit - shadow_next < size) {
+            /* The rest of the current region, if any, is wasted. */
+            Addr r = shadow_map_region( SHADOW_REGION_SZB );
+            if (r != 0) {
+               shadow_next  = r;
+               shadow_limit = r + SHADOW_REGION_SZB;
+            }
+         }
+         if (shadow_limit - shadow_next >= size) {
+            a = shadow_next;
+            shadow_next += size;
+         }
+      }
+      if (a != 0) {
+         shadow_stats.n_allocs++;
+         shadow_stats.alloc_bytes += size;
+         return (void*)a;
+      }
+      /* Can't get a region; try for a plain mapping instead. */
+   }
+#  endif
+
+   sres = VG_(am_mmap_anon_float_valgrind)( size );
    return sr_isError(sres) ? NULL : (void*)sr_Res(sres);
 }
 
+void VG_(am_get_shadow_thp_stats) ( /*OUT*/AmShadowThpStats* stats )
+{
+   *stats = shadow_stats;
+   stats->rss_bytes = stats->thp_bytes = 0;
+#  if defined(VGO_linux)
+   if (shadow_stats.n_regions > 0)
+      read_smaps_thp( &stats->rss_bytes, &stats->thp_bytes );
+#  endif
+}
+
 /* Map a file at an unconstrained address for V, and update the
    segment array accordingly. Use the provided flags */
 
@@ -3547,6 +3656,85 @@ static void parse_procselfmaps (
       (*record_gap) ( gapStart, Addr_MAX - gapStart + 1 );
 }
 
+/* Add up the Rss and AnonHugePages of the shadow regions, as given by
+   /proc/self/smaps.  They are the V-owned anonymous mappings which the
+   kernel flags "hg" (MADV_HUGEPAGE) -- nothing else of ours is.  The
+   file is far too big to read in one go, so read it a line at a
+   time, dropping the ends of overlong lines (which can only be
+   headers with long file names). */
+
+static HChar smaps_chunk[4096];
+static HChar smaps_line[256];
+
+static void read_smaps_thp ( /*OUT*/ULong* rss_bytes,
+                             /*OUT*/ULong* thp_bytes )
+{
+   SysRes fd;
+   Int    n_chunk, i, n_line = 0;
+   Bool   ours = False;
+   ULong  rss = 0, thp = 0, kb;
+   UWord  start;
+
+   *rss_bytes = *thp_bytes = 0;
+   fd = ML_(am_open)( "/proc/self/smaps", VKI_O_RDONLY, 0 );
+   if (sr_isError(fd))
+      return;
+
+   while ((n_chunk = ML_(am_read)( sr_Res(fd), smaps_chunk,
+                                   sizeof(smaps_chunk) )) > 0) {
+      for (i = 0; i < n_chunk; i++) {
+         if (smaps_chunk[i] != '\n') {
+            if (n_line < (Int)sizeof(smaps_line) - 1)
+               smaps_line[n_line++] = smaps_chunk[i];
+            continue;
+         }
+         smaps_line[n_line] = 0;
+         n_line = 0;
+
+         /* Look for the keys first: some, such as "AnonHugePages:",
+            start with a hex digit too. */
+         if (VG_(strncmp)(smaps_line, "Rss:", 4) == 0
+                  || VG_(strncmp)(smaps_line, "AnonHugePages:", 14) == 0) {
+            HChar* p = smaps_line;
+            while (*p != 0 && decdigit(*p) < 0)
+               p++;
+            readdec64(p, &kb);
+            if (smaps_line[0] == 'R')
+               rss = kb * 1024;
+            else
+               thp = kb * 1024;
+         }
+         else if (VG_(strncmp)(smaps_line, "VmFlags:", 8) == 0) {
+            /* The last line for each mapping. */
+            const HChar* p = smaps_line + 8;
+            Bool hg = False;
+            for (; *p != 0; p++) {
+               if (p[0] == ' ' && p[1] == 'h' && p[2] == 'g'
+                   && (p[3] == ' ' || p[3] == 0))
+                  hg = True;
+            }
+            if (ours && hg) {
+               *rss_bytes += rss;
+               *thp_bytes += thp;
+            }
+            ours = False;
+         }
+         else {
+            /* The header of a new mapping is "start-end perms ...";
+               any other line is of no interest. */
+            Int j = readhex(smaps_line, &start);
+            if (j > 0 && smaps_line[j] == '-') {
+               Int k = find_nsegment_idx(start);
+               ours = nsegments[k].kind == SkAnonV;
+               rss = thp = 0;
+            }
+         }
+      }
+   }
+
+   ML_(am_close)(sr_Res(fd));
+}
+
 /*------END-procmaps-parser-for-Linux----------------------------*/
 
 /*------BEGIN-procmaps-parser-for-Darwin-------------------------*/
@@ -43,6 +43,8 @@
 #include "pub_core_seqmatch.h"
 #include "pub_core_options.h"
 #include "pub_core_redir.h"      // VG_(redir_notify_{new,delete}_SegInfo)
+#include "pub_core_tccache.h"    // VG_(tccache_load_for_DebugInfo)
+#include "pub_core_sbprofile.h"  // VG_(hot_blocks_load_for_DebugInfo)
 #include "pub_core_aspacemgr.h"
 #include "pub_core_machine.h"    // VG_PLAT_USES_PPCTOC
 #include "pub_core_xarray.h"
@@ -60,6 +62,7 @@
 # include "priv_readelf.h"
 # include "priv_readdwarf3.h"
 # include "priv_readpdb.h"
+# include "priv_dicache.h"
 #elif defined(VGO_darwin)
 # include "priv_readmacho.h"
 # include "priv_readpdb.h"
@@ -162,6 +165,163 @@ static void move_DebugInfo_one_step_forward ( DebugInfo* di )
 }
 
 
+/*------------------------------------------------------------*/
+/*--- Address index                                        ---*/
+/*------------------------------------------------------------*/
+
+/* Finding the DebugInfo for a code address by walking debugInfo_list
+   is slow with hundreds of objects loaded, so two sorted arrays of
+   address ranges are kept alongside it: text_index covers the text
+   segments, and rx_index the r-x mappings.  Like the list, they
+   include DebugInfos whose debug info has not been read yet: m_redir
+   looks up symbols while an object is being loaded, before have_dinfo
+   is set, and an index built then must not leave the object out.
+   Rather than being updated piecemeal, the indexes are marked invalid
+   whenever DebugInfos come, go or change, and rebuilt the next time
+   they are needed.  Should any ranges overlap, which would
+   make the answer depend on the order of the list, the index is not
+   used and the list is searched as before. */
+
+typedef
+   struct {
+      Addr       lo;
+      Addr       hi;    // inclusive
+      DebugInfo* di;
+   }
+   DiIndexEnt;
+
+typedef
+   struct {
+      DiIndexEnt* ents;
+      Word        ents_used;
+      Word        ents_size;
+      Bool        valid;     // does it reflect debugInfo_list?
+      Bool        usable;    // if valid, are all the ranges disjoint?
+   }
+   DiIndex;
+
+static DiIndex text_index = { NULL, 0, 0, False, False };
+static DiIndex rx_index   = { NULL, 0, 0, False, False };
+
+/* For --stats. */
+static ULong n_index_lookups  = 0;
+static ULong n_index_fallback = 0;
+static ULong n_index_rebuilds = 0;
+
+static void di_index__invalidate ( void )
+{
+   text_index.valid = False;
+   rx_index.valid   = False;
+}
+
+static void add_to_DiIndex ( DiIndex* ix, Addr avma, SizeT size,
+                             DebugInfo* di )
+{
+   if (size == 0)
+      return;
+   if (ix->ents_used == ix->ents_size) {
+      ix->ents_size = ix->ents_size == 0 ? 64 : 2 * ix->ents_size;
+      ix->ents = ML_(dinfo_realloc)("di.debuginfo.atdi.1", ix->ents,
+                                    ix->ents_size * sizeof(DiIndexEnt));
+   }
+   ix->ents[ix->ents_used].lo = avma;
+   ix->ents[ix->ents_used].hi = avma + size - 1;
+   ix->ents[ix->ents_used].di = di;
+   ix->ents_used++;
+}
+
+static Int cmp_DiIndexEnt ( const void* v1, const void* v2 )
+{
+   const DiIndexEnt* e1 = v1;
+   const DiIndexEnt* e2 = v2;
+   if (e1->lo < e2->lo) return -1;
+   if (e1->lo > e2->lo) return 1;
+   return 0;
+}
+
+static void sort_DiIndex ( DiIndex* ix )
+{
+   Word i;
+   VG_(ssort)(ix->ents, ix->ents_used, sizeof(DiIndexEnt), cmp_DiIndexEnt);
+   ix->usable = True;
+   for (i = 1; i < ix->ents_used; i++) {
+      if (ix->ents[i].lo <= ix->ents[i-1].hi)
+         ix->usable = False;
+   }
+   ix->valid = True;
+}
+
+static void rebuild_DiIndexes ( void )
+{
+   DebugInfo* di;
+   Word       i;
+   n_index_rebuilds++;
+   text_index.ents_used = 0;
+   rx_index.ents_used   = 0;
+   for (di = debugInfo_list; di; di = di->next) {
+      if (di->text_present)
+         add_to_DiIndex(&text_index, di->text_avma, di->text_size, di);
+      if (di->fsm.have_rx_map) {
+         for (i = 0; i < VG_(sizeXA)(di->fsm.maps); i++) {
+            const DebugInfoMapping* map = VG_(indexXA)(di->fsm.maps, i);
+            if (map->rx)
+               add_to_DiIndex(&rx_index, map->avma, map->size, di);
+         }
+      }
+   }
+   sort_DiIndex(&text_index);
+   sort_DiIndex(&rx_index);
+}
+
+/* Look up |a| in |ix|, rebuilding the indexes first if need be.  If
+   the index can be used, set *pdi to the DebugInfo whose range
+   contains |a|, or to NULL if there is none, and return True.
+   Otherwise return False; the caller must then search debugInfo_list
+   itself. */
+static Bool lookup_DiIndex ( DiIndex* ix, Addr a, /*OUT*/DebugInfo** pdi )
+{
+   n_index_lookups++;
+   if (!ix->valid)
+      rebuild_DiIndexes();
+   vg_assert(ix->valid);
+   if (!ix->usable) {
+      n_index_fallback++;
+      return False;
+   }
+   /* The ranges are disjoint, so at most one contains |a|. */
+   Word lo = 0, hi = ix->ents_used - 1;
+   *pdi = NULL;
+   while (lo <= hi) {
+      Word mid = (lo + hi) / 2;
+      if (a < ix->ents[mid].lo) {
+         hi = mid - 1;
+      } else if (a > ix->ents[mid].hi) {
+         lo = mid + 1;
+      } else {
+         *pdi = ix->ents[mid].di;
+         break;
+      }
+   }
+   return True;
+}
+
+/* Find the DebugInfo whose text segment contains |a|, or NULL. */
+static DebugInfo* find_text_DebugInfo ( Addr a )
+{
+   DebugInfo* di;
+   if (lookup_DiIndex(&text_index, a, &di))
+      return di;
+   for (di = debugInfo_list; di != NULL; di = di->next) {
+      if (di->text_present
+          && di->text_size > 0
+          && di->text_avma <= a 
+          && a < di->text_avma + di->text_size)
+         return di;
+   }
+   return NULL;
+}
+
+
 /*------------------------------------------------------------*/
 /*--- Notification (acquire/discard) helpers               ---*/
 /*------------------------------------------------------------*/
@@ -211,13 +371,20 @@ static void free_DebugInfo ( DebugInfo* di )
    GExpr* gexpr;
 
    vg_assert(di != NULL);
+#  if defined(VGO_linux) || defined(VGO_solaris)
+   ML_(discard_elf_lazy_debug_info)(di);
+#  endif
    if (di->fsm.maps)     VG_(deleteXA)(di->fsm.maps);
    if (di->fsm.filename) ML_(dinfo_free)(di->fsm.filename);
    if (di->fsm.dbgname)  ML_(dinfo_free)(di->fsm.dbgname);
    if (di->soname)       ML_(dinfo_free)(di->soname);
+   if (di->buildid)      ML_(dinfo_free)(di->buildid);
    if (di->loctab)       ML_(dinfo_free)(di->loctab);
    if (di->loctab_fndn_ix) ML_(dinfo_free)(di->loctab_fndn_ix);
+   if (di->loccz)        ML_(dinfo_free)(di->loccz);
+   if (di->loccz_blk)    ML_(dinfo_free)(di->loccz_blk);
    if (di->inltab)       ML_(dinfo_free)(di->inltab);
+   if (di->inlnc)        ML_(dinfo_free)(di->inlnc);
    if (di->cfsi_base)    ML_(dinfo_free)(di->cfsi_base);
    if (di->cfsi_m_ix)    ML_(dinfo_free)(di->cfsi_m_ix);
    if (di->cfsi_rd)      ML_(dinfo_free)(di->cfsi_rd);
@@ -302,6 +469,21 @@ static void free_DebugInfo ( DebugInfo* di )
 }
 
 
+/* With --lazy-debuginfo=yes, read the line, inline and variable info
+   of DI, if that hasn't been done yet.  Call this before consulting
+   any of those. */
+static void load_lazy_DebugInfo ( DebugInfo* di )
+{
+#  if defined(VGO_linux) || defined(VGO_solaris)
+   if (UNLIKELY(di->lazy != NULL)) {
+      ML_(read_elf_lazy_debug_info)( di );
+      ML_(dicache_save)( di );
+      ML_(compress_loctab)( di );
+   }
+#  endif
+}
+
+
 /* 'si' is a member of debugInfo_list.  Find it, remove it from the
    list, notify m_redir that this has happened, and free all storage
    reachable from it.
@@ -327,6 +509,8 @@ static void discard_DebugInfo ( DebugInfo* di )
                          reason);
          vg_assert(*prev_next_ptr == curr);
          *prev_next_ptr = curr->next;
+         /* The caches may point into it. */
+         caches__invalidate();
          if (curr->have_dinfo)
             VG_(redir_notify_delete_DebugInfo)( curr );
          free_DebugInfo(curr);
@@ -479,6 +663,7 @@ static DebugInfo* find_or_create_DebugInfo_for ( const HChar* filename )
       vg_assert(di);
       di->next = debugInfo_list;
       debugInfo_list = di;
+      di_index__invalidate();
    }
    return di;
 }
@@ -743,9 +928,12 @@ static ULong di_notify_ACHIEVE_ACCEPT_STATE ( struct _DebugInfo* di )
       See http://bugzilla.mozilla.org/show_bug.cgi?id=788974 */
    truncate_DebugInfoMapping_overlaps( di, di->fsm.maps );
 
-   /* And acquire new info. */
+   /* And acquire new info, from the --debuginfo-cache-dir cache if
+      possible. */
 #  if defined(VGO_linux) || defined(VGO_solaris)
-   ok = ML_(read_elf_debug_info)( di );
+   ok = ML_(dicache_load)( di );
+   if (!ok)
+      ok = ML_(read_elf_debug_info)( di );
 #  elif defined(VGO_darwin)
    ok = ML_(read_macho_debug_info)( di );
 #  else
@@ -758,13 +946,27 @@ static ULong di_notify_ACHIEVE_ACCEPT_STATE ( struct _DebugInfo* di )
                    "acquired info ------\n");
       /* invalidate the debug info caches. */
       caches__invalidate();
-      /* prepare read data for use */
-      ML_(canonicaliseTables)( di );
-      /* Check invariants listed in
-         Comment_on_IMPORTANT_REPRESENTATIONAL_INVARIANTS in
-         priv_storage.h. */
-      check_CFSI_related_invariants(di);
-      ML_(finish_CFSI_arrays)(di);
+      /* Tables loaded from the cache are ready for use as they are,
+         and were checked before they were saved. */
+      if (!di->from_dicache) {
+         /* prepare read data for use */
+         ML_(canonicaliseTables)( di );
+         /* Check invariants listed in
+            Comment_on_IMPORTANT_REPRESENTATIONAL_INVARIANTS in
+            priv_storage.h. */
+         check_CFSI_related_invariants(di);
+         ML_(finish_CFSI_arrays)(di);
+#        if defined(VGO_linux) || defined(VGO_solaris)
+         /* With --lazy-debuginfo=yes, they are saved once the rest
+            has been read; see load_lazy_DebugInfo. */
+         if (!di->lazy)
+            ML_(dicache_save)( di );
+#        endif
+      }
+      /* Now nothing more needs the loctab as an array, unless some
+         of it is yet to be read. */
+      if (!di->lazy)
+         ML_(compress_loctab)( di );
       /* notify m_redir about it */
       TRACE_SYMTAB("\n------ Notifying m_redir ------\n");
       VG_(redir_notify_new_DebugInfo)( di );
@@ -772,14 +974,20 @@ static ULong di_notify_ACHIEVE_ACCEPT_STATE ( struct _DebugInfo* di )
       di->have_dinfo = True;
       vg_assert(di->handle > 0);
       di_handle = di->handle;
+      /* and reload any translations saved by an earlier run, or
+         failing that retranslate the blocks that were hot in it */
+      VG_(tccache_load_for_DebugInfo)( di );
+      VG_(hot_blocks_load_for_DebugInfo)( di );
 
    } else {
       TRACE_SYMTAB("\n------ ELF reading failed ------\n");
       /* Something went wrong (eg. bad ELF file).  Should we delete
          this DebugInfo?  No - it contains info on the rw/rx
-         mappings, at least. */
+         mappings, at least.  It may however have acquired a text
+         segment. */
       di_handle = 0;
       vg_assert(di->have_dinfo == False);
+      di_index__invalidate();
    }
 
    TRACE_SYMTAB("\n");
@@ -1049,6 +1257,7 @@ ULong VG_(di_notify_mmap)( Addr a, Bool allow_SkFileV, Int use_fd )
    map.rw   = is_rw_map;
    map.ro   = is_ro_map;
    VG_(addToXA)(di->fsm.maps, &map);
+   di_index__invalidate();
 
    /* Update flags about what kind of mappings we've already seen. */
    di->fsm.have_rx_map |= is_rx_map;
@@ -1412,6 +1621,8 @@ void VG_(di_notify_pdb_debuginfo)( Int fd_obj, Addr avma_obj,
      // JRS fixme: take notice of return value from read_pdb_debug_info,
      // and handle failure
      vg_assert(di->have_dinfo); // fails if PDB read failed
+     ML_(compress_loctab)( di );
+     di_index__invalidate();
      VG_(am_munmap_valgrind)( (Addr)pdbimage, n_pdbimage );
      VG_(close)(fd_pdbimage);
 
@@ -1443,6 +1654,7 @@ void VG_(di_discard_ALL_debuginfo)( void )
       di2 = di->next;
       VG_(printf)("XXX rm %p\n", di);
       free_DebugInfo( di );
+      di_index__invalidate();
       di = di2;
    }
 }
@@ -1478,10 +1690,9 @@ struct _InlIPCursor {
    Addr eip;             // Cursor used to describe calls at eip.
    DebugInfo* di;        // DebugInfo describing inlined calls at eip
 
-   Word    inltab_lopos; // The inlined fn calls covering eip are in
-   Word    inltab_hipos; // di->inltab[inltab_lopos..inltab_hipos].
-                         // Note that not all inlined fn calls in this range
-                         // are necessarily covering eip.
+   UWord   n_covering;   // The inlined fn calls covering eip are
+   UInt*   covering;     // di->inltab[covering[0 .. n_covering-1]],
+                         // in increasing order of position.
 
    Int   curlevel;       // Current level to describe.
                          // 0 means to describe eip itself.
@@ -1502,7 +1713,7 @@ static Bool is_bottom(const InlIPCursor *iipc)
 
 Bool VG_(next_IIPC)(InlIPCursor *iipc)
 {
-   Word i;
+   UWord i;
    DiInlLoc *hinl = NULL;
    Word hinl_pos = -1;
    DebugInfo *di;
@@ -1516,13 +1727,12 @@ Bool VG_(next_IIPC)(InlIPCursor *iipc)
    }
 
    di = iipc->di;
-   for (i = iipc->inltab_lopos; i <= iipc->inltab_hipos; i++) {
-      if (di->inltab[i].addr_lo <= iipc->eip 
-          && iipc->eip < di->inltab[i].addr_hi
-          && di->inltab[i].level < iipc->curlevel
-          && (!hinl || hinl->level < di->inltab[i].level)) {
-         hinl = &di->inltab[i];
-         hinl_pos = i;
+   for (i = 0; i < iipc->n_covering; i++) {
+      DiInlLoc *inl = &di->inltab[iipc->covering[i]];
+      if (inl->level < iipc->curlevel
+          && (!hinl || hinl->level < inl->level)) {
+         hinl = inl;
+         hinl_pos = iipc->covering[i];
       }
    }
    
@@ -1540,39 +1750,12 @@ Bool VG_(next_IIPC)(InlIPCursor *iipc)
 static void search_all_loctabs ( Addr ptr, /*OUT*/DebugInfo** pdi,
                                            /*OUT*/Word* locno );
 
-/* Returns the position after which eip would be inserted in inltab.
-   (-1 if eip should be inserted before position 0).
-   This is the highest position with an addr_lo <= eip.
-   As inltab is sorted on addr_lo, dichotomic search can be done
-   (note that inltab might have duplicates addr_lo). */
-static Word inltab_insert_pos (DebugInfo *di, Addr eip)
-{
-   Word mid, 
-        lo = 0, 
-        hi = di->inltab_used-1;
-   while (lo <= hi) {
-      mid      = (lo + hi) / 2;
-      if (eip < di->inltab[mid].addr_lo) { hi = mid-1; continue; } 
-      if (eip > di->inltab[mid].addr_lo) { lo = mid+1; continue; }
-      lo = mid; break;
-   }
-
-   while (lo <= di->inltab_used-1 && di->inltab[lo].addr_lo <= eip)
-      lo++;
-#if 0
-   for (mid = 0; mid <= di->inltab_used-1; mid++)
-      if (eip < di->inltab[mid].addr_lo)
-         break;
-   vg_assert (lo - 1 == mid - 1);
-#endif
-   return lo - 1;
-}
-
 InlIPCursor* VG_(new_IIPC)(Addr eip)
 {
    DebugInfo*  di;
    Word        locno;
-   Word        i;
+   UWord       n;
+   const UInt* covering;
    InlIPCursor *ret;
    Bool        avail;
 
@@ -1584,36 +1767,19 @@ InlIPCursor* VG_(new_IIPC)(Addr eip)
    if (di == NULL || di->inltab_used == 0)
       return NULL; // No di (with inltab) containing eip.
 
-   /* Search the entry in di->inltab with the highest addr_lo that
-      contains eip. */
-   /* We start from the highest pos in inltab after which eip would
-      be inserted. */
-   for (i = inltab_insert_pos (di, eip); i >= 0; i--) {
-      if (di->inltab[i].addr_lo <= eip && eip < di->inltab[i].addr_hi) {
-         break;
-      }
-      /* Stop the backward scan when reaching an addr_lo which
-         cannot anymore contain eip : we know that all ranges before
-         i also cannot contain eip. */
-      if (di->inltab[i].addr_lo < eip - di->maxinl_codesz)
-         return NULL;
-   }
-   
-   if (i < 0)
+   /* Find all the entries in di->inltab that contain eip. */
+   n = ML_(search_inltab) ( di, eip, &covering );
+   if (n == 0)
       return NULL; // No entry containing eip.
 
-   /* We have found the highest entry containing eip.
-      Build a cursor. */
-   ret = ML_(dinfo_zalloc) ("dinfo.new_IIPC", sizeof(*ret));
+   /* Build a cursor, keeping its own copy of them. */
+   ret = ML_(dinfo_zalloc) ("dinfo.new_IIPC",
+                            sizeof(*ret) + n * sizeof(UInt));
    ret->eip = eip;
    ret->di = di;
-   ret->inltab_hipos = i;
-   for (i = ret->inltab_hipos - 1; i >= 0; i--) {
-     
-      if (di->inltab[i].addr_lo < eip - di->maxinl_codesz)
-         break; /* Similar stop backward scan logic as above. */
-   }
-   ret->inltab_lopos = i + 1;
+   ret->n_covering = n;
+   ret->covering = (UInt*)(ret + 1);
+   VG_(memcpy)(ret->covering, covering, n * sizeof(UInt));
    ret->curlevel = MAX_LEVEL;
    ret->cur_inltab = -1;
    ret->next_inltab = -1;
@@ -1652,6 +1818,16 @@ static void search_all_symtabs ( Addr ptr, /*OUT*/DebugInfo** pdi,
    DebugInfo* di;
    Bool       inRange;
 
+   if (findText && lookup_DiIndex(&rx_index, ptr, &di)) {
+      if (di == NULL)
+         goto not_found;
+      sno = ML_(search_one_symtab) ( di, ptr, findText );
+      if (sno == -1) goto not_found;
+      *symno = sno;
+      *pdi = di;
+      return;
+   }
+
    for (di = debugInfo_list; di != NULL; di = di->next) {
 
       if (findText) {
@@ -1708,20 +1884,16 @@ static void search_all_loctabs ( Addr ptr, /*OUT*/DebugInfo** pdi,
                                            /*OUT*/Word* locno )
 {
    Word       lno;
-   DebugInfo* di;
-   for (di = debugInfo_list; di != NULL; di = di->next) {
-      if (di->text_present
-          && di->text_size > 0
-          && di->text_avma <= ptr 
-          && ptr < di->text_avma + di->text_size) {
-         lno = ML_(search_one_loctab) ( di, ptr );
-         if (lno == -1) goto not_found;
+   DebugInfo* di = find_text_DebugInfo( ptr );
+   if (di != NULL) {
+      load_lazy_DebugInfo( di );
+      lno = ML_(search_one_loctab) ( di, ptr );
+      if (lno != -1) {
          *locno = lno;
          *pdi = di;
          return;
       }
    }
-  not_found:
    *pdi = NULL;
 }
 
@@ -2049,14 +2221,10 @@ Bool VG_(get_objname) ( Addr a, const HChar** objname )
 
    /* Look in the debugInfo_list to find the name.  In most cases we
       expect this to produce a result. */
-   for (di = debugInfo_list; di != NULL; di = di->next) {
-      if (di->text_present
-          && di->text_size > 0
-          && di->text_avma <= a 
-          && a < di->text_avma + di->text_size) {
-         *objname = di->fsm.filename;
-         return True;
-      }
+   di = find_text_DebugInfo( a );
+   if (di != NULL) {
+      *objname = di->fsm.filename;
+      return True;
    }
    /* Last-ditch fallback position: if we don't find the address in
       the debugInfo_list, ask the address space manager whether it
@@ -2075,20 +2243,7 @@ Bool VG_(get_objname) ( Addr a, const HChar** objname )
    require debug info. */
 DebugInfo* VG_(find_DebugInfo) ( Addr a )
 {
-   static UWord n_search = 0;
-   DebugInfo* di;
-   n_search++;
-   for (di = debugInfo_list; di != NULL; di = di->next) {
-      if (di->text_present
-          && di->text_size > 0
-          && di->text_avma <= a 
-          && a < di->text_avma + di->text_size) {
-         if (0 == (n_search & 0xF))
-            move_DebugInfo_one_step_forward( di );
-         return di;
-      }
-   }
-   return NULL;
+   return find_text_DebugInfo( a );
 }
 
 /* Map a code address to a filename.  Returns True if successful. The
@@ -2113,14 +2268,69 @@ Bool VG_(get_linenum)( Addr a, UInt* lineno )
 {
    DebugInfo* si;
    Word       locno;
+   DiLoc      loc;
    search_all_loctabs ( a, &si, &locno );
    if (si == NULL) 
       return False;
-   *lineno = si->loctab[locno].lineno;
+   ML_(get_loc)(si, locno, &loc);
+   *lineno = loc.lineno;
 
    return True;
 }
 
+/* Caching of queries to source locations and of VG_(describe_IP)
+   results.  Error, leak and profile output symbolises the same code
+   addresses over and over, so remember the answers.  Both caches are
+   direct mapped, and are flushed whenever VG_(debuginfo_generation)
+   changes, since the strings they refer to may then be gone. */
+// Primes.
+#define N_SRCLOC_CACHE   4093
+#define N_DESCR_IP_CACHE 4093
+
+typedef
+   struct {
+      Addr         a;
+      Bool         used;
+      Bool         found;
+      UInt         lineno;
+      const HChar* filename;   // in the DebugInfo
+      const HChar* dirname;    // in the DebugInfo
+   }
+   SrcLoc_CacheEnt;
+
+typedef
+   struct {
+      Addr   eip;
+      Int    level;   // the inline cursor's level, or -1 if none
+      HChar* descr;   // ML_(dinfo_strdup)'d, or NULL if unused
+   }
+   DescrIP_CacheEnt;
+
+static SrcLoc_CacheEnt  srcloc_cache[N_SRCLOC_CACHE];
+static DescrIP_CacheEnt descr_ip_cache[N_DESCR_IP_CACHE];
+static UInt memo_generation = 0;
+
+/* For --stats. */
+static ULong n_srcloc_hits    = 0;
+static ULong n_srcloc_misses  = 0;
+static ULong n_descr_ip_hits   = 0;
+static ULong n_descr_ip_misses = 0;
+
+static void memo_caches__check_generation ( void )
+{
+   UInt gen = VG_(debuginfo_generation)();
+   if (LIKELY(gen == memo_generation))
+      return;
+   UInt i;
+   VG_(memset)(&srcloc_cache, 0, sizeof(srcloc_cache));
+   for (i = 0; i < N_DESCR_IP_CACHE; i++) {
+      if (descr_ip_cache[i].descr)
+         ML_(dinfo_free)(descr_ip_cache[i].descr);
+   }
+   VG_(memset)(&descr_ip_cache, 0, sizeof(descr_ip_cache));
+   memo_generation = gen;
+}
+
 /* Map a code address to a filename/line number/dir name info.
    See prototype for detailed description of behaviour.
 */
@@ -2129,12 +2339,37 @@ Bool VG_(get_filename_linenum) ( Addr a,
                                  /*OUT*/const HChar** dirname,
                                  /*OUT*/UInt* lineno )
 {
-   DebugInfo* si;
-   Word       locno;
-   UInt       fndn_ix;
+   memo_caches__check_generation();
+   SrcLoc_CacheEnt* se = &srcloc_cache[a % N_SRCLOC_CACHE];
 
-   search_all_loctabs ( a, &si, &locno );
-   if (si == NULL) {
+   if (se->used && se->a == a) {
+      n_srcloc_hits++;
+   } else {
+      DebugInfo* si;
+      Word       locno;
+      UInt       fndn_ix;
+      DiLoc      loc;
+
+      n_srcloc_misses++;
+      search_all_loctabs ( a, &si, &locno );
+      se->a    = a;
+      se->used = True;
+      if (si == NULL) {
+         se->found    = False;
+         se->filename = "";
+         se->dirname  = "";
+         se->lineno   = 0;
+      } else {
+         fndn_ix      = ML_(fndn_ix)(si, locno);
+         ML_(get_loc)(si, locno, &loc);
+         se->found    = True;
+         se->filename = ML_(fndn_ix2filename) (si, fndn_ix);
+         se->dirname  = ML_(fndn_ix2dirname) (si, fndn_ix);
+         se->lineno   = loc.lineno;
+      }
+   }
+
+   if (!se->found) {
       if (dirname) {
          *dirname = "";
       }
@@ -2142,13 +2377,12 @@ Bool VG_(get_filename_linenum) ( Addr a,
       return False;
    }
 
-   fndn_ix = ML_(fndn_ix)(si, locno);
-   *filename = ML_(fndn_ix2filename) (si, fndn_ix);
-   *lineno = si->loctab[locno].lineno;
+   *filename = se->filename;
+   *lineno = se->lineno;
 
    if (dirname) {
       /* caller wants directory info too .. */
-      *dirname = ML_(fndn_ix2dirname) (si, fndn_ix);
+      *dirname = se->dirname;
    }
 
    return True;
@@ -2272,6 +2506,20 @@ const HChar* VG_(describe_IP)(Addr eip, const InlIPCursor *iipc)
 
    vg_assert (!iipc || iipc->eip == eip);
 
+   /* Have we described this already?  The result depends only on eip,
+      the inline level and the command line options. */
+   memo_caches__check_generation();
+   Int level = iipc ? iipc->curlevel : -1;
+   DescrIP_CacheEnt* ce
+      = &descr_ip_cache[(eip ^ (UWord)(level + 1) * 0x9E3779B1UL)
+                        % N_DESCR_IP_CACHE];
+   if (ce->descr && ce->eip == eip && ce->level == level) {
+      n_descr_ip_hits++;
+      APPEND(ce->descr);
+      return buf;
+   }
+   n_descr_ip_misses++;
+
    const HChar *buf_fn;
    const HChar *buf_obj;
    const HChar *buf_srcloc;
@@ -2448,6 +2696,17 @@ const HChar* VG_(describe_IP)(Addr eip, const InlIPCursor *iipc)
       }
 
    }
+
+   /* Only remember descriptions that came from debug info.  Anything
+      else comes from the address space manager, which can change its
+      mind without VG_(debuginfo_generation) changing. */
+   if (find_text_DebugInfo(eip) != NULL) {
+      if (ce->descr)
+         ML_(dinfo_free)(ce->descr);
+      ce->eip   = eip;
+      ce->level = level;
+      ce->descr = ML_(dinfo_strdup)("di.debuginfo.describe_IP.1", buf);
+   }
    return buf;
 
 #  undef APPEND
@@ -2686,40 +2945,119 @@ static void find_DiCfSI ( /*OUT*/DebugInfo** diP,
    Also, the cache is invalidated when new debuginfo is read due to
    an mmap or some debuginfo is discarded due to an munmap. */
 
-// Prime number, giving about 6Kbytes cache on 32 bits,
-//                           12Kbytes cache on 64 bits.
-#define N_CFSI_M_CACHE 509
+// A prime number of sets, each of N_CFSI_M_CACHE_WAYS entries, kept in
+// most-recently-used-first order.  About 100Kbytes on amd64.
+#define N_CFSI_M_CACHE_SETS 509
+#define N_CFSI_M_CACHE_WAYS 4
 
 typedef
-   struct { Addr ip; DebugInfo* di; DiCfSI_m* cfsi_m; }
+   struct {
+      Addr       ip;
+      DebugInfo* di;
+      DiCfSI_m*  cfsi_m;
+#     if defined(VGA_x86) || defined(VGA_amd64)
+      /* A precompiled copy of the rule, if it has the usual shape.  If
+         |simple|, then
+            CFA = (cfa_bp ? BP : SP) + cfa_off
+            RA  = [CFA + ra_off]
+            SP  = CFA + sp_off
+            BP  = bp_same ? BP : [CFA + bp_off]
+         and VG_(use_CF_info) can apply it directly, without going
+         through cfsi_m. */
+      Bool       simple;
+      Bool       cfa_bp;
+      Bool       bp_same;
+      Int        cfa_off;
+      Int        ra_off;
+      Int        sp_off;
+      Int        bp_off;
+#     endif
+   }
    CFSI_m_CacheEnt;
 
-static CFSI_m_CacheEnt cfsi_m_cache[N_CFSI_M_CACHE];
+static CFSI_m_CacheEnt cfsi_m_cache[N_CFSI_M_CACHE_SETS][N_CFSI_M_CACHE_WAYS];
+
+/* For --stats. */
+static ULong n_cfsi_m_cache_hits   = 0;
+static ULong n_cfsi_m_cache_misses = 0;
+static ULong n_cfsi_simple_unwinds = 0;
 
 static void cfsi_m_cache__invalidate ( void ) {
    VG_(memset)(&cfsi_m_cache, 0, sizeof(cfsi_m_cache));
 }
 
+/* Fill in the precompiled form of ce's rule, if it has one. */
+static void cfsi_m_cache__precompile ( CFSI_m_CacheEnt* ce )
+{
+#  if defined(VGA_x86) || defined(VGA_amd64)
+   ce->simple = False;
+   if (ce->di == (DebugInfo*)1)
+      return;
+   const DiCfSI_m* m = ce->cfsi_m;
+   if ((m->cfa_how == CFIC_IA_SPREL || m->cfa_how == CFIC_IA_BPREL)
+       && m->ra_how == CFIR_MEMCFAREL
+       && m->sp_how == CFIR_CFAREL
+       && (m->bp_how == CFIR_SAME || m->bp_how == CFIR_MEMCFAREL)) {
+      ce->simple  = True;
+      ce->cfa_bp  = m->cfa_how == CFIC_IA_BPREL;
+      ce->bp_same = m->bp_how == CFIR_SAME;
+      ce->cfa_off = m->cfa_off;
+      ce->ra_off  = m->ra_off;
+      ce->sp_off  = m->sp_off;
+      ce->bp_off  = m->bp_off;
+   }
+#  endif
+}
+
+/* Look for ip in the rest of |set|, and failing that, search for it
+   and replace the LRU entry.  Either way, the entry ends up at the
+   front of the set. */
+__attribute__((noinline))
+static CFSI_m_CacheEnt* cfsi_m_cache__find_slow ( CFSI_m_CacheEnt* set,
+                                                  Addr ip )
+{
+   CFSI_m_CacheEnt tmp;
+   UInt w;
+   for (w = 1; w < N_CFSI_M_CACHE_WAYS; w++) {
+      if (set[w].ip == ip && set[w].di != NULL)
+         break;
+   }
+   if (w < N_CFSI_M_CACHE_WAYS) {
+      n_cfsi_m_cache_hits++;
+      tmp = set[w];
+   } else {
+      n_cfsi_m_cache_misses++;
+      w = N_CFSI_M_CACHE_WAYS - 1;
+      tmp.ip = ip;
+      find_DiCfSI( &tmp.di, &tmp.cfsi_m, ip );
+      cfsi_m_cache__precompile( &tmp );
+   }
+   for (; w > 0; w--)
+      set[w] = set[w-1];
+   set[0] = tmp;
+   return &set[0];
+}
+
+/* Returns NULL if there is no CFI for ip.  The result is only valid
+   until the next call. */
 static inline CFSI_m_CacheEnt* cfsi_m_cache__find ( Addr ip )
 {
-   UWord         hash = ip % N_CFSI_M_CACHE;
-   CFSI_m_CacheEnt* ce = &cfsi_m_cache[hash];
+   CFSI_m_CacheEnt* set = cfsi_m_cache[ip % N_CFSI_M_CACHE_SETS];
+   CFSI_m_CacheEnt* ce;
 #  ifdef N_Q_M_STATS
-   static UWord  n_q = 0, n_m = 0;
+   static UWord  n_q = 0;
    n_q++;
    if (0 == (n_q & 0x1FFFFF))
-      VG_(printf)("QQQ %lu %lu\n", n_q, n_m);
+      VG_(printf)("QQQ %lu %llu\n", n_q, n_cfsi_m_cache_misses);
 #  endif
 
-   if (LIKELY(ce->ip == ip) && LIKELY(ce->di != NULL)) {
+   if (LIKELY(set[0].ip == ip) && LIKELY(set[0].di != NULL)) {
       /* found an entry in the cache .. */
+      n_cfsi_m_cache_hits++;
+      ce = &set[0];
    } else {
-      /* not found in cache.  Search and update. */
-#     ifdef N_Q_M_STATS
-      n_m++;
-#     endif
-      ce->ip = ip;
-      find_DiCfSI( &ce->di, &ce->cfsi_m, ip );
+      /* not at the front of its set.  Look further, or search. */
+      ce = cfsi_m_cache__find_slow(set, ip);
    }
 
    if (UNLIKELY(ce->di == (DebugInfo*)1)) {
@@ -2880,30 +3218,32 @@ Addr ML_(get_CFA) ( Addr ip, Addr sp, Addr fp,
 
 void VG_(ppUnwindInfo) (Addr from, Addr to)
 {
-   DebugInfo*         di;
-   CFSI_m_CacheEnt*   ce;
+   /* Cache entries don't stay put, so copy out what is needed. */
+   DebugInfo*         di = NULL;
+   DiCfSI_m*          cfsi_m = NULL;
    Addr ce_from;
    CFSI_m_CacheEnt*   next_ce;
 
-
-   ce = cfsi_m_cache__find(from);
+   next_ce = cfsi_m_cache__find(from);
+   if (next_ce) {
+      di = next_ce->di;
+      cfsi_m = next_ce->cfsi_m;
+   }
    ce_from = from;
    while (from <= to) {
       from++;
       next_ce = cfsi_m_cache__find(from);
-      if ((ce == NULL && next_ce != NULL)
-          || (ce != NULL && next_ce == NULL)
-          || (ce != NULL && next_ce != NULL && ce->cfsi_m != next_ce->cfsi_m)
-          || from > to) {
-         if (ce == NULL) {
+      DiCfSI_m* next_cfsi_m = next_ce ? next_ce->cfsi_m : NULL;
+      if (cfsi_m != next_cfsi_m || from > to) {
+         if (cfsi_m == NULL) {
             VG_(printf)("[%#lx .. %#lx]: no CFI info\n", ce_from, from-1);
          } else {
-            di = ce->di;
             ML_(ppDiCfSI)(di->cfsi_exprs,
                           ce_from, from - ce_from,
-                          ce->cfsi_m);
+                          cfsi_m);
          }
-         ce = next_ce;
+         di = next_ce ? next_ce->di : NULL;
+         cfsi_m = next_cfsi_m;
          ce_from = from;
       }
    }
@@ -2954,6 +3294,33 @@ Bool VG_(use_CF_info) ( /*MOD*/D3UnwindRegs* uregsHere,
    if (UNLIKELY(ce == NULL))
       return False; /* no info.  Nothing we can do. */
 
+#  if defined(VGA_x86) || defined(VGA_amd64)
+   /* The usual case: apply the precompiled rule directly.  This does
+      the same as the general code below would. */
+   if (LIKELY(ce->simple)) {
+      Addr ra_a, bp_a, bp;
+      n_cfsi_simple_unwinds++;
+      cfa = ce->cfa_off + (ce->cfa_bp ? uregsHere->xbp : uregsHere->xsp);
+      if (UNLIKELY(cfa == 0))
+         return False;
+      ra_a = cfa + (Word)ce->ra_off;
+      if (ra_a < min_accessible || ra_a > max_accessible-sizeof(Addr))
+         return False;
+      if (ce->bp_same) {
+         bp = uregsHere->xbp;
+      } else {
+         bp_a = cfa + (Word)ce->bp_off;
+         if (bp_a < min_accessible || bp_a > max_accessible-sizeof(Addr))
+            return False;
+         bp = ML_(read_Addr)((void *)bp_a);
+      }
+      uregsHere->xip = ML_(read_Addr)((void *)ra_a);
+      uregsHere->xsp = cfa + (Word)ce->sp_off;
+      uregsHere->xbp = bp;
+      return True;
+   }
+#  endif
+
    di = ce->di;
    cfsi_m = ce->cfsi_m;
 
@@ -3586,21 +3953,10 @@ Bool consider_vars_in_frame ( /*MOD*/XArray* /* of HChar */ dname1,
    RegSummary regs;
    Bool debug = False;
 
-   static UInt n_search = 0;
-   static UInt n_steps = 0;
-   n_search++;
    if (debug)
       VG_(printf)("QQQQ: cvif: ip,sp,fp %#lx,%#lx,%#lx\n", ip,sp,fp);
    /* first, find the DebugInfo that pertains to 'ip'. */
-   for (di = debugInfo_list; di; di = di->next) {
-      n_steps++;
-      /* text segment missing? unlikely, but handle it .. */
-      if (!di->text_present || di->text_size == 0)
-         continue;
-      /* Ok.  So does this text mapping bracket the ip? */
-      if (di->text_avma <= ip && ip < di->text_avma + di->text_size)
-         break;
-   }
+   di = find_text_DebugInfo( ip );
  
    /* Didn't find it.  Strange -- means ip is a code address outside
       of any mapped text segment.  Unlikely but not impossible -- app
@@ -3608,20 +3964,7 @@ Bool consider_vars_in_frame ( /*MOD*/XArray* /* of HChar */ dname1,
    if (!di)
       return False;
 
-   if (0 && ((n_search & 0x1) == 0))
-      VG_(printf)("consider_vars_in_frame: %u searches, "
-                  "%u DebugInfos looked at\n", 
-                  n_search, n_steps);
-   /* Start of performance-enhancing hack: once every ??? (chosen
-      hackily after profiling) successful searches, move the found
-      DebugInfo one step closer to the start of the list.  This makes
-      future searches cheaper. */
-   if ((n_search & 0xFFFF) == 0) {
-      /* Move si one step closer to the start of the list. */
-      move_DebugInfo_one_step_forward( di );
-   }
-   /* End of performance-enhancing hack. */
-
+   load_lazy_DebugInfo( di );
    /* any var info at all? */
    if (!di->varinfo)
       return False;
@@ -3740,6 +4083,10 @@ Bool VG_(get_data_description)(
       /* text segment missing? unlikely, but handle it .. */
       if (!di->text_present || di->text_size == 0)
          continue;
+      /* reading deferred info for every object is only worth it
+         if that brings var info */
+      if (VG_(clo_read_var_info))
+         load_lazy_DebugInfo( di );
       /* any var info at all? */
       if (!di->varinfo)
          continue;
@@ -4030,21 +4377,10 @@ VG_(di_get_stack_blocks_at_ip)( Addr ip, Bool arrays_only )
                              ML_(dinfo_free),
                              sizeof(StackBlock) );
 
-   static UInt n_search = 0;
-   static UInt n_steps = 0;
-   n_search++;
    if (debug)
       VG_(printf)("QQQQ: dgsbai: ip %#lx\n", ip);
    /* first, find the DebugInfo that pertains to 'ip'. */
-   for (di = debugInfo_list; di; di = di->next) {
-      n_steps++;
-      /* text segment missing? unlikely, but handle it .. */
-      if (!di->text_present || di->text_size == 0)
-         continue;
-      /* Ok.  So does this text mapping bracket the ip? */
-      if (di->text_avma <= ip && ip < di->text_avma + di->text_size)
-         break;
-   }
+   di = find_text_DebugInfo( ip );
  
    /* Didn't find it.  Strange -- means ip is a code address outside
       of any mapped text segment.  Unlikely but not impossible -- app
@@ -4052,20 +4388,7 @@ VG_(di_get_stack_blocks_at_ip)( Addr ip, Bool arrays_only )
    if (!di)
       return res; /* currently empty */
 
-   if (0 && ((n_search & 0x1) == 0))
-      VG_(printf)("VG_(di_get_stack_blocks_at_ip): %u searches, "
-                  "%u DebugInfos looked at\n", 
-                  n_search, n_steps);
-   /* Start of performance-enhancing hack: once every ??? (chosen
-      hackily after profiling) successful searches, move the found
-      DebugInfo one step closer to the start of the list.  This makes
-      future searches cheaper. */
-   if ((n_search & 0xFFFF) == 0) {
-      /* Move si one step closer to the start of the list. */
-      move_DebugInfo_one_step_forward( di );
-   }
-   /* End of performance-enhancing hack. */
-
+   load_lazy_DebugInfo( di );
    /* any var info at all? */
    if (!di->varinfo)
       return res; /* currently empty */
@@ -4158,6 +4481,7 @@ VG_(di_get_global_blocks_from_dihandle) ( ULong di_handle, Bool  arrays_only )
    gvars = VG_(newXA)( ML_(dinfo_zalloc), "di.debuginfo.dggbfd.1",
                        ML_(dinfo_free), sizeof(GlobalBlock) );
 
+   load_lazy_DebugInfo( di );
    /* any var info at all? */
    if (!di->varinfo)
       return gvars;
@@ -4332,6 +4656,11 @@ const HChar* VG_(DebugInfo_get_filename)(const DebugInfo* di)
    return di->fsm.filename;
 }
 
+const HChar* VG_(DebugInfo_get_buildid)(const DebugInfo* di)
+{
+   return di->buildid;
+}
+
 PtrdiffT VG_(DebugInfo_get_text_bias)(const DebugInfo* di)
 {
    return di->text_present ? di->text_bias : 0;
@@ -4485,9 +4814,34 @@ UInt VG_(debuginfo_generation) (void)
    return debuginfo_generation;
 }
 
+void VG_(print_debuginfo_stats) ( void )
+{
+   VG_(message)(Vg_DebugMsg,
+                " debuginfo: %'llu address index lookups "
+                "(%'llu fell back to a list scan), %'llu rebuilds\n",
+                n_index_lookups, n_index_fallback, n_index_rebuilds);
+   VG_(message)(Vg_DebugMsg,
+                " debuginfo: srcloc cache %'llu hits, %'llu misses; "
+                "describe_IP cache %'llu hits, %'llu misses\n",
+                n_srcloc_hits, n_srcloc_misses,
+                n_descr_ip_hits, n_descr_ip_misses);
+   VG_(message)(Vg_DebugMsg,
+                " debuginfo: cfsi cache %'llu hits, %'llu misses; "
+                "%'llu unwinds by precompiled rule\n",
+                n_cfsi_m_cache_hits, n_cfsi_m_cache_misses,
+                n_cfsi_simple_unwinds);
+   ML_(loctab_print_stats)();
+   VG_(demangle_print_stats)();
+   ML_(img_print_stats)();
+#  if defined(VGO_linux) || defined(VGO_solaris)
+   ML_(dicache_print_stats)();
+#  endif
+}
+
 static void caches__invalidate ( void ) {
    cfsi_m_cache__invalidate();
    sym_name_cache__invalidate();
+   di_index__invalidate();
    debuginfo_generation++;
 }
 
@@ -0,0 +1,1006 @@
+/* -*- mode: C; c-basic-offset: 3; -*- */
+
+/*--------------------------------------------------------------------*/
+/*--- On-disk cache of canonicalised debuginfo.           dicache.c ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Valgrind, a dynamic binary instrumentation
+   framework.
+
+   Copyright (C) 2015-2015 The Valgrind developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#if defined(VGO_linux) || defined(VGO_solaris)
+
+#include "pub_core_basics.h"
+#include "pub_core_vki.h"
+#include "pub_core_debuginfo.h"
+#include "pub_core_libcbase.h"
+#include "pub_core_libcassert.h"
+#include "pub_core_libcfile.h"
+#include "pub_core_libcprint.h"
+#include "pub_core_libcproc.h"     // VG_(getpid)
+#include "pub_core_options.h"
+#include "pub_core_xarray.h"
+#include "pub_core_wordfm.h"
+#include "priv_misc.h"             /* dinfo_zalloc/free/strdup */
+#include "priv_image.h"
+#include "priv_d3basics.h"
+#include "priv_tytypes.h"
+#include "priv_storage.h"
+#include "priv_readelf.h"          /* ML_(read_elf_buildid) */
+#include "priv_dicache.h"          /* self */
+
+
+/*------------------------------------------------------------*/
+/*--- Overview                                             ---*/
+/*------------------------------------------------------------*/
+
+/* Once ML_(canonicaliseTables) and ML_(finish_CFSI_arrays) have run,
+   the symbol, line, inline and CFI tables of a DebugInfo are sorted
+   arrays, and almost all of them can be written out as they are.
+   With --debuginfo-cache-dir=<dir> they are, one file per object,
+   named after the object's build-id and modification time.  When an
+   object with a cached file is loaded again, its tables are read
+   back from the file, and the ELF and DWARF are not looked at at all
+   (other than to find the build-id).
+
+   The tables hold AVMAs, which depend on where the object is mapped.
+   They are not relocated: the file records the object's mappings,
+   and is only used if the object is mapped at the same addresses
+   again, which is the normal case given the deterministic placement
+   of client mappings.  Otherwise the object is read as usual and the
+   file is rewritten.
+
+   Pointers into the string pool (symbol and inlined function names,
+   and the filename/dirname pairs) are written as string numbers, and
+   the strings and pairs are put back into fresh pools when loading.
+   The line table and the CFI refer to the pairs and to the CFI pool
+   by index, and these come out in the same order, so those tables
+   are copied unchanged.
+
+   Each file starts with a header which, besides the table sizes,
+   holds a hash (see compute_key) of everything that decides what
+   ends up in the tables apart from the object itself: the Valgrind
+   version, the sizes of the table entries and the options that
+   control what is read.  A checksum of the rest of the file is
+   checked before anything in it is used, and so is every string
+   number and index in it (see payload_ok): a file which is not as
+   this code would have written it is discarded, like one whose
+   checksum is wrong.
+
+   Variable info is not cached; with --read-var-info=yes, or a tool
+   needing it, the cache is not used.  Neither is it for objects
+   without a build-id.  Info found in a separate debuginfo object is
+   cached along with the rest, so if such an object is installed
+   after the cache file was written, the cache file must be removed
+   for it to be seen.
+
+   File layout, all in host byte order:
+
+      DICFileHeader
+      n_maps            x DICMap
+      DIC_SECT_SZB      bytes of DebugInfo section fields
+      strs_szB          bytes of zero-terminated strings
+      n_fndn            x DICFnDn
+      symtab_used       x DICSym
+      n_sec_names       x UInt (string numbers)
+      loctab_used       x DiLoc
+      loctab_used       x sizeof_fndn_ix bytes
+      inltab_used       x DICInl
+      cfsi_used         x Addr
+      cfsi_used         x sizeof_cfsi_m_ix bytes
+      n_cfsi_m          x DiCfSI_m
+      n_cfsi_exprs      x CfiExpr
+*/
+
+
+/*------------------------------------------------------------*/
+/*--- File format                                          ---*/
+/*------------------------------------------------------------*/
+
+#define DIC_MAGIC "VGDIC001"
+
+typedef
+   struct {
+      HChar magic[8];      /* DIC_MAGIC, without the terminating zero */
+      ULong key;           /* compute_key() of the run that wrote it */
+      ULong payload_sum;   /* fnv1a of everything after the header */
+      ULong payload_szB;
+      ULong mtime;         /* of the object, when it was read */
+      ULong mtime_nsec;
+      Long  obj_size;
+      UInt  n_maps;
+      UInt  n_strs;
+      ULong strs_szB;
+      UInt  soname;        /* string number, or 0 */
+      UInt  n_fndn;
+      UWord symtab_used;
+      UWord n_sec_names;
+      UWord loctab_used;
+      UInt  sizeof_fndn_ix;
+      UInt  sizeof_cfsi_m_ix;
+      UWord inltab_used;
+      SizeT maxinl_codesz;
+      UWord cfsi_used;
+      Addr  cfsi_minavma;
+      Addr  cfsi_maxavma;
+      UInt  n_cfsi_m;
+      UInt  n_cfsi_exprs;
+   }
+   DICFileHeader;
+
+typedef
+   struct {
+      Addr  avma;
+      SizeT size;
+      OffT  foff;
+      UChar rx, rw, ro, unused;
+   }
+   DICMap;
+
+typedef
+   struct {
+      UInt filename;       /* string numbers; 0 is NULL */
+      UInt dirname;
+   }
+   DICFnDn;
+
+typedef
+   struct {
+      SymAVMAs avmas;
+      UInt     size;
+      UInt     pri_name;
+      UInt     n_sec_names;
+      UChar    isText, isIFunc, isGlobal, unused;
+   }
+   DICSym;
+
+typedef
+   struct {
+      Addr  addr_lo;
+      Addr  addr_hi;
+      UInt  inlinedfn;
+      UInt  fndn_ix;
+      UInt  lineno;
+      UInt  level;
+   }
+   DICInl;
+
+/* The fields of a DebugInfo describing its sections, from text_present
+   up to the tables, are plain values and are copied as a block. */
+#define DIC_SECT_OFF  offsetof(struct _DebugInfo, text_present)
+#define DIC_SECT_SZB  (offsetof(struct _DebugInfo, symtab) - DIC_SECT_OFF)
+
+
+/*------------------------------------------------------------*/
+/*--- State and stats                                      ---*/
+/*------------------------------------------------------------*/
+
+typedef enum { DicUnknown, DicOn, DicOff } DicState;
+
+static DicState dic_state = DicUnknown;
+static ULong    dic_key   = 0;
+
+static ULong n_dic_loaded      = 0;
+static ULong n_dic_bytes_read  = 0;
+static ULong n_dic_missed      = 0;
+static ULong n_dic_stale       = 0;
+static ULong n_dic_saved       = 0;
+static ULong n_dic_bytes_saved = 0;
+
+/* 64-bit FNV-1a. */
+#define FNV1A_INIT 0xcbf29ce484222325ULL
+
+static ULong fnv1a ( ULong h, const void* p, SizeT n )
+{
+   const UChar* b = p;
+   SizeT i;
+   for (i = 0; i < n; i++) {
+      h ^= b[i];
+      h *= 0x100000001b3ULL;
+   }
+   return h;
+}
+
+static ULong fnv1a_str ( ULong h, const HChar* s )
+{
+   return fnv1a(h, s ? s : "", s ? VG_(strlen)(s) + 1 : 1);
+}
+
+static ULong compute_key ( void )
+{
+   ULong h = FNV1A_INIT;
+   UWord sizes[9];
+   Bool  flags[2];
+
+   h = fnv1a_str(h, VERSION);
+   sizes[0] = sizeof(struct _DebugInfo);
+   sizes[1] = DIC_SECT_OFF;
+   sizes[2] = sizeof(DiSym);
+   sizes[3] = sizeof(DiLoc);
+   sizes[4] = sizeof(DiInlLoc);
+   sizes[5] = sizeof(DiCfSI_m);
+   sizes[6] = sizeof(CfiExpr);
+   sizes[7] = sizeof(SymAVMAs);
+   sizes[8] = sizeof(DICFileHeader);
+   h = fnv1a(h, sizes, sizeof(sizes));
+
+   /* Options deciding what is read, and from where. */
+   flags[0] = VG_(clo_read_inline_info);
+   flags[1] = VG_(clo_allow_mismatched_debuginfo);
+   h = fnv1a(h, flags, sizeof(flags));
+   h = fnv1a_str(h, VG_(clo_extra_debuginfo_path));
+   h = fnv1a_str(h, VG_(clo_debuginfo_server));
+   return h;
+}
+
+static Bool dicache_enabled ( void )
+{
+   if (dic_state != DicUnknown)
+      return dic_state == DicOn;
+
+   dic_state = DicOff;
+   if (VG_(clo_debuginfo_cache_dir) == NULL)
+      return False;
+   if (VG_(clo_read_var_info)) {
+      VG_(message)(Vg_UserMsg,
+                   "Warning: --debuginfo-cache-dir is ignored when variable"
+                   " info is read\n");
+      return False;
+   }
+   if (!VG_(is_dir)(VG_(clo_debuginfo_cache_dir))) {
+      VG_(message)(Vg_UserMsg,
+                   "Warning: --debuginfo-cache-dir=%s is not a directory;"
+                   " ignored\n", VG_(clo_debuginfo_cache_dir));
+      return False;
+   }
+
+   dic_key   = compute_key();
+   dic_state = DicOn;
+   if (VG_(clo_verbosity) > 1)
+      VG_(message)(Vg_DebugMsg, "debuginfo-cache: using %s, key %016llx\n",
+                   VG_(clo_debuginfo_cache_dir), dic_key);
+   return True;
+}
+
+/* Returns the name of the cache file for an object with BUILDID and
+   status ST, in ML_(dinfo_zalloc)'d storage. */
+static HChar* cache_file_name ( const HChar* buildid,
+                                const struct vg_stat* st )
+{
+   HChar* name = ML_(dinfo_zalloc)("di.dicache.cfn.1",
+                                   VG_(strlen)(VG_(clo_debuginfo_cache_dir))
+                                   + VG_(strlen)(buildid) + 64);
+   VG_(sprintf)(name, "%s/%s-%llx.dic",
+                VG_(clo_debuginfo_cache_dir), buildid, st->mtime);
+   return name;
+}
+
+static Bool same_maps ( const DebugInfo* di,
+                        const DICMap* maps, UInt n_maps )
+{
+   UInt i;
+
+   if (VG_(sizeXA)(di->fsm.maps) != n_maps)
+      return False;
+   for (i = 0; i < n_maps; i++) {
+      const DebugInfoMapping* map = VG_(indexXA)(di->fsm.maps, i);
+      if (map->avma != maps[i].avma || map->size != maps[i].size
+          || map->foff != maps[i].foff || map->rx != maps[i].rx
+          || map->rw != maps[i].rw || map->ro != maps[i].ro)
+         return False;
+   }
+   return True;
+}
+
+
+/*------------------------------------------------------------*/
+/*--- Loading                                              ---*/
+/*------------------------------------------------------------*/
+
+/* Total size of what follows the header, as described by it. */
+static ULong payload_szB ( const DICFileHeader* fh )
+{
+   return (ULong)fh->n_maps * sizeof(DICMap)
+          + DIC_SECT_SZB
+          + fh->strs_szB
+          + (ULong)fh->n_fndn * sizeof(DICFnDn)
+          + (ULong)fh->symtab_used * sizeof(DICSym)
+          + (ULong)fh->n_sec_names * sizeof(UInt)
+          + (ULong)fh->loctab_used * (sizeof(DiLoc) + fh->sizeof_fndn_ix)
+          + (ULong)fh->inltab_used * sizeof(DICInl)
+          + (ULong)fh->cfsi_used * (sizeof(Addr) + fh->sizeof_cfsi_m_ix)
+          + (ULong)fh->n_cfsi_m * sizeof(DiCfSI_m)
+          + (ULong)fh->n_cfsi_exprs * sizeof(CfiExpr);
+}
+
+/* No count can be more than the payload size, or payload_szB() could
+   wrap around. */
+static Bool counts_ok ( const DICFileHeader* fh )
+{
+   ULong max = fh->payload_szB;
+   return fh->n_maps <= max && fh->n_strs <= max && fh->strs_szB <= max
+          && fh->n_fndn <= max && fh->symtab_used <= max
+          && fh->n_sec_names <= max && fh->loctab_used <= max
+          && fh->inltab_used <= max && fh->cfsi_used <= max
+          && fh->n_cfsi_m <= max && fh->n_cfsi_exprs <= max;
+}
+
+static Bool ix_size_ok ( UInt sz )
+{
+   return sz == 1 || sz == 2 || sz == 4;
+}
+
+/* Takes the next N bytes from the payload. */
+static const UChar* take ( const UChar** p, SizeT n )
+{
+   const UChar* r = *p;
+   *p += n;
+   return r;
+}
+
+/* Index i of an array of SZ-byte indices. */
+static UInt get_ix ( const UChar* ixs, UInt sz, UWord i )
+{
+   UShort u16;
+   UInt   u32;
+   switch (sz) {
+      case 1: return ixs[i];
+      case 2: VG_(memcpy)(&u16, ixs + 2 * i, 2); return u16;
+      case 4: VG_(memcpy)(&u32, ixs + 4 * i, 4); return u32;
+      default: vg_assert(0);
+   }
+}
+
+static Word cmp_strs ( UWord s1, UWord s2 )
+{
+   return VG_(strcmp)((const HChar*)s1, (const HChar*)s2);
+}
+
+static Word cmp_fndns ( UWord f1, UWord f2 )
+{
+   return VG_(memcmp)((const void*)f1, (const void*)f2, sizeof(DICFnDn));
+}
+
+static Word cmp_cfsi_ms ( UWord m1, UWord m2 )
+{
+   return VG_(memcmp)((const void*)m1, (const void*)m2, sizeof(DiCfSI_m));
+}
+
+/* The checksum only shows that the payload is as it was written.
+   Before any of it is used, check that everything in it which refers
+   to something else -- string numbers, filename/dirname pair numbers,
+   section name lists and CFI indices -- is in range, and that the
+   strings are zero-terminated within their part of the file.  The
+   strings, pairs and CFI entries go back into deduplicating pools,
+   where they must get their old numbers again, so check that none of
+   them is repeated too. */
+static Bool payload_ok ( const DICFileHeader* fh, const UChar* buf )
+{
+   const UChar* p = buf;
+   WordFM*      seen;
+   UWord        i, n;
+   ULong        n_sec_names;
+   Bool         ok = False;
+
+   take(&p, fh->n_maps * sizeof(DICMap));
+   take(&p, DIC_SECT_SZB);
+
+   /* Strings */
+   const HChar* strs = (const HChar*)take(&p, fh->strs_szB);
+   if (fh->strs_szB > 0 && strs[fh->strs_szB - 1] != 0)
+      return False;
+   for (i = n = 0; i < fh->strs_szB; i++)
+      if (strs[i] == 0)
+         n++;
+   if (n != fh->n_strs || fh->soname > fh->n_strs)
+      return False;
+   seen = VG_(newFM)(ML_(dinfo_zalloc), "di.dicache.pok.1",
+                     ML_(dinfo_free), cmp_strs);
+   for (i = 0; i < fh->strs_szB; i += VG_(strlen)(strs + i) + 1) {
+      if (VG_(addToFM)(seen, (UWord)(strs + i), 0))
+         goto out;
+   }
+   VG_(deleteFM)(seen, NULL, NULL);
+   seen = NULL;
+
+   /* Filename/dirname pairs.  With the strings all different, equal
+      pairs have equal numbers. */
+   const DICFnDn* fndns = (const DICFnDn*)take(&p, fh->n_fndn
+                                                   * sizeof(DICFnDn));
+   seen = VG_(newFM)(ML_(dinfo_zalloc), "di.dicache.pok.2",
+                     ML_(dinfo_free), cmp_fndns);
+   for (i = 0; i < fh->n_fndn; i++) {
+      DICFnDn f;
+      VG_(memcpy)(&f, &fndns[i], sizeof(f));
+      if (f.filename > fh->n_strs || f.dirname > fh->n_strs)
+         goto out;
+      if (VG_(addToFM)(seen, (UWord)&fndns[i], 0))
+         goto out;
+   }
+   VG_(deleteFM)(seen, NULL, NULL);
+   seen = NULL;
+
+   /* Symbols, and their section names */
+   const DICSym* syms = (const DICSym*)take(&p, fh->symtab_used
+                                                * sizeof(DICSym));
+   const UChar* sec_names = take(&p, fh->n_sec_names * sizeof(UInt));
+   n_sec_names = 0;
+   for (i = 0; i < fh->symtab_used; i++) {
+      DICSym ds;
+      VG_(memcpy)(&ds, &syms[i], sizeof(ds));
+      if (ds.pri_name == 0 || ds.pri_name > fh->n_strs)
+         return False;
+      n_sec_names += ds.n_sec_names;
+   }
+   if (n_sec_names != fh->n_sec_names)
+      return False;
+   for (i = 0; i < fh->n_sec_names; i++) {
+      UInt sn = get_ix(sec_names, sizeof(UInt), i);
+      if (sn == 0 || sn > fh->n_strs)
+         return False;
+   }
+
+   /* Lines */
+   take(&p, fh->loctab_used * sizeof(DiLoc));
+   const UChar* fndn_ixs = take(&p, fh->loctab_used * fh->sizeof_fndn_ix);
+   for (i = 0; i < fh->loctab_used; i++) {
+      if (get_ix(fndn_ixs, fh->sizeof_fndn_ix, i) > fh->n_fndn)
+         return False;
+   }
+
+   /* Inlined calls */
+   const DICInl* inls = (const DICInl*)take(&p, fh->inltab_used
+                                                * sizeof(DICInl));
+   for (i = 0; i < fh->inltab_used; i++) {
+      DICInl dl;
+      VG_(memcpy)(&dl, &inls[i], sizeof(dl));
+      if (dl.inlinedfn > fh->n_strs || dl.fndn_ix > fh->n_fndn)
+         return False;
+   }
+
+   /* CFI */
+   take(&p, fh->cfsi_used * sizeof(Addr));
+   const UChar* m_ixs = take(&p, fh->cfsi_used * fh->sizeof_cfsi_m_ix);
+   for (i = 0; i < fh->cfsi_used; i++) {
+      if (get_ix(m_ixs, fh->sizeof_cfsi_m_ix, i) > fh->n_cfsi_m)
+         return False;
+   }
+   const UChar* cfsi_ms = take(&p, fh->n_cfsi_m * sizeof(DiCfSI_m));
+   seen = VG_(newFM)(ML_(dinfo_zalloc), "di.dicache.pok.3",
+                     ML_(dinfo_free), cmp_cfsi_ms);
+   for (i = 0; i < fh->n_cfsi_m; i++) {
+      if (VG_(addToFM)(seen, (UWord)(cfsi_ms + i * sizeof(DiCfSI_m)), 0))
+         goto out;
+   }
+   take(&p, fh->n_cfsi_exprs * sizeof(CfiExpr));
+   vg_assert(p == buf + fh->payload_szB);
+   ok = True;
+
+  out:
+   if (seen)
+      VG_(deleteFM)(seen, NULL, NULL);
+   return ok;
+}
+
+static void* take_copy ( const UChar** p, SizeT n, const HChar* cc )
+{
+   void* r;
+   if (n == 0)
+      return NULL;
+   r = ML_(dinfo_zalloc)(cc, n);
+   VG_(memcpy)(r, take(p, n), n);
+   return r;
+}
+
+Bool ML_(dicache_load) ( DebugInfo* di )
+{
+   struct vg_stat st;
+   DICFileHeader  fh;
+   HChar*         buildid;
+   HChar*         name = NULL;
+   UChar*         buf  = NULL;
+   Int            fd   = -1;
+   Bool           ok   = False;
+   UWord          i, j;
+
+   if (!dicache_enabled())
+      return False;
+
+   if (sr_isError(VG_(stat)(di->fsm.filename, &st)))
+      return False;
+   buildid = ML_(read_elf_buildid)(di->fsm.filename);
+   if (buildid == NULL)
+      return False;
+   name = cache_file_name(buildid, &st);
+
+   SysRes sres = VG_(open)(name, VKI_O_RDONLY, 0);
+   if (sr_isError(sres)) {
+      n_dic_missed++;
+      goto out;
+   }
+   fd = sr_Res(sres);
+
+   /* Check the header, then read the rest in one go and check that
+      too, before anything in the DebugInfo is touched. */
+   if (VG_(read)(fd, &fh, sizeof(fh)) != sizeof(fh)
+       || VG_(memcmp)(fh.magic, DIC_MAGIC, sizeof(fh.magic)) != 0
+       || fh.key != dic_key
+       || fh.mtime != st.mtime || fh.mtime_nsec != st.mtime_nsec
+       || fh.obj_size != st.size
+       || !ix_size_ok(fh.sizeof_fndn_ix) || !ix_size_ok(fh.sizeof_cfsi_m_ix)
+       || fh.payload_szB > 0x7FFFFFFFULL
+       || !counts_ok(&fh)
+       || fh.payload_szB != payload_szB(&fh)
+       || VG_(fsize)(fd) != (Long)(sizeof(fh) + fh.payload_szB))
+      goto stale;
+
+   buf = ML_(dinfo_zalloc)("di.dicache.load.1", fh.payload_szB);
+   if (VG_(read)(fd, buf, (Int)fh.payload_szB) != (Int)fh.payload_szB
+       || fnv1a(FNV1A_INIT, buf, fh.payload_szB) != fh.payload_sum)
+      goto stale;
+
+   const UChar* p = buf;
+   const DICMap* maps = (const DICMap*)take(&p, fh.n_maps * sizeof(DICMap));
+   if (!same_maps(di, maps, fh.n_maps) || !payload_ok(&fh, buf))
+      goto stale;
+
+   /* It's a hit.  From here on, nothing can fail. */
+   if (VG_(clo_verbosity) > 1 || VG_(clo_trace_redir))
+      VG_(message)(Vg_DebugMsg, "Reading syms from %s (cached in %s)\n",
+                   di->fsm.filename, name);
+
+   VG_(memcpy)((UChar*)di + DIC_SECT_OFF, take(&p, DIC_SECT_SZB),
+               DIC_SECT_SZB);
+
+   /* Strings.  strs[0] stands for NULL. */
+   const HChar** strs = ML_(dinfo_zalloc)("di.dicache.load.2",
+                                          (fh.n_strs + 1) * sizeof(HChar*));
+   const HChar* s = (const HChar*)take(&p, fh.strs_szB);
+   for (i = 1; i <= fh.n_strs; i++) {
+      strs[i] = ML_(addStr)(di, s, -1);
+      s += VG_(strlen)(s) + 1;
+   }
+   di->soname = ML_(dinfo_strdup)("di.dicache.load.3",
+                                  fh.soname ? strs[fh.soname] : "NONE");
+   vg_assert(di->buildid == NULL);
+   di->buildid = buildid;
+   buildid = NULL;
+
+   /* Filename/dirname pairs.  These were written in index order, so
+      they get the same indices again. */
+   for (i = 0; i < fh.n_fndn; i++) {
+      DICFnDn f;
+      VG_(memcpy)(&f, take(&p, sizeof(f)), sizeof(f));
+      UInt ix = ML_(addFnDn)(di, strs[f.filename], strs[f.dirname]);
+      vg_assert(ix == i + 1);
+   }
+
+   /* Symbols */
+   const DICSym* syms
+      = (const DICSym*)take(&p, fh.symtab_used * sizeof(DICSym));
+   const UInt* sec_names
+      = (const UInt*)take(&p, fh.n_sec_names * sizeof(UInt));
+   if (fh.symtab_used > 0)
+      di->symtab = ML_(dinfo_zalloc)("di.dicache.load.4",
+                                     fh.symtab_used * sizeof(DiSym));
+   di->symtab_used = di->symtab_size = fh.symtab_used;
+   for (i = 0; i < fh.symtab_used; i++) {
+      DICSym ds;
+      DiSym* sym = &di->symtab[i];
+      VG_(memcpy)(&ds, &syms[i], sizeof(ds));
+      sym->avmas    = ds.avmas;
+      sym->size     = ds.size;
+      sym->pri_name = strs[ds.pri_name];
+      sym->isText   = ds.isText;
+      sym->isIFunc  = ds.isIFunc;
+      sym->isGlobal = ds.isGlobal;
+      if (ds.n_sec_names > 0) {
+         sym->sec_names = ML_(dinfo_zalloc)("di.dicache.load.5",
+                                            (ds.n_sec_names + 1)
+                                            * sizeof(HChar*));
+         for (j = 0; j < ds.n_sec_names; j++) {
+            UInt sn;
+            VG_(memcpy)(&sn, sec_names, sizeof(sn));
+            sec_names++;
+            sym->sec_names[j] = strs[sn];
+         }
+      }
+   }
+
+   /* Lines */
+   di->loctab = take_copy(&p, fh.loctab_used * sizeof(DiLoc),
+                          "di.dicache.load.6");
+   di->sizeof_fndn_ix = fh.sizeof_fndn_ix;
+   di->loctab_fndn_ix = take_copy(&p, fh.loctab_used * fh.sizeof_fndn_ix,
+                                  "di.dicache.load.7");
+   di->loctab_used = di->loctab_size = fh.loctab_used;
+
+   /* Inlined calls */
+   if (fh.inltab_used > 0)
+      di->inltab = ML_(dinfo_zalloc)("di.dicache.load.8",
+                                     fh.inltab_used * sizeof(DiInlLoc));
+   di->inltab_used = di->inltab_size = fh.inltab_used;
+   di->maxinl_codesz = fh.maxinl_codesz;
+   for (i = 0; i < fh.inltab_used; i++) {
+      DICInl dl;
+      DiInlLoc* inl = &di->inltab[i];
+      VG_(memcpy)(&dl, take(&p, sizeof(dl)), sizeof(dl));
+      inl->addr_lo   = dl.addr_lo;
+      inl->addr_hi   = dl.addr_hi;
+      inl->inlinedfn = strs[dl.inlinedfn];
+      inl->fndn_ix   = dl.fndn_ix;
+      inl->lineno    = dl.lineno;
+      inl->level     = dl.level;
+   }
+   ML_(build_inltab_index)(di);
+
+   /* CFI, as left by ML_(finish_CFSI_arrays). */
+   di->cfsi_base = take_copy(&p, fh.cfsi_used * sizeof(Addr),
+                             "di.dicache.load.9");
+   di->sizeof_cfsi_m_ix = fh.sizeof_cfsi_m_ix;
+   di->cfsi_m_ix = take_copy(&p, fh.cfsi_used * fh.sizeof_cfsi_m_ix,
+                             "di.dicache.load.10");
+   di->cfsi_used = di->cfsi_size = fh.cfsi_used;
+   di->cfsi_minavma = fh.cfsi_minavma;
+   di->cfsi_maxavma = fh.cfsi_maxavma;
+   if (fh.n_cfsi_m > 0)
+      di->cfsi_m_pool = VG_(newDedupPA)(fh.n_cfsi_m * sizeof(DiCfSI_m),
+                                        vg_alignof(DiCfSI_m),
+                                        ML_(dinfo_zalloc),
+                                        "di.dicache.load.11",
+                                        ML_(dinfo_free));
+   for (i = 0; i < fh.n_cfsi_m; i++) {
+      DiCfSI_m m;
+      VG_(memcpy)(&m, take(&p, sizeof(m)), sizeof(m));
+      UInt ix = VG_(allocFixedEltDedupPA)(di->cfsi_m_pool,
+                                          sizeof(DiCfSI_m), &m);
+      vg_assert(ix == i + 1);
+   }
+   if (fh.n_cfsi_exprs > 0) {
+      di->cfsi_exprs = VG_(newXA)( ML_(dinfo_zalloc), "di.dicache.load.12",
+                                   ML_(dinfo_free), sizeof(CfiExpr) );
+      for (i = 0; i < fh.n_cfsi_exprs; i++) {
+         CfiExpr e;
+         VG_(memcpy)(&e, take(&p, sizeof(e)), sizeof(e));
+         VG_(addToXA)(di->cfsi_exprs, &e);
+      }
+   }
+   vg_assert(p == buf + fh.payload_szB);
+
+   if (di->cfsi_m_pool)
+      VG_(freezeDedupPA)(di->cfsi_m_pool, ML_(dinfo_shrink_block));
+   if (di->strpool)
+      VG_(freezeDedupPA)(di->strpool, ML_(dinfo_shrink_block));
+   if (di->fndnpool)
+      VG_(freezeDedupPA)(di->fndnpool, ML_(dinfo_shrink_block));
+
+   ML_(dinfo_free)(strs);
+   di->from_dicache = True;
+   n_dic_loaded++;
+   n_dic_bytes_read += sizeof(fh) + fh.payload_szB;
+   ok = True;
+   goto out;
+
+  stale:
+   n_dic_stale++;
+   if (VG_(clo_verbosity) > 1)
+      VG_(message)(Vg_DebugMsg, "debuginfo-cache: %s is stale\n", name);
+
+  out:
+   if (fd >= 0)
+      VG_(close)(fd);
+   if (buf)
+      ML_(dinfo_free)(buf);
+   if (buildid)
+      ML_(dinfo_free)(buildid);
+   ML_(dinfo_free)(name);
+   return ok;
+}
+
+
+/*------------------------------------------------------------*/
+/*--- Saving                                               ---*/
+/*------------------------------------------------------------*/
+
+/* Strings are numbered from 1 in the order first seen.  The string
+   pool is deduplicating, so the address of a string identifies it. */
+typedef
+   struct {
+      WordFM* nums;   /* const HChar* -> UInt */
+      XArray* bytes;  /* of HChar: all the strings, zero-terminated */
+      UInt    n_strs;
+   }
+   StrTab;
+
+static UInt str_num ( StrTab* t, const HChar* s )
+{
+   UWord num;
+   if (s == NULL)
+      return 0;
+   if (VG_(lookupFM)(t->nums, NULL, &num, (UWord)s))
+      return (UInt)num;
+   num = ++t->n_strs;
+   VG_(addToFM)(t->nums, (UWord)s, num);
+   VG_(addBytesToXA)(t->bytes, s, VG_(strlen)(s) + 1);
+   return (UInt)num;
+}
+
+/* The pieces of the file after the header, in order. */
+#define DIC_N_PIECES 13
+
+typedef
+   struct {
+      const void* p;
+      SizeT       szB;
+   }
+   Piece;
+
+static void* xa_contents ( XArray* xa, SizeT* szB, SizeT eltSzB )
+{
+   void* p = NULL;
+   Word  n = 0;
+   if (VG_(sizeXA)(xa) > 0)
+      VG_(getContentsXA_UNSAFE)(xa, &p, &n);
+   *szB = (SizeT)n * eltSzB;
+   return p;
+}
+
+void ML_(dicache_save) ( DebugInfo* di )
+{
+   struct vg_stat st;
+   DICFileHeader  fh;
+   Piece          pieces[DIC_N_PIECES];
+   StrTab         strtab;
+   UWord          i, j;
+   Int            fd;
+   HChar*         name;
+   HChar*         tmpname;
+   Bool           failed = False;
+
+   if (di->from_dicache || di->buildid == NULL || !dicache_enabled())
+      return;
+   vg_assert(di->lazy == NULL);
+   vg_assert(di->cfsi_rd == NULL);
+   vg_assert(di->loccz_blk == NULL); /* compacted only after saving */
+   if (sr_isError(VG_(stat)(di->fsm.filename, &st)))
+      return;
+
+   VG_(memset)(&fh, 0, sizeof(fh));
+   VG_(memcpy)(fh.magic, DIC_MAGIC, sizeof(fh.magic));
+   fh.key        = dic_key;
+   fh.mtime      = st.mtime;
+   fh.mtime_nsec = st.mtime_nsec;
+   fh.obj_size   = st.size;
+
+   strtab.nums   = VG_(newFM)(ML_(dinfo_zalloc), "di.dicache.save.1",
+                              ML_(dinfo_free), NULL);
+   strtab.bytes  = VG_(newXA)(ML_(dinfo_zalloc), "di.dicache.save.2",
+                              ML_(dinfo_free), sizeof(HChar));
+   strtab.n_strs = 0;
+
+   XArray* maps  = VG_(newXA)(ML_(dinfo_zalloc), "di.dicache.save.3",
+                              ML_(dinfo_free), sizeof(DICMap));
+   XArray* fndns = VG_(newXA)(ML_(dinfo_zalloc), "di.dicache.save.4",
+                              ML_(dinfo_free), sizeof(DICFnDn));
+   XArray* syms  = VG_(newXA)(ML_(dinfo_zalloc), "di.dicache.save.5",
+                              ML_(dinfo_free), sizeof(DICSym));
+   XArray* secs  = VG_(newXA)(ML_(dinfo_zalloc), "di.dicache.save.6",
+                              ML_(dinfo_free), sizeof(UInt));
+   XArray* inls  = VG_(newXA)(ML_(dinfo_zalloc), "di.dicache.save.7",
+                              ML_(dinfo_free), sizeof(DICInl));
+   XArray* cfsms = VG_(newXA)(ML_(dinfo_zalloc), "di.dicache.save.8",
+                              ML_(dinfo_free), sizeof(DiCfSI_m));
+
+   for (i = 0; i < VG_(sizeXA)(di->fsm.maps); i++) {
+      const DebugInfoMapping* map = VG_(indexXA)(di->fsm.maps, i);
+      DICMap m;
+      VG_(memset)(&m, 0, sizeof(m));
+      m.avma = map->avma;
+      m.size = map->size;
+      m.foff = map->foff;
+      m.rx   = map->rx;
+      m.rw   = map->rw;
+      m.ro   = map->ro;
+      VG_(addToXA)(maps, &m);
+   }
+   fh.n_maps = VG_(sizeXA)(maps);
+
+   fh.soname = VG_(strcmp)(di->soname, "NONE") == 0
+               ? 0 : str_num(&strtab, di->soname);
+
+   if (di->fndnpool) {
+      fh.n_fndn = VG_(sizeDedupPA)(di->fndnpool);
+      for (i = 1; i <= fh.n_fndn; i++) {
+         const FnDn* fndn = VG_(indexEltNumber)(di->fndnpool, i);
+         DICFnDn f;
+         f.filename = str_num(&strtab, fndn->filename);
+         f.dirname  = str_num(&strtab, fndn->dirname);
+         VG_(addToXA)(fndns, &f);
+      }
+   }
+
+   fh.symtab_used = di->symtab_used;
+   for (i = 0; i < di->symtab_used; i++) {
+      const DiSym* sym = &di->symtab[i];
+      DICSym ds;
+      VG_(memset)(&ds, 0, sizeof(ds));
+      ds.avmas    = sym->avmas;
+      ds.size     = sym->size;
+      ds.pri_name = str_num(&strtab, sym->pri_name);
+      ds.isText   = sym->isText;
+      ds.isIFunc  = sym->isIFunc;
+      ds.isGlobal = sym->isGlobal;
+      for (j = 0; sym->sec_names && sym->sec_names[j]; j++) {
+         UInt sn = str_num(&strtab, sym->sec_names[j]);
+         VG_(addToXA)(secs, &sn);
+         ds.n_sec_names++;
+      }
+      VG_(addToXA)(syms, &ds);
+   }
+   fh.n_sec_names = VG_(sizeXA)(secs);
+
+   fh.loctab_used    = di->loctab_used;
+   fh.sizeof_fndn_ix = di->loctab_used > 0 ? di->sizeof_fndn_ix : 1;
+
+   fh.inltab_used   = di->inltab_used;
+   fh.maxinl_codesz = di->maxinl_codesz;
+   for (i = 0; i < di->inltab_used; i++) {
+      const DiInlLoc* inl = &di->inltab[i];
+      DICInl dl;
+      VG_(memset)(&dl, 0, sizeof(dl));
+      dl.addr_lo   = inl->addr_lo;
+      dl.addr_hi   = inl->addr_hi;
+      dl.inlinedfn = str_num(&strtab, inl->inlinedfn);
+      dl.fndn_ix   = inl->fndn_ix;
+      dl.lineno    = inl->lineno;
+      dl.level     = inl->level;
+      VG_(addToXA)(inls, &dl);
+   }
+
+   fh.cfsi_used        = di->cfsi_used;
+   fh.sizeof_cfsi_m_ix = di->cfsi_used > 0 ? di->sizeof_cfsi_m_ix : 1;
+   fh.cfsi_minavma     = di->cfsi_minavma;
+   fh.cfsi_maxavma     = di->cfsi_maxavma;
+   if (di->cfsi_m_pool) {
+      fh.n_cfsi_m = VG_(sizeDedupPA)(di->cfsi_m_pool);
+      for (i = 1; i <= fh.n_cfsi_m; i++)
+         VG_(addToXA)(cfsms, VG_(indexEltNumber)(di->cfsi_m_pool, i));
+   }
+   fh.n_cfsi_exprs = di->cfsi_exprs ? VG_(sizeXA)(di->cfsi_exprs) : 0;
+
+   fh.n_strs   = strtab.n_strs;
+   fh.strs_szB = VG_(sizeXA)(strtab.bytes);
+
+   SizeT sz;
+   pieces[0].p   = xa_contents(maps, &sz, sizeof(DICMap));
+   pieces[0].szB = sz;
+   pieces[1].p   = (const UChar*)di + DIC_SECT_OFF;
+   pieces[1].szB = DIC_SECT_SZB;
+   pieces[2].p   = xa_contents(strtab.bytes, &sz, sizeof(HChar));
+   pieces[2].szB = sz;
+   pieces[3].p   = xa_contents(fndns, &sz, sizeof(DICFnDn));
+   pieces[3].szB = sz;
+   pieces[4].p   = xa_contents(syms, &sz, sizeof(DICSym));
+   pieces[4].szB = sz;
+   pieces[5].p   = xa_contents(secs, &sz, sizeof(UInt));
+   pieces[5].szB = sz;
+   pieces[6].p   = di->loctab;
+   pieces[6].szB = di->loctab_used * sizeof(DiLoc);
+   pieces[7].p   = di->loctab_fndn_ix;
+   pieces[7].szB = di->loctab_used * fh.sizeof_fndn_ix;
+   pieces[8].p   = xa_contents(inls, &sz, sizeof(DICInl));
+   pieces[8].szB = sz;
+   pieces[9].p   = di->cfsi_base;
+   pieces[9].szB = di->cfsi_used * sizeof(Addr);
+   pieces[10].p   = di->cfsi_m_ix;
+   pieces[10].szB = di->cfsi_used * fh.sizeof_cfsi_m_ix;
+   pieces[11].p   = xa_contents(cfsms, &sz, sizeof(DiCfSI_m));
+   pieces[11].szB = sz;
+   pieces[12].p   = di->cfsi_exprs
+                    ? xa_contents(di->cfsi_exprs, &sz, sizeof(CfiExpr))
+                    : NULL;
+   pieces[12].szB = di->cfsi_exprs ? sz : 0;
+
+   fh.payload_sum = FNV1A_INIT;
+   fh.payload_szB = 0;
+   for (i = 0; i < DIC_N_PIECES; i++) {
+      fh.payload_sum  = fnv1a(fh.payload_sum, pieces[i].p, pieces[i].szB);
+      fh.payload_szB += pieces[i].szB;
+   }
+   vg_assert(fh.payload_szB == payload_szB(&fh));
+
+   /* Write to a temporary file, and rename it into place, so that
+      concurrent runs never see a partly written file. */
+   name    = cache_file_name(di->buildid, &st);
+   tmpname = ML_(dinfo_zalloc)("di.dicache.save.9", VG_(strlen)(name) + 32);
+   VG_(sprintf)(tmpname, "%s.tmp.%d", name, VG_(getpid)());
+   SysRes sres = VG_(open)(tmpname, VKI_O_CREAT|VKI_O_WRONLY|VKI_O_TRUNC,
+                           VKI_S_IRUSR|VKI_S_IWUSR);
+   if (sr_isError(sres)) {
+      if (VG_(clo_verbosity) > 1)
+         VG_(message)(Vg_DebugMsg, "debuginfo-cache: can't create %s\n",
+                      tmpname);
+      goto out;
+   }
+   fd = sr_Res(sres);
+
+   if (VG_(write)(fd, &fh, sizeof(fh)) != sizeof(fh))
+      failed = True;
+   for (i = 0; i < DIC_N_PIECES && !failed; i++) {
+      const UChar* b = pieces[i].p;
+      SizeT        n = pieces[i].szB;
+      while (n > 0 && !failed) {
+         Int chunk = n > 0x40000000 ? 0x40000000 : (Int)n;
+         if (VG_(write)(fd, b, chunk) != chunk)
+            failed = True;
+         b += chunk;
+         n -= chunk;
+      }
+   }
+   VG_(close)(fd);
+
+   if (failed || VG_(rename)(tmpname, name) != 0) {
+      if (VG_(clo_verbosity) > 1)
+         VG_(message)(Vg_DebugMsg, "debuginfo-cache: can't write %s\n", name);
+      VG_(unlink)(tmpname);
+      goto out;
+   }
+   n_dic_saved++;
+   n_dic_bytes_saved += sizeof(fh) + fh.payload_szB;
+
+  out:
+   ML_(dinfo_free)(tmpname);
+   ML_(dinfo_free)(name);
+   VG_(deleteFM)(strtab.nums, NULL, NULL);
+   VG_(deleteXA)(strtab.bytes);
+   VG_(deleteXA)(maps);
+   VG_(deleteXA)(fndns);
+   VG_(deleteXA)(syms);
+   VG_(deleteXA)(secs);
+   VG_(deleteXA)(inls);
+   VG_(deleteXA)(cfsms);
+}
+
+
+/*------------------------------------------------------------*/
+/*--- Stats                                                ---*/
+/*------------------------------------------------------------*/
+
+void ML_(dicache_print_stats) ( void )
+{
+   if (dic_state != DicOn)
+      return;
+   VG_(message)(Vg_DebugMsg,
+                " debuginfo-cache: loaded %'llu objects (%'llu bytes), "
+                "%'llu not cached, %'llu stale\n",
+                n_dic_loaded, n_dic_bytes_read, n_dic_missed, n_dic_stale);
+   VG_(message)(Vg_DebugMsg,
+                " debuginfo-cache: saved  %'llu objects (%'llu bytes)\n",
+                n_dic_saved, n_dic_bytes_saved);
+}
+
+#endif // defined(VGO_linux) || defined(VGO_solaris)
+
+/*--------------------------------------------------------------------*/
+/*--- end                                                dicache.c ---*/
+/*--------------------------------------------------------------------*/
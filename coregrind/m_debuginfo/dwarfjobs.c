@@ -0,0 +1,590 @@
+/* -*- mode: C; c-basic-offset: 3; -*- */
+
+/*--------------------------------------------------------------------*/
+/*--- Reading DWARF in helper processes.              dwarfjobs.c ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Valgrind, a dynamic binary instrumentation
+   framework.
+
+   Copyright (C) 2015-2015 The Valgrind developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#if defined(VGO_linux) || defined(VGO_darwin) || defined(VGO_solaris)
+
+#include "pub_core_basics.h"
+#include "pub_core_vki.h"
+#include "pub_core_debuginfo.h"
+#include "pub_core_libcbase.h"
+#include "pub_core_libcassert.h"
+#include "pub_core_libcfile.h"
+#include "pub_core_libcprint.h"
+#include "pub_core_libcproc.h"     // VG_(fork), VG_(waitpid)
+#include "pub_core_libcsignal.h"   // VG_(sigaction)
+#include "pub_core_options.h"
+#include "pub_core_xarray.h"
+#include "pub_core_wordfm.h"
+#include "priv_misc.h"             /* dinfo_zalloc/free */
+#include "priv_image.h"
+#include "priv_storage.h"
+#include "priv_dwarfjobs.h"        /* self */
+
+
+/*------------------------------------------------------------*/
+/*--- Overview                                             ---*/
+/*------------------------------------------------------------*/
+
+/* Nothing in m_debuginfo, nor the allocator and the image cache under
+   it, is thread safe, so the work is split between processes rather
+   than threads.  A helper is a fork of Valgrind, which runs the
+   ordinary readers on its own copy of the DebugInfo, skipping all but
+   every Nth CU.  Whatever each CU adds to the loctab and inltab is
+   written, with the strings it refers to, to a temporary file, and
+   the CU's entries are then dropped from the helper's tables.  The
+   parent reads the files back in CU order -- helper 0's first CU,
+   then helper 1's first, and so on -- and adds the entries through
+   ML_(addLineInfo) and ML_(addInlInfo), so the result is the same as
+   if it had read all the CUs itself.
+
+   Meanwhile the parent can read the variable info, which can't be
+   split up like this since types are shared between CUs.  When the
+   variable info is read, the inlined call info comes with it, so
+   then the helpers only read the line info.
+
+   Only local images can be shared with helpers; the connection to a
+   debuginfo server can't.  As in VG_(system), SIGCHLD is set to its
+   default while helpers run, so that their exits don't reach the
+   client. */
+
+
+/*------------------------------------------------------------*/
+/*--- State                                                ---*/
+/*------------------------------------------------------------*/
+
+#define DW_JOBS_MAX        16
+
+/* In the parent. */
+static Int  n_jobs = 0;              /* helpers running */
+static Bool start_failed = False;    /* some couldn't be started */
+static Int  job_pid[DW_JOBS_MAX];
+static Int  job_fd[DW_JOBS_MAX];     /* their output, already unlinked */
+static vki_sigaction_fromK_t saved_sigchld;
+
+/* In a helper. */
+static Int  my_job = -1;             /* which one this is, or -1 */
+static Int  n_total = 0;             /* how many CUs are shared between */
+static UInt n_cus[DW_JOBS_N_PHASES];
+static Bool helper_failed = False;
+static WordFM* str_ids  = NULL;      /* HChar* in di->strpool -> id */
+static WordFM* fndn_ids = NULL;      /* fndn_ix -> id */
+static UInt    n_str_ids  = 0;
+static UInt    n_fndn_ids = 0;
+
+/* Records in a helper's output.  Strings and filename/dirname pairs
+   are numbered from 1 in the order they are sent; 0 means NULL, or
+   the unknown fndn_ix 0, respectively. */
+#define R_CU        'C'    /* UChar phase, UInt cu */
+#define R_STR       'S'    /* UInt len, then the bytes */
+#define R_FNDN      'F'    /* UInt filename, UInt dirname */
+#define R_LOC       'L'    /* Addr addr, UInt size, lineno, fndn */
+#define R_INL       'I'    /* Addr lo, hi, UInt fn, fndn, lineno, level */
+#define R_END       'E'    /* UChar ok */
+
+
+/*------------------------------------------------------------*/
+/*--- In a helper                                          ---*/
+/*------------------------------------------------------------*/
+
+static struct {
+   Int   fd;
+   Bool  failed;
+   UInt  used;
+   UChar buf[65536];
+} out;
+
+static void w_flush ( void )
+{
+   if (out.used > 0 && !out.failed
+       && VG_(write)(out.fd, out.buf, out.used) != (Int)out.used)
+      out.failed = True;
+   out.used = 0;
+}
+
+static void w_bytes ( const void* p, UInt n )
+{
+   const UChar* b = p;
+   while (n > 0) {
+      UInt chunk = sizeof(out.buf) - out.used;
+      if (chunk > n)
+         chunk = n;
+      VG_(memcpy)(&out.buf[out.used], b, chunk);
+      out.used += chunk;
+      b += chunk;
+      n -= chunk;
+      if (out.used == sizeof(out.buf))
+         w_flush();
+   }
+}
+
+static void w_UChar ( UChar c ) { w_bytes(&c, sizeof(c)); }
+static void w_UInt  ( UInt n )  { w_bytes(&n, sizeof(n)); }
+static void w_Addr  ( Addr a )  { w_bytes(&a, sizeof(a)); }
+
+static UInt str_id ( const HChar* str )
+{
+   UWord id;
+   UInt  len;
+
+   if (str == NULL)
+      return 0;
+   if (VG_(lookupFM)(str_ids, NULL, &id, (UWord)str))
+      return id;
+   id = ++n_str_ids;
+   VG_(addToFM)(str_ids, (UWord)str, id);
+   len = VG_(strlen)(str);
+   w_UChar(R_STR);
+   w_UInt(len);
+   w_bytes(str, len);
+   return id;
+}
+
+static UInt fndn_id ( const DebugInfo* di, UInt fndn_ix )
+{
+   UWord       id;
+   const FnDn* fndn;
+   UInt        fn, dn;
+
+   if (fndn_ix == 0)
+      return 0;
+   if (VG_(lookupFM)(fndn_ids, NULL, &id, fndn_ix))
+      return id;
+   fndn = VG_(indexEltNumber)(di->fndnpool, fndn_ix);
+   fn = str_id(fndn->filename);
+   dn = str_id(fndn->dirname);
+   id = ++n_fndn_ids;
+   VG_(addToFM)(fndn_ids, fndn_ix, id);
+   w_UChar(R_FNDN);
+   w_UInt(fn);
+   w_UInt(dn);
+   return id;
+}
+
+/* Send the entries added since the last call, and forget them. */
+static void flush_tables ( DebugInfo* di )
+{
+   UWord i;
+
+   for (i = 0; i < di->loctab_used; i++) {
+      const DiLoc* loc = &di->loctab[i];
+      UInt fndn = fndn_id(di, ML_(fndn_ix)(di, i));
+      w_UChar(R_LOC);
+      w_Addr(loc->addr);
+      w_UInt(loc->size);
+      w_UInt(loc->lineno);
+      w_UInt(fndn);
+   }
+   for (i = 0; i < di->inltab_used; i++) {
+      const DiInlLoc* inl = &di->inltab[i];
+      UInt fn   = str_id(inl->inlinedfn);
+      UInt fndn = fndn_id(di, inl->fndn_ix);
+      w_UChar(R_INL);
+      w_Addr(inl->addr_lo);
+      w_Addr(inl->addr_hi);
+      w_UInt(fn);
+      w_UInt(fndn);
+      w_UInt(inl->lineno);
+      w_UInt(inl->level);
+   }
+   di->loctab_used = 0;
+   di->inltab_used = 0;
+}
+
+static void start_helper ( DebugInfo* di, Int job, Int fd )
+{
+   Int i;
+
+   my_job  = job;
+   n_total = VG_(clo_debuginfo_jobs);
+   for (i = 0; i < job; i++)
+      VG_(close)(job_fd[i]);
+   n_jobs = 0;
+
+   out.fd     = fd;
+   out.failed = False;
+   out.used   = 0;
+   str_ids  = VG_(newFM)(ML_(dinfo_zalloc), "di.dwjobs.sh.1",
+                         ML_(dinfo_free), NULL);
+   fndn_ids = VG_(newFM)(ML_(dinfo_zalloc), "di.dwjobs.sh.2",
+                         ML_(dinfo_free), NULL);
+
+   /* The entries already there are the parent's business. */
+   di->loctab_used = 0;
+   di->inltab_used = 0;
+}
+
+Bool ML_(dwjobs_skip_cu) ( DebugInfo* di, DwJobsPhase phase )
+{
+   UInt cu;
+
+   if (my_job < 0)
+      return False;
+
+   flush_tables(di);
+   cu = n_cus[phase]++;
+   if (cu % (UInt)n_total != (UInt)my_job)
+      return True;
+   w_UChar(R_CU);
+   w_UChar(phase);
+   w_UInt(cu);
+   return False;
+}
+
+void ML_(dwjobs_note_failure) ( void )
+{
+   if (my_job >= 0)
+      helper_failed = True;
+}
+
+void ML_(dwjobs_finish) ( DebugInfo* di )
+{
+   vg_assert(my_job >= 0);
+   flush_tables(di);
+   w_UChar(R_END);
+   w_UChar(!helper_failed);
+   w_flush();
+   VG_(exit_now)(out.failed ? 1 : 0);
+   /*NOTREACHED*/
+   vg_assert(0);
+}
+
+
+/*------------------------------------------------------------*/
+/*--- In the parent                                        ---*/
+/*------------------------------------------------------------*/
+
+Bool ML_(dwjobs_start) ( DebugInfo* di,
+                         const DiSlice* escns, Int n_escns )
+{
+   vki_sigaction_toK_t sa;
+   ULong szB = 0;
+   Int   i, fd, pid;
+
+   vg_assert(n_jobs == 0 && my_job < 0);
+   start_failed = False;
+
+   if (VG_(clo_debuginfo_jobs) <= 1)
+      return False;
+   for (i = 0; i < n_escns; i++) {
+      if (!ML_(sli_is_valid)(escns[i]))
+         continue;
+      if (!ML_(img_is_local)(escns[i].img))
+         return False;
+      szB += escns[i].szB;
+   }
+   /* Don't bother with less than this much DWARF. */
+   if (szB < (ULong)VG_(clo_debuginfo_jobs_min_szB))
+      return False;
+
+   VG_(memset)(&sa, 0, sizeof(sa));
+   VG_(sigemptyset)(&sa.sa_mask);
+   sa.ksa_handler = VKI_SIG_DFL;
+   sa.sa_flags    = 0;
+   if (VG_(sigaction)(VKI_SIGCHLD, &sa, &saved_sigchld) != 0)
+      return False;
+
+   vg_assert(VG_(clo_debuginfo_jobs) <= DW_JOBS_MAX);
+   for (i = 0; i < VG_(clo_debuginfo_jobs); i++) {
+      HChar name[VG_(mkstemp_fullname_bufsz)(sizeof("dwjobs") - 1)];
+      fd = VG_(mkstemp)("dwjobs", name);
+      if (fd < 0)
+         break;
+      VG_(unlink)(name);
+      pid = VG_(fork)();
+      if (pid < 0) {
+         VG_(close)(fd);
+         break;
+      }
+      if (pid == 0) {
+         start_helper(di, i, fd);
+         return True;
+      }
+      job_pid[i] = pid;
+      job_fd[i]  = fd;
+      n_jobs++;
+   }
+   if (n_jobs < VG_(clo_debuginfo_jobs))
+      start_failed = True;
+
+   if (VG_(clo_verbosity) > 1)
+      VG_(message)(Vg_DebugMsg,
+                   "debuginfo-jobs: %d helpers reading %'llu bytes of DWARF"
+                   " in %s\n", n_jobs, szB, di->fsm.filename);
+   if (n_jobs == 0) {
+      vki_sigaction_toK_t sa2;
+      VG_(convert_sigaction_fromK_to_toK)(&saved_sigchld, &sa2);
+      VG_(sigaction)(VKI_SIGCHLD, &sa2, NULL);
+   }
+   return False;
+}
+
+Bool ML_(dwjobs_active) ( void )
+{
+   return n_jobs > 0;
+}
+
+/* A buffered reader for a helper's output, which also maps the
+   helper's string and filename/dirname ids to the parent's. */
+typedef
+   struct {
+      Int     fd;
+      UInt    used, pos;
+      Bool    have_cu;     /* the next CU's R_CU record has been read: */
+      UChar   cu_phase;
+      UInt    cu_no;
+      XArray* strs;    /* of const HChar*, in di->strpool */
+      XArray* fndns;   /* of UInt */
+      UChar   buf[65536];
+   }
+   JobReader;
+
+static UChar r_peek ( JobReader* r )
+{
+   if (r->pos == r->used) {
+      Int n = VG_(read)(r->fd, r->buf, sizeof(r->buf));
+      /* The file was checked to end with an R_END record. */
+      vg_assert(n > 0);
+      r->used = n;
+      r->pos  = 0;
+   }
+   return r->buf[r->pos];
+}
+
+static void r_bytes ( JobReader* r, void* dst, UInt n )
+{
+   UChar* d = dst;
+   while (n > 0) {
+      UInt chunk;
+      (void)r_peek(r);
+      chunk = r->used - r->pos;
+      if (chunk > n)
+         chunk = n;
+      VG_(memcpy)(d, &r->buf[r->pos], chunk);
+      r->pos += chunk;
+      d += chunk;
+      n -= chunk;
+   }
+}
+
+static UChar r_UChar ( JobReader* r ) { UChar c; r_bytes(r, &c, sizeof(c)); return c; }
+static UInt  r_UInt  ( JobReader* r ) { UInt n;  r_bytes(r, &n, sizeof(n)); return n; }
+static Addr  r_Addr  ( JobReader* r ) { Addr a;  r_bytes(r, &a, sizeof(a)); return a; }
+
+static const HChar* r_str ( JobReader* r, UInt id )
+{
+   return id == 0 ? NULL : *(const HChar**)VG_(indexXA)(r->strs, id - 1);
+}
+
+static UInt r_fndn ( JobReader* r, UInt id )
+{
+   return id == 0 ? 0 : *(UInt*)VG_(indexXA)(r->fndns, id - 1);
+}
+
+/* Read the next R_CU record, if that's what comes next. */
+static Bool r_next_cu ( JobReader* r )
+{
+   if (!r->have_cu && r_peek(r) == R_CU) {
+      (void)r_UChar(r);
+      r->cu_phase = r_UChar(r);
+      r->cu_no    = r_UInt(r);
+      r->have_cu  = True;
+   }
+   return r->have_cu;
+}
+
+/* Add the entries of one CU, up to the next R_CU or R_END record. */
+static void merge_cu ( DebugInfo* di, JobReader* r,
+                       /*MOD*/ULong* n_locs, /*MOD*/ULong* n_inls )
+{
+   static HChar* scratch = NULL;
+   static UInt   scratch_szB = 0;
+
+   while (True) {
+      UChar tag = r_peek(r);
+      if (tag == R_CU || tag == R_END)
+         return;
+      (void)r_UChar(r);
+      switch (tag) {
+         case R_STR: {
+            UInt len = r_UInt(r);
+            const HChar* str;
+            if (len + 1 > scratch_szB) {
+               if (scratch)
+                  ML_(dinfo_free)(scratch);
+               scratch_szB = len + 1 < 256 ? 256 : len + 1;
+               scratch = ML_(dinfo_zalloc)("di.dwjobs.mc.1", scratch_szB);
+            }
+            r_bytes(r, scratch, len);
+            scratch[len] = 0;
+            str = ML_(addStr)(di, scratch, len);
+            VG_(addToXA)(r->strs, &str);
+            break;
+         }
+         case R_FNDN: {
+            const HChar* fn = r_str(r, r_UInt(r));
+            const HChar* dn = r_str(r, r_UInt(r));
+            UInt fndn_ix = ML_(addFnDn)(di, fn, dn);
+            VG_(addToXA)(r->fndns, &fndn_ix);
+            break;
+         }
+         case R_LOC: {
+            Addr addr   = r_Addr(r);
+            UInt size   = r_UInt(r);
+            UInt lineno = r_UInt(r);
+            UInt fndn   = r_fndn(r, r_UInt(r));
+            ML_(addLineInfo)(di, fndn, addr, addr + size, lineno, 0);
+            (*n_locs)++;
+            break;
+         }
+         case R_INL: {
+            Addr lo     = r_Addr(r);
+            Addr hi     = r_Addr(r);
+            const HChar* fn = r_str(r, r_UInt(r));
+            UInt fndn   = r_fndn(r, r_UInt(r));
+            UInt lineno = r_UInt(r);
+            UInt level  = r_UInt(r);
+            ML_(addInlInfo)(di, lo, hi, fn, fndn, lineno, level);
+            (*n_inls)++;
+            break;
+         }
+         default:
+            vg_assert(0);
+      }
+   }
+}
+
+/* Did helper J exit normally, having written all its output? */
+static Bool job_succeeded ( Int j )
+{
+   Int   status = 0;
+   Long  size;
+   UChar end[2];
+
+   if (VG_(waitpid)(job_pid[j], &status, 0) != job_pid[j] || status != 0)
+      return False;
+   size = VG_(fsize)(job_fd[j]);
+   if (size < 2)
+      return False;
+   if (sr_isError(VG_(pread)(job_fd[j], end, 2, size - 2)))
+      return False;
+   return end[0] == R_END && end[1] == 1;
+}
+
+Bool ML_(dwjobs_collect) ( DebugInfo* di )
+{
+   vki_sigaction_toK_t sa;
+   JobReader* readers[DW_JOBS_MAX];
+   ULong n_locs = 0, n_inls = 0;
+   Bool  ok = !start_failed;
+   Int   j, phase;
+   UInt  cu;
+
+   if (n_jobs == 0)
+      return False;
+
+   for (j = 0; j < n_jobs; j++) {
+      if (!job_succeeded(j))
+         ok = False;
+   }
+   VG_(convert_sigaction_fromK_to_toK)(&saved_sigchld, &sa);
+   VG_(sigaction)(VKI_SIGCHLD, &sa, NULL);
+
+   if (ok) {
+      /* If the output turns out not to be as expected, the entries
+         merged so far are dropped again, and the caller reads the
+         whole lot itself. */
+      UWord loctab_used = di->loctab_used;
+      UWord inltab_used = di->inltab_used;
+
+      for (j = 0; j < n_jobs; j++) {
+         readers[j] = ML_(dinfo_zalloc)("di.dwjobs.c.1", sizeof(JobReader));
+         readers[j]->fd    = job_fd[j];
+         readers[j]->strs  = VG_(newXA)(ML_(dinfo_zalloc), "di.dwjobs.c.2",
+                                        ML_(dinfo_free),
+                                        sizeof(const HChar*));
+         readers[j]->fndns = VG_(newXA)(ML_(dinfo_zalloc), "di.dwjobs.c.3",
+                                        ML_(dinfo_free), sizeof(UInt));
+         VG_(lseek)(job_fd[j], 0, VKI_SEEK_SET);
+      }
+
+      /* The CUs were dealt out round robin, so once the helper whose
+         turn it is has no more of a phase, nor has anyone else. */
+      for (phase = 0; phase < DW_JOBS_N_PHASES; phase++) {
+         for (cu = 0; ; cu++) {
+            JobReader* r = readers[cu % n_jobs];
+            if (!r_next_cu(r) || r->cu_phase != phase)
+               break;
+            vg_assert(r->cu_no == cu);
+            r->have_cu = False;
+            merge_cu(di, r, &n_locs, &n_inls);
+         }
+      }
+
+      /* Every CU of every helper must have been merged by now.
+         Anything else means the CUs were not dealt out as expected,
+         or some output came before the first CU. */
+      for (j = 0; j < n_jobs; j++) {
+         if (readers[j]->have_cu || r_peek(readers[j]) != R_END)
+            ok = False;
+      }
+      if (!ok) {
+         di->loctab_used = loctab_used;
+         di->inltab_used = inltab_used;
+      }
+
+      for (j = 0; j < n_jobs; j++) {
+         VG_(deleteXA)(readers[j]->strs);
+         VG_(deleteXA)(readers[j]->fndns);
+         ML_(dinfo_free)(readers[j]);
+      }
+   }
+
+   if (VG_(clo_verbosity) > 1) {
+      if (ok)
+         VG_(message)(Vg_DebugMsg,
+                      "debuginfo-jobs: merged %'llu line and %'llu"
+                      " inlined call entries\n", n_locs, n_inls);
+      else
+         VG_(message)(Vg_DebugMsg,
+                      "debuginfo-jobs: helpers failed; reading"
+                      " without them\n");
+   }
+
+   for (j = 0; j < n_jobs; j++)
+      VG_(close)(job_fd[j]);
+   n_jobs = 0;
+   return ok;
+}
+
+#endif // defined(VGO_linux) || defined(VGO_darwin) || defined(VGO_solaris)
+
+/*--------------------------------------------------------------------*/
+/*--- end                                             dwarfjobs.c ---*/
+/*--------------------------------------------------------------------*/
@@ -41,6 +41,7 @@
 #include "pub_core_libcprint.h"
 #include "pub_core_libcproc.h"     /* VG_(read_millisecond_timer) */
 #include "pub_core_libcfile.h"
+#include "pub_core_aspacemgr.h"    /* VG_(am_mmap_file_float_valgrind) */
 #include "priv_misc.h"             /* dinfo_zalloc/free/strdup */
 #include "priv_image.h"            /* self */
 
@@ -57,6 +58,43 @@
 
 #define COMPRESSED_SLICE_ARRAY_GROW_SIZE 64
 
+/* Compressed slices are inflated on demand, in chunks of this size,
+   which must be a multiple of TINFL_LZ_DICT_SIZE.  At most
+   DECOMP_CACHE_N_CHUNKS chunks per image are cached, so at most 32MB
+   of decompressed data is held at once.  Each chunk boundary passed
+   costs a checkpoint of about 43KB, so that later requests for the
+   chunk can start from there rather than from the start of the
+   slice. */
+#define DECOMP_CHUNK_SIZE     (1024 * 1024)
+#define DECOMP_CACHE_N_CHUNKS 32
+/* How much compressed data is read at once. */
+#define DECOMP_IN_SIZE        (64 * 1024)
+
+STATIC_ASSERT(DECOMP_CHUNK_SIZE % TINFL_LZ_DICT_SIZE == 0);
+
+/* Blocks of images from a debuginfo server are fetched in batches,
+   each costing one round trip: with servers that understand RDMV, up
+   to RDMV_MAX_RANGES blocks in a single request, otherwise as up to
+   READ_PIPELINE_DEPTH READ requests sent back to back.  On a miss, up
+   to REMOTE_RA_MAX_BLOCKS following blocks are read ahead too; the
+   window doubles on each miss that continues a sequential run.
+   ML_(img_prefetch) reads at most REMOTE_PREFETCH_MAX_BLOCKS blocks,
+   half the cache. */
+#define RDMV_MAX_RANGES            256
+#define READ_PIPELINE_DEPTH        32
+#define REMOTE_RA_MAX_BLOCKS       32
+#define REMOTE_PREFETCH_MAX_BLOCKS (CACHE_N_ENTRIES / 2)
+
+/* Local files up to this size are mapped into memory in their
+   entirety, and read directly from there.  Bigger ones, and images
+   for which the mapping fails, are read through the cache.  On 32-bit
+   hosts address space is scarce, so be more conservative there. */
+#if VG_WORDSIZE == 8
+#  define MAX_MAPPED_FILE_SIZE  (~(SizeT)0)
+#else
+#  define MAX_MAPPED_FILE_SIZE  (64 * 1024 * 1024)
+#endif
+
 /* An entry in the cache. */
 typedef
    struct {
@@ -68,6 +106,16 @@ typedef
    }
    CEnt;
 
+/* A decompression checkpoint: the state of the inflater at a chunk
+   boundary. */
+typedef
+   struct {
+      tinfl_decompressor inflator;
+      DiOffT in_off;                   // compressed bytes consumed so far
+      UChar  dict[TINFL_LZ_DICT_SIZE]; // the last 32KB of output
+   }
+   CChk;
+
 /* Compressed slice */
 typedef
    struct {
@@ -75,6 +123,10 @@ typedef
       SizeT  szD;   // size of decompressed data
       DiOffT offC;  // offset of compressed data
       SizeT  szC;   // size of compressed data
+      // NULL, or one pointer per DECOMP_CHUNK_SIZE chunk of the
+      // decompressed data.  chk[k], if non-NULL, is the state at the
+      // start of chunk k.  chk[0] is always NULL.
+      CChk** chk;
    }
    CSlc;
 
@@ -92,6 +144,12 @@ typedef
       // (that is, using a debuginfo server; hence when is_local==False)
       // Session ID allocated to us by the server.  Cannot be zero.
       ULong session_id;
+      // Does the server take RDMV (multi-range read) requests?
+      Bool  has_rdmv;
+      // Read-ahead state: the block that would continue the current
+      // sequential run of misses, and the current window, in blocks.
+      DiOffT ra_next;
+      UInt   ra_win;
    }
    Source;
 
@@ -116,8 +174,30 @@ struct _DiImage {
    UInt  cslc_used;
    // Size of cslc array
    UInt  cslc_size;
+
+   // For local files only: if map_szB is nonzero, the whole file is
+   // mapped read-only at |map|, map_szB == real_size, and reads of
+   // offsets below real_size are served directly from the mapping.
+   // The cache is then only used for decompressed slices.
+   const UChar* map;
+   SizeT        map_szB;
 };
 
+/* Counters for --stats. */
+static ULong n_img_local      = 0; // local images created
+static ULong n_img_mapped     = 0; //   of which were mapped
+static ULong n_img_mapped_szB = 0;
+static ULong n_cent_hits      = 0; // found in ces[1 .. ces_used-1]
+static ULong n_cent_reads     = 0; // misses filled from the file/server
+static ULong n_cent_read_szB  = 0;
+static ULong n_cent_decomps   = 0; // misses filled by decompression
+static ULong n_decomp_szB     = 0; // bytes inflated for those
+static ULong n_decomp_chks    = 0; // checkpoints made
+static ULong n_remote_trips   = 0; // round trips to the server
+static ULong n_remote_blocks  = 0; // blocks fetched from the server
+static ULong n_remote_ra      = 0; //   of which were read ahead
+static ULong n_remote_pf      = 0; //   of which were prefetched
+
 
 /* Sanity check code for CEnts. */
 static void pp_CEnt(const HChar* msg, CEnt* ce)
@@ -273,11 +353,9 @@ static void give_up__image_overrun(void)
    /*NOTREACHED*/
 }
 
-/* "Do" a transaction: that is, send the given frame to the server and
-   return the frame it sends back.  Caller owns the resulting frame
-   and must free it.  A NULL return means the transaction failed for
-   some reason. */
-static Frame* do_transaction ( Int sd, const Frame* req )
+/* Send the given frame to the server.  Returns False if that
+   failed. */
+static Bool send_Frame ( Int sd, const Frame* req )
 {
    if (0) VG_(printf)("CLIENT: send %c%c%c%c\n",
                       req->data[0], req->data[1], req->data[2], req->data[3]);
@@ -298,15 +376,21 @@ static Frame* do_transaction ( Int sd, const Frame* req )
    write_UInt_le(&wr_first8[0], adler);
 
    Int r = my_write(sd, &wr_first8[0], 8);
-   if (r != 8) return NULL;
+   if (r != 8) return False;
    vg_assert(req->n_data >= 4); // else ill formed -- no KIND field
    r = my_write(sd, req->data, req->n_data);
-   if (r != req->n_data) return NULL;
+   if (r != req->n_data) return False;
+   return True;
+}
 
-   /* So, the request is sent.  Now get a request of the same format
-      out of the channel. */
+/* Get the next frame the server sends.  Caller owns the resulting
+   frame and must free it.  A NULL return means the channel failed,
+   or the frame was corrupted, for some reason. */
+static Frame* recv_Frame ( Int sd )
+{
+   /* Frames come back in the same format as requests go out. */
    UChar rd_first8[8];  // adler32; length32
-   r = my_read(sd, &rd_first8[0], 8);
+   Int r = my_read(sd, &rd_first8[0], 8);
    if (r != 8) return NULL;
    UInt rd_adler = read_UInt_le(&rd_first8[0]);
    UInt rd_len   = read_UInt_le(&rd_first8[4]);
@@ -323,7 +407,7 @@ static Frame* do_transaction ( Int sd, const Frame* req )
                       res->data[0], res->data[1], res->data[2], res->data[3]);
 
    /* Compute the checksum for the received data, and check it. */
-   adler = VG_(adler32)(0, NULL, 0); // initial value
+   UInt adler = VG_(adler32)(0, NULL, 0); // initial value
    adler = VG_(adler32)(adler, &rd_first8[4], 4);
    if (res->n_data > 0)
       adler = VG_(adler32)(adler, res->data, res->n_data);
@@ -332,6 +416,17 @@ static Frame* do_transaction ( Int sd, const Frame* req )
    return res;
 }
 
+/* "Do" a transaction: that is, send the given frame to the server and
+   return the frame it sends back.  Caller owns the resulting frame
+   and must free it.  A NULL return means the transaction failed for
+   some reason. */
+static Frame* do_transaction ( Int sd, const Frame* req )
+{
+   n_remote_trips++;
+   if (!send_Frame(sd, req)) return NULL;
+   return recv_Frame(sd);
+}
+
 static void free_Frame ( Frame* fr )
 {
    vg_assert(fr && fr->data);
@@ -363,6 +458,25 @@ static Frame* mk_Frame_le64_le64_le64 ( const HChar* tag,
    return f;
 }
 
+/* An RDMV frame: the session ID, the number of ranges N, then N
+   (offset, length) pairs. */
+static Frame* mk_Frame_RDMV ( ULong session_id, UInt n,
+                              const DiOffT* offs, const SizeT* lens )
+{
+   UInt i;
+   Frame* f = ML_(dinfo_zalloc)("di.mFR.1", sizeof(Frame));
+   f->n_data = 4 + 2*8 + n*2*8;
+   f->data = ML_(dinfo_zalloc)("di.mFR.2", f->n_data);
+   VG_(memcpy)(&f->data[0], "RDMV", 4);
+   write_ULong_le(&f->data[4 + 0*8], session_id);
+   write_ULong_le(&f->data[4 + 1*8], n);
+   for (i = 0; i < n; i++) {
+      write_ULong_le(&f->data[4 + (2 + 2*i + 0)*8], offs[i]);
+      write_ULong_le(&f->data[4 + (2 + 2*i + 1)*8], lens[i]);
+   }
+   return f;
+}
+
 static Frame* mk_Frame_asciiz ( const HChar* tag, const HChar* str )
 {
    vg_assert(VG_(strlen)(tag) == 4);
@@ -535,6 +649,121 @@ static void move_CEnt_to_top ( DiImage* img, UInt entNo )
    img->ces[0] = tmp;
 }
 
+/* Fill the entries |entNos[0 .. n-1]| with the blocks of the file at
+   |offs[0 .. n-1]|, which must be block aligned, by fetching them
+   from the server.  The requests for a batch of blocks all go out
+   before any of the replies are read, so a batch costs one round
+   trip rather than one per block.  The server replies to each range
+   of an RDMV request, and to each READ request, with an RDOK frame,
+   in order, so the replies are handled the same way in both cases. */
+static void set_CEnts_remote ( const DiImage* img, UInt n,
+                               const UInt* entNos, const DiOffT* offs )
+{
+   UInt   i, j;
+   SizeT  lens[RDMV_MAX_RANGES];
+   Frame* req = NULL;
+   Frame* res = NULL;
+   UInt   batch = img->source.has_rdmv ? RDMV_MAX_RANGES
+                                       : READ_PIPELINE_DEPTH;
+   vg_assert(img->source.session_id > 0);
+   vg_assert(batch <= RDMV_MAX_RANGES);
+
+   for (i = 0; i < n; i += batch) {
+      UInt nb = n - i < batch ? n - i : batch;
+      for (j = 0; j < nb; j++) {
+         CEnt* ce = img->ces[entNos[i+j]];
+         vg_assert(ce != NULL && !ce->fromC);
+         vg_assert(offs[i+j] == block_round_down(offs[i+j]));
+         vg_assert(offs[i+j] < img->real_size);
+         lens[j] = img->real_size - offs[i+j];
+         if (lens[j] > ce->size)
+            lens[j] = ce->size;
+      }
+
+      /* Send the requests .. */
+      n_remote_trips++;
+      if (img->source.has_rdmv) {
+         req = mk_Frame_RDMV(img->source.session_id, nb, &offs[i], lens);
+         if (!send_Frame(img->source.fd, req)) goto server_fail;
+         free_Frame(req); req = NULL;
+      } else {
+         for (j = 0; j < nb; j++) {
+            req = mk_Frame_le64_le64_le64("READ", img->source.session_id,
+                                          offs[i+j], lens[j]);
+            if (!send_Frame(img->source.fd, req)) goto server_fail;
+            free_Frame(req); req = NULL;
+         }
+      }
+
+      /* .. and collect the replies. */
+      for (j = 0; j < nb; j++) {
+         CEnt*  ce  = img->ces[entNos[i+j]];
+         DiOffT off = offs[i+j];
+         SizeT  len = lens[j];
+         res = recv_Frame(img->source.fd);
+         if (!res) goto server_fail;
+         ULong  rx_session_id = 0, rx_off = 0, rx_len = 0, rx_zdata_len = 0;
+         UChar* rx_data = NULL;
+         /* Pretty confusing.  rx_sessionid, rx_off and rx_len are copies
+            of the values that we requested in the READ frame just above,
+            so we can be sure that the server is responding to the right
+            request.  It just copies them from the request into the
+            response.  rx_data is the actual data, and rx_zdata_len is
+            its compressed length.  Hence rx_len must equal len, but
+            rx_zdata_len can be different -- smaller, hopefully.. */
+         if (!parse_Frame_le64_le64_le64_bytes
+             (res, "RDOK", &rx_session_id, &rx_off,
+                           &rx_len, &rx_data, &rx_zdata_len))
+            goto server_fail;
+         if (rx_session_id != img->source.session_id
+             || rx_off != off || rx_len != len || rx_data == NULL)
+            goto server_fail;
+
+         // Decompress into the destination buffer
+         // Tell the lib the max number of output bytes it can write.
+         // After the call, this holds the number of bytes actually written,
+         // and it's an error if it is different.
+         lzo_uint out_len = len;
+         Int lzo_rc = lzo1x_decompress_safe(rx_data, rx_zdata_len,
+                                            &ce->data[0], &out_len,
+                                            NULL);
+         Bool ok = lzo_rc == LZO_E_OK && out_len == len;
+         if (!ok) goto server_fail;
+
+         free_Frame(res); res = NULL;
+         ce->off   = off;
+         ce->used  = len;
+         ce->fromC = False;
+         vg_assert(is_sane_CEnt("set_CEnts_remote", img, entNos[i+j]));
+         n_cent_reads++;
+         n_cent_read_szB += len;
+         n_remote_blocks++;
+      }
+   }
+   return;
+
+  server_fail:
+   /* The server screwed up somehow.  Now what? */
+   if (req) free_Frame(req);
+   if (res) {
+      UChar* reason = NULL;
+      if (parse_Frame_asciiz(res, "FAIL", &reason)) {
+         VG_(umsg)("set_CEnt (reading data from DI server): fail: "
+                   "%s\n", reason);
+      } else {
+         VG_(umsg)("set_CEnt (reading data from DI server): fail: "
+                   "unknown reason\n");
+      }
+      free_Frame(res); res = NULL;
+   } else {
+      VG_(umsg)("set_CEnt (reading data from DI server): fail: "
+                "server unexpectedly closed the connection\n");
+   }
+   give_up__comms_lost();
+   /* NOTREACHED */
+   vg_assert(0);
+}
+
 /* Set the given entry so that it has a chunk of the file containing
    the given offset.  It is this function that brings data into the
    cache, either by reading the local file or pulling it from the
@@ -573,70 +802,19 @@ static void set_CEnt ( const DiImage* img, UInt entNo, DiOffT off )
                   nread, len, off, delay);
    }
 
-   if (img->source.is_local) {
+   if (img->map_szB > 0) {
+      // Mapped.  This only happens when priming entry zero.
+      VG_(memcpy)(&ce->data[0], &img->map[off], len);
+   } else if (img->source.is_local) {
       // Simple: just read it
+      n_cent_reads++;
+      n_cent_read_szB += len;
       SysRes sr = VG_(pread)(img->source.fd, &ce->data[0], (Int)len, off);
       vg_assert(!sr_isError(sr));
    } else {
       // Not so simple: poke the server
-      vg_assert(img->source.session_id > 0);
-      Frame* req
-         = mk_Frame_le64_le64_le64("READ", img->source.session_id, off, len);
-      Frame* res = do_transaction(img->source.fd, req);
-      free_Frame(req); req = NULL;
-      if (!res) goto server_fail;
-      ULong  rx_session_id = 0, rx_off = 0, rx_len = 0, rx_zdata_len = 0;
-      UChar* rx_data = NULL;
-      /* Pretty confusing.  rx_sessionid, rx_off and rx_len are copies
-         of the values that we requested in the READ frame just above,
-         so we can be sure that the server is responding to the right
-         request.  It just copies them from the request into the
-         response.  rx_data is the actual data, and rx_zdata_len is
-         its compressed length.  Hence rx_len must equal len, but
-         rx_zdata_len can be different -- smaller, hopefully.. */
-      if (!parse_Frame_le64_le64_le64_bytes
-          (res, "RDOK", &rx_session_id, &rx_off,
-                        &rx_len, &rx_data, &rx_zdata_len))
-         goto server_fail;
-      if (rx_session_id != img->source.session_id
-          || rx_off != off || rx_len != len || rx_data == NULL)
-         goto server_fail;
-
-      //VG_(memcpy)(&ce->data[0], rx_data, len);
-      // Decompress into the destination buffer
-      // Tell the lib the max number of output bytes it can write.
-      // After the call, this holds the number of bytes actually written,
-      // and it's an error if it is different.
-      lzo_uint out_len = len;
-      Int lzo_rc = lzo1x_decompress_safe(rx_data, rx_zdata_len,
-                                         &ce->data[0], &out_len,
-                                         NULL);
-      Bool ok = lzo_rc == LZO_E_OK && out_len == len;
-      if (!ok) goto server_fail;
-
-      free_Frame(res); res = NULL;
-      goto end_of_else_clause;
-     server_fail:
-      /* The server screwed up somehow.  Now what? */
-      if (res) {
-         UChar* reason = NULL;
-         if (parse_Frame_asciiz(res, "FAIL", &reason)) {
-            VG_(umsg)("set_CEnt (reading data from DI server): fail: "
-                      "%s\n", reason);
-         } else {
-            VG_(umsg)("set_CEnt (reading data from DI server): fail: "
-                      "unknown reason\n");
-         }
-         free_Frame(res); res = NULL;
-      } else {
-         VG_(umsg)("set_CEnt (reading data from DI server): fail: "
-                   "server unexpectedly closed the connection\n");
-      }
-      give_up__comms_lost();
-      /* NOTREACHED */
-      vg_assert(0);
-     end_of_else_clause:
-      {}
+      set_CEnts_remote(img, 1, &entNo, &off);
+      return;
    }
    
    ce->off  = off;
@@ -646,6 +824,239 @@ static void set_CEnt ( const DiImage* img, UInt entNo, DiOffT off )
    vg_assert(is_sane_CEnt("set_CEnt", img, entNo));
 }
 
+/* Decompress chunk |k| of |cslc| into a new CEnt, which is not yet
+   connected to |img|.  Decompression starts from the nearest
+   checkpoint at or below chunk |k|, or from the start of the slice,
+   and records checkpoints for all the chunk boundaries it passes, so
+   each part of the slice is inflated more than once only if its chunk
+   is evicted and later needed again.
+
+   The compressed data is read with ML_(img_get_some), which may
+   re-enter get_slowcase.  That is safe, since the compressed data is
+   never itself in a compressed slice, and since no cache state is
+   carried across the call: the new entry is only put in the cache by
+   the caller, afterwards. */
+static CEnt* decompress_chunk ( DiImage* img, CSlc* cslc, UInt k )
+{
+   UInt n_chunks = (cslc->szD + DECOMP_CHUNK_SIZE - 1) / DECOMP_CHUNK_SIZE;
+   vg_assert(k < n_chunks);
+   if (cslc->chk == NULL) {
+      cslc->chk = ML_(dinfo_zalloc)("di.image.decompress_chunk.1",
+                                    n_chunks * sizeof(CChk*));
+   }
+
+   /* Find the place to start from.  There is never a checkpoint for
+      chunk zero; it starts from a freshly initialised inflater. */
+   UInt c = k;
+   while (c > 0 && cslc->chk[c] == NULL)
+      c--;
+   CChk* st = ML_(dinfo_zalloc)("di.image.decompress_chunk.2", sizeof(CChk));
+   if (c == 0) {
+      tinfl_init(&st->inflator);
+      st->in_off = 0;
+   } else {
+      VG_(memcpy)(st, cslc->chk[c], sizeof(CChk));
+   }
+
+   SizeT szK = cslc->szD - (SizeT)k * DECOMP_CHUNK_SIZE;
+   if (szK > DECOMP_CHUNK_SIZE)
+      szK = DECOMP_CHUNK_SIZE;
+   CEnt* ce = ML_(dinfo_zalloc)("di.image.decompress_chunk.3",
+                                offsetof(CEnt, data) + szK);
+   ce->size  = szK;
+   ce->used  = szK;
+   ce->off   = cslc->offD + (DiOffT)k * DECOMP_CHUNK_SIZE;
+   ce->fromC = True;
+
+   UChar* in     = ML_(dinfo_zalloc)("di.image.decompress_chunk.4",
+                                     DECOMP_IN_SIZE);
+   SizeT  in_pos = 0;
+   SizeT  in_len = 0;
+
+   for (; c < n_chunks; c++) {
+      if (c > 0 && cslc->chk[c] == NULL) {
+         cslc->chk[c] = ML_(dinfo_zalloc)("di.image.decompress_chunk.5",
+                                          sizeof(CChk));
+         VG_(memcpy)(cslc->chk[c], st, sizeof(CChk));
+         n_decomp_chks++;
+      }
+      if (c > k)
+         break;
+
+      /* Inflate chunk |c|, keeping it only if it is the one wanted.
+         Since DECOMP_CHUNK_SIZE is a multiple of the dictionary size,
+         chunks start at the start of the dictionary, and no call to
+         tinfl_decompress produces output for two chunks. */
+      SizeT c_szB = cslc->szD - (SizeT)c * DECOMP_CHUNK_SIZE;
+      if (c_szB > DECOMP_CHUNK_SIZE)
+         c_szB = DECOMP_CHUNK_SIZE;
+      SizeT done = 0;
+      while (done < c_szB) {
+         if (in_pos == in_len && st->in_off < cslc->szC) {
+            SizeT want = cslc->szC - st->in_off;
+            if (want > DECOMP_IN_SIZE)
+               want = DECOMP_IN_SIZE;
+            in_len = ML_(img_get_some)(in, img, cslc->offC + st->in_off, want);
+            in_pos = 0;
+         }
+         SizeT in_szB   = in_len - in_pos;
+         Bool  more_in  = st->in_off + in_szB < cslc->szC;
+         SizeT dict_ofs = done & (TINFL_LZ_DICT_SIZE - 1);
+         SizeT out_szB  = TINFL_LZ_DICT_SIZE - dict_ofs;
+         tinfl_status status
+            = tinfl_decompress(&st->inflator, &in[in_pos], &in_szB,
+                               st->dict, &st->dict[dict_ofs], &out_szB,
+                               TINFL_FLAG_PARSE_ZLIB_HEADER
+                               | (more_in ? TINFL_FLAG_HAS_MORE_INPUT : 0));
+         in_pos     += in_szB;
+         st->in_off += in_szB;
+         /* Data that inflates to more or less than the section header
+            says, or doesn't inflate at all, is corrupt. */
+         if (status < 0 || out_szB > c_szB - done
+             || (status == TINFL_STATUS_DONE && done + out_szB < c_szB)
+             || (in_szB == 0 && out_szB == 0))
+            give_up__image_overrun();
+         if (c == k)
+            VG_(memcpy)(&ce->data[done], &st->dict[dict_ofs], out_szB);
+         done += out_szB;
+         n_decomp_szB += out_szB;
+      }
+   }
+
+   ML_(dinfo_free)(in);
+   ML_(dinfo_free)(st);
+   return ce;
+}
+
+/* Put |ce|, a decompressed chunk, in |img|'s cache, at the top.  At
+   most DECOMP_CACHE_N_CHUNKS decompressed chunks are cached; beyond
+   that, the least recently used one makes way. */
+static void install_fromC_CEnt ( DiImage* img, CEnt* ce )
+{
+   UInt i, n_fromC = 0;
+   vg_assert(img->ces_used <= CACHE_N_ENTRIES);
+   for (i = 0; i < img->ces_used; i++) {
+      if (img->ces[i]->fromC)
+         n_fromC++;
+   }
+   if (n_fromC < DECOMP_CACHE_N_CHUNKS && img->ces_used < CACHE_N_ENTRIES) {
+      i = img->ces_used;
+      img->ces_used++;
+      vg_assert(img->ces[i] == NULL);
+   } else {
+      /* Recycle the LRU decompressed chunk, or, if there aren't
+         enough of those yet, the LRU chunk of the file. */
+      Bool wantC = n_fromC >= DECOMP_CACHE_N_CHUNKS;
+      for (i = img->ces_used-1; i > 0; i--) {
+         if (img->ces[i]->fromC == wantC)
+            break;
+      }
+      vg_assert(i > 0 && img->ces[i]->fromC == wantC);
+      ML_(dinfo_free)(img->ces[i]);
+   }
+   img->ces[i] = ce;
+   vg_assert(is_sane_CEnt("install_fromC_CEnt", img, i));
+   if (i > 0)
+      move_CEnt_to_top(img, i);
+}
+
+/* Is the block of the file at |blk| in the cache? */
+static Bool block_is_cached ( const DiImage* img, DiOffT blk )
+{
+   UInt i;
+   for (i = 0; i < img->ces_used; i++) {
+      const CEnt* ce = img->ces[i];
+      if (!ce->fromC && ce->used > 0 && ce->off == blk)
+         return True;
+   }
+   return False;
+}
+
+/* Fetch the blocks of a remote image at |offs[0 .. n-1]|, which must
+   be distinct, block aligned and not already cached, in as few round
+   trips as possible.  Entries are allocated for them while there is
+   space, and otherwise recycled from the (ostensibly) LRU end,
+   avoiding decompressed chunks as get_slowcase does.  Afterwards the
+   block at offs[0] is in ces[0], and the others follow it in order,
+   so that blocks read ahead are not the first to be recycled. */
+static void load_remote_blocks ( DiImage* img, UInt n, const DiOffT* offs )
+{
+   UInt entNos[REMOTE_PREFETCH_MAX_BLOCKS];
+   UInt i, j;
+   vg_assert(!img->source.is_local);
+   vg_assert(n >= 1 && n <= REMOTE_PREFETCH_MAX_BLOCKS);
+
+   UInt ces_used_at_entry = img->ces_used;
+   UInt victim = ces_used_at_entry;
+   for (i = 0; i < n; i++) {
+      if (img->ces_used < CACHE_N_ENTRIES) {
+         entNos[i] = alloc_CEnt(img, CACHE_ENTRY_SIZE, False/*!fromC*/);
+         continue;
+      }
+      /* There are at most DECOMP_CACHE_N_CHUNKS decompressed chunks,
+         and n is at most half the cache, so this can't reach the
+         bottom of the cache. */
+      do {
+         vg_assert(victim > 1);
+         victim--;
+      } while (img->ces[victim]->fromC);
+      CEnt* ce = img->ces[victim];
+      if (ce->size != CACHE_ENTRY_SIZE) {
+         realloc_CEnt(img, victim, CACHE_ENTRY_SIZE);
+         img->ces[victim]->size = CACHE_ENTRY_SIZE;
+      }
+      img->ces[victim]->used = 0;
+      entNos[i] = victim;
+   }
+
+   set_CEnts_remote(img, n, entNos, offs);
+
+   /* Move them to the top, last first, so that they end up in order.
+      Moving entry e to the top pushes those above it down by one. */
+   for (i = n; i > 0; i--) {
+      UInt e = entNos[i-1];
+      if (e > 0)
+         move_CEnt_to_top(img, e);
+      for (j = 0; j < i-1; j++) {
+         if (entNos[j] < e)
+            entNos[j]++;
+      }
+   }
+   vg_assert(img->ces[0]->off == offs[0]);
+}
+
+/* Handle a miss on |off| in a remote image: fetch the block
+   containing it, and read ahead the blocks that follow it, up to the
+   first one that is already cached.  Misses that continue a
+   sequential run double the read-ahead window; others reset it. */
+static void get_remote_miss ( DiImage* img, DiOffT off )
+{
+   DiOffT offs[1 + REMOTE_RA_MAX_BLOCKS];
+   DiOffT blk = block_round_down(off);
+   UInt   n, j;
+
+   if (blk == img->source.ra_next) {
+      img->source.ra_win *= 2;
+      if (img->source.ra_win > REMOTE_RA_MAX_BLOCKS)
+         img->source.ra_win = REMOTE_RA_MAX_BLOCKS;
+   } else {
+      img->source.ra_win = 1;
+   }
+
+   offs[0] = blk;
+   n = 1;
+   for (j = 1; j <= img->source.ra_win; j++) {
+      DiOffT b = blk + (DiOffT)j * CACHE_ENTRY_SIZE;
+      if (b >= img->real_size || block_is_cached(img, b))
+         break;
+      offs[n++] = b;
+   }
+   img->source.ra_next = offs[n-1] + CACHE_ENTRY_SIZE;
+   n_remote_ra += n - 1;
+
+   load_remote_blocks(img, n, offs);
+}
+
 __attribute__((noinline))
 static UChar get_slowcase ( DiImage* img, DiOffT off )
 {
@@ -664,6 +1075,7 @@ static UChar get_slowcase ( DiImage* img, DiOffT off )
 
    if (LIKELY(i < img->ces_used)) {
       // Found it.  Move to the top and stop.
+      n_cent_hits++;
       move_CEnt_to_top(img, i);
       vg_assert(is_in_CEnt(img->ces[0], off));
       return img->ces[0]->data[ off - img->ces[0]->off ];
@@ -671,139 +1083,72 @@ static UChar get_slowcase ( DiImage* img, DiOffT off )
 
    vg_assert(i <= img->ces_used);
 
-   // It's not in any entry.  Either allocate a new one or recycle the LRU
-   // one.  This is where the presence of compressed sections makes things
-   // tricky.  There are 4 cases to consider:
-   //
-   // (1) not from a compressed slice, we can allocate a new entry
-   // (2) not from a compressed slice, we have to recycle the LRU entry
-   // (3) from a compressed slice, we can allocate a new entry
-   // (4) from a compressed slice, we have to recycle the LRU entry
-   //
-   // Cases (3) and (4) are complex because we will have to call
-   // ML_(img_get_some) to get the compressed data.  But this function is
-   // reachable from ML_(img_get_some), so we may re-enter get_slowcase a
-   // second time as a result.  Given that the compressed data will be cause
-   // only cases (1) and (2) to happen, this guarantees no infinite recursion.
-   // It does however mean that we can't carry (in this function invokation)
-   // any local copies of the overall cache state across the ML_(img_get_some)
-   // call, since it may become invalidated by the recursive call to
-   // get_slowcase.
-
-   // First of all, see if it is in a compressed slice, and if so, pull the
-   // compressed data into an intermediate buffer.  Given the preceding
-   // comment, this is a safe place to do it, since we are not carrying any
-   // cache state here apart from the knowledge that the requested offset is
-   // not in the cache at all, and the recursive call won't change that fact.
-
+   // It's not in any entry.  If it is in a compressed slice, inflate
+   // the chunk of the slice containing it.  See decompress_chunk for why
+   // the recursion that involves is OK.
    CSlc* cslc = find_cslc(img, off);
-   UChar* cbuf = NULL;
    if (cslc != NULL) {
-      SizeT len = 0;
-      cbuf = ML_(dinfo_zalloc)("di.image.get_slowcase.cbuf-1", cslc->szC);
-      // get compressed data
-      while (len < cslc->szC)
-         len += ML_(img_get_some)(cbuf + len, img, cslc->offC + len,
-                                  cslc->szC - len);
+      UInt  k  = (off - cslc->offD) / DECOMP_CHUNK_SIZE;
+      CEnt* ce = decompress_chunk(img, cslc, k);
+      n_cent_decomps++;
+      install_fromC_CEnt(img, ce);
+      vg_assert(img->ces[0] == ce && is_in_CEnt(ce, off));
+      return ce->data[ off - ce->off ];
    }
 
-   // Now we can do what we like.
-   vg_assert((cslc == NULL && cbuf == NULL) || (cslc != NULL && cbuf != NULL));
+   // Remote images read ahead; see get_remote_miss.
+   if (!img->source.is_local) {
+      get_remote_miss(img, off);
+      vg_assert(is_in_CEnt(img->ces[0], off));
+      return img->ces[0]->data[ off - img->ces[0]->off ];
+   }
 
-   // Note, we can't capture this earlier, for exactly the reasons detailed
-   // above.
+   // Otherwise, either allocate a new entry or recycle the LRU one, and
+   // read into it the block of the file containing |off|.
    UInt ces_used_at_entry = img->ces_used;
 
-   // This is the size of the CEnt that we want to have after allocation or
-   // recycling.
-   SizeT size = (cslc == NULL) ? CACHE_ENTRY_SIZE : cslc->szD;
-
-   // Cases (1) and (3)
    if (img->ces_used < CACHE_N_ENTRIES) {
       /* Allocate a new cache entry, and fill it in. */
-      i = alloc_CEnt(img, size, /*fromC?*/cslc != NULL);
-      if (cslc == NULL) {
-         set_CEnt(img, i, off);
-         img->ces[i]->fromC = False;
-         vg_assert(is_sane_CEnt("get_slowcase-case-1", img, i));
-         vg_assert(img->ces_used == ces_used_at_entry + 1);
-      } else {
-         SizeT len = tinfl_decompress_mem_to_mem(
-                        img->ces[i]->data, cslc->szD,
-                        cbuf, cslc->szC,
-                        TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF
-                        | TINFL_FLAG_PARSE_ZLIB_HEADER);
-         vg_assert(len == cslc->szD); // sanity check on data, FIXME
-         vg_assert(cslc->szD == size);
-         img->ces[i]->used = cslc->szD;
-         img->ces[i]->off = cslc->offD;
-         img->ces[i]->fromC = True;
-         vg_assert(is_sane_CEnt("get_slowcase-case-3", img, i));
-         vg_assert(img->ces_used == ces_used_at_entry + 1);
-      }
+      i = alloc_CEnt(img, CACHE_ENTRY_SIZE, False/*!fromC*/);
+      set_CEnt(img, i, off);
+      vg_assert(is_sane_CEnt("get_slowcase-alloc", img, i));
       vg_assert(img->ces_used == ces_used_at_entry + 1);
-      if (i > 0) {
-         move_CEnt_to_top(img, i);
-         i = 0;
+   } else {
+      /* All entries in use.  Recycle the (ostensibly) LRU one, but
+         avoid decompressed chunks, since those are expensive to
+         recreate.  There are at most DECOMP_CACHE_N_CHUNKS of those,
+         so there is always another candidate. */
+      for (i = CACHE_N_ENTRIES-1; i > 0; i--) {
+         if (!img->ces[i]->fromC)
+            break;
       }
-      vg_assert(is_in_CEnt(img->ces[i], off));
-      if (cbuf != NULL) {
-         ML_(dinfo_free)(cbuf);
+      vg_assert(i >= 0 && i < CACHE_N_ENTRIES);
+      if (img->ces[i]->size != CACHE_ENTRY_SIZE) {
+         realloc_CEnt(img, i, CACHE_ENTRY_SIZE);
+         img->ces[i]->size = CACHE_ENTRY_SIZE;
       }
-      return img->ces[i]->data[ off - img->ces[i]->off ];
-   }
-
-   // Cases (2) and (4)
-   /* All entries in use.  Recycle the (ostensibly) LRU one.  But try to find
-      a non-fromC entry to recycle, though, since discarding and reloading
-      fromC entries is very expensive.  The result is that -- unless all
-      CACHE_N_ENTRIES wind up being used by decompressed slices, which is
-      highly unlikely -- we'll wind up keeping all the decompressed data in
-      the cache for its entire remaining life.  We could probably do better
-      but it would make the cache management even more complex. */
-   vg_assert(img->ces_used == CACHE_N_ENTRIES);
-
-   // Select entry to recycle.
-   for (i = CACHE_N_ENTRIES-1; i > 0; i--) {
-      if (!img->ces[i]->fromC)
-         break;
-   }
-   vg_assert(i >= 0 && i < CACHE_N_ENTRIES);
-
-   realloc_CEnt(img, i, size);
-   img->ces[i]->size = size;
-   img->ces[i]->used = 0;
-   if (cslc == NULL) {
-      set_CEnt(img, i, off);
+      img->ces[i]->used = 0;
       img->ces[i]->fromC = False;
-      vg_assert(is_sane_CEnt("get_slowcase-case-2", img, i));
-   } else {
-      SizeT len = tinfl_decompress_mem_to_mem(
-                     img->ces[i]->data, cslc->szD,
-                     cbuf, cslc->szC,
-                     TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF
-                     | TINFL_FLAG_PARSE_ZLIB_HEADER);
-      vg_assert(len == size);
-      img->ces[i]->used = size;
-      img->ces[i]->off = cslc->offD;
-      img->ces[i]->fromC = True;
-      vg_assert(is_sane_CEnt("get_slowcase-case-4", img, i));
+      set_CEnt(img, i, off);
+      vg_assert(is_sane_CEnt("get_slowcase-recycle", img, i));
+      vg_assert(img->ces_used == ces_used_at_entry);
    }
-   vg_assert(img->ces_used == ces_used_at_entry);
    if (i > 0) {
       move_CEnt_to_top(img, i);
       i = 0;
    }
    vg_assert(is_in_CEnt(img->ces[i], off));
-   if (cbuf != NULL) {
-      ML_(dinfo_free)(cbuf);
-   }
    return img->ces[i]->data[ off - img->ces[i]->off ];
 }
 
 // This is called a lot, so do the usual fast/slow split stuff on it. */
 static inline UChar get ( DiImage* img, DiOffT off )
 {
+   /* If the file is mapped, anything outside the decompressed slices
+      can be read directly.  map_szB is zero for unmapped images, so
+      this costs unmapped images one untaken branch. */
+   if (LIKELY(off < img->map_szB))
+      return img->map[off];
    /* Most likely case is, it's in the ces[0] position. */
    /* ML_(img_from_local_file) requests a read for ces[0] when
       creating the image.  Hence slot zero is always non-NULL, so we
@@ -851,8 +1196,29 @@ DiImage* ML_(img_from_local_file)(const HChar* fullpath)
    img->cslc            = NULL;
    img->cslc_size       = 0;
    img->cslc_used       = 0;
+   img->map             = NULL;
+   img->map_szB         = 0;
    /* img->ces is already zeroed out */
    vg_assert(img->source.fd >= 0);
+   n_img_local++;
+
+   /* Try to map the whole file, so that reads from it don't need to go
+      through the cache.  If that works, the fd is no longer needed.
+      Closing it means that images kept around for later reading
+      (--lazy-debuginfo) don't use up the client's file descriptors. */
+   if (size <= MAX_MAPPED_FILE_SIZE) {
+      SysRes sres = VG_(am_mmap_file_float_valgrind)(
+                       VG_PGROUNDUP(size), VKI_PROT_READ,
+                       img->source.fd, 0 );
+      if (!sr_isError(sres)) {
+         img->map     = (const UChar*)(Addr)sr_Res(sres);
+         img->map_szB = size;
+         VG_(close)(img->source.fd);
+         img->source.fd = -1;
+         n_img_mapped++;
+         n_img_mapped_szB += size;
+      }
+   }
 
    /* Force the zeroth entry to be the first chunk of the file.
       That's likely to be the first part that's requested anyway, and
@@ -915,6 +1281,22 @@ DiImage* ML_(img_from_di_server)(const HChar* filename,
    req = NULL;
    res = NULL;
 
+   /* Ask it which protocol extensions it has.  Servers that predate
+      the CAPS request say FAIL, and are read from with plain READ
+      requests. */
+   Bool has_rdmv = False;
+   req = mk_Frame_noargs("CAPS");
+   res = do_transaction(sd, req);
+   if (res == NULL)
+      goto fail;
+   UChar* caps = NULL;
+   if (parse_Frame_asciiz(res, "CAOK", &caps))
+      has_rdmv = VG_(strstr)((const HChar*)caps, "RDMV") != NULL;
+   free_Frame(req);
+   free_Frame(res);
+   req = NULL;
+   res = NULL;
+
    /* Server seems plausible.  Present it with the name of the file we
       want and see if it'll give us back a session ID for it. */
    req = mk_Frame_asciiz("OPEN", filename);
@@ -934,6 +1316,10 @@ DiImage* ML_(img_from_di_server)(const HChar* filename,
    img->source.is_local   = False;
    img->source.fd         = sd;
    img->source.session_id = session_id;
+   img->source.has_rdmv   = has_rdmv;
+   /* The block primed below starts a sequential run. */
+   img->source.ra_next    = CACHE_ENTRY_SIZE;
+   img->source.ra_win     = 1;
    img->size              = size;
    img->real_size         = size;
    img->ces_used          = 0;
@@ -944,6 +1330,8 @@ DiImage* ML_(img_from_di_server)(const HChar* filename,
    img->cslc            = NULL;
    img->cslc_size       = 0;
    img->cslc_used       = 0;
+   img->map             = NULL;
+   img->map_szB         = 0;
 
    /* img->ces is already zeroed out */
    vg_assert(img->source.fd >= 0);
@@ -976,6 +1364,52 @@ DiImage* ML_(img_from_di_server)(const HChar* filename,
    return NULL;
 }
 
+void ML_(img_prefetch)(DiImage* img, UInt n,
+                       const DiOffT* offs, const SizeT* szBs)
+{
+   DiOffT blks[REMOTE_PREFETCH_MAX_BLOCKS];
+   UInt   n_blks = 0;
+   UInt   i, j;
+   vg_assert(img != NULL);
+   if (img->source.is_local)
+      return;
+
+   for (i = 0; i < n && n_blks < REMOTE_PREFETCH_MAX_BLOCKS; i++) {
+      DiOffT off = offs[i];
+      SizeT  szB = szBs[i];
+      if (szB == 0 || off >= img->size)
+         continue;
+      /* For compressed sections, fetch the compressed data. */
+      if (off >= img->real_size) {
+         const CSlc* cslc = find_cslc(img, off);
+         if (cslc == NULL)
+            continue;
+         off = cslc->offC;
+         szB = cslc->szC;
+      }
+      if (szB > img->real_size - off)
+         szB = img->real_size - off;
+      DiOffT b;
+      for (b = block_round_down(off);
+           b < off + szB && n_blks < REMOTE_PREFETCH_MAX_BLOCKS;
+           b += CACHE_ENTRY_SIZE) {
+         if (block_is_cached(img, b))
+            continue;
+         for (j = 0; j < n_blks; j++) {
+            if (blks[j] == b)
+               break;
+         }
+         if (j == n_blks)
+            blks[n_blks++] = b;
+      }
+   }
+
+   if (n_blks > 0) {
+      n_remote_pf += n_blks;
+      load_remote_blocks(img, n_blks, blks);
+   }
+}
+
 DiOffT ML_(img_mark_compressed_part)(DiImage* img, DiOffT offset, SizeT szC,
                                      SizeT szD)
 {
@@ -994,6 +1428,7 @@ DiOffT ML_(img_mark_compressed_part)(DiImage* img, DiOffT offset, SizeT szC,
    img->cslc[img->cslc_used].szC = szC;
    img->cslc[img->cslc_used].offD = img->size;
    img->cslc[img->cslc_used].szD = szD;
+   img->cslc[img->cslc_used].chk = NULL;
    img->size += szD;
    img->cslc_used++;
    return ret;
@@ -1003,9 +1438,16 @@ void ML_(img_done)(DiImage* img)
 {
    vg_assert(img != NULL);
    if (img->source.is_local) {
-      /* Close the file; nothing else to do. */
+      /* Unmap or close the file; nothing else to do. */
       vg_assert(img->source.session_id == 0);
-      VG_(close)(img->source.fd);
+      if (img->map_szB > 0) {
+         SysRes sres = VG_(am_munmap_valgrind)((Addr)img->map,
+                                               VG_PGROUNDUP(img->map_szB));
+         vg_assert(!sr_isError(sres));
+         vg_assert(img->source.fd == -1);
+      } else {
+         VG_(close)(img->source.fd);
+      }
    } else {
       /* Close the socket.  The server can detect this and will scrub
          the connection when it happens, so there's no need to tell it
@@ -1024,11 +1466,36 @@ void ML_(img_done)(DiImage* img)
    for (i = i; i < img->ces_used; i++) {
       vg_assert(img->ces[i] == NULL);
    }
+   for (i = 0; i < img->cslc_used; i++) {
+      CSlc* cslc = &img->cslc[i];
+      if (cslc->chk == NULL)
+         continue;
+      UInt k, n_chunks
+         = (cslc->szD + DECOMP_CHUNK_SIZE - 1) / DECOMP_CHUNK_SIZE;
+      for (k = 0; k < n_chunks; k++) {
+         if (cslc->chk[k])
+            ML_(dinfo_free)(cslc->chk[k]);
+      }
+      ML_(dinfo_free)(cslc->chk);
+   }
    ML_(dinfo_free)(img->source.name);
    ML_(dinfo_free)(img->cslc);
    ML_(dinfo_free)(img);
 }
 
+Bool ML_(img_has_fd)(const DiImage* img)
+{
+   vg_assert(img != NULL);
+   /* A mapped local file has no fd left; an unmapped one, or a remote
+      image (which keeps the socket to the server), does. */
+   return img->source.fd >= 0;
+}
+
+Bool ML_(img_is_local)(const DiImage* img)
+{
+   return img->source.is_local;
+}
+
 DiOffT ML_(img_size)(const DiImage* img)
 {
    vg_assert(img != NULL);
@@ -1083,6 +1550,10 @@ void ML_(img_get)(/*OUT*/void* dst,
    vg_assert(img != NULL);
    vg_assert(size > 0);
    ensure_valid(img, offset, size, "ML_(img_get)");
+   if (LIKELY(offset + size <= img->map_szB)) {
+      VG_(memcpy)(dst, &img->map[offset], size);
+      return;
+   }
    SizeT i;
    for (i = 0; i < size; i++) {
       ((UChar*)dst)[i] = get(img, offset + i);
@@ -1096,6 +1567,15 @@ SizeT ML_(img_get_some)(/*OUT*/void* dst,
    vg_assert(size > 0);
    ensure_valid(img, offset, size, "ML_(img_get_some)");
    UChar* dstU = (UChar*)dst;
+   /* For mapped images, copy as much of the range as the mapping
+      covers.  Anything above it is in decompressed slices. */
+   if (LIKELY(offset < img->map_szB)) {
+      SizeT nToCopy = size;
+      if (nToCopy > img->map_szB - offset)
+         nToCopy = img->map_szB - offset;
+      VG_(memcpy)(dstU, &img->map[offset], nToCopy);
+      return nToCopy;
+   }
    /* Use |get| in the normal way to get the first byte of the range.
       This guarantees to put the cache entry containing |offset| in
       position zero. */
@@ -1314,6 +1794,25 @@ UInt ML_(img_calc_gnu_debuglink_crc32)(DiImage* img)
    vg_assert(0);
 }
 
+void ML_(img_print_stats)(void)
+{
+   VG_(message)(Vg_DebugMsg,
+                " image: %'llu local files, %'llu mapped (%'llu bytes)\n",
+                n_img_local, n_img_mapped, n_img_mapped_szB);
+   VG_(message)(Vg_DebugMsg,
+                " image: cache: %'llu slow-path hits, %'llu misses "
+                "(%'llu reads of %'llu bytes, %'llu decompressions)\n",
+                n_cent_hits, n_cent_reads + n_cent_decomps,
+                n_cent_reads, n_cent_read_szB, n_cent_decomps);
+   VG_(message)(Vg_DebugMsg,
+                " image: inflated %'llu bytes, %'llu checkpoints\n",
+                n_decomp_szB, n_decomp_chks);
+   VG_(message)(Vg_DebugMsg,
+                " image: server: %'llu round trips, %'llu blocks "
+                "(%'llu read ahead, %'llu prefetched)\n",
+                n_remote_trips, n_remote_blocks, n_remote_ra, n_remote_pf);
+}
+
 ////////////////////////////////////////////////////
 #include "minilzo-inl.c"
 
@@ -0,0 +1,59 @@
+/* -*- mode: C; c-basic-offset: 3; -*- */
+
+/*--------------------------------------------------------------------*/
+/*--- On-disk cache of canonicalised debuginfo.      priv_dicache.h ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Valgrind, a dynamic binary instrumentation
+   framework.
+
+   Copyright (C) 2015-2015 The Valgrind developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#ifndef __PRIV_DICACHE_H
+#define __PRIV_DICACHE_H
+
+#include "pub_core_debuginfo.h"   // DebugInfo
+
+/* With --debuginfo-cache-dir=<dir>, the tables of each ELF object
+   with a build-id are saved to <dir> once they have been read and
+   canonicalised, and are loaded from there instead of being read from
+   the object in later runs.  See dicache.c. */
+
+/* Try to fill in DI, which has just reached its accept state, from
+   the cache.  Returns True if that worked, in which case DI's tables
+   are complete and canonical; ML_(canonicaliseTables) and
+   ML_(finish_CFSI_arrays) must not be run on it.  Returns False, with
+   DI untouched, otherwise. */
+extern Bool ML_(dicache_load) ( DebugInfo* di );
+
+/* Save DI's tables, which must be complete and canonical, to the
+   cache, unless they were loaded from it. */
+extern void ML_(dicache_save) ( DebugInfo* di );
+
+/* Print the --stats counters. */
+extern void ML_(dicache_print_stats) ( void );
+
+#endif /* ndef __PRIV_DICACHE_H */
+
+/*--------------------------------------------------------------------*/
+/*--- end                                           priv_dicache.h ---*/
+/*--------------------------------------------------------------------*/
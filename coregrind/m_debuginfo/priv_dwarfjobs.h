@@ -0,0 +1,87 @@
+/* -*- mode: C; c-basic-offset: 3; -*- */
+
+/*--------------------------------------------------------------------*/
+/*--- Reading DWARF in helper processes.         priv_dwarfjobs.h ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Valgrind, a dynamic binary instrumentation
+   framework.
+
+   Copyright (C) 2015-2015 The Valgrind developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#ifndef __PRIV_DWARFJOBS_H
+#define __PRIV_DWARFJOBS_H
+
+#include "pub_core_debuginfo.h"   // DebugInfo
+#include "priv_image.h"           // DiSlice
+
+/* With --debuginfo-jobs=N, the line number info and (when the
+   variable info isn't wanted) the inlined call info of a large object
+   are read by N helper processes, each taking every Nth compilation
+   unit, and merged into the DebugInfo in compilation unit order.  See
+   dwarfjobs.c. */
+
+/* The CU loops that can be split up. */
+typedef
+   enum {
+      DwJobsLines=0,     /* ML_(read_debuginfo_dwarf3) */
+      DwJobsInlined=1    /* ML_(new_dwarf3_reader), inlined calls only */
+   }
+   DwJobsPhase;
+
+#define DW_JOBS_N_PHASES 2
+
+/* Start the helpers for DI, if --debuginfo-jobs asks for them and
+   reading the sections in ESCNS[0 .. N_ESCNS-1] is worth it.  Returns
+   True in a helper, which must then run the readers for the phases it
+   is to do and call ML_(dwjobs_finish).  Returns False in the parent,
+   whether or not helpers were started. */
+extern Bool ML_(dwjobs_start) ( DebugInfo* di,
+                                const DiSlice* escns, Int n_escns );
+
+/* In the parent: are helpers running? */
+extern Bool ML_(dwjobs_active) ( void );
+
+/* In the parent: wait for the helpers, and add what they read to DI.
+   Returns False if there were no helpers, or if any failed, in which
+   case nothing has been added and the caller should read the info
+   itself. */
+extern Bool ML_(dwjobs_collect) ( DebugInfo* di );
+
+/* In a helper: send what has been read and exit. */
+__attribute__((noreturn))
+extern void ML_(dwjobs_finish) ( DebugInfo* di );
+
+/* Called by the readers at the start of each CU of PHASE.  Returns
+   True if this process should skip the CU; never in the parent. */
+extern Bool ML_(dwjobs_skip_cu) ( DebugInfo* di, DwJobsPhase phase );
+
+/* Called by the readers when they give up on the rest of the CUs.
+   A helper's results are then thrown away, and the parent reads the
+   info itself, so as to behave exactly as without helpers. */
+extern void ML_(dwjobs_note_failure) ( void );
+
+#endif /* ndef __PRIV_DWARFJOBS_H */
+
+/*--------------------------------------------------------------------*/
+/*--- end                                         priv_dwarfjobs.h ---*/
+/*--------------------------------------------------------------------*/
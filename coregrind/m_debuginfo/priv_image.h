@@ -74,6 +74,20 @@ DiImage* ML_(img_from_di_server)(const HChar* filename,
 /* Destroy an existing image. */
 void ML_(img_done)(DiImage*);
 
+/* Does the image still read through a file descriptor?  Images which
+   do are not kept for --lazy-debuginfo: there are only a few fds
+   Valgrind can keep out of the client's way. */
+Bool ML_(img_has_fd)(const DiImage*);
+
+/* Print the --stats counters: how many local images were mapped, and
+   how the cache used for the others (and for decompressed slices)
+   performed. */
+void ML_(img_print_stats)(void);
+
+/* Is the image read from a local file, rather than from a debuginfo
+   server? */
+Bool ML_(img_is_local)(const DiImage* img);
+
 /* Virtual size of the image. */
 DiOffT ML_(img_size)(const DiImage* img);
 
@@ -137,6 +151,15 @@ UInt ML_(img_calc_gnu_debuglink_crc32)(DiImage* img);
 DiOffT ML_(img_mark_compressed_part)(DiImage* img, DiOffT offset, SizeT szC,
                                      SizeT szD);
 
+/* Tell the image that the sections [offs[i], +szBs[i]), for i in
+   0 .. n-1, are about to be read.  For images from a debuginfo
+   server, the parts of them that aren't cached are fetched in as few
+   round trips as possible (at most half the cache's worth; the rest
+   is fetched on demand as usual).  For compressed sections, it is the
+   compressed data that is fetched.  Does nothing for local images. */
+void ML_(img_prefetch)(DiImage* img, UInt n,
+                       const DiOffT* offs, const SizeT* szBs);
+
 
 /*------------------------------------------------------------*/
 /*--- DiCursor -- cursors for reading images               ---*/
@@ -54,6 +54,19 @@ extern Bool ML_(is_elf_object_file)( const void* image, SizeT n_image,
 */
 extern Bool ML_(read_elf_debug_info) ( DebugInfo* di );
 
+/* Returns the build-id of the ELF object FILENAME as a lower-case hex
+   string in ML_(dinfo_zalloc)'d storage, or NULL if it has none. */
+extern HChar* ML_(read_elf_buildid) ( const HChar* filename );
+
+/* With --lazy-debuginfo=yes, ML_(read_elf_debug_info) leaves the DWARF
+   line, inline and variable info in di->lazy.  Read it now, and
+   canonicalise it.  No-op if di->lazy is NULL. */
+extern void ML_(read_elf_lazy_debug_info) ( DebugInfo* di );
+
+/* Throw away di->lazy, without reading it, closing the images it
+   keeps open.  No-op if di->lazy is NULL. */
+extern void ML_(discard_elf_lazy_debug_info) ( DebugInfo* di );
+
 
 #endif /* ndef __PRIV_READELF_H */
 
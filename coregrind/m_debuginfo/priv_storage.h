@@ -129,6 +129,24 @@ typedef
    }
    DiLoc;
 
+/* Once canonicalised and no longer needed in array form, the loctab
+   is replaced by a compact encoding; see ML_(compress_loctab).  The
+   entries are cut into blocks of LOC_BLOCK_N, each described by a
+   DiLocBlk giving its first entry's address, line number and fndn_ix,
+   and where its encoded entries start in di->loccz.  Blocks are in
+   address order, so a lookup is a binary search over the blocks
+   followed by decoding at most LOC_BLOCK_N entries. */
+#define LOC_BLOCK_N 32
+
+typedef
+   struct {
+      Addr   addr;     /* address of the block's first entry */
+      UInt   lineno;   /* its line number */
+      UInt   fndn_ix;  /* its fndn_ix */
+      UInt   offs;     /* offset of the block's entries in di->loccz */
+   }
+   DiLocBlk;
+
 #define LEVEL_BITS  (32 - LINENO_BITS)
 #define MAX_LEVEL     ((1 << LEVEL_BITS) - 1)
 
@@ -153,6 +171,20 @@ typedef
    }
    DiInlLoc;
 
+/* One element of the nested containment list over inltab, which
+   ML_(search_inltab) uses to find all the inlined calls covering an
+   address.  Each list holds ranges none of which contains another, in
+   increasing order of both addr_lo and addr_hi; the ranges contained
+   in a range form its sublist.  The top-level list is at the start
+   of di->inlnc and all the others follow. */
+typedef
+   struct {
+      UInt   ix;     /* position in di->inltab */
+      UInt   sub;    /* position in di->inlnc of the sublist */
+      UInt   nsub;   /* number of elements in the sublist */
+   }
+   DiInlNode;
+
 /* --------------------- CF INFO --------------------- */
 
 /* DiCfSI: a structure to summarise DWARF2/3 CFA info for the code
@@ -640,6 +672,11 @@ struct _DebugInfo {
    /* The file's soname. */
    HChar* soname;
 
+   /* The object's build-id (NT_GNU_BUILD_ID note) as a lower-case hex
+      string, or NULL if it doesn't have one.  In mallocville
+      (VG_AR_DINFO). */
+   HChar* buildid;
+
    /* Description of some important mapped segments.  The presence or
       absence of the mapping is denoted by the _present field, since
       in some obscure circumstances (to do with data/sdata/bss) it is
@@ -870,6 +907,14 @@ struct _DebugInfo {
                                depending on sizeof_fndn_ix. */
    UWord   loctab_used;
    UWord   loctab_size;
+   /* The compact form of loctab, which replaces it once it has been
+      built.  loctab and loctab_fndn_ix are then NULL, but loctab_used
+      still gives the number of entries.  Use ML_(get_loc) and
+      ML_(fndn_ix) rather than looking at either form directly. */
+   UChar*    loccz;
+   SizeT     loccz_szB;
+   DiLocBlk* loccz_blk;
+   UWord     loccz_nblk;
    /* An expandable array of inlined fn info.
       maxinl_codesz is the biggest inlined piece of code
       in inltab (i.e. the max of 'addr_hi - addr_lo'. */
@@ -877,6 +922,11 @@ struct _DebugInfo {
    UWord   inltab_used;
    UWord   inltab_size;
    SizeT   maxinl_codesz;
+   /* Nested containment list over inltab, inltab_used entries of
+      which the first inlnc_ntop are the top-level list.  Built by
+      ML_(build_inltab_index). */
+   DiInlNode* inlnc;
+   UWord      inlnc_ntop;
 
    /* A set of expandable arrays to store CFI summary info records.
       The machine specific information (i.e. the DiCfSI_m struct)
@@ -1000,6 +1050,18 @@ struct _DebugInfo {
       This helps performance a lot during ML_(addLineInfo) etc., which can
       easily be invoked hundreds of thousands of times. */
    DebugInfoMapping* last_rx_map;
+
+   /* With --lazy-debuginfo=yes, the DWARF line, inline and variable
+      info is not read along with the rest, and this holds what is
+      needed to read it later: see ML_(read_elf_lazy_debug_info).
+      Until then loctab, inltab and varinfo are empty, and strpool
+      and fndnpool are not frozen.  NULL once the info has been read,
+      or if there is none to read. */
+   struct _DiLazyDwarf* lazy;
+
+   /* Were the tables loaded from the --debuginfo-cache-dir cache
+      rather than read from the object?  See dicache.c. */
+   Bool from_dicache;
 };
 
 /* --------------------- functions --------------------- */
@@ -1033,6 +1095,10 @@ extern const HChar* ML_(fndn_ix2dirname) (const DebugInfo* di,
    0 if filename/dirname are unknown. */
 extern UInt ML_(fndn_ix) (const DebugInfo* di, Word locno);
 
+/* Fetch entry locno of di's loctab, in whichever form it is held. */
+extern void ML_(get_loc) ( const DebugInfo* di, Word locno,
+                           /*OUT*/DiLoc* loc );
+
 /* Add a line-number record to a DebugInfo.
    fndn_ix is an index in di->fndnpool, allocated using  ML_(addFnDn).
    Give a 0 index for a unknown filename/dirname pair. */
@@ -1094,6 +1160,11 @@ extern void ML_(addVar)( struct _DebugInfo* di,
    this after finishing adding entries to these tables. */
 extern void ML_(canonicaliseTables) ( struct _DebugInfo* di );
 
+/* Canonicalise the line, inline and variable info of 'di', and freeze
+   its string and filename pools.  Call this after reading info that
+   was deferred by --lazy-debuginfo=yes. */
+extern void ML_(canonicaliseLazyTables) ( struct _DebugInfo* di );
+
 /* Canonicalise the call-frame-info table held by 'di', in preparation
    for use. This is called by ML_(canonicaliseTables) but can also be
    called on it's own to sort just this table. */
@@ -1114,6 +1185,24 @@ extern Word ML_(search_one_symtab) ( const DebugInfo* di, Addr ptr,
    if not found.  Binary search.  */
 extern Word ML_(search_one_loctab) ( const DebugInfo* di, Addr ptr );
 
+/* Find all the inltab entries whose range contains ptr, and return
+   how many there are.  Their positions in di->inltab are put in *res,
+   in increasing order, in a buffer that stays valid until the next
+   call.  Takes O(log n + k) time, using di->inlnc. */
+extern UWord ML_(search_inltab) ( const DebugInfo* di, Addr ptr,
+                                  /*OUT*/const UInt** res );
+
+/* (Re)build di->inlnc from di->inltab, which must be canonical. */
+extern void ML_(build_inltab_index) ( struct _DebugInfo* di );
+
+/* Replace di's canonical loctab by its compact encoding.  Call this
+   once nothing more will be added to the loctab, nor will it be
+   saved to the --debuginfo-cache-dir cache. */
+extern void ML_(compress_loctab) ( struct _DebugInfo* di );
+
+/* Print the --stats counters for loctab compression. */
+extern void ML_(loctab_print_stats) ( void );
+
 /* Find a CFI-table index containing the specified pointer, or -1 if
    not found.  Binary search.  */
 extern Word ML_(search_one_cfitab) ( const DebugInfo* di, Addr ptr );
@@ -44,6 +44,7 @@
 #include "priv_d3basics.h"
 #include "priv_tytypes.h"
 #include "priv_storage.h"
+#include "priv_dwarfjobs.h"        /* ML_(dwjobs_skip_cu) */
 #include "priv_readdwarf.h"        /* self */
 
 
@@ -1074,6 +1075,10 @@ void ML_(read_debuginfo_dwarf3)
                       "Ignoring non-Dwarf2/3/4 block in .debug_info" );
          continue;
       }
+
+      /* With --debuginfo-jobs, another process may be doing this one. */
+      if (ML_(dwjobs_skip_cu)( di, DwJobsLines ))
+         continue;
       
       /* Fill ui with offset in .debug_line and compdir */
       if (0)
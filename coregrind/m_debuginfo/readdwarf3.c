@@ -151,6 +151,7 @@
 #include "priv_tytypes.h"
 #include "priv_d3basics.h"
 #include "priv_storage.h"
+#include "priv_dwarfjobs.h"        /* ML_(dwjobs_skip_cu) */
 #include "priv_readdwarf3.h"       /* self */
 
 
@@ -4697,6 +4698,19 @@ void new_dwarf3_reader_wrk (
             parse_CU_Header( &cc, td3, &info, escn_debug_abbv,
                              pass == 2, False );
          }
+
+         /* With --debuginfo-jobs, another process may be doing this
+            one.  (Helpers only read inlined call info, so never see
+            .debug_types.) */
+         if (pass < 2 && ML_(dwjobs_skip_cu)( di, DwJobsInlined )) {
+            cu_offset_now = cu_start_offset
+                            + cc.unit_length + (cc.is_dw64 ? 12 : 4);
+            clear_CUConst(&cc);
+            if (cu_offset_now >= section_size)
+               break;
+            set_position_of_Cursor( &info, cu_offset_now );
+            continue;
+         }
          cc.escn_debug_str      = pass == 0 ? escn_debug_str_alt
                                             : escn_debug_str;
          cc.escn_debug_ranges   = escn_debug_ranges;
@@ -5215,6 +5229,7 @@ ML_(new_dwarf3_reader) (
       TRACE_D3("\n------ .debug_info reading failed ------\n");
 
       ML_(symerr)(di, True, d3rd_jmpbuf_reason);
+      ML_(dwjobs_note_failure)();
    }
 
    d3rd_jmpbuf_valid  = False;
@@ -51,6 +51,7 @@
 #include "priv_readdwarf.h"        /* 'cos ELF contains DWARF */
 #include "priv_readdwarf3.h"
 #include "priv_readexidx.h"
+#include "priv_dwarfjobs.h"
 #include "config.h"
 
 /* --- !!! --- EXTERNAL HEADERS start --- !!! --- */
@@ -1196,6 +1197,18 @@ HChar* find_buildid(DiImage* img, Bool rel_ok, Bool search_shdrs)
    return buildid;
 }
 
+HChar* ML_(read_elf_buildid) ( const HChar* filename )
+{
+   HChar*   buildid;
+   DiImage* img = ML_(img_from_local_file)(filename);
+
+   if (img == NULL)
+      return NULL;
+   buildid = find_buildid(img, False, False);
+   ML_(img_done)(img);
+   return buildid;
+}
+
 
 /* Try and open a separate debug file, ignoring any where the CRC does
    not match the value from the main object file.  Returned DiImage
@@ -1511,6 +1524,129 @@ static Bool check_compression(ElfXX_Shdr* h, DiSlice* s) {
     return True;
 }
 
+/* The DWARF sections of an object whose line, inline and variable
+   info is to be read later (--lazy-debuginfo=yes), and the images they
+   live in, which are kept open until then. */
+typedef
+   struct _DiLazyDwarf {
+      DiImage* mimg;
+      DiImage* dimg;
+      DiImage* aimg;
+      DiSlice  debug_info_escn;
+      DiSlice  debug_types_escn;
+      DiSlice  debug_abbv_escn;
+      DiSlice  debug_line_escn;
+      DiSlice  debug_str_escn;
+      DiSlice  debug_ranges_escn;
+      DiSlice  debug_loc_escn;
+      DiSlice  debug_info_alt_escn;
+      DiSlice  debug_abbv_alt_escn;
+      DiSlice  debug_line_alt_escn;
+      DiSlice  debug_str_alt_escn;
+   }
+   DiLazyDwarf;
+
+/* Read the line number info and, if wanted, the inline and variable
+   info, from the DWARF sections given.  Helper processes are used only
+   if ALLOW_JOBS. */
+static
+void read_dwarf_line_and_die_info ( struct _DebugInfo* di,
+                                    DiSlice debug_info_escn,
+                                    DiSlice debug_types_escn,
+                                    DiSlice debug_abbv_escn,
+                                    DiSlice debug_line_escn,
+                                    DiSlice debug_str_escn,
+                                    DiSlice debug_ranges_escn,
+                                    DiSlice debug_loc_escn,
+                                    DiSlice debug_info_alt_escn,
+                                    DiSlice debug_abbv_alt_escn,
+                                    DiSlice debug_line_alt_escn,
+                                    DiSlice debug_str_alt_escn,
+                                    Bool allow_jobs )
+{
+   /* With --debuginfo-jobs, helper processes may read the line
+      info, and the inline info unless it comes with the variable
+      info, while we get on with the rest (see dwarfjobs.c). */
+   const DiSlice dwarf_escns[]
+      = { debug_info_escn,     debug_types_escn,
+          debug_abbv_escn,     debug_line_escn,
+          debug_str_escn,      debug_ranges_escn,
+          debug_loc_escn,      debug_info_alt_escn,
+          debug_abbv_alt_escn, debug_line_alt_escn,
+          debug_str_alt_escn };
+   Bool inl_jobs   = !VG_(clo_read_var_info)
+                     && VG_(clo_read_inline_info);
+   Bool lines_done = False;
+   Bool dies_done  = !VG_(clo_read_var_info)
+                     && !VG_(clo_read_inline_info);
+
+   if (allow_jobs
+       && ML_(dwjobs_start)( di, dwarf_escns,
+                             sizeof(dwarf_escns)/sizeof(dwarf_escns[0]) )) {
+      /* We're a helper: read our share of the CUs, and go. */
+      ML_(read_debuginfo_dwarf3) ( di,
+                                   debug_info_escn,
+                                   debug_types_escn,
+                                   debug_abbv_escn,
+                                   debug_line_escn,
+                                   debug_str_escn,
+                                   debug_str_alt_escn );
+      if (inl_jobs)
+         ML_(new_dwarf3_reader)(
+            di, debug_info_escn,     debug_types_escn,
+                debug_abbv_escn,     debug_line_escn,
+                debug_str_escn,      debug_ranges_escn,
+                debug_loc_escn,      debug_info_alt_escn,
+                debug_abbv_alt_escn, debug_line_alt_escn,
+                debug_str_alt_escn
+         );
+      ML_(dwjobs_finish)( di );
+      /*NOTREACHED*/
+   }
+   if (ML_(dwjobs_active)()) {
+      if (VG_(clo_read_var_info)) {
+         ML_(new_dwarf3_reader)(
+            di, debug_info_escn,     debug_types_escn,
+                debug_abbv_escn,     debug_line_escn,
+                debug_str_escn,      debug_ranges_escn,
+                debug_loc_escn,      debug_info_alt_escn,
+                debug_abbv_alt_escn, debug_line_alt_escn,
+                debug_str_alt_escn
+         );
+         dies_done = True;
+      }
+      if (ML_(dwjobs_collect)( di )) {
+         lines_done = True;
+         if (inl_jobs)
+            dies_done = True;
+      }
+   }
+
+   /* The old reader: line numbers and unwind info only */
+   if (!lines_done)
+      ML_(read_debuginfo_dwarf3) ( di,
+                                   debug_info_escn,
+                                   debug_types_escn,
+                                   debug_abbv_escn,
+                                   debug_line_escn,
+                                   debug_str_escn,
+                                   debug_str_alt_escn );
+   /* The new reader: read the DIEs in .debug_info to acquire
+      information on variable types and locations or inline info.
+      But only if the tool asks for it, or the user requests it on
+      the command line. */
+   if (!dies_done) {
+      ML_(new_dwarf3_reader)(
+         di, debug_info_escn,     debug_types_escn,
+             debug_abbv_escn,     debug_line_escn,
+             debug_str_escn,      debug_ranges_escn,
+             debug_loc_escn,      debug_info_alt_escn,
+             debug_abbv_alt_escn, debug_line_alt_escn,
+             debug_str_alt_escn
+      );
+   }
+}
+
 /* The central function for reading ELF debug info.  For the
    object/exe specified by the DebugInfo, find ELF sections, then read
    the symbols, line number info, file name info, CFA (stack-unwind
@@ -2636,10 +2772,11 @@ Bool ML_(read_elf_debug_info) ( struct _DebugInfo* di )
          }
       }
 
-      if (buildid) {
-         ML_(dinfo_free)(buildid);
-         buildid = NULL; /* paranoia */
-      }
+      /* Hand the build-id over to the DebugInfo; it is freed along
+         with it. */
+      vg_assert(di->buildid == NULL);
+      di->buildid = buildid;
+      buildid = NULL; /* paranoia */
 
       /* As a last-ditch measure, try looking for in the
          --extra-debuginfo-path and/or on the --debuginfo-server, but
@@ -2889,6 +3026,31 @@ Bool ML_(read_elf_debug_info) ( struct _DebugInfo* di )
 
 #           undef FIND
          } /* Find all interesting sections */
+
+         /* If the debug image is on a --debuginfo-server, fetch the
+            sections that are read first and in their entirety in one
+            go, rather than a cache miss (and round trip) at a time. */
+         if (!ML_(img_is_local)(dimg)) {
+            DiOffT pf_offs[4 + N_EHFRAME_SECTS];
+            SizeT  pf_szBs[4 + N_EHFRAME_SECTS];
+            UInt   pf_n = 0;
+#           define PREFETCH(_sec_escn) \
+               do { \
+                  if ((_sec_escn).img == dimg) { \
+                     pf_offs[pf_n] = (_sec_escn).ioff; \
+                     pf_szBs[pf_n] = (_sec_escn).szB; \
+                     pf_n++; \
+                  } \
+               } while (0)
+            PREFETCH(symtab_escn);
+            PREFETCH(strtab_escn);
+            PREFETCH(debug_line_escn);
+            PREFETCH(debug_frame_escn);
+            for (i = 0; i < ehframe_mix; i++)
+               PREFETCH(ehframe_escn[i]);
+#           undef PREFETCH
+            ML_(img_prefetch)(dimg, pf_n, pf_offs, pf_szBs);
+         }
       } /* do we have a debug image? */
 
       /* TOPLEVEL */
@@ -3094,27 +3256,40 @@ Bool ML_(read_elf_debug_info) ( struct _DebugInfo* di )
       if (ML_(sli_is_valid)(debug_info_escn) 
           && ML_(sli_is_valid)(debug_abbv_escn)
           && ML_(sli_is_valid)(debug_line_escn)) {
-         /* The old reader: line numbers and unwind info only */
-         ML_(read_debuginfo_dwarf3) ( di,
-                                      debug_info_escn,
-                                      debug_types_escn,
-                                      debug_abbv_escn,
-                                      debug_line_escn,
-                                      debug_str_escn,
-                                      debug_str_alt_escn );
-         /* The new reader: read the DIEs in .debug_info to acquire
-            information on variable types and locations or inline info.
-            But only if the tool asks for it, or the user requests it on
-            the command line. */
-         if (VG_(clo_read_var_info) /* the user or tool asked for it */
-             || VG_(clo_read_inline_info)) {
-            ML_(new_dwarf3_reader)(
+         if (VG_(clo_lazy_debuginfo)
+             && !(mimg && ML_(img_has_fd)(mimg))
+             && !(dimg && ML_(img_has_fd)(dimg))
+             && !(aimg && ML_(img_has_fd)(aimg))) {
+            /* Read this when it is first wanted.  The slices point into
+               the images, so those are handed over too.  That is only
+               done for images which are mapped in, and so hold no fd:
+               the rest are read now. */
+            DiLazyDwarf* lz
+               = ML_(dinfo_zalloc)("di.redi.lazy.1", sizeof(DiLazyDwarf));
+            lz->mimg = mimg;
+            lz->dimg = dimg;
+            lz->aimg = aimg;
+            mimg = dimg = aimg = NULL;
+            lz->debug_info_escn     = debug_info_escn;
+            lz->debug_types_escn    = debug_types_escn;
+            lz->debug_abbv_escn     = debug_abbv_escn;
+            lz->debug_line_escn     = debug_line_escn;
+            lz->debug_str_escn      = debug_str_escn;
+            lz->debug_ranges_escn   = debug_ranges_escn;
+            lz->debug_loc_escn      = debug_loc_escn;
+            lz->debug_info_alt_escn = debug_info_alt_escn;
+            lz->debug_abbv_alt_escn = debug_abbv_alt_escn;
+            lz->debug_line_alt_escn = debug_line_alt_escn;
+            lz->debug_str_alt_escn  = debug_str_alt_escn;
+            di->lazy = lz;
+         } else {
+            read_dwarf_line_and_die_info(
                di, debug_info_escn,     debug_types_escn,
                    debug_abbv_escn,     debug_line_escn,
                    debug_str_escn,      debug_ranges_escn,
                    debug_loc_escn,      debug_info_alt_escn,
                    debug_abbv_alt_escn, debug_line_alt_escn,
-                   debug_str_alt_escn
+                   debug_str_alt_escn,  True/*allow_jobs*/
             );
          }
       }
@@ -3200,7 +3375,10 @@ Bool ML_(read_elf_debug_info) ( struct _DebugInfo* di )
 
   out: 
    {
-      /* Last, but not least, detach from the image(s). */
+      /* Last, but not least, detach from the image(s).  If the DWARF
+         was put aside for later, they were handed over with it. */
+      if (!res)
+         ML_(discard_elf_lazy_debug_info)(di);
       if (mimg) ML_(img_done)(mimg);
       if (dimg) ML_(img_done)(dimg);
       if (aimg) ML_(img_done)(aimg);
@@ -3213,6 +3391,52 @@ Bool ML_(read_elf_debug_info) ( struct _DebugInfo* di )
    /* NOTREACHED */
 }
 
+void ML_(read_elf_lazy_debug_info) ( struct _DebugInfo* di )
+{
+   DiLazyDwarf* lz = di->lazy;
+
+   if (lz == NULL)
+      return;
+   /* Clear it first: with di->lazy NULL, the readers and
+      ML_(canonicaliseLazyTables) behave as for an eager read. */
+   di->lazy = NULL;
+
+   if (VG_(clo_verbosity) > 1)
+      VG_(message)(Vg_DebugMsg, "Reading deferred debug info for %s\n",
+                   di->fsm.filename);
+
+   /* Helper processes are not used here: this happens at some
+      arbitrary point in the run, and the tables are small enough for
+      one object at a time. */
+   read_dwarf_line_and_die_info(
+      di, lz->debug_info_escn,     lz->debug_types_escn,
+          lz->debug_abbv_escn,     lz->debug_line_escn,
+          lz->debug_str_escn,      lz->debug_ranges_escn,
+          lz->debug_loc_escn,      lz->debug_info_alt_escn,
+          lz->debug_abbv_alt_escn, lz->debug_line_alt_escn,
+          lz->debug_str_alt_escn,  False/*!allow_jobs*/
+   );
+   ML_(canonicaliseLazyTables)( di );
+
+   if (lz->mimg) ML_(img_done)(lz->mimg);
+   if (lz->dimg) ML_(img_done)(lz->dimg);
+   if (lz->aimg) ML_(img_done)(lz->aimg);
+   ML_(dinfo_free)(lz);
+}
+
+void ML_(discard_elf_lazy_debug_info) ( struct _DebugInfo* di )
+{
+   DiLazyDwarf* lz = di->lazy;
+
+   if (lz == NULL)
+      return;
+   di->lazy = NULL;
+   if (lz->mimg) ML_(img_done)(lz->mimg);
+   if (lz->dimg) ML_(img_done)(lz->dimg);
+   if (lz->aimg) ML_(img_done)(lz->aimg);
+   ML_(dinfo_free)(lz);
+}
+
 #endif // defined(VGO_linux) || defined(VGO_solaris)
 
 /*--------------------------------------------------------------------*/
@@ -347,10 +347,229 @@ void ML_(addSym) ( struct _DebugInfo* di, DiSym* sym )
    vg_assert(di->symtab_used <= di->symtab_size);
 }
 
+/* The compact loctab.  Each block's entries are encoded one after
+   another, each relative to the previous one (or, for the first, to
+   the values in the DiLocBlk), as:
+
+      ULEB128  gap between the previous entry's end and this one's addr
+      ULEB128  size
+      ULEB128  (zigzag(lineno delta) << 1) | fndn_ix-differs
+      ULEB128  fndn_ix, only present if it differs
+
+   Consecutive line records are usually contiguous, in the same file,
+   and a few lines apart, so this typically takes 3 or 4 bytes per
+   entry, against sizeof(DiLoc) + sizeof_fndn_ix for the array. */
+
+static ULong loccz_n_tables  = 0;
+static ULong loccz_n_entries = 0;
+static ULong loccz_raw_szB   = 0;
+static ULong loccz_cz_szB    = 0;
+
+/* Write V to P, unless P is NULL, and return the number of bytes it
+   takes. */
+static SizeT put_uleb128 ( UChar* p, ULong v )
+{
+   SizeT n = 0;
+   do {
+      UChar b = v & 0x7F;
+      v >>= 7;
+      if (v != 0)
+         b |= 0x80;
+      if (p)
+         p[n] = b;
+      n++;
+   } while (v != 0);
+   return n;
+}
+
+static ULong get_uleb128 ( const UChar** pp )
+{
+   const UChar* p = *pp;
+   ULong v = 0;
+   UInt  shift = 0;
+   UChar b;
+   do {
+      b = *p++;
+      v |= ((ULong)(b & 0x7F)) << shift;
+      shift += 7;
+   } while (b & 0x80);
+   *pp = p;
+   return v;
+}
+
+/* Decoding state: where the next entry starts, and the values of the
+   previous entry that it is encoded relative to. */
+typedef
+   struct {
+      const UChar* p;
+      Addr         end;
+      UInt         lineno;
+      UInt         fndn_ix;
+   }
+   LocCursor;
+
+static void start_loc_block ( const DebugInfo* di, UWord b,
+                              /*OUT*/LocCursor* cur )
+{
+   const DiLocBlk* blk = &di->loccz_blk[b];
+   cur->p       = di->loccz + blk->offs;
+   cur->end     = blk->addr;
+   cur->lineno  = blk->lineno;
+   cur->fndn_ix = blk->fndn_ix;
+}
+
+static void next_loc ( LocCursor* cur, /*OUT*/DiLoc* loc,
+                       /*OUT*/UInt* fndn_ix )
+{
+   ULong v;
+   UInt  zz;
+   Int   dl;
+
+   loc->addr = cur->end + (Addr)get_uleb128(&cur->p);
+   loc->size = get_uleb128(&cur->p);
+   v  = get_uleb128(&cur->p);
+   zz = (UInt)(v >> 1);
+   dl = (Int)(zz >> 1) ^ -(Int)(zz & 1);
+   cur->lineno += dl;
+   loc->lineno = cur->lineno;
+   if (v & 1)
+      cur->fndn_ix = (UInt)get_uleb128(&cur->p);
+   *fndn_ix = cur->fndn_ix;
+   cur->end = loc->addr + loc->size;
+}
+
+/* Encode LOC, which has FNDN_IX, relative to CUR, at P unless P is
+   NULL.  Returns the number of bytes it takes. */
+static SizeT put_loc ( UChar* p, /*MOD*/LocCursor* cur,
+                       const DiLoc* loc, UInt fndn_ix )
+{
+   SizeT n  = 0;
+   Int   dl = (Int)loc->lineno - (Int)cur->lineno;
+   UInt  zz = ((UInt)dl << 1) ^ (UInt)(dl >> 31);
+   Bool  nf = fndn_ix != cur->fndn_ix;
+
+   vg_assert(loc->addr >= cur->end);
+   n += put_uleb128(p ? p + n : NULL, loc->addr - cur->end);
+   n += put_uleb128(p ? p + n : NULL, loc->size);
+   n += put_uleb128(p ? p + n : NULL, ((ULong)zz << 1) | (nf ? 1 : 0));
+   if (nf)
+      n += put_uleb128(p ? p + n : NULL, fndn_ix);
+   cur->end     = loc->addr + loc->size;
+   cur->lineno  = loc->lineno;
+   cur->fndn_ix = fndn_ix;
+   return n;
+}
+
+static void get_compressed_loc ( const DebugInfo* di, Word locno,
+                                 /*OUT*/DiLoc* loc, /*OUT*/UInt* fndn_ix )
+{
+   LocCursor cur;
+   UWord     j;
+
+   vg_assert(locno >= 0 && locno < di->loctab_used);
+   start_loc_block(di, locno / LOC_BLOCK_N, &cur);
+   for (j = 0; j <= locno % LOC_BLOCK_N; j++)
+      next_loc(&cur, loc, fndn_ix);
+}
+
+void ML_(compress_loctab) ( struct _DebugInfo* di )
+{
+   UWord     n = di->loctab_used, nblk, i;
+   SizeT     szB, raw_szB;
+   LocCursor cur;
+   UChar*    cz  = NULL;
+   DiLocBlk* blk = NULL;
+   UChar*    p;
+
+   if (di->loctab == NULL)
+      return; /* already done, or nothing to do */
+   vg_assert(di->loccz_blk == NULL);
+
+   raw_szB = di->loctab_size * (sizeof(DiLoc) + di->sizeof_fndn_ix);
+   nblk = (n + LOC_BLOCK_N - 1) / LOC_BLOCK_N;
+
+   /* Pass 1: find the size of the encoding. */
+   szB = 0;
+   for (i = 0; i < n; i++) {
+      if (i % LOC_BLOCK_N == 0) {
+         cur.end     = di->loctab[i].addr;
+         cur.lineno  = di->loctab[i].lineno;
+         cur.fndn_ix = ML_(fndn_ix)(di, i);
+      }
+      szB += put_loc(NULL, &cur, &di->loctab[i], ML_(fndn_ix)(di, i));
+   }
+   vg_assert(szB <= 0xFFFFFFFFUL);
+
+   /* Pass 2: encode.  Don't install the result until the end, as
+      ML_(fndn_ix) must keep reading the array form until then. */
+   if (n > 0) {
+      cz  = ML_(dinfo_zalloc)("di.storage.cLT.1", szB);
+      blk = ML_(dinfo_zalloc)("di.storage.cLT.2", nblk * sizeof(DiLocBlk));
+   }
+   p = cz;
+   for (i = 0; i < n; i++) {
+      if (i % LOC_BLOCK_N == 0) {
+         DiLocBlk* b = &blk[i / LOC_BLOCK_N];
+         b->addr     = di->loctab[i].addr;
+         b->lineno   = di->loctab[i].lineno;
+         b->fndn_ix  = ML_(fndn_ix)(di, i);
+         b->offs     = p - cz;
+         cur.end     = b->addr;
+         cur.lineno  = b->lineno;
+         cur.fndn_ix = b->fndn_ix;
+      }
+      p += put_loc(p, &cur, &di->loctab[i], ML_(fndn_ix)(di, i));
+   }
+   vg_assert(p == cz + szB);
+   di->loccz      = cz;
+   di->loccz_szB  = szB;
+   di->loccz_blk  = blk;
+   di->loccz_nblk = nblk;
+
+   ML_(dinfo_free)(di->loctab);
+   if (di->loctab_fndn_ix)
+      ML_(dinfo_free)(di->loctab_fndn_ix);
+   di->loctab         = NULL;
+   di->loctab_fndn_ix = NULL;
+   di->loctab_size    = 0;
+
+   loccz_n_tables++;
+   loccz_n_entries += n;
+   loccz_raw_szB   += raw_szB;
+   loccz_cz_szB    += szB + nblk * sizeof(DiLocBlk);
+}
+
+void ML_(loctab_print_stats) ( void )
+{
+   VG_(message)(Vg_DebugMsg,
+                " loctab: %'llu tables, %'llu entries, "
+                "%'llu bytes compacted to %'llu\n",
+                loccz_n_tables, loccz_n_entries,
+                loccz_raw_szB, loccz_cz_szB);
+}
+
+void ML_(get_loc) ( const DebugInfo* di, Word locno, /*OUT*/DiLoc* loc )
+{
+   UInt fndn_ix;
+
+   if (di->loccz_blk != NULL) {
+      get_compressed_loc(di, locno, loc, &fndn_ix);
+      return;
+   }
+   vg_assert(locno >= 0 && locno < di->loctab_used);
+   *loc = di->loctab[locno];
+}
+
 UInt ML_(fndn_ix) (const DebugInfo* di, Word locno)
 {
    UInt fndn_ix;
 
+   if (di->loccz_blk != NULL) {
+      DiLoc loc;
+      get_compressed_loc(di, locno, &loc, &fndn_ix);
+      return fndn_ix;
+   }
+
    switch(di->sizeof_fndn_ix) {
       case 1: fndn_ix = ((UChar*)  di->loctab_fndn_ix)[locno]; break;
       case 2: fndn_ix = ((UShort*) di->loctab_fndn_ix)[locno]; break;
@@ -2106,6 +2325,99 @@ static void canonicaliseInltab ( struct _DebugInfo* di )
 
    /* Free up unused space at the end of the table. */
    shrinkInlTab(di);
+
+   ML_(build_inltab_index)(di);
+}
+
+/* Sort order for building the nested containment list: by addr_lo,
+   and among ranges starting at the same address, the biggest first,
+   so that any range comes after all the ranges containing it. */
+static const DiInlLoc* sorting_inltab = NULL;
+static Int compare_DiInlLoc_via_ix ( const void* va, const void* vb )
+{
+   UInt ia = *(const UInt*)va;
+   UInt ib = *(const UInt*)vb;
+   const DiInlLoc* a = &sorting_inltab[ia];
+   const DiInlLoc* b = &sorting_inltab[ib];
+   if (a->addr_lo < b->addr_lo) return -1;
+   if (a->addr_lo > b->addr_lo) return  1;
+   if (a->addr_hi > b->addr_hi) return -1;
+   if (a->addr_hi < b->addr_hi) return  1;
+   if (ia < ib) return -1;
+   if (ia > ib) return  1;
+   return 0;
+}
+
+void ML_(build_inltab_index) ( struct _DebugInfo* di )
+{
+   const UInt NONE = 0xFFFFFFFF;
+   UWord  n = di->inltab_used, i, sp, off, ntop;
+   UInt   *perm, *parent, *nchild, *sub, *fill;
+
+   if (di->inlnc) {
+      ML_(dinfo_free)(di->inlnc);
+      di->inlnc = NULL;
+   }
+   di->inlnc_ntop = 0;
+   if (n == 0)
+      return;
+   vg_assert(n < NONE);
+
+   /* perm[i] is the inltab position of the i'th range in sort order.
+      All the other temporary arrays are indexed by sort order. */
+   perm   = ML_(dinfo_zalloc)("di.storage.bII.1", n * sizeof(UInt));
+   parent = ML_(dinfo_zalloc)("di.storage.bII.2", n * sizeof(UInt));
+   nchild = ML_(dinfo_zalloc)("di.storage.bII.3", n * sizeof(UInt));
+   sub    = ML_(dinfo_zalloc)("di.storage.bII.4", n * sizeof(UInt));
+   fill   = ML_(dinfo_zalloc)("di.storage.bII.5", n * sizeof(UInt));
+   for (i = 0; i < n; i++)
+      perm[i] = i;
+   sorting_inltab = di->inltab;
+   VG_(ssort)(perm, n, sizeof(*perm), compare_DiInlLoc_via_ix);
+   sorting_inltab = NULL;
+
+   /* Give each range as parent the innermost preceding range that
+      contains it.  'sub' is used as the stack of currently open
+      ranges, each containing the next. */
+   sp = 0;
+   ntop = 0;
+   for (i = 0; i < n; i++) {
+      Addr hi = di->inltab[perm[i]].addr_hi;
+      while (sp > 0 && di->inltab[perm[sub[sp-1]]].addr_hi < hi)
+         sp--;
+      parent[i] = sp > 0 ? sub[sp-1] : NONE;
+      if (parent[i] == NONE)
+         ntop++;
+      else
+         nchild[parent[i]]++;
+      sub[sp++] = i;
+   }
+
+   /* Lay out the lists: the top-level one first, then each sublist,
+      in sort order of the range owning it. */
+   off = ntop;
+   for (i = 0; i < n; i++) {
+      sub[i] = off;
+      off += nchild[i];
+   }
+   vg_assert(off == n);
+
+   di->inlnc = ML_(dinfo_zalloc)("di.storage.bII.6", n * sizeof(DiInlNode));
+   di->inlnc_ntop = ntop;
+   ntop = 0;
+   for (i = 0; i < n; i++) {
+      UWord slot = parent[i] == NONE ? ntop++
+                                     : sub[parent[i]] + fill[parent[i]]++;
+      di->inlnc[slot].ix   = perm[i];
+      di->inlnc[slot].sub  = sub[i];
+      di->inlnc[slot].nsub = nchild[i];
+   }
+
+   ML_(dinfo_free)(perm);
+   ML_(dinfo_free)(parent);
+   ML_(dinfo_free)(nchild);
+   ML_(dinfo_free)(sub);
+   ML_(dinfo_free)(fill);
 }
 
 
@@ -2345,6 +2657,21 @@ void ML_(canonicaliseTables) ( struct _DebugInfo* di )
    if (di->cfsi_m_pool)
       VG_(freezeDedupPA) (di->cfsi_m_pool, ML_(dinfo_shrink_block));
    canonicaliseVarInfo ( di );
+   /* If more is to be read later, the pools must stay open. */
+   if (di->lazy)
+      return;
+   if (di->strpool)
+      VG_(freezeDedupPA) (di->strpool, ML_(dinfo_shrink_block));
+   if (di->fndnpool)
+      VG_(freezeDedupPA) (di->fndnpool, ML_(dinfo_shrink_block));
+}
+
+void ML_(canonicaliseLazyTables) ( struct _DebugInfo* di )
+{
+   vg_assert(di->lazy == NULL);
+   canonicaliseLoctab ( di );
+   canonicaliseInltab ( di );
+   canonicaliseVarInfo ( di );
    if (di->strpool)
       VG_(freezeDedupPA) (di->strpool, ML_(dinfo_shrink_block));
    if (di->fndnpool)
@@ -2394,6 +2721,31 @@ Word ML_(search_one_loctab) ( const DebugInfo* di, Addr ptr )
    Word mid, 
         lo = 0, 
         hi = di->loctab_used-1;
+
+   if (di->loccz_blk != NULL) {
+      /* Find the last block starting at or below ptr, then scan it. */
+      LocCursor cur;
+      DiLoc     loc;
+      UInt      fndn_ix;
+      Word      j, n;
+      lo = 0;
+      hi = di->loccz_nblk - 1;
+      while (lo <= hi) {
+         mid = (lo + hi) / 2;
+         if (ptr < di->loccz_blk[mid].addr) hi = mid-1; else lo = mid+1;
+      }
+      if (hi < 0) return -1; /* below the first entry */
+      start_loc_block(di, hi, &cur);
+      n = di->loctab_used - hi * LOC_BLOCK_N;
+      if (n > LOC_BLOCK_N) n = LOC_BLOCK_N;
+      for (j = 0; j < n; j++) {
+         next_loc(&cur, &loc, &fndn_ix);
+         if (ptr < loc.addr) return -1;
+         if (ptr < loc.addr + loc.size) return hi * LOC_BLOCK_N + j;
+      }
+      return -1;
+   }
+
    while (True) {
       /* current unsearched space is from lo to hi, inclusive. */
       if (lo > hi) return -1; /* not found */
@@ -2409,6 +2761,71 @@ Word ML_(search_one_loctab) ( const DebugInfo* di, Addr ptr )
 }
 
 
+/* Results of ML_(search_inltab). */
+static UInt* inl_hits      = NULL;
+static UWord inl_hits_used = 0;
+static UWord inl_hits_size = 0;
+
+static void add_inl_hit ( UInt ix )
+{
+   if (inl_hits_used == inl_hits_size) {
+      UWord new_sz = inl_hits_size == 0 ? 16 : 2 * inl_hits_size;
+      UInt* new_tab = ML_(dinfo_zalloc)("di.storage.aIH.1",
+                                        new_sz * sizeof(UInt));
+      if (inl_hits != NULL) {
+         VG_(memcpy)(new_tab, inl_hits, inl_hits_used * sizeof(UInt));
+         ML_(dinfo_free)(inl_hits);
+      }
+      inl_hits = new_tab;
+      inl_hits_size = new_sz;
+   }
+   inl_hits[inl_hits_used++] = ix;
+}
+
+/* Add to inl_hits the ranges in the list di->inlnc[lo .. lo+n-1], or
+   in their sublists, which contain ptr. */
+static void search_inlnc ( const DebugInfo* di, UWord lo, UWord n, Addr ptr )
+{
+   /* Both addr_lo and addr_hi increase along the list, so the ranges
+      containing ptr are those just before the first one starting
+      above it, back to the first one ending at or before it. */
+   Word mid, l = lo, h = lo + n - 1;
+   while (l <= h) {
+      mid = (l + h) / 2;
+      if (ptr < di->inltab[di->inlnc[mid].ix].addr_lo) h = mid-1;
+      else                                              l = mid+1;
+   }
+   for (; h >= (Word)lo; h--) {
+      const DiInlNode* nd = &di->inlnc[h];
+      if (di->inltab[nd->ix].addr_hi <= ptr)
+         break;
+      add_inl_hit(nd->ix);
+      if (nd->nsub > 0)
+         search_inlnc(di, nd->sub, nd->nsub, ptr);
+   }
+}
+
+UWord ML_(search_inltab) ( const DebugInfo* di, Addr ptr,
+                           /*OUT*/const UInt** res )
+{
+   UWord i, j;
+
+   inl_hits_used = 0;
+   if (di->inlnc_ntop > 0)
+      search_inlnc(di, 0, di->inlnc_ntop, ptr);
+
+   /* Usually only a handful, so insertion sort. */
+   for (i = 1; i < inl_hits_used; i++) {
+      UInt ix = inl_hits[i];
+      for (j = i; j > 0 && inl_hits[j-1] > ix; j--)
+         inl_hits[j] = inl_hits[j-1];
+      inl_hits[j] = ix;
+   }
+   *res = inl_hits;
+   return inl_hits_used;
+}
+
+
 /* Find a CFI-table index containing the specified pointer, or -1
    if not found.  Binary search.  */
 
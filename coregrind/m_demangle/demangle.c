@@ -34,6 +34,7 @@
 
 #include "pub_core_basics.h"
 #include "pub_core_demangle.h"
+#include "pub_core_deduppoolalloc.h"
 #include "pub_core_libcassert.h"
 #include "pub_core_libcbase.h"
 #include "pub_core_libcprint.h"
@@ -111,20 +112,15 @@ static void rust_demangle_sym ( HChar* );
    To update to a newer libiberty, use the "update-demangler" script
    which is included in the valgrind repository. */
 
-/* This is the main, standard demangler entry point. */
-
-/* Upon return, *RESULT will point to the demangled name.
-   The memory buffer that holds the demangled name is allocated on the
-   heap and will be deallocated in the next invocation. Conceptually,
-   that buffer is owned by VG_(demangle). That means two things:
-   (1) Users of VG_(demangle) must not free that buffer.
-   (2) If the demangled name needs to be stashed away for later use,
-       the contents of the buffer need to be copied. It is not sufficient
-       to just store the pointer as it will point to deallocated memory
-       after the next VG_(demangle) invocation. */
-void VG_(demangle) ( Bool do_cxx_demangling, Bool do_z_demangling,
-                     /* IN */  const HChar  *orig,
-                     /* OUT */ const HChar **result )
+/* This does the actual work for VG_(demangle), below, which caches
+   its results.  *RESULT is either ORIG, a static buffer in
+   VG_(maybe_Z_demangle), or a buffer in VG_AR_DEMANGLE which is freed
+   on the next call; either way, it must be copied before the next
+   call. */
+static
+void demangle_uncached ( Bool do_cxx_demangling, Bool do_z_demangling,
+                         /* IN */  const HChar  *orig,
+                         /* OUT */ const HChar **result )
 {
    /* Possibly undo (2) */
    /* Z-Demangling was requested.  
@@ -184,6 +180,181 @@ void VG_(demangle) ( Bool do_cxx_demangling, Bool do_z_demangling,
 }
 
 
+/*------------------------------------------------------------*/
+/*--- CACHE OF DEMANGLED NAMES                             ---*/
+/*------------------------------------------------------------*/
+
+/* Running the libiberty demangler is expensive, and the same few
+   names get demangled over and over: every stack trace printed or
+   compared for error dedup goes through get_sym_name in
+   m_debuginfo, which demangles each frame's symbol afresh.  So
+   results are memoised here, keyed on the mangled name and on which
+   stages were requested.  Both the mangled and the demangled names
+   are interned in a DedupPoolAlloc, so a name reached through
+   several DebugInfos (or several stages, when demangling is a no-op)
+   is stored only once.
+
+   The key is the name's contents rather than its address, since the
+   symbol tables which hold the mangled names come and go as objects
+   are mapped and unmapped.  VG_(clo_demangle) is fixed once the
+   command line has been processed, so it is not part of the key.
+
+   The cache is bounded: once it holds DM_CACHE_MAX_ENTRIES names, or
+   adding a name would take the total length of the names in it past
+   DM_CACHE_MAX_SZB, it is flushed in its entirety.  That is fine given
+   VG_(demangle)'s contract, which only promises that a result lives
+   until the next call.  The length bound matters because some
+   demangled C++ names run to many kilobytes.  A name which on its own
+   is longer than that is not cached. */
+
+#define DM_CACHE_N_BUCKETS   4093  /* prime */
+#define DM_CACHE_MAX_ENTRIES 65536
+#define DM_CACHE_MAX_SZB     (4 * 1024 * 1024)
+
+typedef
+   struct _DM_CacheEnt {
+      struct _DM_CacheEnt* next;
+      UInt         hash;
+      UInt         stages;  /* 1 = C++, 2 = Z */
+      const HChar* orig;    /* interned in dm_cache_strpool */
+      const HChar* result;  /* ditto */
+   }
+   DM_CacheEnt;
+
+static DM_CacheEnt*    dm_cache[DM_CACHE_N_BUCKETS];
+static DedupPoolAlloc* dm_cache_strpool = NULL;
+static UInt            dm_cache_used = 0;
+static SizeT           dm_cache_szB  = 0;  /* of orig and result names */
+
+/* Stats, for --stats */
+static ULong n_dm_cache_hits    = 0;
+static ULong n_dm_cache_misses  = 0;
+static ULong n_dm_cache_flushes = 0;
+
+static void* dm_cache_alloc ( const HChar* cc, SizeT szB )
+{
+   return VG_(arena_malloc)(VG_AR_DEMANGLE, cc, szB);
+}
+
+static void dm_cache_free ( void* p )
+{
+   VG_(arena_free)(VG_AR_DEMANGLE, p);
+}
+
+static void dm_cache__flush ( void )
+{
+   UInt i;
+   for (i = 0; i < DM_CACHE_N_BUCKETS; i++) {
+      DM_CacheEnt* ent = dm_cache[i];
+      while (ent) {
+         DM_CacheEnt* next = ent->next;
+         dm_cache_free(ent);
+         ent = next;
+      }
+      dm_cache[i] = NULL;
+   }
+   if (dm_cache_strpool) {
+      VG_(deleteDedupPA)(dm_cache_strpool);
+      dm_cache_strpool = NULL;
+   }
+   dm_cache_used = 0;
+   dm_cache_szB  = 0;
+}
+
+static const HChar* dm_cache__intern ( const HChar* str )
+{
+   if (dm_cache_strpool == NULL)
+      dm_cache_strpool = VG_(newDedupPA)(64 * 1024, 1, dm_cache_alloc,
+                                         "demangle.cache.1",
+                                         dm_cache_free);
+   return VG_(allocEltDedupPA)(dm_cache_strpool,
+                               VG_(strlen)(str) + 1, str);
+}
+
+/* Upon return, *RESULT will point to the demangled name.
+   The memory buffer that holds the demangled name is owned by
+   VG_(demangle) and is guaranteed to stay valid only until the next
+   invocation.  That means two things:
+   (1) Users of VG_(demangle) must not free that buffer.
+   (2) If the demangled name needs to be stashed away for later use,
+       the contents of the buffer need to be copied. It is not sufficient
+       to just store the pointer as it will point to deallocated memory
+       after the cache is next flushed. */
+void VG_(demangle) ( Bool do_cxx_demangling, Bool do_z_demangling,
+                     /* IN */  const HChar  *orig,
+                     /* OUT */ const HChar **result )
+{
+   const HChar* p;
+   const HChar* demangled;
+   DM_CacheEnt* ent;
+   UInt         hash, stages, b;
+   SizeT        szB;
+
+   /* Most names need no demangling at all: only Z-encoded names (which
+      all start with "_vg") and C++/Rust/D names (which start with "_Z")
+      are changed by demangle_uncached.  Don't clutter the cache with
+      the rest. */
+   if (orig == NULL || orig[0] != '_'
+       || !( (do_z_demangling && orig[1] == 'v' && orig[2] == 'g')
+             || (do_cxx_demangling && VG_(clo_demangle)
+                 && orig[1] == 'Z') )) {
+      *result = orig;
+      return;
+   }
+
+   stages = (do_cxx_demangling ? 1 : 0) | (do_z_demangling ? 2 : 0);
+   hash = stages;
+   for (p = orig; *p; p++)
+      hash = hash * 31 + (UChar)*p;
+   b = hash % DM_CACHE_N_BUCKETS;
+
+   for (ent = dm_cache[b]; ent; ent = ent->next) {
+      if (ent->hash == hash && ent->stages == stages
+          && VG_(strcmp)(ent->orig, orig) == 0) {
+         n_dm_cache_hits++;
+         *result = ent->result;
+         return;
+      }
+   }
+
+   n_dm_cache_misses++;
+   demangle_uncached(do_cxx_demangling, do_z_demangling, orig, &demangled);
+
+   szB = VG_(strlen)(orig) + 1 + VG_(strlen)(demangled) + 1;
+   if (szB > DM_CACHE_MAX_SZB) {
+      *result = demangled;
+      return;
+   }
+   if (dm_cache_used >= DM_CACHE_MAX_ENTRIES
+       || dm_cache_szB + szB > DM_CACHE_MAX_SZB) {
+      n_dm_cache_flushes++;
+      dm_cache__flush();
+   }
+
+   ent = dm_cache_alloc("demangle.cache.2", sizeof(DM_CacheEnt));
+   ent->hash   = hash;
+   ent->stages = stages;
+   ent->orig   = dm_cache__intern(orig);
+   ent->result = dm_cache__intern(demangled);
+   ent->next   = dm_cache[b];
+   dm_cache[b] = ent;
+   dm_cache_used++;
+   dm_cache_szB += szB;
+
+   *result = ent->result;
+}
+
+void VG_(demangle_print_stats) ( void )
+{
+   VG_(message)(Vg_DebugMsg,
+                " demangle: cache %'llu hits, %'llu misses, "
+                "%'llu flushes, %u names (%'lu bytes, %u unique strings)\n",
+                n_dm_cache_hits, n_dm_cache_misses, n_dm_cache_flushes,
+                dm_cache_used, dm_cache_szB,
+                dm_cache_strpool ? VG_(sizeDedupPA)(dm_cache_strpool) : 0);
+}
+
+
 /*------------------------------------------------------------*/
 /*--- DEMANGLE Z-ENCODED NAMES                             ---*/
 /*------------------------------------------------------------*/
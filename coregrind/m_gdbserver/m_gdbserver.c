@@ -1563,3 +1563,8 @@ void VG_(gdbserver_status_output)(void)
        VG_(dyn_vgdb_error),
        hostvisibility ? "yes" : "no");
 }
+
+Bool VG_(gdbserver_was_called)(void)
+{
+   return gdbserver_called > 0;
+}
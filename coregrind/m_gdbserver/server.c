@@ -31,6 +31,10 @@
 #include "pub_core_syswrap.h"      // VG_(show_open_fds)
 #include "pub_core_scheduler.h"
 #include "pub_core_transtab.h"
+#include "pub_core_tccache.h"
+#include "pub_core_transahead.h"
+#include "pub_core_sbprofile.h"
+#include "pub_core_smcprotect.h"
 #include "pub_core_debuginfo.h"
 #include "pub_core_addrinfo.h"
 #include "pub_core_aspacemgr.h"
@@ -169,6 +173,26 @@ void VG_(print_all_stats) (Bool memory_stats, Bool tool_stats)
 
    VG_(print_translation_stats)();
    VG_(print_tt_tc_stats)();
+   VG_(print_tccache_stats)();
+   VG_(print_debuginfo_stats)();
+   VG_(print_transahead_stats)();
+   VG_(print_hot_blocks_stats)();
+   VG_(print_smcprotect_stats)();
+   if (VG_(clo_shadow_thp)) {
+      AmShadowThpStats st;
+      VG_(am_get_shadow_thp_stats)(&st);
+      VG_(message)(Vg_DebugMsg,
+                   " shadow-thp: %'llu allocs, %'llu bytes, in %'llu regions"
+                   " of %'llu bytes (%'llu not advised)\n",
+                   st.n_allocs, st.alloc_bytes, st.n_regions,
+                   st.region_bytes, st.n_madv_fails);
+      VG_(message)(Vg_DebugMsg,
+                   " shadow-thp: %'llu bytes resident, %'llu in huge pages"
+                   " (%llu%%)\n",
+                   st.rss_bytes, st.thp_bytes,
+                   st.rss_bytes == 0 ? 0ULL
+                                     : st.thp_bytes * 100 / st.rss_bytes);
+   }
    VG_(print_scheduler_stats)();
    VG_(print_ExeContext_stats)( False /* with_stacktraces */ );
    VG_(print_errormgr_stats)();
@@ -898,7 +898,7 @@ Int VG_(fork) ( void )
    Timing stuff
    ------------------------------------------------------------------ */
 
-UInt VG_(read_millisecond_timer) ( void )
+ULong VG_(read_microsecond_timer) ( void )
 {
    /* 'now' and 'base' are in microseconds */
    static ULong base = 0;
@@ -941,7 +941,12 @@ UInt VG_(read_millisecond_timer) ( void )
    if (base == 0)
       base = now;
 
-   return (now - base) / 1000;
+   return now - base;
+}
+
+UInt VG_(read_millisecond_timer) ( void )
+{
+   return VG_(read_microsecond_timer)() / 1000;
 }
 
 Int VG_(gettimeofday)(struct vki_timeval *tv, struct vki_timezone *tz)
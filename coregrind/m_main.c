@@ -65,6 +65,8 @@
 #include "pub_core_translate.h"     // For VG_(translate)
 #include "pub_core_trampoline.h"
 #include "pub_core_transtab.h"
+#include "pub_core_tccache.h"
+#include "pub_core_transahead.h"
 #include "pub_core_inner.h"
 #if defined(ENABLE_INNER_CLIENT_REQUEST)
 #include "pub_core_clreq.h"
@@ -166,10 +168,12 @@ static void usage_NORETURN ( Bool debug_help )
 "    --allow-mismatched-debuginfo=no|yes  [no]\n"
 "                              for the above two flags only, accept debuginfo\n"
 "                              objects that don't \"match\" the main object\n"
-"    --smc-check=none|stack|all|all-non-file [all-non-file]\n"
+"    --smc-check=none|stack|all|all-non-file|protect [all-non-file]\n"
 "                              checks for self-modifying code: none, only for\n"
 "                              code found in stacks, for all code, or for all\n"
-"                              code except that from file-backed mappings\n"
+"                              code except that from file-backed mappings;\n"
+"                              protect is all-non-file using write-protection\n"
+"                              rather than checks where it can\n"
 "    --read-inline-info=yes|no read debug info about inlined function calls\n"
 "                              and use it to do better stack traces.  [yes]\n"
 "                              on Linux/Android/Solaris for Memcheck/Helgrind/DRD\n"
@@ -178,6 +182,12 @@ static void usage_NORETURN ( Bool debug_help )
 "                              and use it to print better error messages in\n"
 "                              tools that make use of it (Memcheck, Helgrind,\n"
 "                              DRD) [no]\n"
+"    --debuginfo-jobs=<number> read the line and inlined call info of big\n"
+"                              objects in <number> helper processes [1]\n"
+"    --lazy-debuginfo=no|yes   read line, inlined call and variable info\n"
+"                              only when it is first needed? [no]\n"
+"    --debuginfo-cache-dir=<dir>  save the debug info tables of objects\n"
+"                              in <dir>, and load them from there later\n"
 "    --vgdb-poll=<number>      gdbserver poll max every <number> basic blocks [%d] \n"
 "    --vgdb-shadow-registers=no|yes   let gdb see the shadow registers [no]\n"
 "    --vgdb-prefix=<prefix>    prefix for vgdb FIFOs [%s]\n"
@@ -189,6 +199,12 @@ static void usage_NORETURN ( Bool debug_help )
 "           lax-ioctls lax-doors fuse-compatible enable-outer\n"
 "           no-inner-prefix no-nptl-pthread-stackcache none\n"
 "    --fair-sched=no|yes|try   schedule threads fairly on multicore systems [no]\n"
+"    --parallel-threads=no|yes let threads run in parallel, if the tool\n"
+"                              supports it [no]\n"
+"    --adaptive-sched=no|yes   vary thread timeslices with lock contention\n"
+"                              and syscall frequency [no]\n"
+"    --sched-spin=no|yes       spin before sleeping when waiting for the\n"
+"                              fair-sched lock [no]\n"
 "    --kernel-variant=variant1,variant2,...\n"
 "         handle non-standard kernel variants [none]\n"
 "         where variant is one of:\n"
@@ -200,7 +216,20 @@ static void usage_NORETURN ( Bool debug_help )
 "           more sectors may increase performance, but use more memory.\n"
 "    --avg-transtab-entry-size=<number> avg size in bytes of a translated\n"
 "           basic block [0, meaning use tool provided default]\n"
+"    --transtab-keep-hot=no|yes keep recently used translations when the\n"
+"           translation cache is full? [no]\n"
+"    --tc-cache-dir=<dir>      save translations in <dir> at exit and reuse\n"
+"           them in later runs, if the tool supports it [none]\n"
+"    --tier2-threshold=<number> translate blocks cheaply at first, and\n"
+"           retranslate them with full superblock chasing once they have\n"
+"           been run <number> times [0, meaning disabled]\n"
+"    --translate-ahead=no|yes  translate code likely to be run next while\n"
+"           the program is blocked in system calls? [no]\n"
+"    --hot-blocks-file=<file>  save the blocks run in <file> at exit, and\n"
+"           translate them in advance in later runs [none]\n"
 "    --aspace-minaddr=0xPP     avoid mapping memory below 0xPP [guessed]\n"
+"    --shadow-thp=no|yes       back the tool's shadow memory with\n"
+"                              transparent huge pages? [no]\n"
 "    --valgrind-stacksize=<number> size of valgrind (host) thread's stack\n"
 "                               (in bytes) ["
                                 VG_STRINGIFY(VG_DEFAULT_STACK_ACTIVE_SZB) 
@@ -243,6 +272,8 @@ static void usage_NORETURN ( Bool debug_help )
 "    --trace-symtab=no|yes     show symbol table details? [no]\n"
 "    --trace-symtab-patt=<patt> limit debuginfo tracing to obj name <patt>\n"
 "    --trace-cfi=no|yes        show call-frame-info details? [no]\n"
+"    --debuginfo-jobs-min-size=<number>  use --debuginfo-jobs helpers only\n"
+"                              for objects with this much DWARF [4194304]\n"
 "    --debug-dump=syms         mimic /usr/bin/readelf --syms\n"
 "    --debug-dump=line         mimic /usr/bin/readelf --debug-dump=line\n"
 "    --debug-dump=frames       mimic /usr/bin/readelf --debug-dump=frames\n"
@@ -642,6 +673,10 @@ void main_process_cmd_line_options( void )
             VG_(fmsg_bad_option)(arg,
                "Bad argument, should be 'yes', 'try' or 'no'\n");
       }
+      else if VG_BOOL_CLO(arg, "--parallel-threads",
+                               VG_(clo_parallel_threads)) {}
+      else if VG_BOOL_CLO(arg, "--adaptive-sched", VG_(clo_adaptive_sched)) {}
+      else if VG_BOOL_CLO(arg, "--sched-spin",     VG_(clo_sched_spin)) {}
       else if VG_BOOL_CLO(arg, "--trace-sched",      VG_(clo_trace_sched)) {}
       else if VG_BOOL_CLO(arg, "--trace-signals",    VG_(clo_trace_signals)) {}
       else if VG_BOOL_CLO(arg, "--trace-symtab",     VG_(clo_trace_symtab)) {}
@@ -660,6 +695,13 @@ void main_process_cmd_line_options( void )
       else if VG_BOOL_CLO(arg, "--sym-offsets",      VG_(clo_sym_offsets)) {}
       else if VG_BOOL_CLO(arg, "--read-inline-info", VG_(clo_read_inline_info)) {}
       else if VG_BOOL_CLO(arg, "--read-var-info",    VG_(clo_read_var_info)) {}
+      else if VG_BINT_CLO(arg, "--debuginfo-jobs",   VG_(clo_debuginfo_jobs),
+                          1, 16) {}
+      else if VG_BINT_CLO(arg, "--debuginfo-jobs-min-size",
+                          VG_(clo_debuginfo_jobs_min_szB), 0, 0x7FFFFFFF) {}
+      else if VG_BOOL_CLO(arg, "--lazy-debuginfo",   VG_(clo_lazy_debuginfo)) {}
+      else if VG_STR_CLO (arg, "--debuginfo-cache-dir",
+                          VG_(clo_debuginfo_cache_dir)) {}
 
       else if VG_INT_CLO (arg, "--dump-error",       VG_(clo_dump_error))   {}
       else if VG_INT_CLO (arg, "--input-fd",         VG_(clo_input_fd))     {}
@@ -672,6 +714,13 @@ void main_process_cmd_line_options( void )
       else if VG_BINT_CLO(arg, "--avg-transtab-entry-size",
                                VG_(clo_avg_transtab_entry_size),
                                50, 5000) {}
+      else if VG_BOOL_CLO(arg, "--transtab-keep-hot",
+                               VG_(clo_transtab_keep_hot)) {}
+      else if VG_BINT_CLO(arg, "--tier2-threshold",
+                               VG_(clo_tier2_threshold),
+                               0, 1000000000) {}
+      else if VG_BOOL_CLO(arg, "--translate-ahead",
+                               VG_(clo_translate_ahead)) {}
       else if VG_BINT_CLO(arg, "--merge-recursive-frames",
                                VG_(clo_merge_recursive_frames), 0,
                                VG_DEEPEST_BACKTRACE) {}
@@ -684,6 +733,8 @@ void main_process_cmd_line_options( void )
                           VG_(clo_smc_check), Vg_SmcAll) {}
       else if VG_XACT_CLO(arg, "--smc-check=all-non-file",
                           VG_(clo_smc_check), Vg_SmcAllNonFile) {}
+      else if VG_XACT_CLO(arg, "--smc-check=protect",
+                          VG_(clo_smc_check), Vg_SmcProtect) {}
 
       else if VG_USETX_CLO (arg, "--kernel-variant",
                             "bproc,"
@@ -782,6 +833,10 @@ void main_process_cmd_line_options( void )
 
       else if VG_STR_CLO (arg, "--extra-debuginfo-path",
                       VG_(clo_extra_debuginfo_path)) {}
+      else if VG_STR_CLO (arg, "--tc-cache-dir", VG_(clo_tc_cache_dir)) {}
+      else if VG_STR_CLO (arg, "--hot-blocks-file",
+                      VG_(clo_hot_blocks_file)) {}
+      else if VG_BOOL_CLO(arg, "--shadow-thp", VG_(clo_shadow_thp)) {}
 
       else if VG_STR_CLO(arg, "--require-text-symbol", tmp_str) {
          /* String needs to be of the form C?*C?*, where C is any
@@ -1651,6 +1706,33 @@ Int valgrind_main ( Int argc, HChar **argv, HChar **envp )
    VG_(debugLog)(1, "main", "Initialise TT/TC\n");
    VG_(init_tt_tc)();
 
+   //--------------------------------------------------------------
+   // Initialise the persistent translation cache
+   //   p: init_tt_tc
+   //   p: tl_post_clo_init [tools may declare the need there]
+   //--------------------------------------------------------------
+   VG_(tccache_init)();
+
+   //--------------------------------------------------------------
+   // Start the translate-ahead helper thread
+   //   p: init_tt_tc
+   //   p: tl_post_clo_init [tools may declare the need there]
+   //--------------------------------------------------------------
+   VG_(transahead_init)();
+
+   //--------------------------------------------------------------
+   // Read the hot blocks saved by an earlier run
+   //   p: tl_post_clo_init [tools may declare the need there]
+   //   p: before the initial debuginfo is read
+   //--------------------------------------------------------------
+   VG_(hot_blocks_init)();
+
+   //--------------------------------------------------------------
+   // Decide whether threads may run in parallel
+   //   p: tl_post_clo_init [tools may declare the need there]
+   //--------------------------------------------------------------
+   VG_(parallel_threads_init)();
+
    //--------------------------------------------------------------
    // Initialise the redirect table.
    //   p: init_tt_tc [so it can call VG_(search_transtab) safely]
@@ -1961,6 +2043,12 @@ Int valgrind_main ( Int argc, HChar **argv, HChar **envp )
      vg_assert(VG_(running_tid) == VG_INVALID_THREADID);
    }
 
+   //--------------------------------------------------------------
+   // Replay the --hot-blocks-file blocks of the initial objects
+   //   p: Finalise initial image [for tid_main's stack pointer]
+   //--------------------------------------------------------------
+   VG_(hot_blocks_start_replay)( tid_main );
+
    //--------------------------------------------------------------
    // Initialise the signal handling subsystem
    //   p: n/a
@@ -2140,6 +2228,13 @@ void shutdown_actions_NORETURN( ThreadId tid,
 
    VG_(sanity_check_general)( True /*include expensive checks*/ );
 
+   /* Save translations for use by later runs, if so requested. */
+   VG_(tccache_save)();
+
+   /* Likewise the list of blocks run.  This must come before the
+      end-of-run SB profile, which zeroes the counters. */
+   VG_(hot_blocks_save)();
+
    if (VG_(clo_stats))
       VG_(print_all_stats)(VG_(clo_verbosity) >= 1, /* Memory stats */
                            False /* tool prints stats in the tool fini */);
@@ -72,6 +72,12 @@ static void cc_analyse_alloc_arena ( ArenaId aid ); /* fwds */
 
 typedef UChar UByte;
 
+// Small blocks in the non-client arenas are handled by a slab-style
+// front end; see "Small-block front end" below.  Payload sizes up to
+// SLAB_MAX_PSZB each have their own size class.
+#define SLAB_MAX_PSZB         256
+#define SLAB_N_CLASSES        (SLAB_MAX_PSZB / VG_MIN_MALLOC_SZB + 1)
+
 /* Layout of an in-use block:
 
       cost center (OPTIONAL)   (VG_MIN_MALLOC_SZB bytes, only when h-p enabled)
@@ -187,6 +193,24 @@ typedef
    }
    Superblock;
 
+// A size class of the small-block front end.  'cached' is a LIFO list
+// of freed blocks of the class, linked through the first word of their
+// payloads.  'run' is the unused end of the block most recently carved
+// up into blocks of the class, or NULL.
+typedef
+   struct {
+      UByte*       cached;
+      UInt         n_cached;
+      Block*       run;
+      // Stats only
+      ULong        stats__nallocs;
+      ULong        stats__nreused;
+      ULong        stats__nruns;
+      ULong        stats__noverflows;  // frees not cached as over the limit
+      ULong        stats__nreleased;   // cached blocks given back
+   }
+   SlabClass;
+
 // An arena. 'freelist' is a circular, doubly-linked list.  'rz_szB' is
 // elastic, in that it can be bigger than asked-for to ensure alignment.
 typedef
@@ -225,6 +249,15 @@ typedef
       Addr         perm_malloc_current; // first byte free in perm_malloc sb.
       Addr         perm_malloc_limit; // maximum usable byte in perm_malloc sb.
 
+      // Small-block front end, used for non-client arenas only.  Index
+      // 0 is unused.
+      Bool         slab_on;
+      SlabClass    slab[SLAB_N_CLASSES];
+      // Payload bytes in blocks which are in use as far as the
+      // superblocks are concerned, but are in fact cached or unused
+      // parts of runs.
+      SizeT        stats__slab_idle_bytes;
+
       // Stats only
       SizeT        stats__perm_bytes_on_loan;
       SizeT        stats__perm_blocks;
@@ -251,6 +284,7 @@ typedef
 /*------------------------------------------------------------*/
 
 #define SIZE_T_0x1      ((SizeT)0x1)
+#define SIZE_T_0x2      ((SizeT)0x2)
 
 static const char* probably_your_fault =
    "This is probably caused by your program erroneously writing past the\n"
@@ -259,23 +293,32 @@ static const char* probably_your_fault =
    "probably go away.  Please try that before reporting this as a bug.\n";
 
 // Mark a bszB as in-use, and not in-use, and remove the in-use attribute.
+// An in-use block can also be marked as cached by the small-block front
+// end (see slab_free); bszB is always a multiple of VG_MIN_MALLOC_SZB,
+// so bit 1 is free for that.
 static __inline__
 SizeT mk_inuse_bszB ( SizeT bszB )
 {
    vg_assert2(bszB != 0, probably_your_fault);
-   return bszB & (~SIZE_T_0x1);
+   return bszB & (~(SIZE_T_0x1 | SIZE_T_0x2));
 }
 static __inline__
 SizeT mk_free_bszB ( SizeT bszB )
 {
    vg_assert2(bszB != 0, probably_your_fault);
-   return bszB | SIZE_T_0x1;
+   return (bszB & ~SIZE_T_0x2) | SIZE_T_0x1;
+}
+static __inline__
+SizeT mk_cached_bszB ( SizeT bszB )
+{
+   vg_assert2(bszB != 0, probably_your_fault);
+   return (bszB & ~SIZE_T_0x1) | SIZE_T_0x2;
 }
 static __inline__
 SizeT mk_plain_bszB ( SizeT bszB )
 {
    vg_assert2(bszB != 0, probably_your_fault);
-   return bszB & (~SIZE_T_0x1);
+   return bszB & (~(SIZE_T_0x1 | SIZE_T_0x2));
 }
 
 // Forward definition.
@@ -331,6 +374,15 @@ Bool is_inuse_block ( Block* b )
    return (0 != (bszB & SIZE_T_0x1)) ? False : True;
 }
 
+// Is this (in-use) block on a cache of the small-block front end?
+static __inline__
+Bool is_cached_block ( Block* b )
+{
+   SizeT bszB = get_bszB_as_is(b);
+   vg_assert2(bszB != 0, probably_your_fault);
+   return 0 != (bszB & SIZE_T_0x2);
+}
+
 //---------------------------------------------------------------------------
 
 // Return the lower, upper and total overhead in bytes for a block.
@@ -602,6 +654,9 @@ void arena_init ( ArenaId aid, const HChar* name, SizeT rz_szB,
    a->deferred_reclaimed_sb    = 0;
    a->perm_malloc_current      = 0;
    a->perm_malloc_limit        = 0;
+   a->slab_on                  = !a->clientmem;
+   VG_(memset)(a->slab, 0, sizeof(a->slab));
+   a->stats__slab_idle_bytes   = 0;
    a->stats__perm_bytes_on_loan= 0;
    a->stats__perm_blocks       = 0;
    a->stats__nreclaim_unsplit  = 0;
@@ -621,7 +676,7 @@ void arena_init ( ArenaId aid, const HChar* name, SizeT rz_szB,
 /* Print vital stats for an arena. */
 void VG_(print_all_arena_stats) ( void )
 {
-   UInt i;
+   UInt i, c;
    for (i = 0; i < VG_N_ARENAS; i++) {
       Arena* a = arenaId_to_ArenaP(i);
       VG_(message)(Vg_DebugMsg,
@@ -639,6 +694,19 @@ void VG_(print_all_arena_stats) ( void )
                    a->stats__nsearches,
                    a->rz_szB
       );
+      for (c = 1; c < SLAB_N_CLASSES; c++) {
+         const SlabClass* sc = &a->slab[c];
+         if (sc->stats__nallocs == 0)
+            continue;
+         VG_(message)(Vg_DebugMsg,
+                      "%-8s: slab %3lu B: %'12llu allocs, %'12llu reused, "
+                      "%'7llu runs, %'7u cached, %'9llu overflows, "
+                      "%'9llu released\n",
+                      a->name, (SizeT)c * VG_MIN_MALLOC_SZB,
+                      sc->stats__nallocs, sc->stats__nreused,
+                      sc->stats__nruns, sc->n_cached,
+                      sc->stats__noverflows, sc->stats__nreleased);
+      }
    }
 }
 
@@ -1347,7 +1415,7 @@ static void sanity_check_malloc_arena ( ArenaId aid )
          }
          if (thisFree) blockctr_sb_free++;
          if (!thisFree)
-            arena_bytes_on_loan += bszB_to_pszB(a, b_bszB);
+            arena_bytes_on_loan += bszB_to_pszB(a, mk_plain_bszB(b_bszB));
          lastWasFree = thisFree;
       }
       if (i > sb->n_payload_bytes) {
@@ -1359,6 +1427,9 @@ static void sanity_check_malloc_arena ( ArenaId aid )
 
    arena_bytes_on_loan += a->stats__perm_bytes_on_loan;
 
+   // Blocks held by the small-block front end look in use.
+   arena_bytes_on_loan -= a->stats__slab_idle_bytes;
+
    if (arena_bytes_on_loan != a->stats__bytes_on_loan) {
 #     ifdef VERBOSE_MALLOC
       VG_(printf)( "sanity_check_malloc_arena: a->bytes_on_loan %lu, "
@@ -1400,6 +1471,28 @@ static void sanity_check_malloc_arena ( ArenaId aid )
       }
    }
 
+   // Check the small-block front end's caches.
+   for (i = 1; i < SLAB_N_CLASSES; i++) {
+      UByte* v;
+      UInt   n = 0;
+      for (v = a->slab[i].cached; v != NULL; v = *(UByte**)v) {
+         b = get_payload_block(a, v);
+         if (!is_inuse_block(b) || !is_cached_block(b)
+             || get_pszB(a, b) != i * VG_MIN_MALLOC_SZB) {
+            VG_(printf)( "sanity_check_malloc_arena: slab class %u at %p: "
+                         "BAD CACHED BLOCK\n", i, b );
+            BOMB;
+         }
+         n++;
+      }
+      if (n != a->slab[i].n_cached) {
+         VG_(printf)( "sanity_check_malloc_arena: slab class %u: "
+                      "CACHED COUNT MISMATCH (%u, %u)\n",
+                      i, n, a->slab[i].n_cached );
+         BOMB;
+      }
+   }
+
    if (blockctr_sb_free != blockctr_li) {
 #     ifdef VERBOSE_MALLOC
       VG_(printf)( "sanity_check_malloc_arena: BLOCK COUNT MISMATCH "
@@ -1500,7 +1593,7 @@ static void cc_analyse_alloc_arena ( ArenaId aid )
          if (0)
          VG_(printf)("block: inUse=%d pszB=%d cc=%s\n", 
                      (Int)(!thisFree), 
-                     (Int)bszB_to_pszB(a, b_bszB),
+                     (Int)bszB_to_pszB(a, mk_plain_bszB(b_bszB)),
                      get_cc(b));
          vg_assert(cc);
          for (k = 0; k < n_ccs; k++) {
@@ -1519,7 +1612,7 @@ static void cc_analyse_alloc_arena ( ArenaId aid )
          }
 
          vg_assert(k >= 0 && k < n_ccs && k < N_AN_CCS);
-         anCCs[k].nBytes += (ULong)bszB_to_pszB(a, b_bszB);
+         anCCs[k].nBytes += (ULong)bszB_to_pszB(a, mk_plain_bszB(b_bszB));
          anCCs[k].nBlocks++;
       }
       if (i > sb->n_payload_bytes) {
@@ -1727,10 +1820,251 @@ void add_one_block_to_stats (Arena* a, SizeT loaned)
    a->stats__tot_bytes  += (ULong)loaned;
 }
 
+
+/*------------------------------------------------------------*/
+/*--- Small-block front end.                               ---*/
+/*------------------------------------------------------------*/
+
+/* The tools, and the core, make huge numbers of small allocations of
+   a few fixed sizes: WordFM nodes, hash table entries and the like.
+   Allocating each from the freelists above costs a search, a split,
+   and on free a merge with the neighbours, only for the same sized
+   block to be split off again a moment later.  So, in the non-client
+   arenas, small blocks are handled separately.
+
+   Each payload size up to SLAB_MAX_PSZB (as rounded up to
+   VG_MIN_MALLOC_SZB) is a size class.  A freed block of a class size
+   is not put on a freelist, but stays in use as far as the rest of
+   this file is concerned, and goes on a per-class cache instead.
+   Allocations of that class are taken from the cache first.  When it
+   is empty, they are carved off the front of a 'run': a block of
+   around SLAB_RUN_SZB obtained in the ordinary way, whose unused rest
+   is kept as a single in-use block.  So the superblocks still consist
+   of nothing but ordinary blocks, and can be walked and checked as
+   before.
+
+   So that a burst of small allocations doesn't tie up memory for
+   good, each cache holds at most SLAB_MAX_CACHED_SZB bytes; further
+   frees take the ordinary path, and any free blocks too small for a
+   run are used before a new run is started.  Even so, cached blocks
+   and runs scattered over superblocks which are otherwise free stop
+   those from being merged into bigger free blocks or unmapped.  So
+   when an allocation finds no free block big enough, all the caches
+   and runs of the arena are given back in the ordinary way (see
+   slab_release), and the search is made again before a new superblock
+   is allocated.  Payload bytes in cached blocks and unused parts of
+   runs are counted in stats__slab_idle_bytes, not in
+   stats__bytes_on_loan. */
+
+#define SLAB_RUN_SZB          4096
+#define SLAB_MIN_RUN_BLOCKS   8
+#define SLAB_MAX_CACHED_SZB   (1024 * 1024)
+
+static void* arena_malloc_general ( ArenaId aid, const HChar* cc,
+                                    SizeT req_pszB ); /* fwds */
+static void arena_free_general ( ArenaId aid, Arena* a, Block* b );
+
+// The class of a (rounded up) payload size, or 0 if it doesn't have one.
+static __inline__
+UInt slab_class ( SizeT pszB )
+{
+   return pszB <= SLAB_MAX_PSZB ? pszB / VG_MIN_MALLOC_SZB : 0;
+}
+
+static
+void* slab_malloc ( ArenaId aid, Arena* a, const HChar* cc, UInt c )
+{
+   SlabClass* sc   = &a->slab[c];
+   SizeT      pszB = (SizeT)c * VG_MIN_MALLOC_SZB;
+   SizeT      bszB = pszB_to_bszB(a, pszB);
+   SizeT      run_bszB, n;
+   UInt       lno;
+   Block*     b;
+   UByte*     v;
+
+   sc->stats__nallocs++;
+
+   if (LIKELY(sc->cached != NULL)) {
+      v = sc->cached;
+      sc->cached = *(UByte**)v;
+      sc->n_cached--;
+      sc->stats__nreused++;
+      b = get_payload_block(a, v);
+      INNER_REQUEST(mkBhdrAccess(a,b));
+      vg_assert(is_cached_block(b));
+      set_bszB(b, mk_inuse_bszB(get_bszB(b)));
+      INNER_REQUEST(mkBhdrNoAccess(a,b));
+      a->stats__slab_idle_bytes -= get_pszB(a, b);
+   } else {
+      if (sc->run == NULL) {
+         n = SLAB_RUN_SZB / bszB;
+         if (n < SLAB_MIN_RUN_BLOCKS)
+            n = SLAB_MIN_RUN_BLOCKS;
+         run_bszB = n * bszB;
+
+         // Blocks freed when the cache was full, and the like, are on
+         // the freelists.  Use any too small for a run before starting
+         // one, else they'd never be used.
+         for (lno = pszB_to_listNo(pszB);
+              lno < pszB_to_listNo(bszB_to_pszB(a, run_bszB)); lno++) {
+            if (a->freelist[lno] != NULL)
+               return arena_malloc_general(aid, cc, pszB);
+         }
+
+         v = arena_malloc_general(aid, "admin.slab-run",
+                                  bszB_to_pszB(a, run_bszB));
+         INNER_REQUEST(VALGRIND_FREELIKE_BLOCK(v, a->rz_szB));
+         sc->run = get_payload_block(a, v);
+         // Not on loan until carved up.
+         n = get_pszB(a, sc->run);
+         a->stats__bytes_on_loan    -= n;
+         a->stats__tot_blocks       -= 1;
+         a->stats__tot_bytes        -= n;
+         a->stats__slab_idle_bytes  += n;
+         sc->stats__nruns++;
+      }
+
+      // Carve b off the front of the run, unless what would be left
+      // couldn't be a block; then b is the whole of it.
+      b        = sc->run;
+      run_bszB = get_bszB(b);
+      a->stats__slab_idle_bytes -= bszB_to_pszB(a, run_bszB);
+      if (run_bszB - bszB >= min_useful_bszB(a)) {
+         mkInuseBlock(a, b, bszB);
+         sc->run = b + bszB;
+         mkInuseBlock(a, sc->run, run_bszB - bszB);
+         if (VG_(clo_profile_heap))
+            set_cc(sc->run, "admin.slab-run");
+         a->stats__slab_idle_bytes += bszB_to_pszB(a, run_bszB - bszB);
+      } else {
+         sc->run = NULL;
+      }
+      v = get_block_payload(a, b);
+   }
+
+   if (VG_(clo_profile_heap))
+      set_cc(b, cc);
+   add_one_block_to_stats(a, get_pszB(a, b));
+
+   INNER_REQUEST(VALGRIND_MALLOCLIKE_BLOCK(v, get_pszB(a, b),
+                                           a->rz_szB, False));
+   return v;
+}
+
+// Put b, which is being freed, on the cache of its class.  Returns
+// False if it should be freed in the ordinary way instead.
+static
+Bool slab_free ( Arena* a, Block* b, SizeT b_pszB )
+{
+   UInt       c = slab_class(b_pszB);
+   SlabClass* sc;
+   UByte*     v;
+
+   if (c == 0 || c * VG_MIN_MALLOC_SZB != b_pszB)
+      return False;
+   sc = &a->slab[c];
+   if ((sc->n_cached + 1) * b_pszB > SLAB_MAX_CACHED_SZB) {
+      sc->stats__noverflows++;
+      return False;
+   }
+
+   v = get_block_payload(a, b);
+   a->stats__bytes_on_loan   -= b_pszB;
+   a->stats__slab_idle_bytes += b_pszB;
+
+   // See VG_(arena_free) for the choice of junk.
+   VG_(memset)(v, 0xDD, b_pszB);
+   *(UByte**)v = sc->cached;
+   sc->cached  = v;
+   sc->n_cached++;
+   // Mark it, so that freeing it again is caught by VG_(arena_free).
+   INNER_REQUEST(mkBhdrAccess(a,b));
+   set_bszB(b, mk_cached_bszB(get_bszB(b)));
+   INNER_REQUEST(mkBhdrNoAccess(a,b));
+   if (VG_(clo_profile_heap))
+      set_cc(b, "admin.slab-cached");
+
+   INNER_REQUEST(VALGRIND_FREELIKE_BLOCK(v, a->rz_szB));
+   INNER_REQUEST(VALGRIND_MAKE_MEM_DEFINED(v, sizeof(UByte*)));
+   return True;
+}
+
+// Free b, a cached block or the rest of a run, in the ordinary way.
+static
+void slab_release_block ( ArenaId aid, Arena* a, Block* b )
+{
+   SizeT pszB;
+
+   INNER_REQUEST(mkBhdrAccess(a,b));
+   set_bszB(b, mk_inuse_bszB(get_bszB(b)));
+   INNER_REQUEST(mkBhdrNoAccess(a,b));
+   pszB = get_pszB(a, b);
+   // arena_free_general takes it off the bytes on loan again.
+   a->stats__slab_idle_bytes -= pszB;
+   a->stats__bytes_on_loan   += pszB;
+   INNER_REQUEST(VALGRIND_MALLOCLIKE_BLOCK(get_block_payload(a, b), pszB,
+                                           a->rz_szB, False));
+   arena_free_general(aid, a, b);
+}
+
+// Give all the cached blocks and runs of a back in the ordinary way.
+// Returns False if there were none.
+static
+Bool slab_release ( ArenaId aid, Arena* a )
+{
+   UInt   c;
+   Bool   any = False;
+   UByte* v;
+
+   for (c = 1; c < SLAB_N_CLASSES; c++) {
+      SlabClass* sc = &a->slab[c];
+      while (sc->cached != NULL) {
+         v = sc->cached;
+         sc->cached = *(UByte**)v;
+         sc->n_cached--;
+         sc->stats__nreleased++;
+         vg_assert(is_cached_block(get_payload_block(a, v)));
+         slab_release_block(aid, a, get_payload_block(a, v));
+         any = True;
+      }
+      vg_assert(sc->n_cached == 0);
+      if (sc->run != NULL) {
+         Block* run = sc->run;
+         sc->run = NULL;
+         slab_release_block(aid, a, run);
+         any = True;
+      }
+   }
+   return any;
+}
+
 /* Allocate a piece of memory of req_pszB bytes on the given arena.
    The function may return NULL if (and only if) aid == VG_AR_CLIENT.
    Otherwise, the function returns a non-NULL value. */
 void* VG_(arena_malloc) ( ArenaId aid, const HChar* cc, SizeT req_pszB )
+{
+   Arena* a;
+   UInt   c;
+
+   ensure_mm_init(aid);
+   a = arenaId_to_ArenaP(aid);
+
+   vg_assert(req_pszB < MAX_PSZB);
+   // You must provide a cost-center name against which to charge
+   // this allocation; it isn't optional.
+   vg_assert(cc);
+
+   if (a->slab_on) {
+      c = slab_class(align_req_pszB(req_pszB));
+      if (c > 0 || req_pszB == 0)
+         return slab_malloc(aid, a, cc, c > 0 ? c : 1);
+   }
+   return arena_malloc_general(aid, cc, req_pszB);
+}
+
+// Allocate from the freelists, bypassing the small-block front end.
+static
+void* arena_malloc_general ( ArenaId aid, const HChar* cc, SizeT req_pszB )
 {
    SizeT       req_bszB, frag_bszB, b_bszB;
    UInt        lno, i;
@@ -1770,6 +2104,7 @@ void* VG_(arena_malloc) ( ArenaId aid, const HChar* cc, SizeT req_pszB )
    // back.  This would require care to avoid pathological worst-case
    // behaviour.
    //
+  search:
    for (lno = pszB_to_listNo(req_pszB); lno < N_MALLOC_LISTS; lno++) {
       UWord nsearches_this_level = 0;
       b = a->freelist[lno];
@@ -1797,8 +2132,13 @@ void* VG_(arena_malloc) ( ArenaId aid, const HChar* cc, SizeT req_pszB )
       }
    }
 
-   // If we reach here, no suitable block found, allocate a new superblock
+   // If we reach here, no suitable block found.  Blocks idle in the
+   // small-block front end may be keeping free ones apart; if there
+   // are any, give them back and try again.  Otherwise allocate a new
+   // superblock.
    vg_assert(lno == N_MALLOC_LISTS);
+   if (a->slab_on && slab_release(aid, a))
+      goto search;
    new_sb = newSuperblock(a, req_bszB);
    if (NULL == new_sb) {
       // Should only fail if for client, otherwise, should have aborted
@@ -2080,10 +2420,8 @@ static void mergeWithFreeNeighbours (Arena* a, Superblock* sb,
  
 void VG_(arena_free) ( ArenaId aid, void* ptr )
 {
-   Superblock* sb;
    Block*      b;
    SizeT       b_bszB, b_pszB;
-   UInt        b_listno;
    Arena*      a;
 
    ensure_mm_init(aid);
@@ -2097,8 +2435,34 @@ void VG_(arena_free) ( ArenaId aid, void* ptr )
 
    /* If this is one of V's areas, check carefully the block we're
       getting back.  This picks up simple block-end overruns. */
-   if (aid != VG_AR_CLIENT)
+   if (aid != VG_AR_CLIENT) {
       vg_assert(is_inuse_block(b) && blockSane(a, b));
+      vg_assert2(!is_cached_block(b),
+                 "VG_(arena_free): block %p in arena %s freed twice\n",
+                 ptr, a->name);
+   }
+
+   b_bszB   = get_bszB(b);
+   b_pszB   = bszB_to_pszB(a, b_bszB);
+
+   if (a->slab_on && slab_free(a, b, b_pszB)) {
+#     ifdef DEBUG_MALLOC
+      sanity_check_malloc_arena(aid);
+#     endif
+      return;
+   }
+
+   arena_free_general(aid, a, b);
+}
+
+// Free b in the ordinary way, bypassing the small-block front end.
+static
+void arena_free_general ( ArenaId aid, Arena* a, Block* b )
+{
+   Superblock* sb;
+   SizeT       b_bszB, b_pszB;
+   UInt        b_listno;
+   void*       ptr = get_block_payload(a, b);
 
    b_bszB   = get_bszB(b);
    b_pszB   = bszB_to_pszB(a, b_bszB);
@@ -2248,11 +2612,13 @@ void* VG_(arena_memalign) ( ArenaId aid, const HChar* cc,
    {
       /* As we will split the block given back by VG_(arena_malloc),
          we have to (temporarily) disable unsplittable for this arena,
-         as unsplittable superblocks cannot be splitted. */
+         as unsplittable superblocks cannot be splitted.  Nor can the
+         block come from the small-block front end, as the fragment
+         might then end up next to a free block. */
       const SizeT save_min_unsplittable_sblock_szB 
          = a->min_unsplittable_sblock_szB;
       a->min_unsplittable_sblock_szB = MAX_PSZB;
-      base_p = VG_(arena_malloc) ( aid, cc, base_pszB_req );
+      base_p = arena_malloc_general ( aid, cc, base_pszB_req );
       a->min_unsplittable_sblock_szB = save_min_unsplittable_sblock_szB;
    }
    a->stats__bytes_on_loan = saved_bytes_on_loan;
@@ -88,6 +88,11 @@ Bool   VG_(clo_default_supp)   = True;
 XArray *VG_(clo_suppressions);   // array of strings
 XArray *VG_(clo_fullpath_after); // array of strings
 const HChar* VG_(clo_extra_debuginfo_path) = NULL;
+const HChar* VG_(clo_tc_cache_dir) = NULL;
+UInt   VG_(clo_tier2_threshold) = 0;
+Bool   VG_(clo_translate_ahead) = False;
+const HChar* VG_(clo_hot_blocks_file) = NULL;
+Bool   VG_(clo_shadow_thp)     = False;
 const HChar* VG_(clo_debuginfo_server) = NULL;
 Bool   VG_(clo_allow_mismatched_debuginfo) = False;
 UChar  VG_(clo_trace_flags)    = 0; // 00000000b
@@ -107,6 +112,9 @@ Bool   VG_(clo_debug_dump_frames) = False;
 Bool   VG_(clo_trace_redir)    = False;
 enum FairSchedType
        VG_(clo_fair_sched)     = disable_fair_sched;
+Bool   VG_(clo_parallel_threads) = False;
+Bool   VG_(clo_adaptive_sched) = False;
+Bool   VG_(clo_sched_spin)     = False;
 Bool   VG_(clo_trace_sched)    = False;
 Bool   VG_(clo_profile_heap)   = False;
 Int    VG_(clo_core_redzone_size) = CORE_REDZONE_DEFAULT_SZB;
@@ -124,6 +132,10 @@ UInt   VG_(clo_sim_hints)      = 0;
 Bool   VG_(clo_sym_offsets)    = False;
 Bool   VG_(clo_read_inline_info) = False; // Or should be put it to True by default ???
 Bool   VG_(clo_read_var_info)  = False;
+Int    VG_(clo_debuginfo_jobs) = 1;
+Int    VG_(clo_debuginfo_jobs_min_szB) = 4 * 1024 * 1024;
+Bool   VG_(clo_lazy_debuginfo) = False;
+const HChar* VG_(clo_debuginfo_cache_dir) = NULL;
 XArray *VG_(clo_req_tsyms);  // array of strings
 Bool   VG_(clo_run_libc_freeres) = True;
 Bool   VG_(clo_run_cxx_freeres) = True;
@@ -788,6 +788,192 @@ void VG_(redir_add_ifunc_target)( Addr old_from, Addr new_from )
     }
 }
 
+/* Index over the marked specs of one generate_and_add_actives call,
+   so that each symbol name is only compared against the specs that
+   could possibly match it, rather than against all of them.  Specs
+   whose fnpatt contains no wildcards can only match that exact name
+   and go in a hash table.  The others go in a trie keyed on the
+   literal prefix of the pattern (the part before the first '*' or
+   '?'); walking a name down the trie visits exactly the patterns
+   whose prefix it starts with, and those are then checked with
+   VG_(string_match).  Each entry carries the position of its spec in
+   the list, so that candidates can be processed in list order, as
+   the conflict resolution in maybe_add_active depends on it. */
+
+typedef
+   struct _SpecIdxEnt {
+      struct _SpecIdxEnt* next; /* hash chain, or trie node list */
+      Spec*  sp;
+      UInt   ord;               /* position of sp in the spec list */
+      Bool   isExact;           /* sp->from_fnpatt has no wildcards */
+   }
+   SpecIdxEnt;
+
+typedef
+   struct _SpecTrie {
+      struct _SpecTrie* kids;    /* first child */
+      struct _SpecTrie* sibling; /* next child of our parent */
+      SpecIdxEnt*       specs;   /* patterns whose prefix ends here */
+      HChar             ch;      /* edge label from the parent */
+   }
+   SpecTrie;
+
+typedef
+   struct {
+      SpecIdxEnt** exact;      /* hash table of exact names */
+      UInt         exact_mask; /* number of buckets - 1 */
+      SpecIdxEnt*  ents;       /* all entries, one per marked spec */
+      SpecTrie*    nodes;      /* trie nodes; nodes[0] is the root */
+      UInt         n_nodes;
+      SpecIdxEnt** cands;      /* scratch: candidates for one name */
+      UInt         n_exact;
+      UInt         n_wild;
+   }
+   SpecIndex;
+
+static UInt spec_name_hash ( const HChar* s )
+{
+   UInt h = 2166136261u;
+   for (; *s; s++)
+      h = (h ^ (UChar)*s) * 16777619u;
+   return h;
+}
+
+/* Length of the literal prefix of PATT, i.e. up to the first
+   wildcard, or the whole string if there is none. */
+static SizeT spec_prefix_len ( const HChar* patt )
+{
+   SizeT n = 0;
+   while (patt[n] != 0 && patt[n] != '*' && patt[n] != '?')
+      n++;
+   return n;
+}
+
+static void build_spec_index ( /*OUT*/SpecIndex* ix, Spec* specs )
+{
+   Spec* sp;
+   UInt  n_marked = 0, n_exact = 0, n_chars = 0, ord, nb, i;
+
+   for (sp = specs; sp; sp = sp->next) {
+      if (!sp->mark)
+         continue;
+      n_marked++;
+      SizeT plen = spec_prefix_len(sp->from_fnpatt);
+      if (sp->from_fnpatt[plen] == 0)
+         n_exact++;
+      else
+         n_chars += plen;
+   }
+   vg_assert(n_marked > 0);
+
+   nb = 1;
+   while (nb < 2 * n_exact)
+      nb *= 2;
+
+   VG_(memset)(ix, 0, sizeof(*ix));
+   ix->exact      = dinfo_zalloc("redir.bsi.1", nb * sizeof(SpecIdxEnt*));
+   ix->exact_mask = nb - 1;
+   ix->ents       = dinfo_zalloc("redir.bsi.2",
+                                 n_marked * sizeof(SpecIdxEnt));
+   ix->nodes      = dinfo_zalloc("redir.bsi.3",
+                                 (n_chars + 1) * sizeof(SpecTrie));
+   ix->n_nodes    = 1;
+   ix->cands      = dinfo_zalloc("redir.bsi.4",
+                                 n_marked * sizeof(SpecIdxEnt*));
+
+   i = 0;
+   for (sp = specs, ord = 0; sp; sp = sp->next, ord++) {
+      if (!sp->mark)
+         continue;
+      SpecIdxEnt* ent = &ix->ents[i++];
+      SizeT plen = spec_prefix_len(sp->from_fnpatt);
+      ent->sp      = sp;
+      ent->ord     = ord;
+      ent->isExact = sp->from_fnpatt[plen] == 0;
+      if (ent->isExact) {
+         UInt b = spec_name_hash(sp->from_fnpatt) & ix->exact_mask;
+         ent->next = ix->exact[b];
+         ix->exact[b] = ent;
+         ix->n_exact++;
+      } else {
+         SpecTrie* node = &ix->nodes[0];
+         SizeT     j;
+         for (j = 0; j < plen; j++) {
+            SpecTrie* kid;
+            for (kid = node->kids; kid; kid = kid->sibling)
+               if (kid->ch == sp->from_fnpatt[j])
+                  break;
+            if (!kid) {
+               vg_assert(ix->n_nodes < n_chars + 1);
+               kid = &ix->nodes[ix->n_nodes++];
+               kid->ch      = sp->from_fnpatt[j];
+               kid->sibling = node->kids;
+               node->kids   = kid;
+            }
+            node = kid;
+         }
+         ent->next = node->specs;
+         node->specs = ent;
+         ix->n_wild++;
+      }
+   }
+   vg_assert(i == n_marked);
+}
+
+static void free_spec_index ( SpecIndex* ix )
+{
+   dinfo_free(ix->exact);
+   dinfo_free(ix->ents);
+   dinfo_free(ix->nodes);
+   dinfo_free(ix->cands);
+}
+
+/* Put in ix->cands, sorted by list position, the specs which might
+   match NAME, and return how many there are.  Exact specs are known
+   to match; wildcard ones still need checking.  *n_wild is
+   incremented by the number of wildcard candidates. */
+static UInt lookup_spec_index ( SpecIndex* ix, const HChar* name,
+                                /*MOD*/ULong* n_wild )
+{
+   SpecIdxEnt* ent;
+   UInt        n = 0, i, j;
+
+   if (ix->n_exact > 0) {
+      UInt b = spec_name_hash(name) & ix->exact_mask;
+      for (ent = ix->exact[b]; ent; ent = ent->next)
+         if (0 == VG_(strcmp)(ent->sp->from_fnpatt, name))
+            ix->cands[n++] = ent;
+   }
+
+   if (ix->n_wild > 0) {
+      const SpecTrie* node = &ix->nodes[0];
+      const HChar*    p    = name;
+      while (True) {
+         for (ent = node->specs; ent; ent = ent->next) {
+            ix->cands[n++] = ent;
+            (*n_wild)++;
+         }
+         if (*p == 0)
+            break;
+         for (node = node->kids; node; node = node->sibling)
+            if (node->ch == *p)
+               break;
+         if (!node)
+            break;
+         p++;
+      }
+   }
+
+   /* Nearly always zero or one candidates, so insertion sort. */
+   for (i = 1; i < n; i++) {
+      ent = ix->cands[i];
+      for (j = i; j > 0 && ix->cands[j-1]->ord > ent->ord; j--)
+         ix->cands[j] = ix->cands[j-1];
+      ix->cands[j] = ent;
+   }
+   return n;
+}
+
 /* Do one element of the basic cross product: add to the active set,
    all matches resulting from comparing all the given specs against
    all the symbols in the given seginfo.  If a conflicting binding
@@ -810,6 +996,10 @@ void generate_and_add_actives (
    SymAVMAs  sym_avmas;
    const HChar*  sym_name_pri;
    const HChar** sym_names_sec;
+   SpecIndex  ix;
+   UInt       n_cands, c;
+   ULong      n_names = 0, n_exact_hits = 0, n_wild_cands = 0,
+              n_wild_hits = 0;
 
    /* First figure out which of the specs match the seginfo's soname.
       Also clear the 'done' bits, so that after the main loop below
@@ -837,6 +1027,8 @@ void generate_and_add_actives (
    if (!anyMark)
       return;
 
+   build_spec_index(&ix, specs);
+
    /* Iterate outermost over the symbols in the seginfo, in the hope
       of trashing the caches less. */
    nsyms = VG_(DebugInfo_syms_howmany)( di );
@@ -854,11 +1046,19 @@ void generate_and_add_actives (
          if (!isText)
             continue;
 
-         for (sp = specs; sp; sp = sp->next) {
-            if (!sp->mark)
-               continue; /* soname doesn't match */
-            if (VG_(string_match)( sp->from_fnpatt, *names )
-		&& (sp->isGlobal == False || isGlobal == True)) {
+         n_names++;
+         n_cands = lookup_spec_index(&ix, *names, &n_wild_cands);
+         for (c = 0; c < n_cands; c++) {
+            sp = ix.cands[c]->sp;
+            vg_assert(sp->mark);
+            if (ix.cands[c]->isExact) {
+               n_exact_hits++;
+            } else {
+               if (!VG_(string_match)( sp->from_fnpatt, *names ))
+                  continue;
+               n_wild_hits++;
+            }
+            if (sp->isGlobal == False || isGlobal == True) {
                /* got a new binding.  Add to collection. */
                act.from_addr   = sym_avmas.main;
                act.to_addr     = sp->to_addr;
@@ -883,12 +1083,22 @@ void generate_and_add_actives (
                }
 
             }
-         } /* for (sp = specs; sp; sp = sp->next) */
+         } /* for (c = 0; c < n_cands; c++) */
 
       } /* iterating over names[] */
       free_symname_array(names_init, &twoslots[0]);
    } /* for (i = 0; i < nsyms; i++)  */
 
+   if (VG_(clo_trace_redir))
+      VG_(message)(Vg_DebugMsg,
+                   "   redir index for soname %s: %u exact + %u wildcard specs,"
+                   " %llu names, %llu exact hits,"
+                   " %llu wildcard candidates (%llu matched)\n",
+                   VG_(DebugInfo_get_soname)(di), ix.n_exact, ix.n_wild,
+                   n_names, n_exact_hits, n_wild_cands, n_wild_hits);
+
+   free_spec_index(&ix);
+
    /* Now, finally, look for Specs which were marked to be done, but
       didn't get matched.  If any such are mandatory we must abort the
       system at this point. */
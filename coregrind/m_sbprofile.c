@@ -30,13 +30,19 @@
 /* Contributed by Julian Seward <jseward@acm.org> */
 
 #include "pub_core_basics.h"
+#include "pub_core_vki.h"
 #include "pub_core_transtab.h"
 #include "pub_core_libcbase.h"
+#include "pub_core_libcfile.h"
 #include "pub_core_libcprint.h"
 #include "pub_core_libcassert.h"
 #include "pub_core_debuginfo.h"
+#include "pub_core_mallocfree.h"
+#include "pub_core_threadstate.h"  // VG_(running_tid)
+#include "pub_core_tooliface.h"
 #include "pub_core_translate.h"
 #include "pub_core_options.h"
+#include "pub_core_xarray.h"
 #include "pub_core_sbprofile.h"    // self
 
 /*====================================================================*/
@@ -213,6 +219,325 @@ void VG_(get_and_show_SB_profile) ( ULong ecs_done )
 }
 
 
+/*====================================================================*/
+/*=== Saving and replaying hot blocks                              ===*/
+/*====================================================================*/
+
+/* With --hot-blocks-file=<file>, every translation counts its
+   entries, as with SB profiling.  At exit the blocks which were run
+   (at most HOT_BLOCKS_MAX, hottest first) are written to <file> as
+   offsets in the ELF objects they came from.  In the next run with
+   the same option, each block in the file is translated as soon as
+   the debuginfo for its object has been read, so that most of the
+   code the program needs is already in the TC when it gets there.
+
+   Unlike --tc-cache-dir, no host code is stored, so the file is
+   small, doesn't depend on the Valgrind build or options, and still
+   works when an object is loaded at a different address.  The cost
+   is that every block still has to be translated once per run, but
+   that happens in a burst, before it is needed.  Offsets are
+   relative to the object's link-time addresses (ie. entry minus text
+   bias).  Objects are identified by file name, and also by build-id
+   when they have one.  An out of date offset does no harm: at worst
+   it yields a translation which is never used.
+
+   Like translate-ahead, replay is only done for tools which declare
+   VG_(needs_persistent_translations), since their instrumentation
+   has no side effects.
+
+   The file is plain text:
+
+      # Valgrind hot blocks 1
+      obj <build-id or -> <file name>
+      <offset, in hex>
+      ...
+*/
+
+#define HOT_BLOCKS_MAX     50000
+#define HOT_BLOCKS_HEADER  "# Valgrind hot blocks 1\n"
+
+typedef
+   struct {
+      HChar*  filename;
+      HChar*  buildid;   /* NULL if it has none */
+      XArray* offsets;   /* of Addr, hottest first */
+   }
+   HotObj;
+
+/* The blocks read from the file at startup; NULL if none. */
+static XArray* hot_objs = NULL;   /* of HotObj */
+
+/* Stats */
+static ULong n_hot_replayed   = 0;
+static ULong n_hot_translated = 0;
+static ULong n_hot_present    = 0;
+static ULong n_hot_saved      = 0;
+
+/* The thread whose stack pointer the translator is given while
+   replaying at startup.  Until it has one, i.e. until the scheduler
+   and the initial image are set up, replay is deferred: see
+   VG_(hot_blocks_start_replay). */
+static ThreadId replay_tid = VG_INVALID_THREADID;
+
+/* Parse the zero-terminated file contents in buf into hot_objs,
+   overwriting buf in the process.  Returns False if it is
+   malformed. */
+static Bool parse_hot_blocks ( HChar* buf )
+{
+   HChar*  line = buf;
+   HotObj* obj  = NULL;
+
+   if (VG_(strncmp)(buf, HOT_BLOCKS_HEADER,
+                    VG_(strlen)(HOT_BLOCKS_HEADER)) != 0)
+      return False;
+
+   while (*line) {
+      HChar* eol = VG_(strchr)(line, '\n');
+      if (eol == NULL)
+         return False;
+      *eol = 0;
+
+      if (line[0] == '#') {
+         /* comment */
+      } else if (VG_(strncmp)(line, "obj ", 4) == 0) {
+         HChar* id   = line + 4;
+         HChar* name = VG_(strchr)(id, ' ');
+         if (name == NULL)
+            return False;
+         *name++ = 0;
+         HotObj ho;
+         ho.filename = VG_(strdup)("sbprofile.phb.1", name);
+         ho.buildid  = VG_(strcmp)(id, "-") == 0
+                          ? NULL : VG_(strdup)("sbprofile.phb.2", id);
+         ho.offsets  = VG_(newXA)(VG_(malloc), "sbprofile.phb.3",
+                                  VG_(free), sizeof(Addr));
+         VG_(addToXA)(hot_objs, &ho);
+         obj = VG_(indexXA)(hot_objs, VG_(sizeXA)(hot_objs) - 1);
+      } else {
+         HChar* end;
+         Addr   off = (Addr)VG_(strtoull16)(line, &end);
+         if (obj == NULL || end == line || *end != 0)
+            return False;
+         VG_(addToXA)(obj->offsets, &off);
+      }
+      line = eol + 1;
+   }
+   return True;
+}
+
+void VG_(hot_blocks_init) ( void )
+{
+   Int    fd;
+   Long   size;
+   HChar* buf;
+
+   if (VG_(clo_hot_blocks_file) == NULL)
+      return;
+
+   if (!VG_(needs).persistent_translations) {
+      VG_(message)(Vg_UserMsg,
+                   "Warning: --hot-blocks-file: hot blocks are not"
+                   " replayed with this tool (or with these tool options)"
+                   "\n");
+      return;
+   }
+
+   SysRes sres = VG_(open)(VG_(clo_hot_blocks_file), VKI_O_RDONLY, 0);
+   if (sr_isError(sres))
+      return;   /* not an error: the first run creates it */
+   fd = sr_Res(sres);
+
+   size = VG_(fsize)(fd);
+   if (size < 0 || size > 0x7FFFFFFFLL) {
+      VG_(close)(fd);
+      return;
+   }
+   buf = VG_(malloc)("sbprofile.hbi.1", size + 1);
+   if (VG_(read)(fd, buf, (Int)size) == (Int)size) {
+      buf[size] = 0;
+      hot_objs = VG_(newXA)(VG_(malloc), "sbprofile.hbi.2",
+                            VG_(free), sizeof(HotObj));
+      if (!parse_hot_blocks(buf)) {
+         VG_(message)(Vg_UserMsg,
+                      "Warning: --hot-blocks-file=%s is malformed;"
+                      " not replayed\n", VG_(clo_hot_blocks_file));
+         VG_(dropTailXA)(hot_objs, VG_(sizeXA)(hot_objs));
+      }
+   }
+   VG_(free)(buf);
+   VG_(close)(fd);
+
+   if (hot_objs != NULL && VG_(clo_verbosity) > 1)
+      VG_(message)(Vg_DebugMsg,
+                   "hot-blocks: read %ld objects from %s\n",
+                   VG_(sizeXA)(hot_objs), VG_(clo_hot_blocks_file));
+}
+
+void VG_(hot_blocks_load_for_DebugInfo) ( const DebugInfo* di )
+{
+   Word i, j, n;
+
+   if (hot_objs == NULL)
+      return;
+
+   const HChar* filename  = VG_(DebugInfo_get_filename)(di);
+   const HChar* buildid   = VG_(DebugInfo_get_buildid)(di);
+   Addr         text_avma = VG_(DebugInfo_get_text_avma)(di);
+   SizeT        text_size = VG_(DebugInfo_get_text_size)(di);
+   PtrdiffT     text_bias = VG_(DebugInfo_get_text_bias)(di);
+   ThreadId     tid       = VG_(running_tid) == VG_INVALID_THREADID
+                               ? replay_tid : VG_(running_tid);
+
+   if (filename == NULL || text_size == 0)
+      return;
+   /* The translator may look at the thread's stack pointer (for
+      --smc-check=stack and =protect), so it must have a real one. */
+   if (tid == VG_INVALID_THREADID)
+      return;
+   if (VG_(threads)[tid].status != VgTs_Init
+       && VG_(threads)[tid].status != VgTs_Runnable)
+      return;
+
+   for (i = 0; i < VG_(sizeXA)(hot_objs); i++) {
+      const HotObj* obj = VG_(indexXA)(hot_objs, i);
+      if (VG_(strcmp)(obj->filename, filename) != 0)
+         continue;
+      if (obj->buildid != NULL && buildid != NULL
+          && VG_(strcmp)(obj->buildid, buildid) != 0)
+         continue;
+
+      n = VG_(sizeXA)(obj->offsets);
+      for (j = 0; j < n; j++) {
+         Addr a = *(Addr*)VG_(indexXA)(obj->offsets, j) + text_bias;
+         if (a < text_avma || a - text_avma >= text_size)
+            continue;
+         n_hot_replayed++;
+         if (VG_(search_transtab)(NULL, NULL, NULL, a, False)) {
+            n_hot_present++;
+            continue;
+         }
+         if (VG_(translate_ahead)(tid, a, 0/*bbs_done*/))
+            n_hot_translated++;
+      }
+   }
+}
+
+void VG_(hot_blocks_start_replay) ( ThreadId tid )
+{
+   const DebugInfo* di;
+
+   vg_assert(replay_tid == VG_INVALID_THREADID);
+   replay_tid = tid;
+   if (hot_objs == NULL)
+      return;
+   for (di = VG_(next_DebugInfo)(NULL); di; di = VG_(next_DebugInfo)(di))
+      VG_(hot_blocks_load_for_DebugInfo)(di);
+}
+
+typedef
+   struct {
+      const DebugInfo* di;
+      Addr             offset;
+      ULong            score;
+   }
+   HotBlock;
+
+static void add_hot_block ( void* opaque, Addr entry, ULong score )
+{
+   XArray*    blocks = opaque;
+   DebugInfo* di     = VG_(find_DebugInfo)(entry);
+   HotBlock   hb;
+
+   if (di == NULL || VG_(DebugInfo_get_filename)(di) == NULL)
+      return;
+   hb.di     = di;
+   hb.offset = entry - VG_(DebugInfo_get_text_bias)(di);
+   hb.score  = score;
+   VG_(addToXA)(blocks, &hb);
+}
+
+static Int cmp_HotBlock_by_score ( const void* v1, const void* v2 )
+{
+   const HotBlock* hb1 = v1;
+   const HotBlock* hb2 = v2;
+   if (hb1->score > hb2->score) return -1;
+   if (hb1->score < hb2->score) return 1;
+   if (hb1->offset < hb2->offset) return -1;
+   if (hb1->offset > hb2->offset) return 1;
+   return 0;
+}
+
+void VG_(hot_blocks_save) ( void )
+{
+   XArray* blocks;
+   VgFile* fp;
+   Word    i, j, n;
+
+   if (VG_(clo_hot_blocks_file) == NULL)
+      return;
+
+   blocks = VG_(newXA)(VG_(malloc), "sbprofile.hbs.1",
+                       VG_(free), sizeof(HotBlock));
+   VG_(visit_SB_scores)(add_hot_block, blocks);
+   VG_(setCmpFnXA)(blocks, cmp_HotBlock_by_score);
+   VG_(sortXA)(blocks);
+   n = VG_(sizeXA)(blocks);
+   if (n > HOT_BLOCKS_MAX) {
+      VG_(dropTailXA)(blocks, n - HOT_BLOCKS_MAX);
+      n = HOT_BLOCKS_MAX;
+   }
+
+   fp = VG_(fopen)(VG_(clo_hot_blocks_file),
+                   VKI_O_CREAT|VKI_O_WRONLY|VKI_O_TRUNC,
+                   VKI_S_IRUSR|VKI_S_IWUSR);
+   if (fp == NULL) {
+      VG_(message)(Vg_UserMsg,
+                   "Warning: can't create --hot-blocks-file=%s\n",
+                   VG_(clo_hot_blocks_file));
+      VG_(deleteXA)(blocks);
+      return;
+   }
+
+   /* Group the blocks by object, keeping them hottest first.  Each
+      block's di is set to NULL once it has been written. */
+   VG_(fprintf)(fp, HOT_BLOCKS_HEADER);
+   for (i = 0; i < n; i++) {
+      const DebugInfo* di = ((HotBlock*)VG_(indexXA)(blocks, i))->di;
+      const HChar*     id;
+      if (di == NULL)
+         continue;
+      id = VG_(DebugInfo_get_buildid)(di);
+      VG_(fprintf)(fp, "obj %s %s\n", id ? id : "-",
+                   VG_(DebugInfo_get_filename)(di));
+      for (j = i; j < n; j++) {
+         HotBlock* hb = VG_(indexXA)(blocks, j);
+         if (hb->di != di)
+            continue;
+         VG_(fprintf)(fp, "%lx\n", hb->offset);
+         hb->di = NULL;
+         n_hot_saved++;
+      }
+   }
+   VG_(fclose)(fp);
+   VG_(deleteXA)(blocks);
+
+   if (VG_(clo_verbosity) > 1)
+      VG_(message)(Vg_DebugMsg, "hot-blocks: saved %'llu blocks to %s\n",
+                   n_hot_saved, VG_(clo_hot_blocks_file));
+}
+
+void VG_(print_hot_blocks_stats) ( void )
+{
+   if (VG_(clo_hot_blocks_file) == NULL)
+      return;
+   VG_(message)(Vg_DebugMsg,
+                " hot-blocks: replayed %'llu (%'llu translated, "
+                "%'llu already present), saved %'llu\n",
+                n_hot_replayed, n_hot_translated, n_hot_present,
+                n_hot_saved);
+}
+
+
 /*--------------------------------------------------------------------*/
 /*--- end                                            m_sbprofile.c ---*/
 /*--------------------------------------------------------------------*/
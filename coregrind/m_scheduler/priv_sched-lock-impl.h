@@ -41,6 +41,10 @@ struct sched_lock_ops {
    int (*get_sched_lock_owner)(struct sched_lock *p);
    void (*acquire_sched_lock)(struct sched_lock *p);
    void (*release_sched_lock)(struct sched_lock *p);
+   /* Optional: NULL if the implementation can't spin. */
+   void (*set_sched_lock_spin)(struct sched_lock *p, Bool spin);
+   void (*get_sched_lock_spin_stats)(struct sched_lock *p,
+                                     ULong *n_spun, ULong *n_slept);
 };
 
 extern const struct sched_lock_ops ML_(generic_sched_lock_ops);
@@ -45,6 +45,9 @@ void ML_(destroy_sched_lock)(struct sched_lock *p);
 int ML_(get_sched_lock_owner)(struct sched_lock *p);
 void ML_(acquire_sched_lock)(struct sched_lock *p);
 void ML_(release_sched_lock)(struct sched_lock *p);
+Bool ML_(set_sched_lock_spin)(struct sched_lock *p, Bool spin);
+Bool ML_(get_sched_lock_spin_stats)(struct sched_lock *p,
+                                    ULong *n_spun, ULong *n_slept);
 
 #endif   // __PRIV_SCHED_LOCK_H
 
@@ -94,3 +94,31 @@ void ML_(release_sched_lock)(struct sched_lock *p)
 {
    return (sched_lock_ops->release_sched_lock)(p);
 }
+
+/**
+ * Ask the lock to spin for a while before sleeping when it has to wait.
+ *
+ * @return False if this lock implementation doesn't support spinning.
+ */
+Bool ML_(set_sched_lock_spin)(struct sched_lock *p, Bool spin)
+{
+   if (!sched_lock_ops->set_sched_lock_spin)
+      return False;
+   (sched_lock_ops->set_sched_lock_spin)(p, spin);
+   return True;
+}
+
+/**
+ * Get the number of waits which ended while spinning, and the number
+ * which had to sleep.
+ *
+ * @return False if this lock implementation doesn't support spinning.
+ */
+Bool ML_(get_sched_lock_spin_stats)(struct sched_lock *p,
+                                    ULong *n_spun, ULong *n_slept)
+{
+   if (!sched_lock_ops->get_sched_lock_spin_stats)
+      return False;
+   (sched_lock_ops->get_sched_lock_spin_stats)(p, n_spun, n_slept);
+   return True;
+}
@@ -108,12 +108,22 @@
    give finer interleaving but much increased scheduling overheads. */
 #define SCHEDULING_QUANTUM   100000
 
+/* Bounds on the timeslice with --adaptive-sched=yes.  See "Adaptive
+   scheduling" below. */
+#define SCHED_MIN_QUANTUM    (SCHEDULING_QUANTUM / 10)
+#define SCHED_MAX_QUANTUM    (SCHEDULING_QUANTUM * 4)
+
 /* If False, a fault is Valgrind-internal (ie, a bug) */
 Bool VG_(in_generated_code) = False;
 
 /* 64-bit counter for the number of basic blocks done. */
 static ULong bbs_done = 0;
 
+/* Are threads running generated code in parallel, and how many are
+   doing so right now?  See "Running threads in parallel" below. */
+static Bool         parallel_active    = False;
+static volatile Int n_running_parallel = 0;
+
 /* Counter to see if vgdb activity is to be verified.
    When nr of bbs done reaches vgdb_next_poll, scheduler will
    poll for gdbserver activity. VG_(force_vgdb_poll) and 
@@ -125,28 +135,62 @@ static ULong vgdb_next_poll;
 static void do_client_request ( ThreadId tid );
 static void scheduler_sanity ( ThreadId tid );
 static void mostly_clear_thread_record ( ThreadId tid );
+static void reset_adaptive_sched ( ThreadId tid );
 
 /* Stats. */
 static ULong n_scheduling_events_MINOR = 0;
 static ULong n_scheduling_events_MAJOR = 0;
+static ULong n_parallel_runs  = 0;
+static ULong n_parallel_stops = 0;
+static ULong n_slices_kept    = 0;
+
+/* Per-thread scheduling stats, indexed by ThreadId, and the state of
+   the adaptive policy.  Each entry is only written by the thread it
+   belongs to, and so covers all threads which have had that
+   ThreadId.  The times are only measured with --stats=yes. */
+typedef
+   struct {
+      ULong slices;          /* timeslices run */
+      ULong bbs;             /* blocks run */
+      ULong syscalls;
+      ULong acquires;        /* acquisitions of the_BigLock ... */
+      ULong contended;       /* ... which found it held or wanted */
+      ULong wait_us;         /* time spent waiting for the_BigLock */
+      ULong run_us;          /* time spent holding it */
+      ULong acquired_at;     /* when it was last acquired */
+      /* Adaptive policy */
+      Int   quantum;         /* length of the next timeslice */
+      Long  syscall_gap;     /* average blocks run between syscalls */
+      ULong bbs_at_syscall;  /* blocks run at the last syscall */
+   }
+   SchedThreadStats;
 
-/* Stats: number of XIndirs, and number that missed in the fast
-   cache. */
+static SchedThreadStats* thread_stats = NULL;
+
+/* Stats: number of XIndirs, number that hit in way 1 of the fast
+   cache (only counted by the dispatchers that probe way 1), and
+   number that missed in the fast cache. */
 static ULong stats__n_xindirs = 0;
+static ULong stats__n_xindir_hits1 = 0;
 static ULong stats__n_xindir_misses = 0;
 
 /* And 32-bit temp bins for the above, so that 32-bit platforms don't
    have to do 64 bit incs on the hot path through
    VG_(cp_disp_xindir). */
 /*global*/ UInt VG_(stats__n_xindirs_32) = 0;
+/*global*/ UInt VG_(stats__n_xindir_hits1_32) = 0;
 /*global*/ UInt VG_(stats__n_xindir_misses_32) = 0;
 
 /* Sanity checking counts. */
 static UInt sanity_fast_count = 0;
 static UInt sanity_slow_count = 0;
 
+static void print_sched_lock_stats ( void );
+
 void VG_(print_scheduler_stats)(void)
 {
+   ThreadId tid;
+
    VG_(message)(Vg_DebugMsg,
       "scheduler: %'llu event checks.\n", bbs_done );
    VG_(message)(Vg_DebugMsg,
@@ -154,9 +198,40 @@ void VG_(print_scheduler_stats)(void)
                 stats__n_xindirs, stats__n_xindir_misses,
                 stats__n_xindirs / (stats__n_xindir_misses 
                                     ? stats__n_xindir_misses : 1));
+   VG_(message)(Vg_DebugMsg,
+                "scheduler: %'llu indir transfers hit in fast-cache way 0, "
+                "%'llu in way 1\n",
+                stats__n_xindirs - stats__n_xindir_hits1
+                                 - stats__n_xindir_misses,
+                stats__n_xindir_hits1);
    VG_(message)(Vg_DebugMsg,
       "scheduler: %'llu/%'llu major/minor sched events.\n",
       n_scheduling_events_MAJOR, n_scheduling_events_MINOR);
+   if (parallel_active)
+      VG_(message)(Vg_DebugMsg,
+                   "scheduler: %'llu parallel runs, %'llu stops for "
+                   "TT/TC changes\n",
+                   n_parallel_runs, n_parallel_stops);
+   if (VG_(clo_adaptive_sched))
+      VG_(message)(Vg_DebugMsg,
+                   "scheduler: %'llu timeslices continued without "
+                   "releasing the lock\n", n_slices_kept);
+   print_sched_lock_stats();
+   for (tid = 1; tid < VG_N_THREADS; tid++) {
+      const SchedThreadStats* ts = &thread_stats[tid];
+      if (ts->acquires == 0)
+         continue;
+      VG_(message)(Vg_DebugMsg,
+                   "scheduler: tid %u: %'llu slices, %'llu bbs, "
+                   "%'llu syscalls, %'llu/%'llu lock waits\n",
+                   tid, ts->slices, ts->bbs, ts->syscalls,
+                   ts->contended, ts->acquires);
+      if (VG_(clo_stats))
+         VG_(message)(Vg_DebugMsg,
+                      "scheduler: tid %u: %'llu ms running, "
+                      "%'llu ms waiting for the lock\n",
+                      tid, ts->run_us / 1000, ts->wait_us / 1000);
+   }
    VG_(message)(Vg_DebugMsg, 
                 "   sanity: %u cheap, %u expensive checks.\n",
                 sanity_fast_count, sanity_slow_count );
@@ -167,6 +242,25 @@ void VG_(print_scheduler_stats)(void)
  */
 static struct sched_lock *the_BigLock;
 
+/* Is the_BigLock handed over in FIFO order (the ticket lock)? */
+static Bool fifo_BigLock = False;
+
+/* Number of threads waiting for the_BigLock, and how many of those
+   make syscalls often (--adaptive-sched=yes only). */
+static volatile Int n_biglock_waiters = 0;
+static volatile Int n_io_waiters      = 0;
+
+static void print_sched_lock_stats ( void )
+{
+   ULong n_spun, n_slept;
+
+   if (VG_(clo_sched_spin)
+       && ML_(get_sched_lock_spin_stats)(the_BigLock, &n_spun, &n_slept))
+      VG_(message)(Vg_DebugMsg,
+                   "scheduler: %'llu lock waits ended while spinning, "
+                   "%'llu slept\n", n_spun, n_slept);
+}
+
 
 /* ---------------------------------------------------------------------
    Helper functions for the scheduler.
@@ -194,6 +288,35 @@ void maybe_show_sb_profile ( void )
    }
 }
 
+/* For tiered translation (--tier2-threshold): every so often, look
+   for first-tier translations which have become hot and retranslate
+   them with superblock chasing.  This is done here, between runs of
+   guest code and holding the lock, so that the old translation can
+   be thrown away safely. */
+#define TIER2_SCAN_INTERVAL  2000000
+#define TIER2_MAX_PER_SCAN   64
+
+static
+void maybe_promote_hot_translations ( ThreadId tid )
+{
+   static ULong bbs_done_lastcheck = 0;
+   Addr hot[TIER2_MAX_PER_SCAN];
+   UInt i, n_hot;
+
+   vg_assert(VG_(clo_tier2_threshold) > 0);
+   if (bbs_done - bbs_done_lastcheck < TIER2_SCAN_INTERVAL)
+      return;
+   bbs_done_lastcheck = bbs_done;
+
+   n_hot = VG_(get_hot_translations)( hot, TIER2_MAX_PER_SCAN,
+                                      VG_(clo_tier2_threshold) );
+   for (i = 0; i < n_hot; i++) {
+      /* If it can't be translated now, the first-tier translation
+         simply stays in place. */
+      (void)VG_(translate_at_tier2)( tid, hot[i], bbs_done );
+   }
+}
+
 static
 const HChar* name_of_sched_event ( UInt event )
 {
@@ -242,6 +365,7 @@ ThreadId VG_(alloc_ThreadState) ( void )
       if (VG_(threads)[i].status == VgTs_Empty) {
 	 VG_(threads)[i].status = VgTs_Init;
 	 VG_(threads)[i].exitreason = VgSrc_None;
+         reset_adaptive_sched(i);
          if (VG_(threads)[i].thread_name)
             VG_(free)(VG_(threads)[i].thread_name);
          VG_(threads)[i].thread_name = NULL;
@@ -265,6 +389,9 @@ ThreadId VG_(alloc_ThreadState) ( void )
 void VG_(acquire_BigLock)(ThreadId tid, const HChar* who)
 {
    ThreadState *tst;
+   SchedThreadStats *ts = &thread_stats[tid];
+   Bool  io, contended;
+   ULong t0 = 0;
 
 #if 0
    if (VG_(clo_trace_sched)) {
@@ -274,11 +401,32 @@ void VG_(acquire_BigLock)(ThreadId tid, const HChar* who)
    }
 #endif
 
+   /* Only our own entry in thread_stats can be touched before we
+      have the lock.  The test for contention is racy, but it's only
+      for stats and the adaptive policy. */
+   io = VG_(clo_adaptive_sched) && ts->syscall_gap < SCHED_MIN_QUANTUM;
+   if (io)
+      __sync_fetch_and_add(&n_io_waiters, 1);
+   contended = n_biglock_waiters > 0
+               || ML_(get_sched_lock_owner)(the_BigLock) != 0;
+   if (VG_(clo_stats))
+      t0 = VG_(read_microsecond_timer)();
+
    /* First, acquire the_BigLock.  We can't do anything else safely
       prior to this point.  Even doing debug printing prior to this
       point is, technically, wrong. */
    VG_(acquire_BigLock_LL)(NULL);
 
+   if (io)
+      __sync_fetch_and_sub(&n_io_waiters, 1);
+   ts->acquires++;
+   if (contended)
+      ts->contended++;
+   if (VG_(clo_stats)) {
+      ts->acquired_at = VG_(read_microsecond_timer)();
+      ts->wait_us += ts->acquired_at - t0;
+   }
+
    tst = VG_(get_ThreadState)(tid);
 
    vg_assert(tst->status != VgTs_Runnable);
@@ -326,6 +474,10 @@ void VG_(release_BigLock)(ThreadId tid, ThreadStatus sleepstate,
    vg_assert(VG_(running_tid) == tid);
    VG_(running_tid) = VG_INVALID_THREADID;
 
+   if (VG_(clo_stats))
+      thread_stats[tid].run_us += VG_(read_microsecond_timer)()
+                                  - thread_stats[tid].acquired_at;
+
    if (VG_(clo_trace_sched)) {
       const HChar *status = VG_(name_of_ThreadStatus)(sleepstate);
       HChar buf[VG_(strlen)(who) + VG_(strlen)(status) + 30];
@@ -342,6 +494,8 @@ static void init_BigLock(void)
 {
    vg_assert(!the_BigLock);
    the_BigLock = ML_(create_sched_lock)();
+   if (VG_(clo_sched_spin))
+      ML_(set_sched_lock_spin)(the_BigLock, True);
 }
 
 static void deinit_BigLock(void)
@@ -353,7 +507,9 @@ static void deinit_BigLock(void)
 /* See pub_core_scheduler.h for description */
 void VG_(acquire_BigLock_LL) ( const HChar* who )
 {
+   __sync_fetch_and_add(&n_biglock_waiters, 1);
    ML_(acquire_sched_lock)(the_BigLock);
+   __sync_fetch_and_sub(&n_biglock_waiters, 1);
 }
 
 /* See pub_core_scheduler.h for description */
@@ -368,6 +524,11 @@ Bool VG_(owns_BigLock_LL) ( ThreadId tid )
            == VG_(threads)[tid].os_state.lwpid);
 }
 
+Bool VG_(BigLock_is_wanted) ( void )
+{
+   return n_biglock_waiters > 0;
+}
+
 
 /* Clear out the ThreadState and release the semaphore. Leaves the
    ThreadState in VgTs_Zombie state, so that it doesn't get
@@ -435,6 +596,18 @@ void VG_(get_thread_out_of_syscall)(ThreadId tid)
    }
 }
 
+/* Tell the kernel we're yielding. */
+static void yield_cpu ( void )
+{
+#  if defined(VGO_linux) || defined(VGO_darwin)
+   VG_(do_syscall0)(__NR_sched_yield);
+#  elif defined(VGO_solaris)
+   VG_(do_syscall0)(__NR_yield);
+#  else
+#    error Unknown OS
+#  endif
+}
+
 /* 
    Yield the CPU for a short time to let some other thread run.
  */
@@ -447,16 +620,7 @@ void VG_(vg_yield)(void)
 
    VG_(release_BigLock)(tid, VgTs_Yielding, "VG_(vg_yield)");
 
-   /* 
-      Tell the kernel we're yielding.
-    */
-#  if defined(VGO_linux) || defined(VGO_darwin)
-   VG_(do_syscall0)(__NR_sched_yield);
-#  elif defined(VGO_solaris)
-   VG_(do_syscall0)(__NR_yield);
-#  else
-#    error Unknown OS
-#  endif
+   yield_cpu();
 
    VG_(acquire_BigLock)(tid, "VG_(vg_yield)");
 }
@@ -590,6 +754,13 @@ static void sched_fork_cleanup(ThreadId me)
       }
    }
 
+   /* Threads running in parallel in the parent don't exist here. */
+   for (tid = 1; tid < VG_N_THREADS; tid++)
+      VG_(threads)[tid].running_parallel = False;
+   n_running_parallel = 0;
+   n_biglock_waiters  = 0;
+   n_io_waiters       = 0;
+
    /* re-init and take the sema */
    deinit_BigLock();
    init_BigLock();
@@ -608,12 +779,13 @@ ThreadId VG_(scheduler_init_phase1) ( void )
 
    VG_(debugLog)(1,"sched","sched_init_phase1\n");
 
-   if (VG_(clo_fair_sched) != disable_fair_sched
-       && !ML_(set_sched_lock_impl)(sched_lock_ticket)
-       && VG_(clo_fair_sched) == enable_fair_sched)
-   {
-      VG_(printf)("Error: fair scheduling is not supported on this system.\n");
-      VG_(exit)(1);
+   if (VG_(clo_fair_sched) != disable_fair_sched) {
+      fifo_BigLock = ML_(set_sched_lock_impl)(sched_lock_ticket);
+      if (!fifo_BigLock && VG_(clo_fair_sched) == enable_fair_sched) {
+         VG_(printf)("Error: fair scheduling is not supported on this "
+                     "system.\n");
+         VG_(exit)(1);
+      }
    }
 
    if (VG_(clo_verbosity) > 1) {
@@ -624,6 +796,14 @@ ThreadId VG_(scheduler_init_phase1) ( void )
 
    init_BigLock();
 
+   if (VG_(clo_sched_spin) && !fifo_BigLock)
+      VG_(message)(Vg_UserMsg,
+                   "Warning: --sched-spin=yes has no effect without "
+                   "--fair-sched=yes or try\n");
+
+   thread_stats = VG_(calloc)("scheduler.thread_stats", VG_N_THREADS,
+                              sizeof(SchedThreadStats));
+
    for (i = 0 /* NB; not 1 */; i < VG_N_THREADS; i++) {
       /* Paranoia .. completely zero it out. */
       VG_(memset)( & VG_(threads)[i], 0, sizeof( VG_(threads)[i] ) );
@@ -680,6 +860,213 @@ void VG_(scheduler_init_phase2) ( ThreadId tid_main,
 }
 
 
+/* ---------------------------------------------------------------------
+   Running threads in parallel.
+   ------------------------------------------------------------------ */
+
+/* With --parallel-threads=yes, and a tool which says that its
+   instrumentation is thread-safe (VG_(needs_parallel_execution)), a
+   thread lets go of the_BigLock while it runs generated code, and
+   takes it back when the code returns to the scheduler.  Everything
+   else the core does still needs the_BigLock, so threads really run
+   in parallel only while they are running code which has already been
+   translated and chained.  For a long-running multithreaded program,
+   that is most of the time.
+
+   Generated code depends on nothing of the core's but the TT/TC and
+   the fast cache.  Whoever changes those -- by adding, chaining or
+   discarding translations, or by filling in the fast cache -- first
+   calls VG_(stop_parallel_threads), which m_transtab does.  That sets
+   the event counter of every thread running in parallel to zero, so
+   that it leaves generated code at its next block boundary, and waits
+   until they all have.  None of them can start again before the
+   caller lets go of the_BigLock.  Stopping the world is not cheap, so
+   m_transtab does it only when it actually changes something: a fast
+   cache entry which another thread has already filled in is left
+   alone, and chaining requests are queued and done in batches (see
+   VG_(tt_tc_do_chaining)).  The dispatchers normally reorder
+   the ways of a fast cache set on a hit in way 1.  That isn't safe
+   with other threads reading the set, so VG_(tt_fast_no_swap) turns
+   it off.
+
+   A thread which takes a synchronous signal while running in parallel
+   takes the_BigLock back first thing in the signal handler (see
+   VG_(end_parallel_run)), and the rest of the signal handling happens
+   as usual.
+
+   The event counts of threads which are stopped early, and hence
+   bbs_done, are approximate in this mode.
+
+   Only x86 and amd64 Linux are supported: there, VEX turns all guest
+   atomic instructions into host atomic instructions. */
+
+void VG_(parallel_threads_init) ( void )
+{
+   if (!VG_(clo_parallel_threads))
+      return;
+
+#  if defined(VGO_linux) && (defined(VGA_x86) || defined(VGA_amd64))
+   if (!VG_(needs).parallel_execution) {
+      VG_(message)(Vg_UserMsg,
+                   "Warning: --parallel-threads is not supported by this"
+                   " tool; ignored\n");
+      return;
+   }
+   if (VG_(clo_vgdb) != Vg_VgdbNo) {
+      VG_(message)(Vg_UserMsg,
+                   "Warning: --parallel-threads=yes requires --vgdb=no;"
+                   " ignored\n");
+      return;
+   }
+   parallel_active       = True;
+   VG_(tt_fast_no_swap) = 1;
+#  else
+   VG_(message)(Vg_UserMsg,
+                "Warning: --parallel-threads is not supported on this"
+                " platform; ignored\n");
+#  endif
+}
+
+/* Let go of the_BigLock while TID runs generated code. */
+static void start_parallel_run ( ThreadId tid )
+{
+   ThreadState* tst = VG_(get_ThreadState)(tid);
+
+   vg_assert(VG_(running_tid) == tid);
+   vg_assert(!tst->running_parallel);
+   n_parallel_runs++;
+
+   tst->running_parallel = True;
+   __sync_fetch_and_add(&n_running_parallel, 1);
+   VG_(running_tid) = VG_INVALID_THREADID;
+   VG_(release_BigLock_LL)("parallel run");
+}
+
+void VG_(end_parallel_run) ( ThreadId tid )
+{
+   ThreadState* tst = VG_(get_ThreadState)(tid);
+   UInt         evc;
+
+   if (!tst->running_parallel)
+      return;
+
+   /* VG_(stop_parallel_threads) may yet zero the event counter;
+      it's too late for that to mean anything. */
+   evc = tst->arch.vex.host_EvC_COUNTER;
+   tst->running_parallel = False;
+   __sync_fetch_and_sub(&n_running_parallel, 1);
+
+   VG_(acquire_BigLock_LL)("parallel run");
+   tst->arch.vex.host_EvC_COUNTER = evc;
+   vg_assert(VG_(running_tid) == VG_INVALID_THREADID);
+   VG_(running_tid) = tid;
+
+   /* As if the thread had been running generated code with
+      the_BigLock all along. */
+   vg_assert(VG_(in_generated_code) == False);
+   VG_(in_generated_code) = True;
+}
+
+void VG_(stop_parallel_threads) ( void )
+{
+   ThreadId tid;
+
+   if (n_running_parallel == 0)
+      return;
+
+   n_parallel_stops++;
+   while (n_running_parallel > 0) {
+      for (tid = 1; tid < VG_N_THREADS; tid++) {
+         if (VG_(threads)[tid].running_parallel)
+            VG_(threads)[tid].arch.vex.host_EvC_COUNTER = 0;
+      }
+      yield_cpu();
+   }
+   __sync_synchronize();
+}
+
+Bool VG_(parallel_threads_running) ( void )
+{
+   return n_running_parallel > 0;
+}
+
+
+/* ---------------------------------------------------------------------
+   Adaptive scheduling.
+   ------------------------------------------------------------------ */
+
+/* Normally every thread runs for SCHEDULING_QUANTUM blocks, then lets
+   go of the_BigLock and takes it again.  That costs a lock round trip
+   per timeslice even when no other thread wants to run, and, with the
+   pipe-based lock, the releasing thread often wins the lock straight
+   back, so compute-bound threads get very uneven shares.
+
+   With --adaptive-sched=yes, the length of a thread's next timeslice
+   is worked out at the end of each one, from the number of threads
+   waiting for the_BigLock (which VG_(acquire_BigLock_LL) keeps count
+   of) and from how often those threads make syscalls:
+
+   - nobody waiting: the timeslice doubles, up to SCHED_MAX_QUANTUM,
+     and the thread carries on without releasing the_BigLock at all;
+
+   - some waiting thread makes syscalls every SCHED_MIN_QUANTUM blocks
+     or less (on average): SCHED_MIN_QUANTUM.  Such threads only want
+     to run briefly before blocking again, and a short timeslice gets
+     them through quickly;
+
+   - otherwise: the waiters are compute-bound, and the timeslice
+     shrinks as they get more numerous, so that a round of all of them
+     takes roughly two standard timeslices.
+
+   With the pipe-based lock, a thread which releases the_BigLock while
+   others are waiting also yields the CPU before trying to take it
+   back, to give them a fair chance.  The ticket lock hands the lock
+   over in FIFO order anyway. */
+
+static void reset_adaptive_sched ( ThreadId tid )
+{
+   SchedThreadStats* ts = &thread_stats[tid];
+
+   ts->quantum        = SCHEDULING_QUANTUM;
+   ts->syscall_gap    = SCHEDULING_QUANTUM;
+   ts->bbs_at_syscall = ts->bbs;
+}
+
+static void note_syscall ( ThreadId tid )
+{
+   SchedThreadStats* ts = &thread_stats[tid];
+   Long gap = (Long)(ts->bbs - ts->bbs_at_syscall);
+
+   ts->syscalls++;
+   ts->syscall_gap   += (gap - ts->syscall_gap) / 8;
+   ts->bbs_at_syscall = ts->bbs;
+}
+
+/* Length of TID's next timeslice.  Must be called with the_BigLock
+   held. */
+static Int next_quantum ( ThreadId tid )
+{
+   SchedThreadStats* ts = &thread_stats[tid];
+   Int waiters = n_biglock_waiters;
+
+   if (!VG_(clo_adaptive_sched))
+      return SCHEDULING_QUANTUM;
+
+   if (waiters == 0) {
+      ts->quantum *= 2;
+      if (ts->quantum > SCHED_MAX_QUANTUM)
+         ts->quantum = SCHED_MAX_QUANTUM;
+   } else if (n_io_waiters > 0) {
+      ts->quantum = SCHED_MIN_QUANTUM;
+   } else {
+      ts->quantum = 2 * SCHEDULING_QUANTUM / (1 + waiters);
+      if (ts->quantum < SCHED_MIN_QUANTUM)
+         ts->quantum = SCHED_MIN_QUANTUM;
+   }
+   return ts->quantum;
+}
+
+
 /* ---------------------------------------------------------------------
    Helpers for running translations.
    ------------------------------------------------------------------ */
@@ -877,9 +1264,13 @@ void run_thread_for_a_while ( /*OUT*/HWord* two_words,
    do_pre_run_checks( tst );
    /* end Paranoia */
 
-   /* Futz with the XIndir stats counters. */
-   vg_assert(VG_(stats__n_xindirs_32) == 0);
-   vg_assert(VG_(stats__n_xindir_misses_32) == 0);
+   /* Futz with the XIndir stats counters.  Threads running in
+      parallel may be adding to them even now. */
+   if (!parallel_active) {
+      vg_assert(VG_(stats__n_xindirs_32) == 0);
+      vg_assert(VG_(stats__n_xindir_hits1_32) == 0);
+      vg_assert(VG_(stats__n_xindir_misses_32) == 0);
+   }
 
    /* Clear return area. */
    two_words[0] = two_words[1] = 0;
@@ -890,11 +1281,11 @@ void run_thread_for_a_while ( /*OUT*/HWord* two_words,
       host_code_addr = alt_host_addr;
    } else {
       /* normal case -- redir translation */
-      UInt cno = (UInt)VG_TT_FAST_HASH((Addr)tst->arch.vex.VG_INSTR_PTR);
-      if (LIKELY(VG_(tt_fast)[cno].guest == (Addr)tst->arch.vex.VG_INSTR_PTR))
-         host_code_addr = VG_(tt_fast)[cno].host;
-      else {
-         Addr res = 0;
+      Addr res = 0;
+      if (LIKELY(VG_(lookup_tt_fast)(&res,
+                                     (Addr)tst->arch.vex.VG_INSTR_PTR))) {
+         host_code_addr = res;
+      } else {
          /* not found in VG_(tt_fast). Searching here the transtab
             improves the performance compared to returning directly
             to the scheduler. */
@@ -942,7 +1333,10 @@ void run_thread_for_a_while ( /*OUT*/HWord* two_words,
    VG_TRACK( start_client_code, tid, bbs_done );
 
    vg_assert(VG_(in_generated_code) == False);
-   VG_(in_generated_code) = True;
+   if (parallel_active)
+      start_parallel_run(tid);
+   else
+      VG_(in_generated_code) = True;
 
    SCHEDSETJMP(
       tid, 
@@ -954,6 +1348,7 @@ void run_thread_for_a_while ( /*OUT*/HWord* two_words,
       )
    );
 
+   VG_(end_parallel_run)(tid);
    vg_assert(VG_(in_generated_code) == True);
    VG_(in_generated_code) = False;
 
@@ -975,6 +1370,8 @@ void run_thread_for_a_while ( /*OUT*/HWord* two_words,
       generated code. */
    stats__n_xindirs += (ULong)VG_(stats__n_xindirs_32);
    VG_(stats__n_xindirs_32) = 0;
+   stats__n_xindir_hits1 += (ULong)VG_(stats__n_xindir_hits1_32);
+   VG_(stats__n_xindir_hits1_32) = 0;
    stats__n_xindir_misses += (ULong)VG_(stats__n_xindir_misses_32);
    VG_(stats__n_xindir_misses_32) = 0;
 
@@ -1004,6 +1401,7 @@ void run_thread_for_a_while ( /*OUT*/HWord* two_words,
 
    vg_assert(done_this_time >= 0);
    bbs_done += (ULong)done_this_time;
+   thread_stats[tid].bbs += (ULong)done_this_time;
 
    *dispatchCtrP -= done_this_time;
    vg_assert(*dispatchCtrP >= 0);
@@ -1043,8 +1441,12 @@ static void handle_tt_miss ( ThreadId tid )
    Bool found;
    Addr ip = VG_(get_IP)(tid);
 
-   /* Trivial event.  Miss in the fast-cache.  Do a full
-      lookup for it. */
+   /* Trivial event.  Miss in the fast-cache.  Dispatchers which
+      only probe way 0 come here on a way 1 hit too, so try that
+      before doing a full lookup. */
+   Addr hcode;
+   if (VG_(lookup_tt_fast)( &hcode, ip ))
+      return;
    found = VG_(search_transtab)( NULL, NULL, NULL,
                                  ip, True/*upd_fast_cache*/ );
    if (UNLIKELY(!found)) {
@@ -1119,6 +1521,8 @@ static void handle_syscall(ThreadId tid, UInt trc)
       vg_assert(ok);
    }
 
+   note_syscall(tid);
+
    SCHEDSETJMP(tid, jumped, VG_(client_syscall)(tid, trc));
 
    if (VG_(clo_sanity_level) >= 3) {
@@ -1276,7 +1680,8 @@ VgSchedReturnCode VG_(scheduler) ( ThreadId tid )
    
    vg_assert(VG_(is_running_thread)(tid));
 
-   dispatch_ctr = SCHEDULING_QUANTUM;
+   dispatch_ctr = VG_(clo_adaptive_sched) ? thread_stats[tid].quantum
+                                          : SCHEDULING_QUANTUM;
 
    while (!VG_(is_exiting)(tid)) {
 
@@ -1300,12 +1705,21 @@ VgSchedReturnCode VG_(scheduler) ( ThreadId tid )
 	 /* 3 Aug 06: doing sys__nsleep works but crashes some apps.
             sys_yield also helps the problem, whilst not crashing apps. */
 
-	 VG_(release_BigLock)(tid, VgTs_Yielding, 
-                                   "VG_(scheduler):timeslice");
-	 /* ------------ now we don't have The Lock ------------ */
+         if (VG_(clo_adaptive_sched) && n_biglock_waiters == 0) {
+            /* Nobody else wants to run; carry on. */
+            n_slices_kept++;
+         } else {
+            VG_(release_BigLock)(tid, VgTs_Yielding, 
+                                      "VG_(scheduler):timeslice");
+            /* ------------ now we don't have The Lock ------------ */
+
+            if (VG_(clo_adaptive_sched) && !fifo_BigLock
+                && n_biglock_waiters > 0)
+               yield_cpu();
 
-	 VG_(acquire_BigLock)(tid, "VG_(scheduler):timeslice");
-	 /* ------------ now we do have The Lock ------------ */
+            VG_(acquire_BigLock)(tid, "VG_(scheduler):timeslice");
+            /* ------------ now we do have The Lock ------------ */
+         }
 
 	 /* OK, do some relatively expensive housekeeping stuff */
 	 scheduler_sanity(tid);
@@ -1320,9 +1734,10 @@ VgSchedReturnCode VG_(scheduler) ( ThreadId tid )
 
 	 /* For stats purposes only. */
 	 n_scheduling_events_MAJOR++;
+         thread_stats[tid].slices++;
 
 	 /* Figure out how many bbs to ask vg_run_innerloop to do. */
-         dispatch_ctr = SCHEDULING_QUANTUM;
+         dispatch_ctr = next_quantum(tid);
 
 	 /* paranoia ... */
 	 vg_assert(tst->tid == tid);
@@ -1646,6 +2061,9 @@ VgSchedReturnCode VG_(scheduler) ( ThreadId tid )
 
       if (UNLIKELY(VG_(clo_profyle_sbs)) && VG_(clo_profyle_interval) > 0)
          maybe_show_sb_profile();
+
+      if (UNLIKELY(VG_(clo_tier2_threshold) > 0) && !VG_(is_exiting)(tid))
+         maybe_promote_hot_translations(tid);
    }
 
    if (VG_(clo_trace_sched))
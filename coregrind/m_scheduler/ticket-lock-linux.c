@@ -55,11 +55,20 @@
 #define TL_FUTEX_COUNT (1U << TL_FUTEX_COUNT_LOG2)
 #define TL_FUTEX_MASK (TL_FUTEX_COUNT - 1)
 
+/* Bounds on the number of times a waiter spins before sleeping. */
+#define TL_SPIN_MIN 16
+#define TL_SPIN_MAX 4096
+
 struct sched_lock {
    volatile unsigned head;
    volatile unsigned tail;
    volatile unsigned futex[TL_FUTEX_COUNT];
    int owner;
+   /* The following are only modified by the lock owner. */
+   Bool spin;
+   unsigned spins;    /* running average of spins needed */
+   ULong n_spun;      /* waits which ended while spinning */
+   ULong n_slept;     /* waits which had to sleep */
 };
 
 #if 1
@@ -100,6 +109,28 @@ static int get_sched_lock_owner(struct sched_lock *p)
    return p->owner;
 }
 
+static void set_sched_lock_spin(struct sched_lock *p, Bool spin)
+{
+   p->spin = spin;
+   p->spins = TL_SPIN_MIN;
+}
+
+static void get_sched_lock_spin_stats(struct sched_lock *p,
+                                      ULong *n_spun, ULong *n_slept)
+{
+   *n_spun = p->n_spun;
+   *n_slept = p->n_slept;
+}
+
+static inline void cpu_relax(void)
+{
+#if defined(VGA_x86) || defined(VGA_amd64)
+   __asm__ __volatile__("pause" ::: "memory");
+#else
+   __sync_synchronize();
+#endif
+}
+
 /*
  * Acquire ticket lock. Increment the tail of the queue and use the original
  * value as the ticket value. Wait until the head of the queue equals the
@@ -108,20 +139,36 @@ static int get_sched_lock_owner(struct sched_lock *p)
  * released. That last effect is sometimes called the "thundering herd"
  * effect.
  *
+ * If spinning is enabled, a waiter first spins for up to twice the recent
+ * average number of spins needed (cf. glibc's adaptive mutexes) before it
+ * goes to sleep, so that short waits don't cost a sleep and a wakeup.
+ *
  * See also Nick Piggin, x86: FIFO ticket spinlocks, Linux kernel mailing list
  * (http://lkml.org/lkml/2007/11/1/125) for more info.
  */
 static void acquire_sched_lock(struct sched_lock *p)
 {
-   unsigned ticket, futex_value;
+   unsigned ticket, futex_value, n, max_spins;
    volatile unsigned *futex;
    SysRes sres;
+   Bool spun_only = False;
 
    ticket = __sync_fetch_and_add(&p->tail, 1);
    futex = &p->futex[ticket & TL_FUTEX_MASK];
    if (s_debug)
       VG_(printf)("[%d/%d] acquire: ticket %u\n", VG_(getpid)(),
                   VG_(gettid)(), ticket);
+   n = 0;
+   if (p->spin && ticket != p->head) {
+      spun_only = True;
+      max_spins = p->spins * 2 + TL_SPIN_MIN;
+      if (max_spins > TL_SPIN_MAX)
+         max_spins = TL_SPIN_MAX;
+      while (n < max_spins && ticket != p->head) {
+         cpu_relax();
+         n++;
+      }
+   }
    for (;;) {
       futex_value = *futex;
       __sync_synchronize();
@@ -132,6 +179,7 @@ static void acquire_sched_lock(struct sched_lock *p)
                      " futex[%ld] != %u\n", VG_(getpid)(),
                      VG_(gettid)(), ticket, (long)(futex - p->futex),
                      futex_value);
+      spun_only = False;
       sres = VG_(do_syscall3)(__NR_futex, (UWord)futex,
                               VKI_FUTEX_WAIT | VKI_FUTEX_PRIVATE_FLAG,
                               futex_value);
@@ -144,6 +192,15 @@ static void acquire_sched_lock(struct sched_lock *p)
    INNER_REQUEST(ANNOTATE_RWLOCK_ACQUIRED(p, /*is_w*/1));
    vg_assert(p->owner == 0);
    p->owner = VG_(gettid)();
+   if (p->spin && n > 0) {
+      /* Waits which had to sleep pull the average down: if waits are
+         typically long, spinning only wastes CPU time. */
+      if (spun_only)
+         p->n_spun++;
+      else
+         p->n_slept++;
+      p->spins += ((int)(spun_only ? n : TL_SPIN_MIN) - (int)p->spins) / 8;
+   }
 }
 
 /*
@@ -190,4 +247,6 @@ const struct sched_lock_ops ML_(linux_ticket_lock_ops) = {
    .get_sched_lock_owner = get_sched_lock_owner,
    .acquire_sched_lock   = acquire_sched_lock,
    .release_sched_lock   = release_sched_lock,
+   .set_sched_lock_spin  = set_sched_lock_spin,
+   .get_sched_lock_spin_stats = get_sched_lock_spin_stats,
 };
@@ -220,6 +220,7 @@
 #include "pub_core_scheduler.h"
 #include "pub_core_signals.h"
 #include "pub_core_sigframe.h"      // For VG_(sigframe_create)()
+#include "pub_core_smcprotect.h"    // For VG_(smc_handle_write_fault)()
 #include "pub_core_stacks.h"        // For VG_(change_stack)()
 #include "pub_core_stacktrace.h"    // For VG_(get_and_pp_StackTrace)()
 #include "pub_core_syscall.h"
@@ -2828,6 +2829,12 @@ void sync_signalhandler ( Int sigNo,
    ThreadId tid = VG_(lwpid_to_vgtid)(VG_(gettid)());
    Bool from_user;
 
+   /* A thread running generated code in parallel with others (see
+      --parallel-threads) must get the_BigLock back before doing
+      anything else. */
+   if (VG_(is_valid_tid)(tid))
+      VG_(end_parallel_run)(tid);
+
    if (0) 
       VG_(printf)("sync_sighandler(%d, %p, %p)\n", sigNo, info, uc);
 
@@ -2867,8 +2874,19 @@ void sync_signalhandler ( Int sigNo,
    /* Figure out if the signal is being sent from outside the process.
       (Why do we care?)  If the signal is from the user rather than the
       kernel, then treat it more like an async signal than a sync signal --
-      that is, merely queue it for later delivery. */
-   if (from_user) {
+      that is, merely queue it for later delivery.
+
+      But first, a write to code which --smc-check=protect has
+      write-protected isn't the client's business at all.  Once the
+      translations from the page have been discarded and the page is
+      writable again, the faulting instruction can simply be
+      restarted. */
+   if (!from_user && sigNo == VKI_SIGSEGV
+       && info->si_code == VKI_SEGV_ACCERR
+       && VG_(clo_smc_check) == Vg_SmcProtect
+       && VG_(smc_handle_write_fault)((Addr)info->VKI_SIGINFO_si_addr)) {
+      /* done */
+   } else if (from_user) {
       sync_signalhandler_from_user(  tid, sigNo, info, uc);
    } else {
       sync_signalhandler_from_kernel(tid, sigNo, info, uc);
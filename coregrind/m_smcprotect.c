@@ -0,0 +1,311 @@
+/*--------------------------------------------------------------------*/
+/*--- Write-protecting translated code.             m_smcprotect.c ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Valgrind, a dynamic binary instrumentation
+   framework.
+
+   Copyright (C) 2015-2015 The Valgrind developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#include "pub_core_basics.h"
+#include "pub_core_vki.h"
+#include "pub_core_vkiscnums.h"
+#include "pub_core_aspacemgr.h"
+#include "pub_core_libcbase.h"
+#include "pub_core_libcassert.h"
+#include "pub_core_libcprint.h"
+#include "pub_core_mallocfree.h"
+#include "pub_core_options.h"
+#include "pub_core_syscall.h"       // VG_(do_syscall3)
+#include "pub_core_transtab.h"      // VG_(discard_translations)
+#include "pub_core_wordfm.h"
+#include "pub_core_smcprotect.h"    // self
+
+
+/*====================================================================*/
+/*=== Overview                                                     ===*/
+/*====================================================================*/
+
+/* With --smc-check=all-non-file, every translation of code outside
+   file mappings starts by hashing the guest bytes it was made from
+   and comparing the result with the hash taken at translation time.
+   For code which is run a lot -- trampolines, JIT output -- that is
+   expensive, and almost always unnecessary.
+
+   With --smc-check=protect, code in private writable anonymous
+   mappings is instead translated without a check, and the pages it
+   came from are then write-protected, behind aspacem's back: the
+   segments keep their W permission.  A write to such a page faults.
+   The SIGSEGV handler passes the fault here, and if the page is one of
+   ours, all translations from it are discarded, the page is made
+   writable again, and the faulting instruction is restarted.  The
+   page is protected again when code is next translated from it.
+
+   Pages which are written too often (because they mix code and data,
+   for example) are given up on: after SMC_MAX_WRITES writes, code
+   from them gets a self-check, as with all-non-file.  So does code
+   on the current thread's stack (see needs_self_check in
+   m_translate.c) and anywhere else we can't protect.
+
+   Code in anonymous mappings without W permission needs neither: it
+   can only be changed after an mprotect, and in this mode
+   VG_(am_notify_mprotect) asks for a discard of any range with
+   translations in it.
+
+   The kernel doesn't fault on a protected page, it fails the syscall
+   with EFAULT, so syscall wrappers unprotect the buffers they are
+   about to have written (see PRE_MEM_WRITE).  Pages leave our care
+   when translations from them are discarded, since VG_(discard_
+   translations) tells us about every range it discards, and aspacem
+   asks for that for any range with translations which is unmapped,
+   remapped or mprotected.
+
+   Not caught: code changed by writes through another mapping of the
+   same memory, by the kernel other than in syscall buffers, or by
+   madvise(MADV_DONTNEED). */
+
+
+/*====================================================================*/
+/*=== Page state                                                   ===*/
+/*====================================================================*/
+
+#define SMC_MAX_WRITES  4
+
+/* Page address -> (writes << 1) | PAGE_PROTECTED.  Only pages which
+   are protected or have been written are present. */
+#define PAGE_PROTECTED  1
+static WordFM* pages = NULL;
+
+/* Stats */
+static ULong n_smc_protected   = 0;
+static ULong n_smc_faults      = 0;
+static ULong n_smc_syscall     = 0;
+static ULong n_smc_unprotected = 0;
+static ULong n_smc_given_up    = 0;
+
+static inline UInt n_writes ( UWord v )
+{
+   return (UInt)(v >> 1);
+}
+
+/* Set the kernel's permissions for PAGE to those of its segment,
+   less W if !WRITABLE.  Returns False if there's nothing there to
+   set them for. */
+static Bool set_page_perms ( Addr page, Bool writable )
+{
+   NSegment const* seg = VG_(am_find_nsegment)(page);
+   UInt   prot = 0;
+   SysRes sres;
+
+   if (seg == NULL
+       || (seg->kind != SkAnonC && seg->kind != SkFileC
+           && seg->kind != SkShmC))
+      return False;
+   if (seg->hasR)              prot |= VKI_PROT_READ;
+   if (seg->hasW && writable)  prot |= VKI_PROT_WRITE;
+   if (seg->hasX)              prot |= VKI_PROT_EXEC;
+   sres = VG_(do_syscall3)(__NR_mprotect, (UWord)page, VKI_PAGE_SIZE, prot);
+   return !sr_isError(sres);
+}
+
+/* Find the first page in [lo, hi) that we know about. */
+static Bool next_known_page ( Addr lo, Addr hi,
+                              /*OUT*/Addr* page, /*OUT*/UWord* v )
+{
+   UWord k;
+   Bool  found;
+
+   if (lo >= hi)
+      return False;
+   VG_(initIterAtFM)(pages, lo);
+   found = VG_(nextIterFM)(pages, &k, v);
+   VG_(doneIterFM)(pages);
+   if (!found || k >= hi)
+      return False;
+   *page = k;
+   return True;
+}
+
+/* PAGE, which is protected, is about to be written by the client or
+   by the kernel.  Note the write and discard the translations from
+   it, which also unprotects it. */
+static void note_write ( Addr page, UWord v )
+{
+   if (n_writes(v) < SMC_MAX_WRITES) {
+      v += 2;
+      if (n_writes(v) == SMC_MAX_WRITES) {
+         n_smc_given_up++;
+         if (VG_(clo_verbosity) > 2)
+            VG_(message)(Vg_DebugMsg,
+                         "smc-check=protect: page %#lx written too often,"
+                         " using self-checks\n", page);
+      }
+   }
+   VG_(addToFM)(pages, page, v);
+   VG_(discard_translations)(page, VKI_PAGE_SIZE, "smc_protect");
+}
+
+
+/*====================================================================*/
+/*=== Interface                                                    ===*/
+/*====================================================================*/
+
+Bool VG_(smc_can_skip_check) ( NSegment const* seg, Addr a, SizeT len,
+                               /*OUT*/Bool* protect )
+{
+   Addr  page;
+   UWord v;
+
+   vg_assert(VG_(clo_smc_check) == Vg_SmcProtect);
+   *protect = False;
+
+   if (seg == NULL || seg->kind != SkAnonC || a < seg->start
+       || (len > 0 && a + len - 1 > seg->end))
+      return False;
+   /* Shared memory can be written through another mapping of it, here
+      or in another process, which our protection won't see. */
+   if (seg->isShared)
+      return False;
+   if (!seg->hasW)
+      return True;
+
+   if (pages != NULL) {
+      for (page = VG_PGROUNDDN(a); page < a + len; page += VKI_PAGE_SIZE) {
+         if (VG_(lookupFM)(pages, NULL, &v, page)
+             && n_writes(v) >= SMC_MAX_WRITES)
+            return False;
+      }
+   }
+   *protect = True;
+   return True;
+}
+
+void VG_(smc_protect) ( Addr a, SizeT len )
+{
+   Addr  page;
+   UWord v;
+
+   if (len == 0)
+      return;
+   if (pages == NULL)
+      pages = VG_(newFM)(VG_(malloc), "smcprotect.pages", VG_(free), NULL);
+
+   for (page = VG_PGROUNDDN(a); page < a + len; page += VKI_PAGE_SIZE) {
+      if (!VG_(lookupFM)(pages, NULL, &v, page))
+         v = 0;
+      if (v & PAGE_PROTECTED)
+         continue;
+      if (!set_page_perms(page, False/*!writable*/))
+         continue;
+      VG_(addToFM)(pages, page, v | PAGE_PROTECTED);
+      n_smc_protected++;
+   }
+}
+
+void VG_(smc_discarding) ( /*MOD*/Addr* start, /*MOD*/ULong* len )
+{
+   Addr  lo, hi, page;
+   UWord v;
+   Bool  any = False;
+
+   if (pages == NULL || VG_(sizeFM)(pages) == 0)
+      return;
+
+   lo = VG_PGROUNDDN(*start);
+   hi = VG_PGROUNDUP(*start + *len);
+   while (next_known_page(lo, hi, &page, &v)) {
+      if (v & PAGE_PROTECTED) {
+         any = True;
+         n_smc_unprotected++;
+         if (!set_page_perms(page, True/*writable*/)) {
+            /* Unmapped: forget it altogether. */
+            VG_(delFromFM)(pages, NULL, NULL, page);
+         } else {
+            VG_(addToFM)(pages, page, v & ~(UWord)PAGE_PROTECTED);
+         }
+      }
+      lo = page + VKI_PAGE_SIZE;
+   }
+
+   /* Other translations from the pages just unprotected were also
+      relying on them staying unwritten. */
+   if (any) {
+      lo     = VG_PGROUNDDN(*start);
+      *len   = VG_PGROUNDUP(*start + *len) - lo;
+      *start = lo;
+   }
+}
+
+Bool VG_(smc_handle_write_fault) ( Addr addr )
+{
+   Addr  page = VG_PGROUNDDN(addr);
+   UWord v;
+
+   if (pages == NULL || !VG_(lookupFM)(pages, NULL, &v, page)
+       || !(v & PAGE_PROTECTED))
+      return False;
+
+   n_smc_faults++;
+   note_write(page, v);
+   return True;
+}
+
+void VG_(smc_pre_syscall_write) ( Addr a, SizeT len )
+{
+   Addr  lo, hi, page;
+   UWord v;
+
+   if (pages == NULL || len == 0)
+      return;
+
+   lo = VG_PGROUNDDN(a);
+   hi = VG_PGROUNDUP(a + len);
+   while (next_known_page(lo, hi, &page, &v)) {
+      if (v & PAGE_PROTECTED) {
+         n_smc_syscall++;
+         note_write(page, v);
+      }
+      lo = page + VKI_PAGE_SIZE;
+   }
+}
+
+
+/*====================================================================*/
+/*=== Stats                                                        ===*/
+/*====================================================================*/
+
+void VG_(print_smcprotect_stats) ( void )
+{
+   if (VG_(clo_smc_check) != Vg_SmcProtect)
+      return;
+   VG_(message)(Vg_DebugMsg,
+                " smcprotect: %'llu pages protected, %'llu unprotected, "
+                "%'llu given up on\n",
+                n_smc_protected, n_smc_unprotected, n_smc_given_up);
+   VG_(message)(Vg_DebugMsg,
+                " smcprotect: %'llu write faults, %'llu syscall writes\n",
+                n_smc_faults, n_smc_syscall);
+}
+
+/*--------------------------------------------------------------------*/
+/*--- end                                           m_smcprotect.c ---*/
+/*--------------------------------------------------------------------*/
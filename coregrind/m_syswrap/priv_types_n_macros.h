@@ -33,6 +33,7 @@
 #define __PRIV_TYPES_N_MACROS_H
 
 #include "pub_core_basics.h"    // Addr
+#include "pub_core_smcprotect.h" // VG_(smc_pre_syscall_write)
 
 /* requires #include "pub_core_options.h" */
 /* requires #include "pub_core_signals.h" */
@@ -614,7 +615,11 @@ static inline UWord getERR ( SyscallStatus* st ) {
    VG_TRACK( pre_mem_read_asciiz, Vg_CoreSysCall, tid, zzname, zzaddr)
 
 #define PRE_MEM_WRITE(zzname, zzaddr, zzlen) \
-   VG_TRACK( pre_mem_write, Vg_CoreSysCall, tid, zzname, zzaddr, zzlen)
+   do { \
+      if (VG_(clo_smc_check) == Vg_SmcProtect) \
+         VG_(smc_pre_syscall_write)(zzaddr, zzlen); \
+      VG_TRACK( pre_mem_write, Vg_CoreSysCall, tid, zzname, zzaddr, zzlen); \
+   } while (0)
 
 #define POST_MEM_WRITE(zzaddr, zzlen) \
    VG_TRACK( post_mem_write, Vg_CoreSysCall, tid, zzaddr, zzlen)
@@ -429,44 +429,32 @@ void VG_(main_thread_wrapper_NORETURN)(ThreadId tid)
    vg_assert(0);
 }
 
-/* Clone a new thread. Note that in the clone syscalls, we hard-code
-   tlsaddr argument as NULL : the guest TLS is emulated via guest
-   registers, and Valgrind itself has no thread local storage. */
+/* Clone a new thread, which starts by calling FN(ARG) on STACK. Note
+   that in the clone syscalls, we hard-code tlsaddr argument as NULL :
+   the guest TLS is emulated via guest registers, and Valgrind itself
+   has no thread local storage. */
 static SysRes clone_new_thread ( Word (*fn)(void *), 
                                  void* stack, 
                                  Word  flags, 
-                                 ThreadState* ctst,
+                                 void* arg,
                                  Int* child_tidptr, 
                                  Int* parent_tidptr)
 {
    SysRes res;
-   /* Note that in all the below, we make sys_clone appear to have returned
-      Success(0) in the child, by assigning the relevant child guest
-      register(s) just before the clone syscall. */
 #if defined(VGP_x86_linux)
    Int          eax;
-   ctst->arch.vex.guest_EAX = 0;
    eax = do_syscall_clone_x86_linux
-      (ML_(start_thread_NORETURN), stack, flags, ctst,
-       child_tidptr, parent_tidptr, NULL);
+      (fn, stack, flags, arg, child_tidptr, parent_tidptr, NULL);
    res = VG_(mk_SysRes_x86_linux)( eax );
 #elif defined(VGP_amd64_linux)
    Long         rax;
-   ctst->arch.vex.guest_RAX = 0;
    rax = do_syscall_clone_amd64_linux
-      (ML_(start_thread_NORETURN), stack, flags, ctst,
-       child_tidptr, parent_tidptr, NULL);
+      (fn, stack, flags, arg, child_tidptr, parent_tidptr, NULL);
    res = VG_(mk_SysRes_amd64_linux)( rax );
 #elif defined(VGP_ppc32_linux)
    ULong        word64;
-   UInt old_cr = LibVEX_GuestPPC32_get_CR( &ctst->arch.vex );
-   /* %r3 = 0 */
-   ctst->arch.vex.guest_GPR3 = 0;
-   /* %cr0.so = 0 */
-   LibVEX_GuestPPC32_put_CR( old_cr & ~(1<<28), &ctst->arch.vex );
    word64 = do_syscall_clone_ppc32_linux
-      (ML_(start_thread_NORETURN), stack, flags, ctst,
-       child_tidptr, parent_tidptr, NULL);
+      (fn, stack, flags, arg, child_tidptr, parent_tidptr, NULL);
    /* High half word64 is syscall return value.  Low half is
       the entire CR, from which we need to extract CR0.SO. */
    /* VG_(printf)("word64 = 0x%llx\n", word64); */
@@ -474,14 +462,8 @@ static SysRes clone_new_thread ( Word (*fn)(void *),
                                     /*errflag*/ (((UInt)word64) >> 28) & 1);
 #elif defined(VGP_ppc64be_linux) || defined(VGP_ppc64le_linux)
    ULong        word64;
-   UInt old_cr = LibVEX_GuestPPC64_get_CR( &ctst->arch.vex );
-   /* %r3 = 0 */
-   ctst->arch.vex.guest_GPR3 = 0;
-   /* %cr0.so = 0 */
-   LibVEX_GuestPPC64_put_CR( old_cr & ~(1<<28), &ctst->arch.vex );
    word64 = do_syscall_clone_ppc64_linux
-      (ML_(start_thread_NORETURN), stack, flags, ctst,
-       child_tidptr, parent_tidptr, NULL);
+      (fn, stack, flags, arg, child_tidptr, parent_tidptr, NULL);
    /* Low half word64 is syscall return value.  Hi half is
       the entire CR, from which we need to extract CR0.SO. */
    /* VG_(printf)("word64 = 0x%llx\n", word64); */
@@ -490,50 +472,35 @@ static SysRes clone_new_thread ( Word (*fn)(void *),
        /*errflag*/ (UInt)((word64 >> (32+28)) & 1));
 #elif defined(VGP_s390x_linux)
    ULong        r2;
-   ctst->arch.vex.guest_r2 = 0;
    r2 = do_syscall_clone_s390x_linux
-      (stack, flags, parent_tidptr, child_tidptr, NULL,
-       ML_(start_thread_NORETURN), ctst);
+      (stack, flags, parent_tidptr, child_tidptr, NULL, fn, arg);
    res = VG_(mk_SysRes_s390x_linux)( r2 );
 #elif defined(VGP_arm64_linux)
    ULong        x0;
-   ctst->arch.vex.guest_X0 = 0;
    x0 = do_syscall_clone_arm64_linux
-      (ML_(start_thread_NORETURN), stack, flags, ctst,
-       child_tidptr, parent_tidptr, NULL);
+      (fn, stack, flags, arg, child_tidptr, parent_tidptr, NULL);
    res = VG_(mk_SysRes_arm64_linux)( x0 );
 #elif defined(VGP_arm_linux)
    UInt r0;
-   ctst->arch.vex.guest_R0 = 0;
    r0 = do_syscall_clone_arm_linux
-      (ML_(start_thread_NORETURN), stack, flags, ctst,
-       child_tidptr, parent_tidptr, NULL);
+      (fn, stack, flags, arg, child_tidptr, parent_tidptr, NULL);
    res = VG_(mk_SysRes_arm_linux)( r0 );
 #elif defined(VGP_mips64_linux)
    UInt ret = 0;
-   ctst->arch.vex.guest_r2 = 0;
-   ctst->arch.vex.guest_r7 = 0;
    ret = do_syscall_clone_mips64_linux
-      (ML_(start_thread_NORETURN), stack, flags, ctst,
-       parent_tidptr, NULL, child_tidptr);
+      (fn, stack, flags, arg, parent_tidptr, NULL, child_tidptr);
    res = VG_(mk_SysRes_mips64_linux)( /* val */ ret, 0, /* errflag */ 0);
 #elif defined(VGP_mips32_linux)
    UInt ret = 0;
-   ctst->arch.vex.guest_r2 = 0;
-   ctst->arch.vex.guest_r7 = 0;
    ret = do_syscall_clone_mips_linux
-      (ML_(start_thread_NORETURN), stack, flags, ctst,
-       child_tidptr, parent_tidptr, NULL);
+      (fn, stack, flags, arg, child_tidptr, parent_tidptr, NULL);
    /* High half word64 is syscall return value.  Low half is
       the entire CR, from which we need to extract CR0.SO. */ 
    res = VG_ (mk_SysRes_mips32_linux) (/*val */ ret, 0, /*errflag */ 0);
 #elif defined(VGP_tilegx_linux)
    Long ret = 0;
-   ctst->arch.vex.guest_r0 = 0;
-   ctst->arch.vex.guest_r3 = 0;
    ret = do_syscall_clone_tilegx_linux
-      (ML_ (start_thread_NORETURN), stack, flags, ctst,
-       child_tidptr, parent_tidptr, NULL);
+      (fn, stack, flags, arg, child_tidptr, parent_tidptr, NULL);
    /* High half word64 is syscall return value. */
    res = VG_(mk_SysRes_tilegx_linux) (/*val */ ret);
 #else
@@ -542,6 +509,44 @@ static SysRes clone_new_thread ( Word (*fn)(void *),
    return res;
 }
 
+/* Make sys_clone appear to have returned Success(0) in the child
+   thread CTST, by assigning the relevant child guest register(s)
+   before the clone syscall. */
+static void setup_child_retval ( ThreadState* ctst )
+{
+#if defined(VGP_x86_linux)
+   ctst->arch.vex.guest_EAX = 0;
+#elif defined(VGP_amd64_linux)
+   ctst->arch.vex.guest_RAX = 0;
+#elif defined(VGP_ppc32_linux)
+   UInt old_cr = LibVEX_GuestPPC32_get_CR( &ctst->arch.vex );
+   /* %r3 = 0 */
+   ctst->arch.vex.guest_GPR3 = 0;
+   /* %cr0.so = 0 */
+   LibVEX_GuestPPC32_put_CR( old_cr & ~(1<<28), &ctst->arch.vex );
+#elif defined(VGP_ppc64be_linux) || defined(VGP_ppc64le_linux)
+   UInt old_cr = LibVEX_GuestPPC64_get_CR( &ctst->arch.vex );
+   /* %r3 = 0 */
+   ctst->arch.vex.guest_GPR3 = 0;
+   /* %cr0.so = 0 */
+   LibVEX_GuestPPC64_put_CR( old_cr & ~(1<<28), &ctst->arch.vex );
+#elif defined(VGP_s390x_linux)
+   ctst->arch.vex.guest_r2 = 0;
+#elif defined(VGP_arm64_linux)
+   ctst->arch.vex.guest_X0 = 0;
+#elif defined(VGP_arm_linux)
+   ctst->arch.vex.guest_R0 = 0;
+#elif defined(VGP_mips64_linux) || defined(VGP_mips32_linux)
+   ctst->arch.vex.guest_r2 = 0;
+   ctst->arch.vex.guest_r7 = 0;
+#elif defined(VGP_tilegx_linux)
+   ctst->arch.vex.guest_r0 = 0;
+   ctst->arch.vex.guest_r3 = 0;
+#else
+# error Unknown platform
+#endif
+}
+
 static void setup_child ( /*OUT*/ ThreadArchState *child, 
                           /*IN*/  ThreadArchState *parent )
 {  
@@ -697,6 +702,7 @@ static SysRes do_clone ( ThreadId ptid,
    VG_(sigprocmask)(VKI_SIG_SETMASK, &blockall, &savedmask);
 
    /* Create the new thread */
+   setup_child_retval ( ctst );
    res = clone_new_thread ( ML_(start_thread_NORETURN), stack, flags, ctst,
                             child_tidptr, parent_tidptr);
 
@@ -719,6 +725,33 @@ static SysRes do_clone ( ThreadId ptid,
    return res;
 }
 
+/* Start a thread of Valgrind's own, which the client never sees: it
+   has no ThreadId and runs FN(ARG) on a fresh VgStack with all
+   signals blocked.  FN must take the_BigLock (with
+   VG_(acquire_BigLock_LL)) before touching any shared state. */
+Bool VG_(start_helper_thread) ( Word (*fn)(void *), void* arg )
+{
+   VgStack*     stack;
+   Addr         initial_SP;
+   SysRes       res;
+   vki_sigset_t blockall, savedmask;
+
+   stack = VG_(am_alloc_VgStack)( &initial_SP );
+   if (stack == NULL)
+      return False;
+
+   VG_(sigfillset)(&blockall);
+   VG_(sigprocmask)(VKI_SIG_SETMASK, &blockall, &savedmask);
+   res = clone_new_thread ( fn, (void*)initial_SP,
+                            VKI_CLONE_VM | VKI_CLONE_FS | VKI_CLONE_FILES
+                            | VKI_CLONE_SIGHAND | VKI_CLONE_THREAD
+                            | VKI_CLONE_SYSVSEM,
+                            arg, NULL, NULL );
+   VG_(sigprocmask)(VKI_SIG_SETMASK, &savedmask, NULL);
+
+   return !sr_isError(res);
+}
+
 /* Do a clone which is really a fork().
    ML_(do_fork_clone) uses the clone syscall to fork a child process.
    Note that this should not be called for a thread creation.
@@ -51,6 +51,7 @@
 #include "pub_core_mallocfree.h"
 #include "pub_core_syswrap.h"
 #include "pub_core_gdbserver.h"     // VG_(gdbserver_report_syscall)
+#include "pub_core_transahead.h"    // VG_(transahead_kick)
 
 #include "priv_types_n_macros.h"
 #include "priv_syswrap-main.h"
@@ -1996,7 +1997,9 @@ void VG_(client_syscall) ( ThreadId tid, UInt trc )
             do_syscall_for_client() directly modifies the guest state. */
          vg_assert(!(sci->flags & SfNoWriteResult));
 
-         /* Drop the bigLock */
+         /* Drop the bigLock, letting the translate-ahead helper have
+            it if it has work to do. */
+         VG_(transahead_kick)();
          VG_(release_BigLock)(tid, VgTs_WaitSys, "VG_(client_syscall)[async]");
          /* Urr.  We're now in a race against other threads trying to
             acquire the bigLock.  I guess that doesn't matter provided
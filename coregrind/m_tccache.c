@@ -0,0 +1,657 @@
+
+/*--------------------------------------------------------------------*/
+/*--- Persistent translation cache.                    m_tccache.c ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Valgrind, a dynamic binary instrumentation
+   framework.
+
+   Copyright (C) 2015-2015 The Valgrind developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#include "pub_core_basics.h"
+#include "pub_core_vki.h"
+#include "pub_core_aspacemgr.h"
+#include "pub_core_clientstate.h"   // VG_(args_for_valgrind)
+#include "pub_core_debuginfo.h"
+#include "pub_core_dispatch.h"      // VG_(disp_cp_*)
+#include "pub_core_gdbserver.h"
+#include "pub_core_libcbase.h"
+#include "pub_core_libcassert.h"
+#include "pub_core_libcfile.h"
+#include "pub_core_libcprint.h"
+#include "pub_core_libcproc.h"      // VG_(getpid)
+#include "pub_core_machine.h"
+#include "pub_core_mallocfree.h"
+#include "pub_core_options.h"
+#include "pub_core_redir.h"         // VG_(redir_do_lookup)
+#include "pub_core_tooliface.h"
+#include "pub_core_transtab.h"
+#include "pub_core_xarray.h"
+#include "pub_core_tccache.h"       // self
+
+
+/*====================================================================*/
+/*=== Overview                                                     ===*/
+/*====================================================================*/
+
+/* With --tc-cache-dir=<dir>, the host code of the translations made
+   from the text of each ELF object is written to <dir> at exit, one
+   file per object.  When the same object is loaded in a later run,
+   its translations are put straight back into the TC, which avoids
+   translating and instrumenting that code again.  For short runs of
+   programs using big libraries that is most of the total cost.
+
+   Host code can only be reused if everything baked into it is the
+   same in the later run:
+
+   * guest addresses.  Hence the object must be loaded at the same
+     address.  Valgrind places client mappings deterministically, so
+     that is the normal case.  There is no relocation of saved code.
+
+   * addresses of helper functions and of the dispatcher in the tool
+     executable, and the CPU features assumed by the code generator.
+
+   * the outcome of every option that affects instrumentation.
+
+   Hence each cache file name contains the object's build-id and text
+   load address, the tool name, and a hash (see compute_key) of the
+   Valgrind version, the host hwcaps, a few code addresses in the
+   tool executable and the complete list of Valgrind and tool
+   options.  Objects without a build-id are not cached.
+
+   Chained jumps point at other translations, so before saving, all
+   chaining is undone (VG_(unchain_all_translations)).  After loading,
+   translations get chained lazily by VG_(tt_tc_do_chaining), in the
+   same way as fresh ones.
+
+   Each saved translation also carries a checksum of the guest bytes
+   it was made from, and this is checked before the translation is
+   loaded.
+
+   Only tools which declare VG_(needs_persistent_translations) can
+   use the cache, since some instrumentation embeds values that are
+   only meaningful in one run (eg. Memcheck's origin tags).
+
+   File layout, all in host byte order:
+
+      TCCFileHeader
+      n_entries times:
+         TCCEntryHeader
+         host code, padded to a multiple of 8 bytes
+*/
+
+
+/*====================================================================*/
+/*=== File format                                                  ===*/
+/*====================================================================*/
+
+#define TCC_MAGIC "VGTCC001"
+
+typedef
+   struct {
+      HChar magic[8];   /* TCC_MAGIC, without the terminating zero */
+      ULong key;        /* compute_key() of the run that wrote it */
+      Addr  text_avma;  /* the object's text, as seen by that run */
+      UWord text_size;
+      UInt  n_entries;
+      UInt  unused;
+   }
+   TCCFileHeader;
+
+typedef
+   struct {
+      VexGuestExtents vge; /* the entry point is vge.base[0] */
+      UInt  hcode_len;
+      UInt  n_guest_instrs;
+      ULong guest_sum;     /* guest_code_sum(&vge) */
+   }
+   TCCEntryHeader;
+
+/* Translations are never bigger than this; see N_TMPBUF in
+   m_translate.c. */
+#define TCC_MAX_HCODE_LEN 60000
+
+
+/*====================================================================*/
+/*=== State and stats                                              ===*/
+/*====================================================================*/
+
+static Bool  tcc_enabled = False;
+static ULong tcc_key     = 0;
+
+static ULong n_files_loaded  = 0;
+static ULong n_tt_loaded     = 0;
+static ULong n_tt_stale      = 0;
+static ULong n_files_saved   = 0;
+static ULong n_tt_saved      = 0;
+static ULong n_bytes_saved   = 0;
+
+
+/*====================================================================*/
+/*=== Hashing                                                      ===*/
+/*====================================================================*/
+
+/* 64-bit FNV-1a. */
+#define FNV1A_INIT 0xcbf29ce484222325ULL
+
+static ULong fnv1a ( ULong h, const void* p, SizeT n )
+{
+   const UChar* b = p;
+   SizeT i;
+   for (i = 0; i < n; i++) {
+      h ^= b[i];
+      h *= 0x100000001b3ULL;
+   }
+   return h;
+}
+
+/* Including the terminating zero, so that consecutive strings can't
+   run together. */
+static ULong fnv1a_str ( ULong h, const HChar* s )
+{
+   return fnv1a(h, s, VG_(strlen)(s) + 1);
+}
+
+static ULong compute_key ( void )
+{
+   ULong h = FNV1A_INIT;
+   Word  i;
+
+   h = fnv1a_str(h, VERSION);
+   h = fnv1a_str(h, VG_(clo_toolname));
+
+   VexArch     arch;
+   VexArchInfo archinfo;
+   VG_(bzero_inline)(&archinfo, sizeof(archinfo));
+   VG_(machine_get_VexArchInfo)( &arch, &archinfo );
+   h = fnv1a(h, &arch, sizeof(arch));
+   h = fnv1a(h, &archinfo.hwcaps, sizeof(archinfo.hwcaps));
+
+   /* Host code refers to these directly.  Checking them catches a
+      rebuilt Valgrind or tool which still has the same version
+      string. */
+   Addr anchors[6];
+   anchors[0] = (Addr)&VG_(disp_cp_chain_me_to_slowEP);
+   anchors[1] = (Addr)&VG_(disp_cp_chain_me_to_fastEP);
+   anchors[2] = (Addr)&VG_(disp_cp_xindir);
+   anchors[3] = (Addr)&VG_(disp_cp_xassisted);
+   anchors[4] = (Addr)&VG_(disp_cp_evcheck_fail);
+   anchors[5] = (Addr)VG_(tdict).tool_instrument;
+   h = fnv1a(h, anchors, sizeof(anchors));
+
+   /* All options, whether they affect code generation or not.  That
+      is conservative, but anything finer grained would need every
+      tool to say which of its options matter. */
+   for (i = 0; i < VG_(sizeXA)(VG_(args_for_valgrind)); i++) {
+      const HChar* arg = *(HChar**)VG_(indexXA)(VG_(args_for_valgrind), i);
+      h = fnv1a_str(h, arg);
+   }
+
+   return h;
+}
+
+/* Are all the guest bytes covered by vge readable? */
+static Bool guest_code_ok ( const VexGuestExtents* vge )
+{
+   UInt i;
+   for (i = 0; i < vge->n_used; i++) {
+      if (vge->len[i] == 0)
+         continue;
+      if (!VG_(am_is_valid_for_client)(vge->base[i], vge->len[i],
+                                       VKI_PROT_READ))
+         return False;
+   }
+   return True;
+}
+
+static ULong guest_code_sum ( const VexGuestExtents* vge )
+{
+   ULong h = FNV1A_INIT;
+   UInt  i;
+   for (i = 0; i < vge->n_used; i++)
+      h = fnv1a(h, (const void*)vge->base[i], vge->len[i]);
+   return h;
+}
+
+/* Is every extent of vge inside [avma, avma+size) ? */
+static Bool vge_inside ( const VexGuestExtents* vge, Addr avma, UWord size )
+{
+   UInt i;
+   for (i = 0; i < vge->n_used; i++) {
+      if (vge->base[i] < avma
+          || vge->base[i] + vge->len[i] > avma + size)
+         return False;
+   }
+   return True;
+}
+
+
+/*====================================================================*/
+/*=== Setup                                                        ===*/
+/*====================================================================*/
+
+void VG_(tccache_init) ( void )
+{
+   vg_assert(!tcc_enabled);
+
+   if (VG_(clo_tc_cache_dir) == NULL)
+      return;
+
+   if (!VG_(needs).persistent_translations) {
+      VG_(message)(Vg_UserMsg,
+                   "Warning: --tc-cache-dir is not supported by this tool"
+                   " (or with these tool options); ignored\n");
+      return;
+   }
+   /* Profiling, tiered translation and --hot-blocks-file patch the
+      address of a per-translation counter into the code. */
+   if (VG_(clo_profyle_sbs) || VG_(clo_tier2_threshold) > 0
+       || VG_(clo_hot_blocks_file) != NULL) {
+      VG_(message)(Vg_UserMsg,
+                   "Warning: --tc-cache-dir is ignored when profiling"
+                   " superblocks, or with --tier2-threshold or"
+                   " --hot-blocks-file\n");
+      return;
+   }
+   /* Every translation would need gdbserver instrumentation, which
+      saved translations might lack. */
+   if (VG_(clo_vgdb) == Vg_VgdbFull) {
+      VG_(message)(Vg_UserMsg,
+                   "Warning: --tc-cache-dir is ignored with --vgdb=full\n");
+      return;
+   }
+   if (!VG_(is_dir)(VG_(clo_tc_cache_dir))) {
+      VG_(message)(Vg_UserMsg,
+                   "Warning: --tc-cache-dir=%s is not a directory; ignored\n",
+                   VG_(clo_tc_cache_dir));
+      return;
+   }
+
+   tcc_key     = compute_key();
+   tcc_enabled = True;
+
+   if (VG_(clo_verbosity) > 1)
+      VG_(message)(Vg_DebugMsg, "tc-cache: using %s, key %016llx\n",
+                   VG_(clo_tc_cache_dir), tcc_key);
+}
+
+/* Returns the name of the cache file for di in malloc'd storage, or
+   NULL if di can't be cached. */
+static HChar* cache_file_name ( const DebugInfo* di )
+{
+   const HChar* buildid = VG_(DebugInfo_get_buildid)(di);
+
+   if (buildid == NULL || VG_(DebugInfo_get_text_size)(di) == 0)
+      return NULL;
+
+   HChar* name = VG_(malloc)("tccache.cfn.1",
+                             VG_(strlen)(VG_(clo_tc_cache_dir))
+                             + VG_(strlen)(buildid)
+                             + VG_(strlen)(VG_(clo_toolname))
+                             + 64);
+   VG_(sprintf)(name, "%s/%s-%lx-%s-%016llx.tcc",
+                VG_(clo_tc_cache_dir), buildid,
+                VG_(DebugInfo_get_text_avma)(di),
+                VG_(clo_toolname), tcc_key);
+   return name;
+}
+
+
+/*====================================================================*/
+/*=== Loading                                                      ===*/
+/*====================================================================*/
+
+void VG_(tccache_load_for_DebugInfo) ( const DebugInfo* di )
+{
+   Int    fd;
+   Long   size;
+   UChar* buf = NULL;
+   UInt   i, n_loaded = 0, n_stale = 0;
+
+   if (!tcc_enabled)
+      return;
+
+   HChar* name = cache_file_name(di);
+   if (name == NULL)
+      return;
+
+   SysRes sres = VG_(open)(name, VKI_O_RDONLY, 0);
+   if (sr_isError(sres)) {
+      VG_(free)(name);
+      return;
+   }
+   fd = sr_Res(sres);
+
+   size = VG_(fsize)(fd);
+   if (size < (Long)sizeof(TCCFileHeader) || size > 0x7FFFFFFFLL)
+      goto out;
+   buf = VG_(malloc)("tccache.load.1", size);
+   if (VG_(read)(fd, buf, (Int)size) != (Int)size)
+      goto out;
+
+   const TCCFileHeader* fh = (const TCCFileHeader*)buf;
+   Addr  text_avma = VG_(DebugInfo_get_text_avma)(di);
+   UWord text_size = VG_(DebugInfo_get_text_size)(di);
+   if (VG_(memcmp)(fh->magic, TCC_MAGIC, sizeof(fh->magic)) != 0
+       || fh->key != tcc_key
+       || fh->text_avma != text_avma
+       || fh->text_size != text_size)
+      goto out;
+
+   Long off = sizeof(TCCFileHeader);
+   for (i = 0; i < fh->n_entries; i++) {
+      TCCEntryHeader eh;
+      if (off + (Long)sizeof(eh) > size)
+         break;
+      /* Copy, since the file buffer need not be suitably aligned. */
+      VG_(memcpy)(&eh, buf + off, sizeof(eh));
+      off += sizeof(eh);
+      if (eh.hcode_len == 0 || eh.hcode_len >= TCC_MAX_HCODE_LEN
+          || off + (Long)eh.hcode_len > size
+          || eh.vge.n_used < 1 || eh.vge.n_used > 3
+          || eh.n_guest_instrs >= 200)
+         break; /* corrupt file; don't trust the rest of it either */
+      const UChar* hcode = buf + off;
+      off += VG_ROUNDUP(eh.hcode_len, 8);
+
+      Addr entry = eh.vge.base[0];
+      if (!vge_inside(&eh.vge, text_avma, text_size))
+         break;
+      if (!guest_code_ok(&eh.vge)
+          || guest_code_sum(&eh.vge) != eh.guest_sum) {
+         n_stale++;
+         continue;
+      }
+      /* Already translated, or redirected elsewhere in this run. */
+      if (VG_(search_transtab)(NULL, NULL, NULL, entry, False))
+         continue;
+      if (VG_(redir_do_lookup)(entry, NULL) != entry)
+         continue;
+
+      UInt e;
+      for (e = 0; e < eh.vge.n_used; e++)
+         VG_(am_set_segment_hasT)( eh.vge.base[e] );
+      VG_(add_to_transtab)( &eh.vge, entry, (Addr)hcode, eh.hcode_len,
+                            False/*is_self_checking*/,
+                            -1/*offs_profInc*/, eh.n_guest_instrs,
+                            0/*tier*/ );
+      n_loaded++;
+   }
+
+   n_files_loaded++;
+   n_tt_loaded += n_loaded;
+   n_tt_stale  += n_stale;
+   if (VG_(clo_verbosity) > 1)
+      VG_(message)(Vg_DebugMsg,
+                   "tc-cache: loaded %u translations (%u stale) for %s\n",
+                   n_loaded, n_stale, VG_(DebugInfo_get_filename)(di));
+
+  out:
+   if (buf)
+      VG_(free)(buf);
+   VG_(close)(fd);
+   VG_(free)(name);
+}
+
+
+/*====================================================================*/
+/*=== Saving                                                       ===*/
+/*====================================================================*/
+
+typedef
+   struct {
+      const DebugInfo* di;
+      UWord            seqno;  /* to keep the TC order within a di */
+      VexGuestExtents  vge;
+      const UChar*     hcode;
+      UInt             hcode_len;
+      UInt             n_guest_instrs;
+   }
+   SaveItem;
+
+typedef
+   struct {
+      XArray*          items;  /* of SaveItem */
+      const DebugInfo* last_di;
+   }
+   SaveState;
+
+static Int cmp_SaveItem ( const void* v1, const void* v2 )
+{
+   const SaveItem* i1 = v1;
+   const SaveItem* i2 = v2;
+   if (i1->di < i2->di) return -1;
+   if (i1->di > i2->di) return 1;
+   if (i1->seqno < i2->seqno) return -1;
+   if (i1->seqno > i2->seqno) return 1;
+   return 0;
+}
+
+static void collect_one ( void* opaque, const VexGuestExtents* vge,
+                          Addr entry, const UChar* hcode, UInt hcode_len,
+                          UInt n_guest_instrs )
+{
+   SaveState*       st = opaque;
+   const DebugInfo* di = st->last_di;
+
+   /* Translations of redirected addresses are for the redirection
+      target; they are not cached. */
+   if (entry != vge->base[0])
+      return;
+
+   /* Translations are made in bursts from the same object, so
+      checking the previous one first saves most of the lookups. */
+   if (di == NULL
+       || !vge_inside(vge, VG_(DebugInfo_get_text_avma)(di),
+                           VG_(DebugInfo_get_text_size)(di))) {
+      di = VG_(find_DebugInfo)(entry);
+      if (di == NULL)
+         return;
+      st->last_di = di;
+   }
+
+   if (VG_(DebugInfo_get_buildid)(di) == NULL
+       || !vge_inside(vge, VG_(DebugInfo_get_text_avma)(di),
+                           VG_(DebugInfo_get_text_size)(di))
+       || !guest_code_ok(vge))
+      return;
+
+   SaveItem it;
+   it.di             = di;
+   it.seqno          = VG_(sizeXA)(st->items);
+   it.vge            = *vge;
+   it.hcode          = hcode;
+   it.hcode_len      = hcode_len;
+   it.n_guest_instrs = n_guest_instrs;
+   VG_(addToXA)(st->items, &it);
+}
+
+/* A minimal buffered writer, so as to avoid a syscall for each of the
+   many small pieces written. */
+typedef
+   struct {
+      Int   fd;
+      Bool  failed;
+      UInt  used;
+      UChar buf[65536];
+   }
+   TCCWriter;
+
+static void w_flush ( TCCWriter* w )
+{
+   if (w->used > 0 && !w->failed
+       && VG_(write)(w->fd, w->buf, w->used) != (Int)w->used)
+      w->failed = True;
+   w->used = 0;
+}
+
+static void w_bytes ( TCCWriter* w, const void* p, UInt n )
+{
+   const UChar* b = p;
+   while (n > 0) {
+      UInt chunk = sizeof(w->buf) - w->used;
+      if (chunk > n)
+         chunk = n;
+      VG_(memcpy)(&w->buf[w->used], b, chunk);
+      w->used += chunk;
+      b += chunk;
+      n -= chunk;
+      if (w->used == sizeof(w->buf))
+         w_flush(w);
+   }
+}
+
+static TCCWriter writer;
+
+static void save_for_DebugInfo ( const DebugInfo* di,
+                                 const SaveItem* items, UInt n_items )
+{
+   static const UChar zeroes[8] = { 0 };
+   UInt i;
+
+   HChar* name = cache_file_name(di);
+   vg_assert(name);
+   HChar* tmpname = VG_(malloc)("tccache.sfd.1", VG_(strlen)(name) + 32);
+   VG_(sprintf)(tmpname, "%s.tmp.%d", name, VG_(getpid)());
+
+   SysRes sres = VG_(open)(tmpname, VKI_O_CREAT|VKI_O_WRONLY|VKI_O_TRUNC,
+                           VKI_S_IRUSR|VKI_S_IWUSR);
+   if (sr_isError(sres)) {
+      if (VG_(clo_verbosity) > 1)
+         VG_(message)(Vg_DebugMsg, "tc-cache: can't create %s\n", tmpname);
+      goto out;
+   }
+
+   writer.fd     = sr_Res(sres);
+   writer.failed = False;
+   writer.used   = 0;
+
+   TCCFileHeader fh;
+   VG_(memset)(&fh, 0, sizeof(fh));
+   VG_(memcpy)(fh.magic, TCC_MAGIC, sizeof(fh.magic));
+   fh.key       = tcc_key;
+   fh.text_avma = VG_(DebugInfo_get_text_avma)(di);
+   fh.text_size = VG_(DebugInfo_get_text_size)(di);
+   fh.n_entries = n_items;
+   w_bytes(&writer, &fh, sizeof(fh));
+
+   ULong n_bytes = sizeof(fh);
+   for (i = 0; i < n_items; i++) {
+      TCCEntryHeader eh;
+      VG_(memset)(&eh, 0, sizeof(eh));
+      eh.vge            = items[i].vge;
+      eh.hcode_len      = items[i].hcode_len;
+      eh.n_guest_instrs = items[i].n_guest_instrs;
+      eh.guest_sum      = guest_code_sum(&items[i].vge);
+      w_bytes(&writer, &eh, sizeof(eh));
+      w_bytes(&writer, items[i].hcode, items[i].hcode_len);
+      w_bytes(&writer, zeroes,
+              VG_ROUNDUP(items[i].hcode_len, 8) - items[i].hcode_len);
+      n_bytes += sizeof(eh) + VG_ROUNDUP(items[i].hcode_len, 8);
+   }
+   w_flush(&writer);
+   VG_(close)(writer.fd);
+
+   if (writer.failed || VG_(rename)(tmpname, name) != 0) {
+      if (VG_(clo_verbosity) > 1)
+         VG_(message)(Vg_DebugMsg, "tc-cache: can't write %s\n", name);
+      VG_(unlink)(tmpname);
+      goto out;
+   }
+
+   n_files_saved++;
+   n_tt_saved    += n_items;
+   n_bytes_saved += n_bytes;
+
+  out:
+   VG_(free)(tmpname);
+   VG_(free)(name);
+}
+
+void VG_(tccache_save) ( void )
+{
+   Word i, j, n;
+
+   if (!tcc_enabled)
+      return;
+
+   /* Translations made while gdbserver was active may contain calls
+      to it. */
+   if (VG_(gdbserver_was_called)()) {
+      if (VG_(clo_verbosity) > 1)
+         VG_(message)(Vg_DebugMsg,
+                      "tc-cache: gdbserver was used; not saving\n");
+      return;
+   }
+
+   VG_(unchain_all_translations)();
+
+   SaveState st;
+   st.items   = VG_(newXA)(VG_(malloc), "tccache.save.1", VG_(free),
+                           sizeof(SaveItem));
+   st.last_di = NULL;
+   VG_(visit_translations)(collect_one, &st);
+
+   VG_(setCmpFnXA)(st.items, cmp_SaveItem);
+   VG_(sortXA)(st.items);
+
+   n = VG_(sizeXA)(st.items);
+   for (i = 0; i < n; i = j) {
+      const SaveItem* first = VG_(indexXA)(st.items, i);
+      for (j = i + 1; j < n; j++) {
+         const SaveItem* it = VG_(indexXA)(st.items, j);
+         if (it->di != first->di)
+            break;
+      }
+      save_for_DebugInfo(first->di, first, (UInt)(j - i));
+   }
+
+   VG_(deleteXA)(st.items);
+
+   if (VG_(clo_verbosity) > 1)
+      VG_(message)(Vg_DebugMsg,
+                   "tc-cache: saved %'llu translations to %'llu files\n",
+                   n_tt_saved, n_files_saved);
+}
+
+
+/*====================================================================*/
+/*=== Stats                                                        ===*/
+/*====================================================================*/
+
+void VG_(print_tccache_stats) ( void )
+{
+   if (!tcc_enabled)
+      return;
+   VG_(message)(Vg_DebugMsg,
+                " tc-cache: loaded     %'llu from %'llu files "
+                "(%'llu stale)\n",
+                n_tt_loaded, n_files_loaded, n_tt_stale);
+   VG_(message)(Vg_DebugMsg,
+                " tc-cache: saved      %'llu to %'llu files "
+                "(%'llu bytes)\n",
+                n_tt_saved, n_files_saved, n_bytes_saved);
+}
+
+/*--------------------------------------------------------------------*/
+/*--- end                                              m_tccache.c ---*/
+/*--------------------------------------------------------------------*/
@@ -0,0 +1,400 @@
+/*--------------------------------------------------------------------*/
+/*--- Translating ahead of need.                    m_transahead.c ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Valgrind, a dynamic binary instrumentation
+   framework.
+
+   Copyright (C) 2015-2015 The Valgrind developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#include "pub_core_basics.h"
+#include "pub_core_vki.h"
+#include "pub_core_aspacemgr.h"     // VG_(am_find_nsegment)
+#include "pub_core_libcbase.h"
+#include "pub_core_libcassert.h"
+#include "pub_core_libcfile.h"
+#include "pub_core_libcprint.h"
+#include "pub_core_libcproc.h"      // VG_(atfork)
+#include "pub_core_options.h"
+#include "pub_core_redir.h"         // VG_(redir_do_lookup)
+#include "pub_core_scheduler.h"     // VG_(acquire_BigLock_LL)
+#include "pub_core_syswrap.h"       // VG_(start_helper_thread)
+#include "pub_core_threadstate.h"
+#include "pub_core_tooliface.h"
+#include "pub_core_translate.h"     // VG_(translate_ahead)
+#include "pub_core_transtab.h"
+#include "pub_core_transahead.h"    // self
+
+
+/*====================================================================*/
+/*=== Overview                                                     ===*/
+/*====================================================================*/
+
+/* Translation is done by the client thread which needs the code, and
+   everything involved -- VEX, the tool's instrumentation function,
+   the TT/TC -- relies on the_BigLock being held.  So translations
+   cannot be made in parallel with running client code.  They can,
+   however, be made while all client threads are blocked in syscalls
+   and nobody is waiting for the_BigLock, which would otherwise be
+   idle.  Programs which do a lot of startup I/O spend much of their
+   time like that.
+
+   With --translate-ahead=yes, VG_(translate) collects the constant
+   targets of the exits of each block it translates, and passes them
+   here.  Those in client file mappings which aren't already
+   translated are put on a queue.  When a client thread is about to
+   drop the_BigLock for a syscall which may block, it wakes the helper
+   thread (through a pipe) if the queue isn't empty.  The helper takes
+   the_BigLock and translates queued blocks, one per acquisition, for
+   as long as every client thread remains in a blocking syscall.  A
+   thread returning from its syscall thus never waits for more than
+   one translation.  Since no client thread can be in a syscall which
+   changes the address space meanwhile (those don't block), the
+   checks made on the client's mappings stay good while the helper
+   translates.  Blocks translated ahead contribute their own
+   successors, up to AHEAD_MAX_DEPTH levels from a block which was
+   actually needed.
+
+   The helper is not a client thread and has no ThreadId.  Each
+   translation is made on behalf of the thread whose block named the
+   successor; VG_(translate_ahead) makes sure that failing to
+   translate it has no effect on that thread.  Since a block
+   translated ahead might never be run, only tools which declare
+   VG_(needs_persistent_translations) -- whose instrumentation has no
+   side effects on tool state -- can use this.
+
+   The helper runs with all signals blocked, and a fault while
+   decoding would kill the process.  So it translates only blocks
+   whose code lies wholly in readable and executable file mappings,
+   backed by a file which is still long enough (see is_safe_to_read),
+   and VEX doesn't chase from them into other blocks.
+
+   The helper is a host thread created with clone, so this is Linux
+   only.  It doesn't survive fork; in the child, translate-ahead is
+   simply turned off. */
+
+
+/*====================================================================*/
+/*=== The queue                                                    ===*/
+/*====================================================================*/
+
+#define N_AHEAD_QUEUE    512
+#define AHEAD_MAX_DEPTH  2
+
+/* No guest instruction is longer than this, on any platform. */
+#define AHEAD_MAX_INSN_SZB  16
+
+typedef
+   struct {
+      Addr     addr;
+      ThreadId tid;      /* on whose behalf to translate it */
+      UInt     depth;    /* 1 for a successor of a block that was run */
+      ULong    bbs_done;
+   }
+   AheadReq;
+
+/* All of this is only accessed while holding the_BigLock. */
+static AheadReq queue[N_AHEAD_QUEUE];
+static UInt     q_first = 0;   /* index of the oldest request */
+static UInt     q_used  = 0;
+
+static Bool ahead_active = False;
+static Int  wake_fd[2]   = { -1, -1 };
+static Bool helper_awake = False;
+
+/* Depth of the block the helper is translating, or 0 if the current
+   translation is a real one. */
+static UInt ahead_depth = 0;
+
+/* Stats */
+static ULong n_ahead_queued     = 0;
+static ULong n_ahead_dropped    = 0;
+static ULong n_ahead_wakeups    = 0;
+static ULong n_ahead_translated = 0;
+static ULong n_ahead_present    = 0;
+static ULong n_ahead_failed     = 0;
+static ULong n_ahead_unsafe     = 0;
+
+/* Is addr worth translating ahead of need? */
+static Bool is_candidate ( Addr addr )
+{
+   NSegment const* seg = VG_(am_find_nsegment)(addr);
+   if (seg == NULL || seg->kind != SkFileC || !seg->hasR || !seg->hasX)
+      return False;
+   return !VG_(search_transtab)(NULL, NULL, NULL, addr, False);
+}
+
+Bool VG_(transahead_active) ( void )
+{
+   return ahead_active;
+}
+
+void VG_(transahead_add_successors) ( ThreadId tid,
+                                      const Addr* succs, UInt n,
+                                      ULong bbs_done )
+{
+   UInt i, depth = ahead_depth + 1;
+
+   if (!ahead_active || depth > AHEAD_MAX_DEPTH)
+      return;
+
+   for (i = 0; i < n; i++) {
+      if (!is_candidate(succs[i]))
+         continue;
+      if (q_used == N_AHEAD_QUEUE) {
+         n_ahead_dropped++;
+         continue;
+      }
+      AheadReq* req = &queue[(q_first + q_used) % N_AHEAD_QUEUE];
+      req->addr     = succs[i];
+      req->tid      = tid;
+      req->depth    = depth;
+      req->bbs_done = bbs_done;
+      q_used++;
+      n_ahead_queued++;
+   }
+}
+
+
+/*====================================================================*/
+/*=== The helper thread                                            ===*/
+/*====================================================================*/
+
+#if defined(VGO_linux)
+/* Is every client thread blocked in a syscall, with nobody waiting
+   for the_BigLock?  A thread back from its syscall stays in
+   VgTs_WaitSys until it has the lock, hence the second check.  Must
+   be called with the_BigLock held. */
+static Bool all_threads_blocked ( void )
+{
+   ThreadId tid;
+   Bool     any = False;
+
+   if (VG_(BigLock_is_wanted)())
+      return False;
+   for (tid = 1; tid < VG_N_THREADS; tid++) {
+      switch (VG_(threads)[tid].status) {
+         case VgTs_Empty:
+         case VgTs_Zombie:
+            break;
+         case VgTs_WaitSys:
+            any = True;
+            break;
+         default:
+            return False;
+      }
+   }
+   return any;
+}
+
+/* Can the code of a block starting at addr be read without a fault?
+   It can't extend beyond the longest block VEX will make, since
+   there's no chasing.  All of that has to be in readable and
+   executable mappings of files which haven't been replaced, or cut
+   short so that some of the mapped pages are beyond their end (which
+   would raise SIGBUS). */
+static Bool is_safe_to_read ( Addr addr )
+{
+   Addr end = addr + VG_(clo_vex_control).guest_max_insns
+                     * AHEAD_MAX_INSN_SZB;
+   Addr a;
+
+   if (end < addr)
+      return False;
+   for (a = addr; a < end; ) {
+      NSegment const* seg = VG_(am_find_nsegment)(a);
+      const HChar*    name;
+      struct vg_stat  st;
+      Addr            last;
+
+      if (seg == NULL || seg->kind != SkFileC || !seg->hasR || !seg->hasX)
+         return False;
+      name = VG_(am_get_filename)(seg);
+      if (name == NULL
+          || sr_isError(VG_(stat)(name, &st))
+          || st.dev != seg->dev || st.ino != seg->ino)
+         return False;
+      last = seg->end < end - 1 ? seg->end : end - 1;
+      if (seg->offset + (last - seg->start) >= VG_PGROUNDUP(st.size))
+         return False;
+      a = seg->end + 1;
+      if (a == 0)
+         break;
+   }
+   return True;
+}
+
+/* Translate the oldest queued block, if it still needs it.  Must be
+   called with the_BigLock held. */
+static void translate_one ( void )
+{
+   AheadReq req;
+   Bool     ok;
+
+   vg_assert(q_used > 0);
+   req     = queue[q_first];
+   q_first = (q_first + 1) % N_AHEAD_QUEUE;
+   q_used--;
+
+   if (!VG_(is_valid_tid)(req.tid)
+       || VG_(threads)[req.tid].status == VgTs_Zombie) {
+      n_ahead_failed++;
+      return;
+   }
+   /* It may have been needed, and so translated, since it was
+      queued. */
+   if (VG_(search_transtab)(NULL, NULL, NULL, req.addr, False)) {
+      n_ahead_present++;
+      return;
+   }
+   /* The code translated is that of the redirection target, if any. */
+   if (!is_safe_to_read(req.addr)
+       || !is_safe_to_read(VG_(redir_do_lookup)(req.addr, NULL))) {
+      n_ahead_unsafe++;
+      return;
+   }
+
+   vg_assert(VG_(running_tid) == VG_INVALID_THREADID);
+   VG_(running_tid) = req.tid;
+   ahead_depth      = req.depth;
+   ok = VG_(translate_ahead)(req.tid, req.addr, req.bbs_done);
+   ahead_depth      = 0;
+   VG_(running_tid) = VG_INVALID_THREADID;
+
+   if (ok)
+      n_ahead_translated++;
+   else
+      n_ahead_failed++;
+}
+
+static Word helper_main ( void* unused )
+{
+   HChar c;
+
+   while (True) {
+      if (VG_(read)(wake_fd[0], &c, 1) != 1)
+         break;
+
+      VG_(acquire_BigLock_LL)("transahead");
+      while (ahead_active && q_used > 0 && all_threads_blocked()) {
+         translate_one();
+         /* Let any thread back from its syscall have the lock. */
+         VG_(release_BigLock_LL)("transahead");
+         VG_(acquire_BigLock_LL)("transahead");
+      }
+      helper_awake = False;
+      VG_(release_BigLock_LL)("transahead");
+   }
+   return 0;
+}
+
+static void transahead_atfork_child ( ThreadId tid )
+{
+   /* The helper thread wasn't copied. */
+   ahead_active = False;
+   helper_awake = False;
+   q_used       = 0;
+   VG_(close)(wake_fd[0]);
+   VG_(close)(wake_fd[1]);
+   wake_fd[0] = wake_fd[1] = -1;
+}
+#endif
+
+void VG_(transahead_kick) ( void )
+{
+   HChar c = 0;
+
+   if (!ahead_active || helper_awake || q_used == 0)
+      return;
+   helper_awake = True;
+   n_ahead_wakeups++;
+   VG_(write)(wake_fd[1], &c, 1);
+}
+
+
+/*====================================================================*/
+/*=== Initialisation                                               ===*/
+/*====================================================================*/
+
+void VG_(transahead_init) ( void )
+{
+   vg_assert(!ahead_active);
+
+   if (!VG_(clo_translate_ahead))
+      return;
+
+#  if defined(VGO_linux)
+   if (!VG_(needs).persistent_translations) {
+      VG_(message)(Vg_UserMsg,
+                   "Warning: --translate-ahead is not supported by this tool"
+                   " (or with these tool options); ignored\n");
+      return;
+   }
+   if (VG_(pipe)(wake_fd) != 0) {
+      VG_(message)(Vg_UserMsg,
+                   "Warning: --translate-ahead: can't create pipe; ignored\n");
+      return;
+   }
+   wake_fd[0] = VG_(safe_fd)(wake_fd[0]);
+   wake_fd[1] = VG_(safe_fd)(wake_fd[1]);
+   if (wake_fd[0] < 0 || wake_fd[1] < 0
+       || !VG_(start_helper_thread)(helper_main, NULL)) {
+      VG_(message)(Vg_UserMsg,
+                   "Warning: --translate-ahead: can't start helper thread;"
+                   " ignored\n");
+      return;
+   }
+   VG_(atfork)(NULL, NULL, transahead_atfork_child);
+   ahead_active = True;
+
+   if (VG_(clo_verbosity) > 1)
+      VG_(message)(Vg_DebugMsg, "translate-ahead: helper thread started\n");
+#  else
+   VG_(message)(Vg_UserMsg,
+                "Warning: --translate-ahead is not supported on this"
+                " platform; ignored\n");
+#  endif
+}
+
+
+/*====================================================================*/
+/*=== Stats                                                        ===*/
+/*====================================================================*/
+
+void VG_(print_transahead_stats) ( void )
+{
+   if (!VG_(clo_translate_ahead))
+      return;
+   VG_(message)(Vg_DebugMsg,
+                " transahead: %'llu queued, %'llu dropped, "
+                "%'llu wakeups\n",
+                n_ahead_queued, n_ahead_dropped, n_ahead_wakeups);
+   VG_(message)(Vg_DebugMsg,
+                " transahead: %'llu translated, %'llu already done, "
+                "%'llu unsafe, %'llu failed\n",
+                n_ahead_translated, n_ahead_present, n_ahead_unsafe,
+                n_ahead_failed);
+}
+
+/*--------------------------------------------------------------------*/
+/*--- end                                           m_transahead.c ---*/
+/*--------------------------------------------------------------------*/
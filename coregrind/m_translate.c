@@ -60,6 +60,10 @@
 
 #include "pub_core_gdbserver.h"   // VG_(instrument_for_gdbserver_if_needed)
 
+#include "pub_core_transahead.h"  // VG_(transahead_add_successors)
+
+#include "pub_core_smcprotect.h"  // VG_(smc_can_skip_check)
+
 #include "libvex_emnote.h"        // For PPC, EmWarn_PPC64_redir_underflow
 
 /*------------------------------------------------------------*/
@@ -780,6 +784,11 @@ static Bool translations_allowable_from_seg ( NSegment const* seg, Addr addr )
 }
 
 
+/* With --smc-check=protect, the extents of the block being
+   translated which are to be write-protected once it is in the TC,
+   as a bitmask in the same form as the result of needs_self_check. */
+static UInt smc_protect_mask = 0;
+
 /* Produce a bitmask stating which of the supplied extents needs a
    self-check.  See documentation of
    VexTranslateArgs::needs_self_check for more details about the
@@ -859,6 +868,29 @@ static UInt needs_self_check ( void* closureV,
                }
                break;
             }
+            case Vg_SmcProtect: {
+               /* as Vg_SmcAllNonFile, except that code which
+                  m_smcprotect can watch by write-protecting it isn't
+                  checked; code on this thread's stack always is */
+               Bool protect;
+               if (!segA) {
+                  segA = VG_(am_find_nsegment)(addr);
+               }
+               NSegment const* segSP
+                  = VG_(am_find_nsegment)(VG_(get_SP)(closure->tid));
+               if (segA && segA->kind == SkFileC && segA->start <= addr
+                   && (len == 0 || addr + len <= segA->end + 1)) {
+                  /* in a file-mapped segment; skip the check */
+               } else if (segA && segA != segSP
+                          && VG_(smc_can_skip_check)(segA, addr, len,
+                                                     &protect)) {
+                  if (protect)
+                     smc_protect_mask |= (1 << i);
+               } else {
+                  check = True;
+               }
+               break;
+            }
             default:
                vg_assert(0);
          }
@@ -933,6 +965,12 @@ static UInt needs_self_check ( void* closureV,
    Chasing across them obviously defeats the redirect mechanism, with
    bad effects for Memcheck, Helgrind, DRD, Massif, and possibly others.
 */
+/* True while VG_(translate_at_tier2) is making a translation. */
+static Bool translating_at_tier2 = False;
+
+/* True while VG_(translate_ahead) is making a translation. */
+static Bool translating_ahead = False;
+
 static Bool chase_into_ok ( void* closureV, Addr addr )
 {
    NSegment const*    seg     = VG_(am_find_nsegment)(addr);
@@ -940,6 +978,15 @@ static Bool chase_into_ok ( void* closureV, Addr addr )
    /* Work through a list of possibilities why we might not want to
       allow a chase. */
 
+   /* Tiered translation, and this is the cheap first translation? */
+   if (VG_(clo_tier2_threshold) > 0 && !translating_at_tier2)
+      goto dontchase;
+
+   /* Translating ahead of need?  m_transahead has only checked that
+      the guest code following the block's own start can be read. */
+   if (translating_ahead)
+      goto dontchase;
+
    /* Destination not in a plausible segment? */
    if (!translations_allowable_from_seg(seg, addr))
       goto dontchase;
@@ -1439,6 +1486,42 @@ static Bool const_True ( Addr guest_addr )
    return True;
 }
 
+/* --------------- translate-ahead support --------------- */
+
+/* The constant successors of the block being translated, for
+   m_transahead.c, as found by collect_successors. */
+#define N_SUCCESSORS 4
+static Addr succs[N_SUCCESSORS];
+static UInt n_succs = 0;
+
+static Addr const_to_Addr ( const IRConst* con )
+{
+   return con->tag == Ico_U64 ? (Addr)con->Ico.U64 : (Addr)con->Ico.U32;
+}
+
+/* Final tidy pass used when translate-ahead is active: runs the
+   tool's own pass, if any, then notes the targets of the block's
+   ordinary jumps to constant addresses. */
+static IRSB* collect_successors ( IRSB* bb )
+{
+   Int i;
+
+   if (VG_(needs).final_IR_tidy_pass)
+      bb = VG_(tdict).tool_final_IR_tidy_pass(bb);
+
+   n_succs = 0;
+   for (i = 0; i < bb->stmts_used && n_succs < N_SUCCESSORS-1; i++) {
+      IRStmt* st = bb->stmts[i];
+      if (st->tag == Ist_Exit && st->Ist.Exit.jk == Ijk_Boring)
+         succs[n_succs++] = const_to_Addr(st->Ist.Exit.dst);
+   }
+   if (bb->next->tag == Iex_Const
+       && (bb->jumpkind == Ijk_Boring || bb->jumpkind == Ijk_Call))
+      succs[n_succs++] = const_to_Addr(bb->next->Iex.Const.con);
+   return bb;
+}
+
+
 /* --------------- main translation function --------------- */
 
 /* Note: see comments at top of m_redir.c for the Big Picture on how
@@ -1479,6 +1562,7 @@ Bool VG_(translate) ( ThreadId tid,
    Addr               addr;
    T_Kind             kind;
    Int                tmpbuf_used, verbosity, i;
+   UInt               tier;
    Bool (*preamble_fn)(void*,IRSB*);
    VexArch            vex_arch;
    VexArchInfo        vex_archinfo;
@@ -1553,7 +1637,7 @@ Bool VG_(translate) ( ThreadId tid,
                    addr, name2 );
    }
 
-   if (!debugging_translation)
+   if (!debugging_translation && !translating_ahead)
       VG_TRACK( pre_mem_read, Vg_CoreTranslate, 
                               tid, "(translator)", addr, 1 );
 
@@ -1586,6 +1670,9 @@ Bool VG_(translate) ( ThreadId tid,
 
    if ( (!translations_allowable_from_seg(seg, addr))
         || addr == TRANSTAB_BOGUS_GUEST_ADDR ) {
+      /* Nobody actually tried to run it. */
+      if (translating_ahead)
+         return False;
       if (VG_(clo_trace_signals))
          VG_(message)(Vg_DebugMsg, "translations not allowed here (0x%lx)"
                                    " - throwing SEGV\n", addr);
@@ -1729,14 +1816,30 @@ Bool VG_(translate) ( ThreadId tid,
    vta.instrument2       = need_to_handle_SP_assignment()
                               ? vg_SP_update_pass
                               : NULL;
-   vta.finaltidy         = VG_(needs).final_IR_tidy_pass
+   n_succs = 0;
+   if (VG_(transahead_active)() && !debugging_translation
+       && kind != T_NoRedir)
+      vta.finaltidy      = collect_successors;
+   else
+      vta.finaltidy      = VG_(needs).final_IR_tidy_pass
                               ? VG_(tdict).tool_final_IR_tidy_pass
                               : NULL;
    vta.needs_self_check  = needs_self_check;
    vta.preamble_function = preamble_fn;
    vta.traceflags        = verbosity;
-   vta.sigill_diag       = VG_(clo_sigill_diag);
-   vta.addProfInc        = VG_(clo_profyle_sbs) && kind != T_NoRedir;
+   vta.sigill_diag       = VG_(clo_sigill_diag) && !translating_ahead;
+
+   /* With tiered translation, first-tier translations count their
+      entries so that VG_(get_hot_translations) can find them.  With
+      --hot-blocks-file, all translations count them, so that
+      VG_(hot_blocks_save) can find the blocks which were run. */
+   if (VG_(clo_tier2_threshold) == 0 || kind == T_NoRedir)
+      tier = 0;
+   else
+      tier = translating_at_tier2 ? 2 : 1;
+   vta.addProfInc        = (VG_(clo_profyle_sbs) || tier == 1
+                            || VG_(clo_hot_blocks_file) != NULL)
+                           && kind != T_NoRedir;
 
    /* Set up the dispatch continuation-point info.  If this is a
       no-redir translation then it cannot be chained, and the chain-me
@@ -1767,6 +1870,7 @@ Bool VG_(translate) ( ThreadId tid,
       = VG_(fnptr_to_fnentry)( &VG_(disp_cp_xassisted) );
 
    /* Sheesh.  Finally, actually _do_ the translation! */
+   smc_protect_mask = 0;
    tres = LibVEX_Translate ( &vta );
 
    vg_assert(tres.status == VexTransOK);
@@ -1788,6 +1892,13 @@ Bool VG_(translate) ( ThreadId tid,
    // only did this for the debugging output produced along the way.
    if (!debugging_translation) {
 
+      // Write-protect the code that the translation has no self-check
+      // for, if it relies on that.
+      for (i = 0; i < vge.n_used; i++) {
+         if (smc_protect_mask & (1 << i))
+            VG_(smc_protect)( vge.base[i], vge.len[i] );
+      }
+
       if (kind != T_NoRedir) {
           // Put it into the normal TT/TC structures.  This is the
           // normal case.
@@ -1800,7 +1911,11 @@ Bool VG_(translate) ( ThreadId tid,
                                 tmpbuf_used,
                                 tres.n_sc_extents > 0,
                                 tres.offs_profInc,
-                                tres.n_guest_instrs );
+                                tres.n_guest_instrs,
+                                tier );
+          if (n_succs > 0)
+             VG_(transahead_add_successors)( tid, succs, n_succs,
+                                             bbs_done );
       } else {
           vg_assert(tres.offs_profInc == -1); /* -1 == unset */
           VG_(add_to_unredir_transtab)( &vge,
@@ -1813,6 +1928,37 @@ Bool VG_(translate) ( ThreadId tid,
    return True;
 }
 
+
+/* Retranslate the block at NRADDR with superblock chasing enabled,
+   replacing the first-tier translation of it.  Only meaningful when
+   --tier2-threshold is in use. */
+Bool VG_(translate_at_tier2) ( ThreadId tid, Addr nraddr, ULong bbs_done )
+{
+   Bool ok;
+   vg_assert(VG_(clo_tier2_threshold) > 0);
+   vg_assert(!translating_at_tier2);
+   translating_at_tier2 = True;
+   ok = VG_(translate)( tid, nraddr, False/*debugging*/, 0/*verbosity*/,
+                        bbs_done, True/*allow redirection*/ );
+   translating_at_tier2 = False;
+   return ok;
+}
+
+
+/* Translate the block at NRADDR before it is needed, on behalf of
+   thread TID.  Nothing is reported to the tool or to the thread if
+   the block can't be translated: it might never have been run. */
+Bool VG_(translate_ahead) ( ThreadId tid, Addr nraddr, ULong bbs_done )
+{
+   Bool ok;
+   vg_assert(!translating_ahead);
+   translating_ahead = True;
+   ok = VG_(translate)( tid, nraddr, False/*debugging*/, 0/*verbosity*/,
+                        bbs_done, True/*allow redirection*/ );
+   translating_ahead = False;
+   return ok;
+}
+
 /*--------------------------------------------------------------------*/
 /*--- end                                                          ---*/
 /*--------------------------------------------------------------------*/
@@ -42,6 +42,8 @@
 #include "pub_core_transtab.h"
 #include "pub_core_aspacemgr.h"
 #include "pub_core_mallocfree.h" // VG_(out_of_memory_NORETURN)
+#include "pub_core_scheduler.h"  // VG_(stop_parallel_threads)
+#include "pub_core_smcprotect.h" // VG_(smc_discarding)
 #include "pub_core_xarray.h"
 #include "pub_core_dispatch.h"   // For VG_(disp_cp*) addresses
 
@@ -63,6 +65,9 @@ static SECno n_sectors = 0;
    provided default. */
 UInt VG_(clo_avg_transtab_entry_size) = 0;
 
+/* Keep recently used translations when a sector is recycled. */
+Bool VG_(clo_transtab_keep_hot) = False;
+
 /*------------------ CONSTANTS ------------------*/
 /* Number of entries in hash table of each sector.  This needs to be a prime
    number to work properly, it must be <= 65535 (so that a TTE index
@@ -91,7 +96,8 @@ typedef UShort HTTno;
 
 /* Equivalence classes for fast address range deletion.  There are 1 +
    2^ECLASS_WIDTH bins.  The highest one, ECLASS_MISC, describes an
-   address range which does not fall cleanly within any specific bin.
+   address range which does not fall cleanly within one or two
+   adjacent bins.
    Note that ECLASS_SHIFT + ECLASS_WIDTH must be < 32.
    ECLASS_N must fit in a EclassNo. */
 #define ECLASS_SHIFT 13
@@ -100,6 +106,12 @@ typedef UShort HTTno;
 #define ECLASS_N     (1 + ECLASS_MISC)
 STATIC_ASSERT(ECLASS_SHIFT + ECLASS_WIDTH < 32);
 
+/* When discarding, inspecting a translation found through an eclass
+   costs about this many times as much as inspecting one in a
+   sequential scan of the whole sector (delete_translations_in_sector).
+   Used to choose between the two. */
+#define ECLASS_SCAN_COST 4
+
 typedef UShort EClassNo;
 
 /*------------------ TYPES ------------------*/
@@ -151,6 +163,21 @@ typedef
    OutEdgeArr;
 
 
+/* Values for TTEntryC.usage.prof.refd.  A translation is marked
+   REFD_USED when it is looked up in the TT (that is, on fast-cache
+   misses) or when a jump is chained to it.  The marks are cleared
+   sector by sector, one sector ahead of the one to be recycled next,
+   so at recycle time REFD_USED means "used during the last sector's
+   worth of translation".  Translations reached through the fast cache
+   or by chained jumps are never looked up, so clearing the marks also
+   drops the sector's translations from the fast cache and undoes the
+   jumps chained to them; see clear_refd_marks.  REFD_KEPT marks
+   translations which are being copied out of a sector that is about
+   to be recycled. */
+#define REFD_NONE 0
+#define REFD_USED 1
+#define REFD_KEPT 2
+
 /* A translation-table entry.  This indicates precisely which areas of
    guest code are included in the translation, and contains all other
    auxiliary info too.  These are split into hold and cold parts,
@@ -176,6 +203,15 @@ typedef
                are profiling. */
             ULong    count;
             UShort   weight;
+            /* Translation tier; see VG_(add_to_transtab).  When
+               tiered translation is enabled, count is maintained
+               for tier 1 translations even if we are not
+               profiling. */
+            UChar    tier;
+            /* One of the REFD_ values below.  Maintained whether or
+               not we are profiling; used by the sector recycling
+               code to decide which translations to keep. */
+            UChar    refd;
          } prof; // if status == InUse
          TTEno next_empty_tte; // if status != InUse
       } usage;
@@ -457,9 +493,10 @@ static Int    tc_sector_szQ = 0;
 static SECno sector_search_order[MAX_N_SECTORS];
 
 
-/* Fast helper for the TC.  A direct-mapped cache which holds a set of
-   recently used (guest address, host address) pairs.  This array is
-   referred to directly from m_dispatch/dispatch-<platform>.S.
+/* Fast helper for the TC.  A 2-way set associative cache which holds
+   a set of recently used (guest address, host address) pairs.  These
+   arrays are referred to directly from m_dispatch/dispatch-<platform>.S.
+   See pub_core_transtab_asm.h for which dispatchers probe which ways.
 
    Entries in tt_fast may refer to any valid TC entry, regardless of
    which sector it's in.  Consequently we must be very careful to
@@ -470,6 +507,10 @@ static SECno sector_search_order[MAX_N_SECTORS];
    assumption that no guest code actually has that address, hence a
    value 0x1 seems good.  m_translate gives the client a synthetic
    segfault if it tries to execute at this address.
+
+   A guest address is in at most one way of its set.  Since fast-cache
+   entries are only ever made for the entry address of a translation,
+   deleting a translation need only clear the one set it can be in.
 */
 /*
 typedef
@@ -481,6 +522,13 @@ typedef
 */
 /*global*/ __attribute__((aligned(16)))
            FastCacheEntry VG_(tt_fast)[VG_TT_FAST_SIZE];
+/*global*/ __attribute__((aligned(16)))
+           FastCacheEntry VG_(tt_fast_way1)[VG_TT_FAST_SIZE];
+
+/* If nonzero, a hit in way 1 doesn't swap the ways.  Set when threads
+   run generated code in parallel, since another thread could be
+   reading the set at the same time. */
+/*global*/ UInt VG_(tt_fast_no_swap) = 0;
 
 /* Make sure we're not used before initialisation. */
 static Bool init_done = False;
@@ -492,6 +540,21 @@ static Bool init_done = False;
 static ULong n_fast_flushes = 0;
 static ULong n_fast_updates = 0;
 
+/* Number of fast-cache entries cleared individually, rather than by
+   a flush. */
+static ULong n_fast_invals = 0;
+
+/* Fast-cache lookups done from C (VG_(lookup_tt_fast)), by outcome.
+   Lookups done by the dispatchers are counted by the scheduler. */
+static ULong n_fast_hits_way0 = 0;
+static ULong n_fast_hits_way1 = 0;
+static ULong n_fast_misses    = 0;
+
+/* Number of chaining requests queued while threads ran in parallel,
+   and number of times the queue was emptied. */
+static ULong n_chains_queued = 0;
+static ULong n_chain_batches = 0;
+
 /* Number of full lookups done. */
 static ULong n_full_lookups = 0;
 static ULong n_lookup_probes = 0;
@@ -508,10 +571,29 @@ static ULong n_dump_count = 0;
 static ULong n_dump_osize = 0;
 static ULong n_sectors_recycled = 0;
 
+/* Number of translations kept when their sector was recycled
+   (--transtab-keep-hot=yes), and number of translations made for
+   code whose translation had been dumped earlier.  The latter is
+   approximate: see evicted_entries. */
+static ULong n_keep_count = 0;
+static ULong n_retrans_after_dump = 0;
+
 /* Number/osize of translations discarded due to requests to do so. */
 static ULong n_disc_count = 0;
 static ULong n_disc_osize = 0;
 
+/* Number of sectors searched for translations to discard by looking
+   at the relevant eclasses, and the number of eclass entries looked
+   at to do so; and the number searched by scanning the whole TT. */
+static ULong n_disc_eclass_scans    = 0;
+static ULong n_disc_eclass_examined = 0;
+static ULong n_disc_full_scans      = 0;
+
+/* Number of tier 1 translations selected for retranslation, and
+   number actually replaced by a tier 2 translation. */
+static ULong n_tier_hot      = 0;
+static ULong n_tier_replaced = 0;
+
 
 /*-------------------------------------------------------------*/
 /*--- Misc                                                  ---*/
@@ -858,12 +940,13 @@ static Bool is_in_the_main_TC ( const void* hcode )
 
 
 /* Fulfill a chaining request, and record admin info so we
-   can undo it later, if required.
+   can undo it later, if required.  No thread may be running in
+   parallel.
 */
-void VG_(tt_tc_do_chaining) ( void* from__patch_addr,
-                              SECno to_sNo,
-                              TTEno to_tteNo,
-                              Bool  to_fastEP )
+static void do_chaining ( void* from__patch_addr,
+                          SECno to_sNo,
+                          TTEno to_tteNo,
+                          Bool  to_fastEP )
 {
    /* Get the CPU info established at startup. */
    VexArch     arch_host = VexArch_INVALID;
@@ -881,6 +964,8 @@ void VG_(tt_tc_do_chaining) ( void* from__patch_addr,
    void*     host_code = ((UChar*)to_tteC->tcptr)
                          + (to_fastEP ? LibVEX_evCheckSzB(arch_host) : 0);
 
+   to_tteC->usage.prof.refd = REFD_USED;
+
    // stay sane -- the patch point (dst) is in this sector's code cache
    vg_assert( (UChar*)host_code >= (UChar*)sectors[to_sNo].tc );
    vg_assert( (UChar*)host_code <= (UChar*)sectors[to_sNo].tc_next
@@ -948,6 +1033,85 @@ void VG_(tt_tc_do_chaining) ( void* from__patch_addr,
    OutEdgeArr__add(&from_tteC->out_edges, &oe);
 }
 
+/* A patch might be half done when another thread runs it, so
+   chaining needs the world stopped.  While threads are running in
+   parallel, requests are queued instead, and done all at once when
+   the queue fills up, when the same jump asks to be chained again
+   (so it's hot), or when the world is stopped for some other reason.
+   Until then, a queued jump just goes back to the scheduler, as an
+   unchained one always does.  Nothing in the TT/TC changes without
+   the world being stopped, so the queued requests stay valid. */
+#define N_PENDING_CHAINS 32
+
+typedef
+   struct {
+      void* from__patch_addr;
+      SECno to_sNo;
+      TTEno to_tteNo;
+      Bool  to_fastEP;
+   }
+   PendingChain;
+
+static PendingChain pending_chains[N_PENDING_CHAINS];
+static UInt         n_pending_chains = 0;
+
+static void do_pending_chains ( void )
+{
+   UInt i;
+   for (i = 0; i < n_pending_chains; i++)
+      do_chaining( pending_chains[i].from__patch_addr,
+                   pending_chains[i].to_sNo,
+                   pending_chains[i].to_tteNo,
+                   pending_chains[i].to_fastEP );
+   n_pending_chains = 0;
+}
+
+/* Stop the world before changing the TT/TC or the fast cache.  The
+   queued chaining requests are done first, while they still refer
+   to live translations. */
+static void stop_parallel_threads ( void )
+{
+   VG_(stop_parallel_threads)();
+   if (n_pending_chains > 0) {
+      n_chain_batches++;
+      do_pending_chains();
+   }
+}
+
+void VG_(tt_tc_do_chaining) ( void* from__patch_addr,
+                              SECno to_sNo,
+                              TTEno to_tteNo,
+                              Bool  to_fastEP )
+{
+   UInt i;
+   Bool again = False;
+
+   if (VG_(parallel_threads_running)()) {
+      for (i = 0; i < n_pending_chains; i++) {
+         if (pending_chains[i].from__patch_addr == from__patch_addr) {
+            again = True;
+            break;
+         }
+      }
+      if (!again) {
+         vg_assert(n_pending_chains < N_PENDING_CHAINS);
+         pending_chains[n_pending_chains].from__patch_addr
+            = from__patch_addr;
+         pending_chains[n_pending_chains].to_sNo    = to_sNo;
+         pending_chains[n_pending_chains].to_tteNo  = to_tteNo;
+         pending_chains[n_pending_chains].to_fastEP = to_fastEP;
+         n_pending_chains++;
+         n_chains_queued++;
+      }
+      if (again || n_pending_chains == N_PENDING_CHAINS)
+         stop_parallel_threads();
+      return;
+   }
+
+   stop_parallel_threads();
+   do_chaining( from__patch_addr, to_sNo, to_tteNo, to_fastEP );
+}
+
 
 /* Unchain one patch, as described by the specified InEdge.  For
    sanity check purposes only (to check that the patched location is
@@ -1052,25 +1216,91 @@ void unchain_in_preparation_for_deletion ( VexArch arch_host,
 }
 
 
+/* Undo all the chained jumps out of the specified block, so that its
+   code refers to no other translation and can be moved. */
+static
+void unchain_out_edges ( VexArch arch_host, VexEndness endness_host,
+                         SECno here_sNo, TTEno here_tteNo )
+{
+   UWord     j, n, m;
+   Int       evCheckSzB = LibVEX_evCheckSzB(arch_host);
+   TTEntryC* here_tteC  = index_tteC(here_sNo, here_tteNo);
+
+   while ((n = OutEdgeArr__size(&here_tteC->out_edges)) > 0) {
+      OutEdge*  oe      = OutEdgeArr__index(&here_tteC->out_edges, n-1);
+      TTEntryC* to_tteC = index_tteC(oe->to_sNo, oe->to_tteNo);
+      m = InEdgeArr__size(&to_tteC->in_edges);
+      vg_assert(m > 0);
+      for (j = 0; j < m; j++) {
+         InEdge* ie = InEdgeArr__index(&to_tteC->in_edges, j);
+         if (ie->from_sNo == here_sNo && ie->from_tteNo == here_tteNo
+             && ie->from_offs == oe->from_offs)
+           break;
+      }
+      vg_assert(j < m); // "ie must be findable"
+      UChar* to_slow_EP = (UChar*)to_tteC->tcptr;
+      UChar* to_fast_EP = to_slow_EP + evCheckSzB;
+      unchain_one(arch_host, endness_host,
+                  InEdgeArr__index(&to_tteC->in_edges, j),
+                  to_fast_EP, to_slow_EP);
+      InEdgeArr__deleteIndex(&to_tteC->in_edges, j);
+      OutEdgeArr__deleteIndex(&here_tteC->out_edges, n-1);
+   }
+}
+
+
+/* Undo all the chained jumps into the specified block, so that each
+   goes through the scheduler again next time it is taken. */
+static
+void unchain_in_edges ( VexArch arch_host, VexEndness endness_host,
+                        SECno here_sNo, TTEno here_tteNo )
+{
+   UWord     j, n, m;
+   Int       evCheckSzB   = LibVEX_evCheckSzB(arch_host);
+   TTEntryC* here_tteC    = index_tteC(here_sNo, here_tteNo);
+   UChar*    here_slow_EP = (UChar*)here_tteC->tcptr;
+   UChar*    here_fast_EP = here_slow_EP + evCheckSzB;
+
+   while ((n = InEdgeArr__size(&here_tteC->in_edges)) > 0) {
+      InEdge*   ie        = InEdgeArr__index(&here_tteC->in_edges, n-1);
+      TTEntryC* from_tteC = index_tteC(ie->from_sNo, ie->from_tteNo);
+      unchain_one(arch_host, endness_host, ie, here_fast_EP, here_slow_EP);
+      m = OutEdgeArr__size(&from_tteC->out_edges);
+      vg_assert(m > 0);
+      for (j = 0; j < m; j++) {
+         OutEdge* oe = OutEdgeArr__index(&from_tteC->out_edges, j);
+         if (oe->to_sNo == here_sNo && oe->to_tteNo == here_tteNo
+             && oe->from_offs == ie->from_offs)
+           break;
+      }
+      vg_assert(j < m); // "oe must be findable"
+      OutEdgeArr__deleteIndex(&from_tteC->out_edges, j);
+      InEdgeArr__deleteIndex(&here_tteC->in_edges, n-1);
+   }
+}
+
+
 /*-------------------------------------------------------------*/
 /*--- Address-range equivalence class stuff                 ---*/
 /*-------------------------------------------------------------*/
 
-/* Return equivalence class number for a range. */
+/* Find the equivalence class numbers of the first and last bytes of
+   a range.  Returns False if the range spans more than two classes,
+   in which case it can only be described by ECLASS_MISC. */
 
-static EClassNo range_to_eclass ( Addr start, UInt len )
+static Bool range_to_eclasses ( /*OUT*/EClassNo* lo_ec,
+                                /*OUT*/EClassNo* hi_ec,
+                                Addr start, UInt len )
 {
    UInt mask   = (1 << ECLASS_WIDTH) - 1;
    UInt lo     = (UInt)start;
    UInt hi     = lo + len - 1;
-   UInt loBits = (lo >> ECLASS_SHIFT) & mask;
-   UInt hiBits = (hi >> ECLASS_SHIFT) & mask;
-   if (loBits == hiBits) {
-      vg_assert(loBits < ECLASS_N-1);
-      return loBits;
-   } else {
-      return ECLASS_MISC;
-   }
+   if ((hi >> ECLASS_SHIFT) - (lo >> ECLASS_SHIFT) > 1)
+      return False;
+   *lo_ec = (lo >> ECLASS_SHIFT) & mask;
+   *hi_ec = (hi >> ECLASS_SHIFT) & mask;
+   vg_assert(*lo_ec < ECLASS_N-1 && *hi_ec < ECLASS_N-1);
+   return True;
 }
 
 
@@ -1078,6 +1308,8 @@ static EClassNo range_to_eclass ( Addr start, UInt len )
    These are written in *eclasses, which must be big enough to hold 3
    Ints.  The number written, between 1 and 3, is returned.  The
    eclasses are presented in order, and any duplicates are removed.
+   An extent which straddles a class boundary is listed in both
+   classes, so long as that doesn't make more than 3 in total.
 */
 
 static 
@@ -1088,22 +1320,27 @@ Int vexGuestExtents_to_eclasses ( /*OUT*/EClassNo* eclasses,
 #  define SWAP(_lv1,_lv2) \
       do { Int t = _lv1; _lv1 = _lv2; _lv2 = t; } while (0)
 
-   UInt i, j, n_ec;
-   EClassNo r;
+   UInt i, j, k, n_ec;
+   EClassNo r[2];
 
    vg_assert(tteH->vge_n_used >= 1 && tteH->vge_n_used <= 3);
 
    n_ec = 0;
    for (i = 0; i < tteH->vge_n_used; i++) {
-      r = range_to_eclass( tteH->vge_base[i], tteH->vge_len[i] );
-      if (r == ECLASS_MISC) 
+      if (!range_to_eclasses( &r[0], &r[1],
+                              tteH->vge_base[i], tteH->vge_len[i] ))
          goto bad;
-      /* only add if we haven't already seen it */
-      for (j = 0; j < n_ec; j++)
-         if (eclasses[j] == r)
-            break;
-      if (j == n_ec)
-         eclasses[n_ec++] = r;
+      for (k = 0; k < (r[0] == r[1] ? 1 : 2); k++) {
+         /* only add if we haven't already seen it */
+         for (j = 0; j < n_ec; j++)
+            if (eclasses[j] == r[k])
+               break;
+         if (j == n_ec) {
+            if (n_ec == 3)
+               goto bad;
+            eclasses[n_ec++] = r[k];
+         }
+      }
    }
 
    if (n_ec == 1)
@@ -1455,19 +1692,56 @@ static inline HTTno HASH_TT ( Addr key )
    return (HTTno)(k32 % N_HTTES_PER_SECTOR);
 }
 
+/* Put (key, tcptr) in way 0 of its set.  Whatever was in way 0
+   moves to way 1, and whatever was in way 1 is dropped. */
 static void setFastCacheEntry ( Addr key, ULong* tcptr )
 {
    UInt cno = (UInt)VG_TT_FAST_HASH(key);
-   VG_(tt_fast)[cno].guest = key;
-   VG_(tt_fast)[cno].host  = (Addr)tcptr;
+   FastCacheEntry* way0 = &VG_(tt_fast)[cno];
+   FastCacheEntry* way1 = &VG_(tt_fast_way1)[cno];
+   /* Don't leave a stale copy of key in way 1. */
+   if (way1->guest == key)
+      way1->guest = TRANSTAB_BOGUS_GUEST_ADDR;
+   if (way0->guest != key && way0->guest != TRANSTAB_BOGUS_GUEST_ADDR)
+      *way1 = *way0;
+   way0->guest = key;
+   way0->host  = (Addr)tcptr;
    n_fast_updates++;
    /* This shouldn't fail.  It should be assured by m_translate
       which should reject any attempt to make translation of code
       starting at TRANSTAB_BOGUS_GUEST_ADDR. */
-   vg_assert(VG_(tt_fast)[cno].guest != TRANSTAB_BOGUS_GUEST_ADDR);
+   vg_assert(way0->guest != TRANSTAB_BOGUS_GUEST_ADDR);
+}
+
+/* Is (key, tcptr) in the fast cache already?  With threads running
+   in parallel, another thread may have missed on the same key and
+   put it there since this one looked. */
+static Bool isFastCacheEntry ( Addr key, ULong* tcptr )
+{
+   UInt cno = (UInt)VG_TT_FAST_HASH(key);
+   return (VG_(tt_fast)[cno].guest == key
+           && VG_(tt_fast)[cno].host == (Addr)tcptr)
+          || (VG_(tt_fast_way1)[cno].guest == key
+              && VG_(tt_fast_way1)[cno].host == (Addr)tcptr);
 }
 
-/* Invalidate the fast cache VG_(tt_fast). */
+/* Remove key from the fast cache, if it is there. */
+static void invalidateFastCacheEntry ( Addr key )
+{
+   UInt cno = (UInt)VG_TT_FAST_HASH(key);
+   if (VG_(tt_fast)[cno].guest == key) {
+      /* Promote way 1, so that way 0 stays the fuller of the two. */
+      VG_(tt_fast)[cno] = VG_(tt_fast_way1)[cno];
+      VG_(tt_fast_way1)[cno].guest = TRANSTAB_BOGUS_GUEST_ADDR;
+      n_fast_invals++;
+   }
+   else if (VG_(tt_fast_way1)[cno].guest == key) {
+      VG_(tt_fast_way1)[cno].guest = TRANSTAB_BOGUS_GUEST_ADDR;
+      n_fast_invals++;
+   }
+}
+
+/* Invalidate all of the fast cache. */
 static void invalidateFastCache ( void )
 {
    UInt j;
@@ -1479,12 +1753,40 @@ static void invalidateFastCache ( void )
       VG_(tt_fast)[j+1].guest = TRANSTAB_BOGUS_GUEST_ADDR;
       VG_(tt_fast)[j+2].guest = TRANSTAB_BOGUS_GUEST_ADDR;
       VG_(tt_fast)[j+3].guest = TRANSTAB_BOGUS_GUEST_ADDR;
+      VG_(tt_fast_way1)[j+0].guest = TRANSTAB_BOGUS_GUEST_ADDR;
+      VG_(tt_fast_way1)[j+1].guest = TRANSTAB_BOGUS_GUEST_ADDR;
+      VG_(tt_fast_way1)[j+2].guest = TRANSTAB_BOGUS_GUEST_ADDR;
+      VG_(tt_fast_way1)[j+3].guest = TRANSTAB_BOGUS_GUEST_ADDR;
    }
 
    vg_assert(j == VG_TT_FAST_SIZE);
    n_fast_flushes++;
 }
 
+Bool VG_(lookup_tt_fast) ( /*OUT*/Addr* res_hcode, Addr guest_addr )
+{
+   UInt cno = (UInt)VG_TT_FAST_HASH(guest_addr);
+   if (LIKELY(VG_(tt_fast)[cno].guest == guest_addr)) {
+      n_fast_hits_way0++;
+      *res_hcode = VG_(tt_fast)[cno].host;
+      return True;
+   }
+   if (VG_(tt_fast_way1)[cno].guest == guest_addr) {
+      n_fast_hits_way1++;
+      if (VG_(tt_fast_no_swap)) {
+         *res_hcode = VG_(tt_fast_way1)[cno].host;
+         return True;
+      }
+      FastCacheEntry tmp = VG_(tt_fast)[cno];
+      VG_(tt_fast)[cno] = VG_(tt_fast_way1)[cno];
+      VG_(tt_fast_way1)[cno] = tmp;
+      *res_hcode = VG_(tt_fast)[cno].host;
+      return True;
+   }
+   n_fast_misses++;
+   return False;
+}
+
 
 static TTEno get_empty_tt_slot(SECno sNo)
 {
@@ -1504,6 +1806,155 @@ static void add_to_empty_tt_list (SECno sNo, TTEno tteno)
    sectors[sNo].empty_tt_list = tteno;
 }
 
+/*------------------ KEEPING HOT TRANSLATIONS ------------------*/
+
+/* With --transtab-keep-hot=yes, the translations in a sector about
+   to be recycled which are marked REFD_USED are copied out first, and
+   put back once the sector has been emptied, rather than having to
+   be retranslated later on.  At most half of the sector's TT and TC
+   is given over to them, so that it still has room for new
+   translations.  The tool is not told about these translations
+   being discarded, since as far as it is concerned they aren't.
+
+   Profiled translations (--profile-flags, and tier 1 translations
+   when --tier2-threshold is in use) contain the address of their
+   counter, and we don't record where, so they can't be moved and
+   are never kept. */
+
+typedef
+   struct {
+      VexGuestExtents vge;
+      Addr   entry;
+      UInt   code_offs;  /* in kept_code */
+      UInt   code_len;
+      UShort weight;
+      UChar  tier;
+   }
+   KeptTrans;
+
+static XArray* kept_trans = NULL; /* of KeptTrans */
+static XArray* kept_code  = NULL; /* of UChar */
+
+/* True while the kept translations are being put back, so that they
+   are not counted as new ones. */
+static Bool adding_kept = False;
+
+/* Guest entry addresses of translations dumped by sector recycling,
+   indexed by HASH_TT, for the n_retrans_after_dump statistic.  Only
+   allocated with --stats=yes.  Collisions just lose information. */
+static Addr* dumped_entries = NULL;
+
+/* Copy out the translations to keep from sector sno, and mark them
+   REFD_KEPT. */
+static void save_hot_translations ( SECno sno )
+{
+   Sector* sec       = &sectors[sno];
+   UInt    max_trans = N_TTES_PER_SECTOR / 2;
+   UInt    max_bytes = 8 * tc_sector_szQ / 2;
+   UInt    n_bytes   = 0;
+   Word    i, n;
+
+   VexArch     arch_host = VexArch_INVALID;
+   VexArchInfo archinfo_host;
+   VG_(bzero_inline)(&archinfo_host, sizeof(archinfo_host));
+   VG_(machine_get_VexArchInfo)( &arch_host, &archinfo_host );
+   VexEndness endness_host = archinfo_host.endness;
+
+   if (kept_trans == NULL) {
+      kept_trans = VG_(newXA)(ttaux_malloc, "transtab.kept_trans",
+                              ttaux_free, sizeof(KeptTrans));
+      kept_code  = VG_(newXA)(ttaux_malloc, "transtab.kept_code",
+                              ttaux_free, sizeof(UChar));
+   }
+   vg_assert(VG_(sizeXA)(kept_trans) == 0);
+   vg_assert(VG_(sizeXA)(kept_code) == 0);
+
+   /* host_extents is in TC order, hence oldest first.  Entries for
+      deleted translations may remain, and their TT slots may since
+      have been reused; skip those. */
+   n = VG_(sizeXA)(sec->host_extents);
+   for (i = 0; i < n && VG_(sizeXA)(kept_trans) < max_trans; i++) {
+      HostExtent* hx   = VG_(indexXA)(sec->host_extents, i);
+      TTEntryH*   tteH = &sec->ttH[hx->tteNo];
+      TTEntryC*   tteC = &sec->ttC[hx->tteNo];
+      if (tteH->status != InUse
+          || (UChar*)tteC->tcptr != hx->start
+          || tteC->usage.prof.refd != REFD_USED
+          || tteC->usage.prof.tier == 1)
+         continue;
+      if (n_bytes + hx->len > max_bytes)
+         break;
+
+      /* Make the code independent of where it is. */
+      unchain_out_edges(arch_host, endness_host, sno, hx->tteNo);
+
+      KeptTrans kt;
+      TTEntryH__to_VexGuestExtents( &kt.vge, tteH );
+      kt.entry     = tteC->entry;
+      kt.code_offs = (UInt)VG_(sizeXA)(kept_code);
+      kt.code_len  = hx->len;
+      kt.weight    = tteC->usage.prof.weight;
+      kt.tier      = tteC->usage.prof.tier;
+      VG_(addBytesToXA)(kept_code, hx->start, hx->len);
+      VG_(addToXA)(kept_trans, &kt);
+      tteC->usage.prof.refd = REFD_KEPT;
+      n_bytes += hx->len;
+   }
+}
+
+/* Put the translations saved by save_hot_translations into the
+   youngest sector, which has just been emptied. */
+static void restore_hot_translations ( void )
+{
+   Word i, n;
+
+   if (kept_trans == NULL)
+      return;
+
+   n = VG_(sizeXA)(kept_trans);
+   adding_kept = True;
+   for (i = 0; i < n; i++) {
+      KeptTrans* kt = VG_(indexXA)(kept_trans, i);
+      VG_(add_to_transtab)( &kt->vge, kt->entry,
+                            (Addr)VG_(indexXA)(kept_code, kt->code_offs),
+                            kt->code_len,
+                            False/*is_self_checking: stats only*/,
+                            -1/*no profInc*/,
+                            kt->weight, kt->tier );
+   }
+   adding_kept = False;
+
+   n_keep_count += n;
+   VG_(dropTailXA)(kept_trans, n);
+   VG_(dropTailXA)(kept_code, VG_(sizeXA)(kept_code));
+}
+
+/* Clear the REFD_USED marks in sector sno.  A hot loop runs entirely
+   through chained jumps, or the fast cache, and would never be marked
+   again.  So those routes to the sector's translations are closed
+   too: the next time one of them is run, it is looked up in the TT,
+   or a jump is chained to it, and it gets marked. */
+static void clear_refd_marks ( SECno sno )
+{
+   Sector* sec = &sectors[sno];
+   if (sec->tc == NULL)
+      return;
+
+   VexArch     arch_host = VexArch_INVALID;
+   VexArchInfo archinfo_host;
+   VG_(bzero_inline)(&archinfo_host, sizeof(archinfo_host));
+   VG_(machine_get_VexArchInfo)( &arch_host, &archinfo_host );
+   VexEndness endness_host = archinfo_host.endness;
+
+   for (TTEno ei = 0; ei < N_TTES_PER_SECTOR; ei++) {
+      if (sec->ttH[ei].status != InUse)
+         continue;
+      sec->ttC[ei].usage.prof.refd = REFD_NONE;
+      unchain_in_edges(arch_host, endness_host, sno, ei);
+      invalidateFastCacheEntry(sec->ttC[ei].entry);
+   }
+}
+
 static void initialiseSector ( SECno sno )
 {
    UInt i;
@@ -1605,7 +2056,6 @@ static void initialiseSector ( SECno sno )
       vg_assert(sec->ttC != NULL);
       vg_assert(sec->ttH != NULL);
       vg_assert(sec->tc_next != NULL);
-      n_dump_count += sec->tt_n_inuse;
 
       VexArch     arch_host = VexArch_INVALID;
       VexArchInfo archinfo_host;
@@ -1621,9 +2071,17 @@ static void initialiseSector ( SECno sno )
          if (sec->ttH[ei].status == InUse) {
             vg_assert(sec->ttC[ei].n_tte2ec >= 1);
             vg_assert(sec->ttC[ei].n_tte2ec <= 3);
-            n_dump_osize += TTEntryH__osize(&sec->ttH[ei]);
-            /* Tell the tool too. */
-            if (VG_(needs).superblock_discards) {
+            Bool kept = sec->ttC[ei].usage.prof.refd == REFD_KEPT;
+            if (!kept) {
+               n_dump_count++;
+               n_dump_osize += TTEntryH__osize(&sec->ttH[ei]);
+               if (dumped_entries) {
+                  Addr entry = sec->ttC[ei].entry;
+                  dumped_entries[HASH_TT(entry)] = entry;
+               }
+            }
+            /* Tell the tool too, unless it's being kept. */
+            if (VG_(needs).superblock_discards && !kept) {
                VexGuestExtents vge_tmp;
                TTEntryH__to_VexGuestExtents( &vge_tmp, &sec->ttH[ei] );
                VG_TDICT_CALL( tool_discard_superblock_info,
@@ -1686,9 +2144,17 @@ static void initialiseSector ( SECno sno )
    }
 }
 
+/* forward */
+static void delete_tte ( /*MOD*/Sector* sec, SECno secNo, TTEno tteno,
+                         VexArch arch_host, VexEndness endness_host );
+
 /* Add a translation of vge to TT/TC.  The translation is temporarily
    in code[0 .. code_len-1].
 
+   tier is 0 unless tiered translation is in use.  A tier 2
+   translation replaces any existing translation for entry, which
+   becomes unreachable as soon as this returns.
+
    pre: youngest_sector points to a valid (although possibly full)
    sector.
 */
@@ -1698,7 +2164,8 @@ void VG_(add_to_transtab)( const VexGuestExtents* vge,
                            UInt             code_len,
                            Bool             is_self_checking,
                            Int              offs_profInc,
-                           UInt             n_guest_instrs )
+                           UInt             n_guest_instrs,
+                           UInt             tier )
 {
    Int    tcAvailQ, reqdQ, y;
    ULong  *tcptr, *tcptr2;
@@ -1713,16 +2180,47 @@ void VG_(add_to_transtab)( const VexGuestExtents* vge,
 
    /* Generally stay sane */
    vg_assert(n_guest_instrs < 200); /* it can be zero, tho */
+   vg_assert(tier <= 2);
+
+   /* This may replace or recycle translations, and updates the fast
+      cache. */
+   stop_parallel_threads();
+
+   /* Get rid of the translation being replaced.  Nothing can be
+      running it, since we're not in generated code.  Jumps chained
+      to it are undone, and will get chained to the new one when next
+      taken.  The fast cache entry for it is overwritten below.  A
+      kept translation being put back replaces nothing: it was
+      copied out of the sector just emptied. */
+   if (tier == 2 && !adding_kept) {
+      SECno old_sNo;
+      TTEno old_tteNo;
+      if (VG_(search_transtab)(NULL, &old_sNo, &old_tteNo, entry, False)) {
+         VexArch     arch_host = VexArch_INVALID;
+         VexArchInfo archinfo_host;
+         VG_(bzero_inline)(&archinfo_host, sizeof(archinfo_host));
+         VG_(machine_get_VexArchInfo)( &arch_host, &archinfo_host );
+         delete_tte( &sectors[old_sNo], old_sNo, old_tteNo,
+                     arch_host, archinfo_host.endness );
+         n_tier_replaced++;
+      }
+   }
 
    if (DEBUG_TRANSTAB)
       VG_(printf)("add_to_transtab(entry = 0x%lx, len = %u) ...\n",
                   entry, code_len);
 
-   n_in_count++;
-   n_in_tsize += code_len;
-   n_in_osize += vge_osize(vge);
-   if (is_self_checking)
-      n_in_sc_count++;
+   if (!adding_kept) {
+      n_in_count++;
+      n_in_tsize += code_len;
+      n_in_osize += vge_osize(vge);
+      if (is_self_checking)
+         n_in_sc_count++;
+      if (dumped_entries && dumped_entries[HASH_TT(entry)] == entry) {
+         n_retrans_after_dump++;
+         dumped_entries[HASH_TT(entry)] = 0;
+      }
+   }
 
    y = youngest_sector;
    vg_assert(isValidSector(y));
@@ -1761,7 +2259,19 @@ void VG_(add_to_transtab)( const VexGuestExtents* vge,
       if (youngest_sector >= n_sectors)
          youngest_sector = 0;
       y = youngest_sector;
+      Bool keep_hot = VG_(clo_transtab_keep_hot) && !VG_(clo_profyle_sbs)
+                      && VG_(clo_hot_blocks_file) == NULL
+                      && sectors[y].tc != NULL;
+      vg_assert(!adding_kept);
+      if (keep_hot)
+         save_hot_translations(y);
       initialiseSector(y);
+      if (keep_hot) {
+         restore_hot_translations();
+         /* Start a new reference period for the sector which will be
+            recycled next. */
+         clear_refd_marks((y + 1) % n_sectors);
+      }
    }
 
    /* Be sure ... */
@@ -1798,6 +2308,7 @@ void VG_(add_to_transtab)( const VexGuestExtents* vge,
    sectors[y].ttC[tteix].usage.prof.count  = 0;
    sectors[y].ttC[tteix].usage.prof.weight = 
       n_guest_instrs == 0 ? 1 : n_guest_instrs;
+   sectors[y].ttC[tteix].usage.prof.tier = (UChar)tier;
    sectors[y].ttC[tteix].entry  = entry;
    TTEntryH__from_VexGuestExtents( &sectors[y].ttH[tteix], vge );
    sectors[y].ttH[tteix].status = InUse;
@@ -1896,9 +2407,14 @@ Bool VG_(search_transtab) ( /*OUT*/Addr*  res_hcode,
          if (tti < N_TTES_PER_SECTOR
              && sectors[sno].ttC[tti].entry == guest_addr) {
             /* found it */
-            if (upd_cache)
+            sectors[sno].ttC[tti].usage.prof.refd = REFD_USED;
+            if (upd_cache
+                && !isFastCacheEntry( guest_addr,
+                                      sectors[sno].ttC[tti].tcptr )) {
+               stop_parallel_threads();
                setFastCacheEntry( 
                   guest_addr, sectors[sno].ttC[tti].tcptr );
+            }
             if (res_hcode)
                *res_hcode = (Addr)sectors[sno].ttC[tti].tcptr;
             if (res_sNo)
@@ -2021,6 +2537,7 @@ static void delete_tte ( /*MOD*/Sector* sec, SECno secNo, TTEno tteno,
    vg_assert(j < N_HTTES_PER_SECTOR);
    sec->htt[k]    = HTT_DELETED;
    tteH->status   = Deleted;
+   invalidateFastCacheEntry(tteC->entry);
    tteC->n_tte2ec = 0;
    add_to_empty_tt_list(secNo, tteno);
 
@@ -2112,7 +2629,6 @@ void VG_(discard_translations) ( Addr guest_start, ULong range,
    Sector* sec;
    SECno   sno;
    EClassNo ec;
-   Bool    anyDeleted = False;
 
    vg_assert(init_done);
 
@@ -2129,81 +2645,95 @@ void VG_(discard_translations) ( Addr guest_start, ULong range,
    if (range == 0)
       return;
 
+   /* With --smc-check=protect, this may widen the range. */
+   if (VG_(clo_smc_check) == Vg_SmcProtect)
+      VG_(smc_discarding)( &guest_start, &range );
+
+   stop_parallel_threads();
+
    VexArch     arch_host = VexArch_INVALID;
    VexArchInfo archinfo_host;
    VG_(bzero_inline)(&archinfo_host, sizeof(archinfo_host));
    VG_(machine_get_VexArchInfo)( &arch_host, &archinfo_host );
    VexEndness endness_host = archinfo_host.endness;
 
-   /* There are two different ways to do this.
+   /* There are two different ways to do this, chosen per sector.
 
-      If the range fits within a single address-range equivalence
-      class, as will be the case for a cache line sized invalidation,
-      then we only have to inspect the set of translations listed in
-      that equivalence class, and also in the "sin-bin" equivalence
-      class ECLASS_MISC.
+      Each translation is listed in the address-range equivalence
+      classes that its guest code touches, or, failing that, in the
+      "sin-bin" equivalence class ECLASS_MISC.  If the range covers
+      only a few classes, as will be the case for a cache line sized
+      invalidation or a JIT compiler discarding the code it is about
+      to overwrite, then we only have to inspect the translations
+      listed in those classes, and also in ECLASS_MISC.
 
       Otherwise, the invalidation is of a larger range and probably
       results from munmap.  In this case it's (probably!) faster just
       to inspect all translations, dump those we don't want, and
       regenerate the equivalence class information (since modifying it
-      in-situ is even more expensive).
+      in-situ is even more expensive).  The same goes if the classes
+      concerned list a good fraction of the sector's translations
+      anyway.
    */
 
-   /* First off, figure out if the range falls within a single class, 
-      and if so which one. */
-
-   ec = ECLASS_MISC;
-   if (range <= (1ULL << ECLASS_SHIFT))
-      ec = range_to_eclass( guest_start, (UInt)range );
-
-   /* if ec is ECLASS_MISC then we aren't looking at just a single
-      class, so use the slow scheme.  Else use the fast scheme,
-      examining 'ec' and ECLASS_MISC. */
-
-   if (ec != ECLASS_MISC) {
-
-      VG_(debugLog)(2, "transtab",
-                       "                    FAST, ec = %d\n", ec);
-
-      /* Fast scheme */
-      vg_assert(ec >= 0 && ec < ECLASS_MISC);
-
-      for (sno = 0; sno < n_sectors; sno++) {
-         sec = &sectors[sno];
-         if (sec->tc == NULL)
-            continue;
-         anyDeleted |= delete_translations_in_sector_eclass( 
-                          sec, sno, guest_start, range, ec, 
-                          arch_host, endness_host
-                       );
-         anyDeleted |= delete_translations_in_sector_eclass( 
-                          sec, sno, guest_start, range, ECLASS_MISC,
-                          arch_host, endness_host
-                       );
+   /* First off, figure out which classes the range covers, if there
+      are fewer than ECLASS_MISC of them.  n_ecs == 0 means there
+      aren't. */
+   UInt     n_ecs    = 0;
+   EClassNo ec_first = 0;
+   if (range <= ((ULong)ECLASS_MISC << ECLASS_SHIFT)) {
+      ULong n = ((guest_start + range - 1) >> ECLASS_SHIFT)
+                - (guest_start >> ECLASS_SHIFT) + 1;
+      if (n <= ECLASS_MISC) {
+         n_ecs    = (UInt)n;
+         ec_first = ((UInt)guest_start >> ECLASS_SHIFT)
+                    & (ECLASS_MISC - 1);
       }
+   }
 
-   } else {
-
-      /* slow scheme */
+   VG_(debugLog)(2, "transtab",
+                    "                    %u eclasses from %d\n",
+                    n_ecs, (Int)ec_first);
 
-      VG_(debugLog)(2, "transtab",
-                       "                    SLOW, ec = %d\n", ec);
+   for (sno = 0; sno < n_sectors; sno++) {
+      sec = &sectors[sno];
+      if (sec->tc == NULL)
+         continue;
 
-      for (sno = 0; sno < n_sectors; sno++) {
-         sec = &sectors[sno];
-         if (sec->tc == NULL)
+      if (n_ecs > 0) {
+         UInt k, n_listed = sec->ec2tte_used[ECLASS_MISC];
+         for (k = 0; k < n_ecs; k++)
+            n_listed += sec->ec2tte_used[(ec_first + k) & (ECLASS_MISC - 1)];
+         if (n_listed * ECLASS_SCAN_COST < N_TTES_PER_SECTOR) {
+            /* Fast scheme */
+            for (k = 0; k < n_ecs; k++) {
+               ec = (ec_first + k) & (ECLASS_MISC - 1);
+               vg_assert(ec >= 0 && ec < ECLASS_MISC);
+               (void)delete_translations_in_sector_eclass( 
+                        sec, sno, guest_start, range, ec, 
+                        arch_host, endness_host
+                     );
+            }
+            (void)delete_translations_in_sector_eclass( 
+                     sec, sno, guest_start, range, ECLASS_MISC,
+                     arch_host, endness_host
+                  );
+            n_disc_eclass_scans++;
+            n_disc_eclass_examined += n_listed;
             continue;
-         anyDeleted |= delete_translations_in_sector( 
-                          sec, sno, guest_start, range,
-                          arch_host, endness_host
-                       );
+         }
       }
 
+      /* slow scheme */
+      (void)delete_translations_in_sector( 
+               sec, sno, guest_start, range,
+               arch_host, endness_host
+            );
+      n_disc_full_scans++;
    }
 
-   if (anyDeleted)
-      invalidateFastCache();
+   /* No need to flush the fast cache: delete_tte has removed the
+      deleted translations from it one by one. */
 
    /* don't forget the no-redir cache */
    unredir_discard_translations( guest_start, range );
@@ -2334,6 +2864,9 @@ void VG_(add_to_unredir_transtab)( const VexGuestExtents* vge,
    /* This is the whole point: it's not redirected! */
    vg_assert(entry == vge->base[0]);
 
+   /* This may throw the whole unredir TC away. */
+   stop_parallel_threads();
+
    /* How many unredir_tt slots are needed */   
    code_szQ = (code_len + 7) / 8;
 
@@ -2438,9 +2971,12 @@ void VG_(init_tt_tc) ( void )
    /* check fast cache entries are packed back-to-back with no spaces */
    vg_assert(sizeof( VG_(tt_fast) ) 
              == VG_TT_FAST_SIZE * sizeof(FastCacheEntry));
+   vg_assert(sizeof( VG_(tt_fast_way1) ) == sizeof( VG_(tt_fast) ));
    /* check fast cache is aligned as we requested.  Not fatal if it
       isn't, but we might as well make sure. */
    vg_assert(VG_IS_16_ALIGNED( ((Addr) & VG_(tt_fast)[0]) ));
+   vg_assert(VG_IS_16_ALIGNED( ((Addr) & VG_(tt_fast_way1)[0]) ));
+   vg_assert(VG_TT_FAST_WAYS == 2);
 
    /* The TTEntryH size is critical for keeping the LLC miss rate down
       when doing a lot of discarding.  Hence check it here.  We also
@@ -2502,6 +3038,12 @@ void VG_(init_tt_tc) ( void )
    /* Initialise the fast cache. */
    invalidateFastCache();
 
+   if (VG_(clo_stats)) {
+      dumped_entries = ttaux_malloc("transtab.dumped_entries",
+                                    N_HTTES_PER_SECTOR * sizeof(Addr));
+      VG_(memset)(dumped_entries, 0, N_HTTES_PER_SECTOR * sizeof(Addr));
+   }
+
    /* and the unredir tt/tc */
    init_unredir_tt_tc();
 
@@ -2551,6 +3093,123 @@ void VG_(init_tt_tc) ( void )
 }
 
 
+/*------------------------------------------------------------*/
+/*--- Tiered translation.                                  ---*/
+/*------------------------------------------------------------*/
+
+/* Find up to max_hot tier 1 translations which have been entered at
+   least threshold times, and write their entry addresses to hot[].
+   Each translation is only ever reported once: the caller is
+   expected to retranslate it at tier 2, and if that fails the tier 1
+   translation is left alone.  Returns the number found. */
+UInt VG_(get_hot_translations) ( /*OUT*/Addr* hot, UInt max_hot,
+                                 ULong threshold )
+{
+   SECno sno;
+   TTEno i;
+   UInt  n_hot = 0;
+
+   vg_assert(init_done);
+
+   for (sno = 0; sno < n_sectors && n_hot < max_hot; sno++) {
+      if (sectors[sno].tc == NULL)
+         continue;
+      for (i = 0; i < N_TTES_PER_SECTOR && n_hot < max_hot; i++) {
+         if (sectors[sno].ttH[i].status != InUse)
+            continue;
+         TTEntryC* tteC = &sectors[sno].ttC[i];
+         if (tteC->usage.prof.tier != 1
+             || tteC->usage.prof.count < threshold)
+            continue;
+         /* Don't report it again. */
+         tteC->usage.prof.tier = 2;
+         hot[n_hot++] = tteC->entry;
+      }
+   }
+
+   n_tier_hot += n_hot;
+   return n_hot;
+}
+
+
+/*------------------------------------------------------------*/
+/*--- Support for the persistent translation cache.        ---*/
+/*------------------------------------------------------------*/
+
+/* Undo every chained jump in the main TC.  Afterwards the host code
+   of each translation refers only to the dispatcher's chain-me stubs
+   and not to any other translation, so it can be copied elsewhere
+   (see m_tccache.c).  Nothing is lost: if the code is run again, the
+   jumps get chained again lazily in the normal way. */
+void VG_(unchain_all_translations) ( void )
+{
+   SECno sno;
+   TTEno i;
+
+   vg_assert(init_done);
+   stop_parallel_threads();
+
+   VexArch     arch_host = VexArch_INVALID;
+   VexArchInfo archinfo_host;
+   VG_(bzero_inline)(&archinfo_host, sizeof(archinfo_host));
+   VG_(machine_get_VexArchInfo)( &arch_host, &archinfo_host );
+   VexEndness endness_host = archinfo_host.endness;
+
+   /* Each patched jump is an InEdge of exactly one block, so
+      unchaining the in-edges of every block undoes them all. */
+   for (sno = 0; sno < n_sectors; sno++) {
+      if (sectors[sno].tc == NULL)
+         continue;
+      for (i = 0; i < N_TTES_PER_SECTOR; i++) {
+         if (sectors[sno].ttH[i].status != InUse)
+            continue;
+         unchain_in_preparation_for_deletion(arch_host, endness_host,
+                                             sno, i);
+      }
+   }
+}
+
+/* Call |fn| for every live translation in the main TC, oldest sector
+   first and in order of creation within each sector.  |fn| may not
+   add or remove translations. */
+void VG_(visit_translations) ( void (*fn)( void* opaque,
+                                           const VexGuestExtents* vge,
+                                           Addr entry,
+                                           const UChar* hcode,
+                                           UInt hcode_len,
+                                           UInt n_guest_instrs ),
+                               void* opaque )
+{
+   Int   i;
+   SECno sno;
+   Word  j, n;
+
+   vg_assert(init_done);
+
+   for (i = 1; i <= n_sectors; i++) {
+      sno = (youngest_sector + i) % n_sectors;
+      if (sectors[sno].tc == NULL)
+         continue;
+      n = VG_(sizeXA)(sectors[sno].host_extents);
+      for (j = 0; j < n; j++) {
+         const HostExtent* hx = VG_(indexXA)(sectors[sno].host_extents, j);
+         const TTEntryC* tteC = &sectors[sno].ttC[hx->tteNo];
+         const TTEntryH* tteH = &sectors[sno].ttH[hx->tteNo];
+         /* Skip extents belonging to deleted translations, including
+            ones whose tt slot has since been reused. */
+         if (tteH->status != InUse || (UChar*)tteC->tcptr != hx->start)
+            continue;
+         VexGuestExtents vge;
+         TTEntryH__to_VexGuestExtents( &vge, tteH );
+         /* In the absence of profiling, .weight is never changed from
+            the value set by VG_(add_to_transtab). */
+         fn( opaque, &vge, tteC->entry, hx->start, hx->len,
+             tteC->usage.prof.weight );
+      }
+   }
+}
+
+
 /*------------------------------------------------------------*/
 /*--- Printing out statistics.                             ---*/
 /*------------------------------------------------------------*/
@@ -2571,8 +3230,18 @@ void VG_(print_tt_tc_stats) ( void )
       "    tt/tc: %'llu tt lookups requiring %'llu probes\n",
       n_full_lookups, n_lookup_probes );
    VG_(message)(Vg_DebugMsg,
-      "    tt/tc: %'llu fast-cache updates, %'llu flushes\n",
-      n_fast_updates, n_fast_flushes );
+      "    tt/tc: %'llu fast-cache updates, %'llu flushes, "
+      "%'llu single invalidations\n",
+      n_fast_updates, n_fast_flushes, n_fast_invals );
+   VG_(message)(Vg_DebugMsg,
+      "    tt/tc: %'llu fast-cache lookups from C: way 0 %'llu hits, "
+      "way 1 %'llu hits, %'llu misses\n",
+      n_fast_hits_way0 + n_fast_hits_way1 + n_fast_misses,
+      n_fast_hits_way0, n_fast_hits_way1, n_fast_misses );
+   if (n_chains_queued > 0)
+      VG_(message)(Vg_DebugMsg,
+         "    tt/tc: %'llu chaining requests queued, done in %'llu batches\n",
+         n_chains_queued, n_chain_batches );
 
    VG_(message)(Vg_DebugMsg,
                 " transtab: new        %'llu "
@@ -2586,9 +3255,22 @@ void VG_(print_tt_tc_stats) ( void )
                 " transtab: dumped     %'llu (%'llu -> ?" "?) "
                 "(sectors recycled %'llu)\n",
                 n_dump_count, n_dump_osize, n_sectors_recycled );
+   VG_(message)(Vg_DebugMsg,
+                " transtab: kept       %'llu on recycling, "
+                "%'llu dumped ones retranslated (approx)\n",
+                n_keep_count, n_retrans_after_dump );
    VG_(message)(Vg_DebugMsg,
                 " transtab: discarded  %'llu (%'llu -> ?" "?)\n",
                 n_disc_count, n_disc_osize );
+   VG_(message)(Vg_DebugMsg,
+                " transtab: discard searches: %'llu by eclass "
+                "(%'llu entries), %'llu full\n",
+                n_disc_eclass_scans, n_disc_eclass_examined,
+                n_disc_full_scans );
+   if (VG_(clo_tier2_threshold) > 0)
+      VG_(message)(Vg_DebugMsg,
+                   " transtab: tier2      %'llu hot, %'llu retranslated\n",
+                   n_tier_hot, n_tier_replaced );
 
    if (DEBUG_TRANSTAB) {
       VG_(printf)("\n");
@@ -2678,6 +3360,28 @@ ULong VG_(get_SB_profile) ( SBProfEntry tops[], UInt n_tops )
    return score_total;
 }
 
+/* Call fn for each translation in the main TC with a nonzero score,
+   without zeroing the counters. */
+void VG_(visit_SB_scores) ( void (*fn)( void* opaque, Addr entry,
+                                        ULong score ),
+                            void* opaque )
+{
+   SECno sno;
+   TTEno i;
+
+   for (sno = 0; sno < n_sectors; sno++) {
+      if (sectors[sno].tc == NULL)
+         continue;
+      for (i = 0; i < N_TTES_PER_SECTOR; i++) {
+         if (sectors[sno].ttH[i].status != InUse)
+            continue;
+         ULong sc = score(&sectors[sno].ttC[i]);
+         if (sc > 0)
+            fn( opaque, sectors[sno].ttC[i].entry, sc );
+      }
+   }
+}
+
 /*--------------------------------------------------------------------*/
 /*--- end                                                          ---*/
 /*--------------------------------------------------------------------*/
@@ -110,6 +110,23 @@ extern ULong VG_(am_get_anonsize_total)( void );
 /* Show the segment array on the debug log, at given loglevel. */
 extern void VG_(am_show_nsegments) ( Int logLevel, const HChar* who );
 
+/* Stats for --shadow-thp. */
+typedef
+   struct {
+      ULong n_regions;      /* 2MB-aligned regions mapped */
+      ULong region_bytes;   /* their total size */
+      ULong n_allocs;       /* VG_(am_shadow_alloc) calls served */
+      ULong alloc_bytes;    /* bytes handed out */
+      ULong n_madv_fails;   /* regions the kernel refused to advise */
+      ULong rss_bytes;      /* resident bytes in the regions, and */
+      ULong thp_bytes;      /* how many of them are in huge pages */
+   }
+   AmShadowThpStats;
+
+/* Fill in *STATS.  The resident byte counts are read from
+   /proc/self/smaps, and are zero if that isn't available. */
+extern void VG_(am_get_shadow_thp_stats) ( /*OUT*/AmShadowThpStats* stats );
+
 /* VG_(am_get_segment_starts) is also part of this section, but its
    prototype is tool-visible, hence not in this header file. */
 
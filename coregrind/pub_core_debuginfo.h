@@ -149,6 +149,9 @@ extern Bool VG_(use_CF_info) ( /*MOD*/D3UnwindRegs* uregs,
    info (e.g. CFI info or FPO info or ...). */
 extern UInt VG_(debuginfo_generation) (void);
 
+/* Print the debuginfo statistics, for --stats=yes. */
+extern void VG_(print_debuginfo_stats) ( void );
+
 
 
 /* True if some FPO information is loaded.
@@ -218,6 +221,10 @@ void VG_(DebugInfo_syms_getidx)  ( const DebugInfo *di,
                                    /*OUT*/Bool*     isText,
                                    /*OUT*/Bool*     isIFunc,
                                    /*OUT*/Bool*     isGlobal );
+/* Returns the object's build-id as a lower-case hex string, or NULL
+   if it has none (or it isn't an ELF object). */
+extern const HChar* VG_(DebugInfo_get_buildid) ( const DebugInfo *di );
+
 /* ppc64-linux only: find the TOC pointer (R2 value) that should be in
    force at the entry point address of the function containing
    guest_code_addr.  Returns 0 if not known. */
@@ -45,6 +45,9 @@ extern
 void VG_(demangle) ( Bool do_cxx_demangling, Bool do_z_demangling,
                      const HChar* orig, const HChar** result );
 
+/* Print the --stats counters for VG_(demangle)'s cache of results. */
+extern void VG_(demangle_print_stats) ( void );
+
 /* Demangle a Z-encoded name as described in pub_tool_redir.h. 
    Z-encoded names are used by Valgrind for doing function 
    interception/wrapping.
@@ -176,6 +176,10 @@ typedef
 /* output various gdbserver statistics and status. */
 extern void VG_(gdbserver_status_output)(void);
 
+/* True if gdbserver has been called at least once.  Translations
+   made since then might contain gdbserver instrumentation. */
+extern Bool VG_(gdbserver_was_called)(void);
+
 /* Shared structure between vgdb and the process running 
    under valgrind.
    We define two variants: a 32 bit and a 64 bit.
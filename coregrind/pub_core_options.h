@@ -195,6 +195,17 @@ extern Bool  VG_(clo_trace_redir);
 /* Enable fair scheduling on multicore systems? default: NO */
 enum FairSchedType { disable_fair_sched, enable_fair_sched, try_fair_sched };
 extern enum FairSchedType VG_(clo_fair_sched);
+
+/* Let threads run generated code in parallel, if the tool supports it
+   (see m_scheduler/scheduler.c)?  Default: NO */
+extern Bool VG_(clo_parallel_threads);
+
+/* Vary the scheduling timeslice with lock contention and syscall
+   frequency (see m_scheduler/scheduler.c)?  Default: NO */
+extern Bool VG_(clo_adaptive_sched);
+/* Spin for a while before sleeping when waiting for the ticket lock
+   (--fair-sched=yes)?  Default: NO */
+extern Bool VG_(clo_sched_spin);
 /* DEBUG: print thread scheduling events?  default: NO */
 extern Bool  VG_(clo_trace_sched);
 /* DEBUG: do heap profiling?  default: NO */
@@ -238,6 +249,18 @@ extern Bool VG_(clo_sym_offsets);
 extern Bool VG_(clo_read_inline_info);
 /* Read DWARF3 variable info even if tool doesn't ask for it? */
 extern Bool VG_(clo_read_var_info);
+/* Number of processes to read DWARF line and inline info with (see
+   m_debuginfo/dwarfjobs.c).  Default: 1 */
+extern Int VG_(clo_debuginfo_jobs);
+/* Use them only for objects with at least this many bytes of DWARF.
+   Default: 4MB; lower values are for testing. */
+extern Int VG_(clo_debuginfo_jobs_min_szB);
+/* Defer reading DWARF line, inline and variable info of an object
+   until something asks for it?  Default: NO */
+extern Bool VG_(clo_lazy_debuginfo);
+/* Where to keep the debug info tables of objects between runs (see
+   m_debuginfo/dicache.c).  Default: NULL, meaning don't */
+extern const HChar* VG_(clo_debuginfo_cache_dir);
 /* Which prefix to strip from full source file paths, if any. */
 extern const HChar* VG_(clo_prefix_to_strip);
 
@@ -320,10 +343,39 @@ extern UInt VG_(clo_num_transtab_sectors);
    provided default. */
 extern UInt VG_(clo_avg_transtab_entry_size);
 
+/* Keep recently used translations when the translation cache is full
+   and a sector is recycled, rather than discarding them all. */
+extern Bool VG_(clo_transtab_keep_hot);
+
+/* If nonzero, translations are first made without superblock
+   chasing, and retranslated with it once they have been entered this
+   many times. */
+extern UInt VG_(clo_tier2_threshold);
+
+/* Translate the likely successors of new translations in a helper
+   thread, while the client threads are blocked in syscalls (see
+   m_transahead.c). */
+extern Bool VG_(clo_translate_ahead);
+
+/* File to which the blocks run are saved at exit, and from which
+   they are translated in advance in later runs (see m_sbprofile.c).
+   NULL (the default) means don't. */
+extern const HChar* VG_(clo_hot_blocks_file);
+
+/* Directory in which translations are saved at exit and from which
+   they are reloaded in later runs (see m_tccache.c).  NULL (the
+   default) means don't. */
+extern const HChar* VG_(clo_tc_cache_dir);
+
 /* Only client requested fixed mapping can be done below 
    VG_(clo_aspacem_minAddr). */
 extern Addr VG_(clo_aspacem_minAddr);
 
+/* Give out tool shadow memory (VG_(am_shadow_alloc)) from 2MB-aligned
+   regions marked for transparent huge pages?  Linux only.  Default:
+   NO */
+extern Bool VG_(clo_shadow_thp);
+
 /* How large the Valgrind thread stacks should be. 
    Will be rounded up to a page.. */
 extern Word VG_(clo_valgrind_stacksize);
@@ -340,8 +392,11 @@ typedef
       Vg_SmcStack, // generate s-c-t's for code found in stacks
                    // (this is the default)
       Vg_SmcAll,   // make all translations self-checking.
-      Vg_SmcAllNonFile // make all translations derived from
+      Vg_SmcAllNonFile, // make all translations derived from
                    // non-file-backed memory self checking
+      Vg_SmcProtect // as Vg_SmcAllNonFile, but write-protect private
+                   // writable anonymous memory instead of checking
+                   // code from it (see m_smcprotect.c)
    } 
    VgSmc;
 
@@ -33,6 +33,7 @@
 #define __PUB_CORE_SBPROFILE_H
 
 #include "pub_core_basics.h"   // VG_ macro
+#include "pub_core_debuginfo.h" // DebugInfo
 
 /* Get and print a profile.  Also, zero out the counters so that if we
    call it again later, the second call will only show new work done
@@ -40,6 +41,27 @@
    run-end profile. */
 void VG_(get_and_show_SB_profile) ( ULong ecs_done );
 
+/* --hot-blocks-file support.  Read the blocks saved by an earlier
+   run; must be called after the tool's post_clo_init. */
+extern void VG_(hot_blocks_init) ( void );
+
+/* Called by m_debuginfo when the debuginfo for an object has been
+   read.  Translates the object's blocks which were hot in the
+   earlier run, unless that has to wait for
+   VG_(hot_blocks_start_replay). */
+extern void VG_(hot_blocks_load_for_DebugInfo) ( const DebugInfo* di );
+
+/* Called once the scheduler and the initial image are set up, with
+   the main thread.  Replays the objects whose debuginfo was read
+   before then, and lets later ones be replayed as they are read. */
+extern void VG_(hot_blocks_start_replay) ( ThreadId tid );
+
+/* Write the blocks which were run to the file.  Must be called
+   before the SB profile counters are zeroed for the last time. */
+extern void VG_(hot_blocks_save) ( void );
+
+extern void VG_(print_hot_blocks_stats) ( void );
+
 #endif   // __PUB_CORE_SBPROFILE_H
 
 /*--------------------------------------------------------------------*/
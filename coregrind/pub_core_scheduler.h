@@ -86,6 +86,11 @@ extern void VG_(release_BigLock_LL) ( const HChar* who );
 /* Whether the specified thread owns the big lock. */
 extern Bool VG_(owns_BigLock_LL) ( ThreadId tid );
 
+/* Whether any thread (or helper) is waiting to acquire the big
+   lock.  Only a hint, unless the caller holds the lock: then the
+   count can only go up. */
+extern Bool VG_(BigLock_is_wanted) ( void );
+
 /* Yield the CPU for a while.  Drops/acquires the lock using the
    normal (non _LL) functions. */
 extern void VG_(vg_yield)(void);
@@ -112,6 +117,25 @@ extern void VG_(force_vgdb_poll) ( void );
 /* Stats ... */
 extern void VG_(print_scheduler_stats) ( void );
 
+/* Decide whether threads may run generated code in parallel
+   (--parallel-threads).  Must be called after the tool's
+   post_clo_init. */
+extern void VG_(parallel_threads_init) ( void );
+
+/* Wait until no thread is running generated code without holding
+   the_BigLock.  Must be called, with the_BigLock held, before
+   changing anything which generated code depends on. */
+extern void VG_(stop_parallel_threads) ( void );
+
+/* Is any thread running generated code without holding the_BigLock?
+   If not, none can start before the caller lets go of it. */
+extern Bool VG_(parallel_threads_running) ( void );
+
+/* If thread tid is running generated code without holding
+   the_BigLock, take it back.  Called by the thread itself on taking
+   a synchronous signal, and on leaving generated code. */
+extern void VG_(end_parallel_run) ( ThreadId tid );
+
 /* If False, a fault is Valgrind-internal (ie, a bug) */
 extern Bool VG_(in_generated_code);
 
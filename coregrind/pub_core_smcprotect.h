@@ -0,0 +1,75 @@
+/*--------------------------------------------------------------------*/
+/*--- Write-protecting translated code.      pub_core_smcprotect.h ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Valgrind, a dynamic binary instrumentation
+   framework.
+
+   Copyright (C) 2015-2015 The Valgrind developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#ifndef __PUB_CORE_SMCPROTECT_H
+#define __PUB_CORE_SMCPROTECT_H
+
+//--------------------------------------------------------------------
+// PURPOSE: With --smc-check=protect, this module detects writes to
+// client code in writable anonymous memory by write-protecting the
+// pages it was translated from, instead of having the translations
+// check their guest bytes on every entry.
+//--------------------------------------------------------------------
+
+#include "pub_core_basics.h"      // VG_ macro
+#include "pub_core_aspacemgr.h"   // NSegment
+
+/* Can the guest code at [a, a+len), which lies in SEG, go without a
+   self-check?  Returns True, setting *protect, if so: *protect says
+   whether VG_(smc_protect) must be called for it once it has been
+   translated.  Returns False if a self-check is needed. */
+extern Bool VG_(smc_can_skip_check) ( NSegment const* seg,
+                                      Addr a, SizeT len,
+                                      /*OUT*/Bool* protect );
+
+/* Write-protect the pages holding [a, a+len). */
+extern void VG_(smc_protect) ( Addr a, SizeT len );
+
+/* Called by VG_(discard_translations) before discarding the range
+   [*start, *start + *len).  Makes the protected pages in it writable
+   again, and widens the range if needed so that all translations
+   from those pages are discarded. */
+extern void VG_(smc_discarding) ( /*MOD*/Addr* start, /*MOD*/ULong* len );
+
+/* Called from the SIGSEGV handler.  Returns True if the fault at ADDR
+   was a write to a protected page, in which case the translations
+   from that page have been discarded, the page is writable again, and
+   the faulting instruction can simply be restarted. */
+extern Bool VG_(smc_handle_write_fault) ( Addr addr );
+
+/* Called before the kernel writes [a, a+len) on behalf of a syscall,
+   so that it doesn't fail with EFAULT on a protected page. */
+extern void VG_(smc_pre_syscall_write) ( Addr a, SizeT len );
+
+extern void VG_(print_smcprotect_stats) ( void );
+
+#endif   // __PUB_CORE_SMCPROTECT_H
+
+/*--------------------------------------------------------------------*/
+/*--- end                                   pub_core_smcprotect.h ---*/
+/*--------------------------------------------------------------------*/
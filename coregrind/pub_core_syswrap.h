@@ -68,6 +68,12 @@ extern void VG_(fixup_guest_state_after_syscall_interrupted)(
 extern Bool VG_(is_ip_in_blocking_syscall)(ThreadId tid, Addr ip);
 #endif
 
+#if defined(VGO_linux)
+// Start a thread which is invisible to the client and runs FN(ARG)
+// with all signals blocked.  Returns False if it could not be created.
+extern Bool VG_(start_helper_thread) ( Word (*fn)(void *), void* arg );
+#endif
+
 // Wait until all other threads are dead
 extern void VG_(reap_threads)(ThreadId self);
 
@@ -0,0 +1,60 @@
+/*--------------------------------------------------------------------*/
+/*--- Persistent translation cache.             pub_core_tccache.h ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Valgrind, a dynamic binary instrumentation
+   framework.
+
+   Copyright (C) 2015-2015 The Valgrind developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#ifndef __PUB_CORE_TCCACHE_H
+#define __PUB_CORE_TCCACHE_H
+
+//--------------------------------------------------------------------
+// PURPOSE: This module saves the translations made from each ELF
+// object to disk at exit (--tc-cache-dir=), and puts them straight
+// back into the translation cache when the same object is loaded in
+// a later run.
+//--------------------------------------------------------------------
+
+#include "pub_core_basics.h"      // VG_ macro
+#include "pub_core_debuginfo.h"   // DebugInfo
+
+/* Decide whether the cache can be used in this run.  Must be called
+   after the tool's post_clo_init and after VG_(init_tt_tc). */
+extern void VG_(tccache_init) ( void );
+
+/* Called by m_debuginfo when the debuginfo for an object has been
+   read.  Loads any saved translations for it into the TC. */
+extern void VG_(tccache_load_for_DebugInfo) ( const DebugInfo* di );
+
+/* Save the translations currently in the TC, one file per object.
+   Called at exit; no guest code may be run afterwards. */
+extern void VG_(tccache_save) ( void );
+
+extern void VG_(print_tccache_stats) ( void );
+
+#endif   // __PUB_CORE_TCCACHE_H
+
+/*--------------------------------------------------------------------*/
+/*--- end                                       pub_core_tccache.h ---*/
+/*--------------------------------------------------------------------*/
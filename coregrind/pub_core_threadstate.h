@@ -405,6 +405,10 @@ typedef struct {
    Bool               sched_jmpbuf_valid;
    VG_MINIMAL_JMP_BUF(sched_jmpbuf);
 
+   /* True while this thread runs generated code without holding
+      the_BigLock (--parallel-threads=yes). */
+   volatile Bool running_parallel;
+
    /* This thread's name. NULL, if no name. */
    HChar *thread_name;
    UInt ptrace;
@@ -95,6 +95,8 @@ typedef
       Bool malloc_replacement;
       Bool xml_output;
       Bool final_IR_tidy_pass;
+      Bool persistent_translations;
+      Bool parallel_execution;
    } 
    VgNeeds;
 
@@ -0,0 +1,67 @@
+/*--------------------------------------------------------------------*/
+/*--- Translating ahead of need.             pub_core_transahead.h ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Valgrind, a dynamic binary instrumentation
+   framework.
+
+   Copyright (C) 2015-2015 The Valgrind developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#ifndef __PUB_CORE_TRANSAHEAD_H
+#define __PUB_CORE_TRANSAHEAD_H
+
+//--------------------------------------------------------------------
+// PURPOSE: With --translate-ahead=yes, a helper thread translates the
+// static successors of newly translated blocks while the client
+// threads are blocked in syscalls, so that they are already in the
+// TC when the client gets to them.
+//--------------------------------------------------------------------
+
+#include "pub_core_basics.h"      // VG_ macro
+
+/* Start the helper thread, if --translate-ahead=yes and it can be
+   used in this run.  Must be called after the tool's post_clo_init
+   and after VG_(init_tt_tc). */
+extern void VG_(transahead_init) ( void );
+
+/* Is translate-ahead in use?  If not, there's no point in collecting
+   successors. */
+extern Bool VG_(transahead_active) ( void );
+
+/* Note the N constant successor addresses of a block just translated
+   for thread TID. */
+extern void VG_(transahead_add_successors) ( ThreadId tid,
+                                             const Addr* succs, UInt n,
+                                             ULong bbs_done );
+
+/* Called by a thread holding the_BigLock just before it releases it
+   to do a syscall which may block.  Wakes the helper thread if it has
+   anything to do. */
+extern void VG_(transahead_kick) ( void );
+
+extern void VG_(print_transahead_stats) ( void );
+
+#endif   // __PUB_CORE_TRANSAHEAD_H
+
+/*--------------------------------------------------------------------*/
+/*--- end                                    pub_core_transahead.h ---*/
+/*--------------------------------------------------------------------*/
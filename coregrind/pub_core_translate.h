@@ -46,6 +46,16 @@ Bool VG_(translate) ( ThreadId tid,
                       ULong    bbs_done,
                       Bool     allow_redirection );
 
+/* Retranslate a hot block with superblock chasing enabled
+   (--tier2-threshold).  The new translation replaces the old one. */
+extern
+Bool VG_(translate_at_tier2) ( ThreadId tid, Addr nraddr, ULong bbs_done );
+
+/* Translate a block which has not been asked for yet, for
+   m_transahead.c.  Fails quietly if it can't be translated. */
+extern
+Bool VG_(translate_ahead) ( ThreadId tid, Addr nraddr, ULong bbs_done );
+
 extern void VG_(print_translation_stats) ( void );
 
 #endif   // __PUB_CORE_TRANSLATE_H
@@ -50,8 +50,15 @@ typedef
    }
    FastCacheEntry;
 
+/* Way 0 and way 1 of the fast-cache; see pub_core_transtab_asm.h. */
 extern __attribute__((aligned(16)))
        FastCacheEntry VG_(tt_fast) [VG_TT_FAST_SIZE];
+extern __attribute__((aligned(16)))
+       FastCacheEntry VG_(tt_fast_way1) [VG_TT_FAST_SIZE];
+
+/* If nonzero, the dispatchers leave the ways of a set in place on a
+   hit in way 1, rather than swapping them. */
+extern UInt VG_(tt_fast_no_swap);
 
 #define TRANSTAB_BOGUS_GUEST_ADDR ((Addr)1)
 
@@ -82,6 +89,10 @@ extern void VG_(init_tt_tc)       ( void );
 # define N_SECTORS_DEFAULT 16
 #endif
 
+/* tier: 0 if tiered translation is not in use.  Otherwise 1 for a
+   first, cheap translation, whose entry count is maintained through
+   offs_profInc, or 2 for a retranslation of a hot block, which
+   replaces the existing translation of entry. */
 extern
 void VG_(add_to_transtab)( const VexGuestExtents* vge,
                            Addr             entry,
@@ -89,7 +100,8 @@ void VG_(add_to_transtab)( const VexGuestExtents* vge,
                            UInt             code_len,
                            Bool             is_self_checking,
                            Int              offs_profInc,
-                           UInt             n_guest_instrs );
+                           UInt             n_guest_instrs,
+                           UInt             tier );
 
 typedef UShort SECno; // SECno type identifies a sector
 typedef UShort TTEno; // TTEno type identifies a TT entry in a sector.
@@ -110,6 +122,11 @@ extern Bool VG_(search_transtab) ( /*OUT*/Addr*  res_hcode,
                                    Addr          guest_addr, 
                                    Bool          upd_cache );
 
+/* Look up guest_addr in both ways of the fast-cache.  A hit in way 1
+   is moved to way 0. */
+extern Bool VG_(lookup_tt_fast) ( /*OUT*/Addr* res_hcode,
+                                  Addr         guest_addr );
+
 extern void VG_(discard_translations) ( Addr  start, ULong range,
                                         const HChar* who );
 
@@ -129,6 +146,31 @@ extern
 Bool VG_(search_unredir_transtab) ( /*OUT*/Addr*  result,
                                     Addr          guest_addr );
 
+// Tiered translation
+
+/* Find up to max_hot tier 1 translations that have been entered at
+   least threshold times, and which haven't been reported before.
+   Their entry addresses are written to hot[]; returns how many. */
+extern UInt VG_(get_hot_translations) ( /*OUT*/Addr* hot, UInt max_hot,
+                                        ULong threshold );
+
+// Support for the persistent translation cache (m_tccache.c)
+
+/* Undo all chained jumps in the main TC.  Harmless: chaining is
+   redone on demand if the code is run again. */
+extern void VG_(unchain_all_translations) ( void );
+
+/* Visit each live translation in the main TC.  The host code is only
+   position independent if VG_(unchain_all_translations) has been
+   called first. */
+extern void VG_(visit_translations) ( void (*fn)( void* opaque,
+                                                  const VexGuestExtents* vge,
+                                                  Addr entry,
+                                                  const UChar* hcode,
+                                                  UInt hcode_len,
+                                                  UInt n_guest_instrs ),
+                                      void* opaque );
+
 // SB profiling stuff
 
 typedef struct _SBProfEntry {
@@ -138,6 +180,13 @@ typedef struct _SBProfEntry {
 
 extern ULong VG_(get_SB_profile) ( SBProfEntry tops[], UInt n_tops );
 
+/* Call fn for each translation with a nonzero score, i.e. which has
+   been run since it was made or since the last VG_(get_SB_profile).
+   The counters are left alone. */
+extern void VG_(visit_SB_scores) ( void (*fn)( void* opaque, Addr entry,
+                                               ULong score ),
+                                   void* opaque );
+
 //  Exported variables
 extern Bool  VG_(ok_to_discard_translations);
 
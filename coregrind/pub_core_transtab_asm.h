@@ -31,8 +31,16 @@
 #ifndef __PUB_CORE_TRANSTAB_ASM_H
 #define __PUB_CORE_TRANSTAB_ASM_H
 
-/* Constants for the fast translation lookup cache.  It is a direct
-   mapped cache, with 2^VG_TT_FAST_BITS entries.
+/* Constants for the fast translation lookup cache.  It is a 2-way
+   set associative cache, with 2^VG_TT_FAST_BITS sets.  Way 0 is
+   VG_(tt_fast) and way 1 is VG_(tt_fast_way1); both are indexed by
+   VG_TT_FAST_HASH.  Way 0 holds the most recently used entry of each
+   set.
+
+   All dispatchers probe way 0.  The x86 and amd64 dispatchers also
+   probe way 1, and on a hit there swap the two entries.  On the other
+   targets a miss in way 0 goes back to the scheduler, which probes
+   way 1 in C (VG_(lookup_tt_fast)) before doing a full lookup.
 
    On x86/amd64, the cache index is computed as
    'address[VG_TT_FAST_BITS-1 : 0]'.
@@ -52,6 +60,7 @@
 #define VG_TT_FAST_BITS 15
 #define VG_TT_FAST_SIZE (1 << VG_TT_FAST_BITS)
 #define VG_TT_FAST_MASK ((VG_TT_FAST_SIZE) - 1)
+#define VG_TT_FAST_WAYS 2
 
 /* This macro isn't usable in asm land; nevertheless this seems
    like a good place to put it. */
@@ -112,6 +112,7 @@ typedef
       Bool    hasT;     // True --> translations have (or MAY have)
                         // been taken from this segment
       Bool    isCH;     // True --> is client heap (SkAnonC ONLY)
+      Bool    isShared; // True --> mapped MAP_SHARED (SkAnonC ONLY)
    }
    NSegment;
 
@@ -151,7 +152,10 @@ extern const HChar* VG_(am_get_filename)( NSegment const * );
 extern Bool VG_(am_is_valid_for_client) ( Addr start, SizeT len, 
                                           UInt prot );
 
-/* Really just a wrapper around VG_(am_mmap_anon_float_valgrind). */
+/* Allocate SIZE bytes of page-aligned, zeroed memory for shadow state.
+   Normally just a wrapper around VG_(am_mmap_anon_float_valgrind);
+   with --shadow-thp=yes, the memory comes from 2MB-aligned regions
+   marked for transparent huge pages.  It cannot be freed. */
 extern void* VG_(am_shadow_alloc)(SizeT size);
 
 /* Unmap the given address range and update the segment array
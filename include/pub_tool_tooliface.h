@@ -497,6 +497,21 @@ extern void VG_(needs_xml_output) ( void );
    function here. */
 extern void VG_(needs_final_IR_tidy_pass) ( IRSB*(*final_tidy)(IRSB*) );
 
+/* Can translations made by this tool be saved and reused in a later
+   run (see --tc-cache-dir)?  Only say so if the instrumentation
+   depends on nothing but the guest code and the command line options;
+   in particular it must not embed pointers to data allocated at run
+   time, nor have side effects on tool state.  Unlike most needs, this
+   one may also be declared in the post_clo_init function. */
+extern void VG_(needs_persistent_translations) ( void );
+
+/* Can client threads run this tool's instrumented code at the same
+   time (see --parallel-threads)?  Only say so if the instrumentation
+   touches nothing but the guest state and client memory, or else
+   does so in a thread-safe way, and calls no helpers which use core
+   or tool state that isn't. */
+extern void VG_(needs_parallel_execution) ( void );
+
 
 /* ------------------------------------------------------------------ */
 /* Core events to track */
@@ -1283,6 +1283,12 @@ struct  vki_seminfo {
 #define VKI_MREMAP_MAYMOVE	1
 #define VKI_MREMAP_FIXED	2
 
+//----------------------------------------------------------------------
+// From linux-3.10/include/uapi/asm-generic/mman-common.h
+//----------------------------------------------------------------------
+
+#define VKI_MADV_HUGEPAGE	14
+
 //----------------------------------------------------------------------
 // From linux-2.6.31-rc4/include/linux/futex.h
 //----------------------------------------------------------------------
@@ -7826,6 +7826,10 @@ static void mc_post_clo_init ( void )
       VG_(track_new_mem_stack_signal)    ( mc_new_mem_w_tid_make_ECU );
    } else {
       /* Not doing origin tracking */
+      /* Origin tracking embeds ExeContext uniques, which are only
+         meaningful in this run, in the instrumentation.  Without it,
+         translations can be reused by later runs. */
+      VG_(needs_persistent_translations) ();
 #     ifdef PERF_FAST_STACK
       VG_(track_new_mem_stack_4)   ( mc_new_mem_stack_4   );
       VG_(track_new_mem_stack_8)   ( mc_new_mem_stack_8   );
@@ -0,0 +1,42 @@
+/* Built with -g -gz=zlib.  The filler below makes the compressed
+   .debug_info section inflate to more than 2MB, so the debuginfo
+   reader inflates it in several chunks.  With GCC at least, main is
+   described near the start of the section and check, which is inlined
+   into it, at the end, so naming the inlined function in the error
+   makes the reader jump forward over the filler and then carry on from
+   near the start. */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+__attribute__((always_inline))
+static inline int check ( int* p )
+{
+   if (*p == 42)   // uninitialised
+      return 1;
+   return 0;
+}
+
+/* Filler: lots of functions, each with a variable of a type of its
+   own, so that the compiler describes them all. */
+#define FIELDS \
+   int f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15;
+#define S1(n)     int f##n ( void ) { struct { FIELDS } v = { 0 }; \
+                                        return v.f0; }
+#define S10(n)    S1(n##0) S1(n##1) S1(n##2) S1(n##3) S1(n##4) \
+                  S1(n##5) S1(n##6) S1(n##7) S1(n##8) S1(n##9)
+#define S100(n)   S10(n##0) S10(n##1) S10(n##2) S10(n##3) S10(n##4) \
+                  S10(n##5) S10(n##6) S10(n##7) S10(n##8) S10(n##9)
+#define S1000(n)  S100(n##0) S100(n##1) S100(n##2) S100(n##3) S100(n##4) \
+                  S100(n##5) S100(n##6) S100(n##7) S100(n##8) S100(n##9)
+S1000(1) S1000(2) S1000(3) S1000(4)  S1000(5)  S1000(6)
+S1000(7) S1000(8) S1000(9) S1000(10) S1000(11) S1000(12)
+
+int main ( void )
+{
+   int* p = malloc(sizeof(int));
+   check(p);
+   free(p);
+   printf("done\n");
+   return 0;
+}
@@ -0,0 +1,50 @@
+/* Inlined calls side by side and inside each other: finding the
+   inlined calls covering an address has to skip the earlier calls
+   which end before it, and go into the ones which contain it. */
+#include "../memcheck.h"
+#define INLINE    inline __attribute__((always_inline))
+
+INLINE int fun_check(int argc) {
+   static int locc = 0;
+   if (argc > 0)
+      locc += argc;
+   return locc;
+}
+
+INLINE int fun_sib(int args) {
+   static int locs = 0;
+   locs += args;
+   return fun_check(args);
+}
+
+INLINE int fun_outer(int argo) {
+   int r = 0;
+   r += fun_sib(1);
+   r += fun_sib(2);
+   r += fun_sib(3);
+   r += fun_sib(argo);
+   r += fun_sib(4);
+   return r;
+}
+
+INLINE int fun_outer2(int argo2) {
+   int r = 0;
+   r += fun_sib(5);
+   r += fun_outer(6);
+   r += fun_outer(argo2);
+   return r;
+}
+
+int main() {
+   int u;
+   int result = 0;
+   VALGRIND_MAKE_MEM_UNDEFINED(&u, sizeof(u));
+   result += fun_sib(1);
+   result += fun_sib(2);
+   result += fun_sib(u);
+   result += fun_sib(3);
+   result += fun_outer(7);
+   result += fun_outer(u);
+   result += fun_outer2(u);
+   return 0;
+}
@@ -0,0 +1,31 @@
+/* Use enough memory that memcheck's shadow memory takes several huge
+   pages with --shadow-thp=yes, and check that the shadow still works:
+   the undefined bytes, and only those, are found. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../memcheck.h"
+
+#define SZB (32 * 1024 * 1024)
+
+int main ( void )
+{
+   unsigned char* p = malloc(SZB);
+   unsigned long  sum = 0;
+   int            i;
+
+   memset(p, 1, SZB);
+   for (i = 0; i < SZB; i += 4096)
+      sum += p[i];
+   printf("sum %lu\n", sum);
+
+   for (i = 0; i < 8; i++)
+      VALGRIND_MAKE_MEM_UNDEFINED(p + i * (SZB / 8) + i, 1);
+   for (i = 0; i < SZB; i += 4096)
+      (void)VALGRIND_CHECK_MEM_IS_DEFINED(p + i, 4096);
+   printf("errors %u\n", VALGRIND_COUNT_ERRORS);
+
+   free(p);
+   return 0;
+}
@@ -0,0 +1,16 @@
+/* Run with --trace-redir=yes: the redirections are shown as each
+   object is loaded, and the functions they redirect from must be found
+   by name although the object's debug info is still being read. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main ( void )
+{
+   char* p = malloc(16);
+   strcpy(p, "redirected");
+   printf("%s %d\n", p, (int)strlen(p));
+   free(p);
+   return 0;
+}
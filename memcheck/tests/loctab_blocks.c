@@ -0,0 +1,102 @@
+/* Enough lines, from two files, that once the line table of this
+   program is compacted it takes several blocks: check that errors
+   near the start, in the middle and at the end of it, and in the
+   other file, get the right lines. */
+#include "../memcheck.h"
+
+static int u, n;
+
+#include "loctab_blocks.h"
+
+int main(void)
+{
+   VALGRIND_MAKE_MEM_UNDEFINED(&u, sizeof(u));
+   if (u)
+      n += 1;
+   n ^= 2;
+   n *= 3;
+   n -= 4;
+   n += 1;
+   n ^= 2;
+   n *= 3;
+   n -= 4;
+   n += 1;
+   n ^= 2;
+   n *= 3;
+   n -= 4;
+   n += 1;
+   n ^= 2;
+   n *= 3;
+   n -= 4;
+   n += 1;
+   n ^= 2;
+   n *= 3;
+   n -= 4;
+   n += 1;
+   n ^= 2;
+   n *= 3;
+   n -= 4;
+   n += 1;
+   n ^= 2;
+   n *= 3;
+   n -= 4;
+   n += 1;
+   n ^= 2;
+   n *= 3;
+   n -= 4;
+   n += 1;
+   n ^= 2;
+   n *= 3;
+   n -= 4;
+   n += 1;
+   n ^= 2;
+   n *= 3;
+   n -= 4;
+   n += 1;
+   if (u)
+      n += 2;
+   in_header();
+   n -= 4;
+   n += 1;
+   n ^= 2;
+   n *= 3;
+   n -= 4;
+   n += 1;
+   n ^= 2;
+   n *= 3;
+   n -= 4;
+   n += 1;
+   n ^= 2;
+   n *= 3;
+   n -= 4;
+   n += 1;
+   n ^= 2;
+   n *= 3;
+   n -= 4;
+   n += 1;
+   n ^= 2;
+   n *= 3;
+   n -= 4;
+   n += 1;
+   n ^= 2;
+   n *= 3;
+   n -= 4;
+   n += 1;
+   n ^= 2;
+   n *= 3;
+   n -= 4;
+   n += 1;
+   n ^= 2;
+   n *= 3;
+   n -= 4;
+   n += 1;
+   n ^= 2;
+   n *= 3;
+   n -= 4;
+   n += 1;
+   n ^= 2;
+   n *= 3;
+   if (u)
+      n += 3;
+   return 0;
+}
@@ -0,0 +1,20 @@
+/* Included by loctab_blocks.c, so that its line table refers to more
+   than one file. */
+
+static void in_header(void)
+{
+   n += 1;
+   n ^= 2;
+   n *= 3;
+   n -= 4;
+   n += 1;
+   n ^= 2;
+   if (u)
+      n += 5;
+   n *= 3;
+   n -= 4;
+   n += 1;
+   n ^= 2;
+   n *= 3;
+   n -= 4;
+}
@@ -0,0 +1,180 @@
+
+/* Unit test for the small-block front end of the non-client arenas in
+   m_mallocfree.c: a block freed twice must be caught, not put on the
+   cache twice (which would later hand it out to two callers). */
+
+#include <assert.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "coregrind/m_mallocfree.c"
+
+/* Stand-ins for what m_mallocfree.c needs from the rest of the core. */
+
+Bool  VG_(clo_profile_heap)      = False;
+Int   VG_(clo_core_redzone_size) = CORE_REDZONE_DEFAULT_SZB;
+Int   VG_(clo_redzone_size)      = -1;
+Int   VG_(clo_verbosity)         = 1;
+VgNeeds         VG_(needs);
+VgToolInterface VG_(tdict);
+
+static SysRes mk_SysRes ( Bool isError, UWord val )
+{
+   SysRes r;
+   memset(&r, 0, sizeof(r));
+#  if defined(VGO_darwin)
+   r._mode = isError ? SysRes_UNIX_ERR : SysRes_UNIX_OK;
+   r._wLO  = val;
+#  else
+   r._isError = isError;
+   r._val     = val;
+#  endif
+   return r;
+}
+
+SysRes VG_(am_mmap_anon_float_valgrind) ( SizeT cszB )
+{
+   void* p = mmap(NULL, cszB, PROT_READ|PROT_WRITE,
+                  MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+   return p == MAP_FAILED ? mk_SysRes(True, 12) : mk_SysRes(False, (UWord)p);
+}
+SysRes VG_(am_mmap_client_heap) ( SizeT length, Int prot )
+{
+   return VG_(am_mmap_anon_float_valgrind)(length);
+}
+SysRes VG_(am_munmap_valgrind) ( Addr start, SizeT length )
+{
+   munmap((void*)start, length);
+   return mk_SysRes(False, 0);
+}
+SysRes VG_(am_munmap_client) ( Bool* need_discard, Addr start, SizeT length )
+{
+   *need_discard = False;
+   return VG_(am_munmap_valgrind)(start, length);
+}
+ULong VG_(am_get_anonsize_total) ( void ) { return 0; }
+void  VG_(am_show_nsegments) ( Int logLevel, const HChar* who ) { }
+void  VG_(discard_translations) ( Addr start, ULong range, const HChar* who )
+{ }
+void  VG_(print_all_stats) ( Bool memory_stats, Bool tool_stats ) { }
+void  VG_(show_sched_status) ( Bool host_stacktrace, Bool stack_usage,
+                               Bool exited_threads ) { }
+
+void VG_(assert_fail) ( Bool isCore, const HChar* expr, const HChar* file,
+                        Int line, const HChar* fn, const HChar* format, ... )
+{
+   fprintf(stderr, "assertion failed: %s\n", expr);
+   abort();
+}
+void VG_(core_panic) ( const HChar* str )
+{
+   fprintf(stderr, "panic: %s\n", str);
+   abort();
+}
+void VG_(exit) ( Int status ) { exit(status); }
+void VG_(debugLog) ( Int level, const HChar* modulename,
+                     const HChar* format, ... ) { }
+UInt VG_(printf) ( const HChar* format, ... )
+{
+   va_list vargs;
+   UInt    n;
+   va_start(vargs, format);
+   n = vprintf(format, vargs);
+   va_end(vargs);
+   return n;
+}
+UInt VG_(message) ( VgMsgKind kind, const HChar* format, ... )
+{
+   va_list vargs;
+   UInt    n;
+   va_start(vargs, format);
+   n = vprintf(format, vargs);
+   va_end(vargs);
+   return n;
+}
+void* VG_(memset) ( void* s, Int c, SizeT sz ) { return memset(s, c, sz); }
+void* VG_(memcpy) ( void* d, const void* s, SizeT sz )
+{ return memcpy(d, s, sz); }
+SizeT VG_(strlen) ( const HChar* str ) { return strlen(str); }
+Int   VG_(strcmp) ( const HChar* s1, const HChar* s2 )
+{ return strcmp(s1, s2); }
+Int   VG_(log2) ( UInt x )
+{
+   Int i;
+   for (i = 0; i < 32; i++)
+      if ((1U << i) == x)
+         return i;
+   return -1;
+}
+void  VG_(ssort) ( void* base, SizeT nmemb, SizeT size,
+                   Int (*compar)(const void*, const void*) )
+{
+   qsort(base, nmemb, size, compar);
+}
+
+/* Allocate and free a few small blocks, going through the cache. */
+static void churn ( void )
+{
+   void* p[10];
+   Int   i;
+   for (i = 0; i < 10; i++)
+      p[i] = VG_(arena_malloc)(VG_AR_CORE, "unit.churn", 8 * (i + 1));
+   for (i = 0; i < 10; i++)
+      VG_(arena_free)(VG_AR_CORE, p[i]);
+   for (i = 0; i < 10; i++) {
+      p[i] = VG_(arena_malloc)(VG_AR_CORE, "unit.churn", 8 * (i + 1));
+      memset(p[i], i, 8 * (i + 1));
+   }
+   for (i = 0; i < 10; i++)
+      VG_(arena_free)(VG_AR_CORE, p[i]);
+}
+
+int main ( void )
+{
+   void* p;
+   void* q;
+   void* r;
+   pid_t pid;
+   int   status;
+
+   churn();
+   VG_(sanity_check_malloc_all)();
+
+   /* A freed block comes back from the cache. */
+   p = VG_(arena_malloc)(VG_AR_CORE, "unit.1", 24);
+   VG_(arena_free)(VG_AR_CORE, p);
+   q = VG_(arena_malloc)(VG_AR_CORE, "unit.2", 24);
+   printf("reused from cache: %s\n", p == q ? "yes" : "no");
+   VG_(arena_free)(VG_AR_CORE, q);
+   VG_(sanity_check_malloc_all)();
+
+   /* Freeing it again must assert, in a child so we can go on. */
+   fflush(stdout);
+   fflush(stderr);
+   pid = fork();
+   assert(pid >= 0);
+   if (pid == 0) {
+      VG_(arena_free)(VG_AR_CORE, q);
+      q = VG_(arena_malloc)(VG_AR_CORE, "unit.3", 24);
+      r = VG_(arena_malloc)(VG_AR_CORE, "unit.4", 24);
+      printf("double free not caught%s\n",
+             q == r ? "; block handed out twice" : "");
+      exit(0);
+   }
+   assert(waitpid(pid, &status, 0) == pid);
+   printf("double free %s\n",
+          WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT
+             ? "caught" : "NOT caught");
+
+   /* And the parent's heap is still fine. */
+   churn();
+   VG_(sanity_check_malloc_all)();
+   printf("done\n");
+   return 0;
+}
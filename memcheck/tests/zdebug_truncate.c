@@ -0,0 +1,79 @@
+/* Copy an ELF file built with -gz=zlib, cutting its compressed
+   .debug_info section down to half its length, but leaving its
+   header saying how big it inflates to alone.  Valgrind should then
+   give up reading the copy's debuginfo, saying why, rather than
+   asserting or reading garbage. */
+
+#include <elf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(SHF_COMPRESSED)
+#define SHF_COMPRESSED (1 << 11)
+#endif
+
+static unsigned char* image;
+static long           image_szB;
+
+#define TRUNCATE(Ehdr, Shdr)                                          \
+   do {                                                               \
+      Ehdr* eh = (Ehdr*)image;                                        \
+      Shdr* sh = (Shdr*)(image + eh->e_shoff);                        \
+      const char* names = (const char*)image                          \
+                          + sh[eh->e_shstrndx].sh_offset;             \
+      int i;                                                          \
+      for (i = 0; i < eh->e_shnum; i++) {                             \
+         if (strcmp(names + sh[i].sh_name, ".debug_info") == 0        \
+             && (sh[i].sh_flags & SHF_COMPRESSED)) {                  \
+            sh[i].sh_size /= 2;                                       \
+            return 1;                                                 \
+         }                                                            \
+      }                                                               \
+   } while (0)
+
+static int truncate_debug_info ( void )
+{
+   if (image_szB < EI_NIDENT || memcmp(image, ELFMAG, SELFMAG) != 0)
+      return 0;
+   if (image[EI_CLASS] == ELFCLASS64)
+      TRUNCATE(Elf64_Ehdr, Elf64_Shdr);
+   else
+      TRUNCATE(Elf32_Ehdr, Elf32_Shdr);
+   return 0;
+}
+
+int main ( int argc, char** argv )
+{
+   FILE* f;
+
+   if (argc != 3) {
+      fprintf(stderr, "usage: %s infile outfile\n", argv[0]);
+      return 1;
+   }
+   f = fopen(argv[1], "rb");
+   if (f == NULL || fseek(f, 0, SEEK_END) != 0
+       || (image_szB = ftell(f)) < 0 || fseek(f, 0, SEEK_SET) != 0) {
+      perror(argv[1]);
+      return 1;
+   }
+   image = malloc(image_szB);
+   if (image == NULL || fread(image, 1, image_szB, f) != image_szB) {
+      perror(argv[1]);
+      return 1;
+   }
+   fclose(f);
+
+   if (!truncate_debug_info()) {
+      fprintf(stderr, "%s: no compressed .debug_info\n", argv[1]);
+      return 1;
+   }
+
+   f = fopen(argv[2], "wb");
+   if (f == NULL || fwrite(image, 1, image_szB, f) != image_szB
+       || fclose(f) != 0) {
+      perror(argv[2]);
+      return 1;
+   }
+   return 0;
+}
@@ -0,0 +1,74 @@
+/* Test that --smc-check=protect spots code being rewritten in a
+   private anonymous RWX mapping.  Each version of the code is written
+   after the previous one has been translated and its page protected,
+   so the write faults, the translations are discarded and the write
+   is restarted.  One version is written by read() into the code page,
+   which the kernel would fail with EFAULT if the page were still
+   protected.  There are more versions than SMC_MAX_WRITES, so after a
+   few the page is given up on and its code is self-checked instead.
+
+   CORRECT output is
+
+      version 0: 100
+      version 1: 101
+      ...
+      version 7: 107
+
+   WRONG output (if a rewrite is missed) repeats an earlier value. */
+
+#include <stdio.h>
+#include <assert.h>
+#include <unistd.h>
+#include "tests/sys_mman.h"
+
+typedef unsigned char UChar;
+
+#define N_VERSIONS  8
+#define BY_READ     3
+
+static UChar* code;
+
+/* Make `insns' be  movl $n, %eax ; ret */
+static void make_version ( UChar* insns, int n )
+{
+   insns[0] = 0xB8;
+   insns[1] = n & 0xFF;
+   insns[2] = (n >> 8) & 0xFF;
+   insns[3] = (n >> 16) & 0xFF;
+   insns[4] = (n >> 24) & 0xFF;
+   insns[5] = 0xC3;
+}
+
+/* Have the kernel write the new version, through a pipe. */
+static void make_version_by_read ( int n )
+{
+   UChar insns[6];
+   int   fds[2];
+   assert(pipe(fds) == 0);
+   make_version(insns, n);
+   assert(write(fds[1], insns, sizeof insns) == sizeof insns);
+   assert(read(fds[0], code, sizeof insns) == sizeof insns);
+   close(fds[0]);
+   close(fds[1]);
+}
+
+// force an indirect call to code[0], so vex can't chase it
+__attribute__((noinline))
+int call ( int (*f)(void) ) { return f(); }
+
+int main ( void )
+{
+   int i;
+   code = mmap(NULL, 4096, PROT_READ|PROT_WRITE|PROT_EXEC,
+               MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+   assert(code != MAP_FAILED);
+   for (i = 0; i < N_VERSIONS; i++) {
+      if (i == BY_READ)
+         make_version_by_read(100 + i);
+      else
+         make_version(code, 100 + i);
+      printf("version %d: %d\n", i, call((int(*)(void)) code));
+   }
+   munmap(code, 4096);
+   return 0;
+}
@@ -0,0 +1,98 @@
+
+/* Test that --smc-check=protect spots writes to translated code in a
+   MAP_SHARED anonymous mapping made through another mapping of the
+   same memory, here the one a forked child inherits.  Write-protecting
+   the pages in this process can't catch those, so the code must be
+   self-checked.
+
+   CORRECT output is
+
+      in p 0
+      in q 1
+      in p 2
+      in q 3
+      in p 4
+      in q 5
+
+   WRONG output (if the child's writes to code[] are missed) is
+
+      in p 0
+      in p 1
+      in p 2
+      in p 3
+      in p 4
+      in p 5
+*/
+
+#include <stdio.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "tests/sys_mman.h"
+
+typedef unsigned long long int Addr;
+typedef unsigned char UChar;
+
+__attribute__((noinline))
+void q ( int n )
+{
+   printf("in q %d\n", n);
+}
+
+__attribute__((noinline))
+void p ( int n )
+{
+   printf("in p %d\n", n);
+}
+
+static UChar* code;
+
+/* Make `code' be  movabsq $dest, %rax ; pushq %rax ; ret */
+static void set_dest ( Addr dest )
+{
+   int i;
+   code[0] = 0x48;
+   code[1] = 0xB8;
+   for (i = 0; i < 8; i++)
+      code[2 + i] = (dest >> (8 * i)) & 0xFF;
+   code[10] = 0x50;
+   code[11] = 0xC3;
+}
+
+/* Do the write in a child process, through its copy of the mapping. */
+static void set_dest_in_child ( Addr dest )
+{
+   int   status;
+   pid_t pid = fork();
+   assert(pid >= 0);
+   if (pid == 0) {
+      set_dest(dest);
+      _exit(0);
+   }
+   assert(waitpid(pid, &status, 0) == pid);
+   assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+// force an indirect branch to code[0], so vex can't chase it
+__attribute__((noinline))
+void dd ( int x, void (*f)(int) ) { f(x); }
+
+__attribute__((noinline))
+void cc ( int x ) { dd(x, (void(*)(int)) &code[0]); }
+
+int main ( void )
+{
+   int i;
+   code = mmap(NULL, 4096, PROT_READ|PROT_WRITE|PROT_EXEC,
+               MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+   assert(code != MAP_FAILED);
+   set_dest((Addr)&p);
+   for (i = 0; i < 6; i += 2) {
+      cc(i);
+      set_dest_in_child((Addr)&q);
+      cc(i+1);
+      set_dest_in_child((Addr)&p);
+   }
+   munmap(code, 4096);
+   return 0;
+}
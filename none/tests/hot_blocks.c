@@ -0,0 +1,98 @@
+/* Run the same code twice: first in a child, whose Valgrind saves the
+   blocks run to the --hot-blocks-file at exit, then after re-executing
+   this program (with --trace-children=yes), whose Valgrind replays
+   them at startup.  The second run uses the replayed translations, so
+   it must print exactly what the first one did. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+static int count_sevens ( void )
+{
+   int i, sum = 0;
+   for (i = 0; i < 100000; i++)
+      sum += (i % 7 == 0) ? 1 : 0;
+   return sum;
+}
+
+static unsigned int hash ( const char* s )
+{
+   unsigned int h = 5381;
+   while (*s)
+      h = h * 33 + (unsigned char)*s++;
+   return h;
+}
+
+static int step ( int state, int c )
+{
+   switch (state) {
+      case 0:  return c == 'a' ? 1 : 0;
+      case 1:  return c == 'b' ? 2 : (c == 'a' ? 1 : 0);
+      case 2:  return c == 'c' ? 3 : (c == 'a' ? 1 : 0);
+      default: return 0;
+   }
+}
+
+static int cmp_int ( const void* a, const void* b )
+{
+   return *(const int*)a - *(const int*)b;
+}
+
+static void work ( const char* who )
+{
+   static const char text[] = "xxabcabxabcaabcbcabc";
+   char buf[64];
+   int  i, j, v[100], matches = 0, state = 0;
+   unsigned int h = 0;
+
+   for (i = 0; i < 1000; i++) {
+      snprintf(buf, sizeof(buf), "block %d", i);
+      h = h * 31 + hash(buf);
+   }
+   for (j = 0; j < 100; j++) {
+      for (i = 0; text[i]; i++) {
+         state = step(state, text[i]);
+         if (state == 3)
+            matches++;
+      }
+   }
+   for (i = 0; i < 100; i++)
+      v[i] = (i * 37) % 101;
+   qsort(v, 100, sizeof(int), cmp_int);
+
+   printf("%s: %d %08x %d %d %d %d\n", who, count_sevens(), h, matches,
+          v[0], v[50], v[99]);
+}
+
+int main ( int argc, char** argv )
+{
+   pid_t pid;
+   int   status;
+
+   if (argc > 1) {
+      work("replay");
+      return 0;
+   }
+
+   fflush(stdout);
+   pid = fork();
+   if (pid < 0) {
+      perror("fork");
+      return 1;
+   }
+   if (pid == 0) {
+      work("save");
+      return 0;
+   }
+   if (waitpid(pid, &status, 0) != pid) {
+      perror("waitpid");
+      return 1;
+   }
+   execl(argv[0], argv[0], "replay", (char*)NULL);
+   perror("execl");
+   return 1;
+}
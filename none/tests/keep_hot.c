@@ -0,0 +1,103 @@
+/* Like perf/bigcode, this runs many copies of a function, so that
+   with --num-transtab-sectors=2 sectors get recycled again and again.
+   Between batches of copies it runs a few hot functions, whose
+   translations --transtab-keep-hot=yes keeps over the recycling, and
+   prints their results.  A kept translation which was not put back
+   as it was, or which is still chained to a dumped one, shows up as
+   a wrong result.
+
+   Like bigcode, this only works on some platforms, and by accident:
+   the copies of cold() must run wherever they are copied to. */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#if defined(__mips__)
+#include <asm/cachectl.h>
+#include <sys/syscall.h>
+#elif defined(__tilegx__)
+#include <asm/cachectl.h>
+#endif
+#include "tests/sys_mman.h"
+
+#define FN_SIZE   1280     // Must be big enough to hold the compiled cold()
+#define N_FNS     40000
+#define BATCH     4000
+
+int cold ( int x, int y )
+{
+   int i;
+   for (i = 0; i < 50; i++) {
+      switch (x % 8) {
+       case 1:  y += 3;
+       case 2:  y += x;
+       case 3:  y *= 2;
+       default: y--;
+      }
+   }
+   return y;
+}
+
+static int hot_sum ( int n )
+{
+   int i, s = 0;
+   for (i = 1; i <= n; i++)
+      s += i * i;
+   return s;
+}
+
+static unsigned int hot_hash ( unsigned int h, int v )
+{
+   int i;
+   for (i = 0; i < 4; i++) {
+      h = h * 33 + (v & 0xff);
+      v >>= 8;
+   }
+   return h;
+}
+
+static int hot_state ( int state, int c )
+{
+   switch (state) {
+      case 0:  return c % 3 == 0 ? 1 : 0;
+      case 1:  return c % 3 == 1 ? 2 : 0;
+      case 2:  return c % 3 == 2 ? 3 : 0;
+      default: return 0;
+   }
+}
+
+int main ( void )
+{
+   int b, i, k, cold_sum = 0, sum = 0, state = 0, n_found = 0;
+   unsigned int h = 5381;
+
+   char* a = mmap(0, FN_SIZE * N_FNS,
+                     PROT_EXEC|PROT_WRITE|PROT_READ,
+                     MAP_PRIVATE|MAP_ANONYMOUS, -1,0);
+   assert(a != (char*)MAP_FAILED);
+   for (i = 0; i < N_FNS; i++)
+      memcpy(&a[FN_SIZE*i], cold, FN_SIZE);
+
+#if defined(__mips__)
+   syscall(__NR_cacheflush, a, FN_SIZE * N_FNS, ICACHE);
+#elif defined(__tilegx__)
+   cacheflush(a, FN_SIZE * N_FNS, ICACHE);
+#endif
+
+   for (b = 0; b < N_FNS; b += BATCH) {
+      for (i = b; i < b + BATCH; i++) {
+         int(*f)(int,int) = (void*)&a[FN_SIZE*i];
+         cold_sum += f(i, N_FNS - i);
+      }
+      for (k = 0; k < 1000; k++) {
+         sum += hot_sum(k % 50);
+         h = hot_hash(h, k + b);
+         state = hot_state(state, k + b);
+         if (state == 3)
+            n_found++;
+      }
+      printf("batch %2d: %d %d %08x %d\n", b / BATCH, cold_sum, sum, h,
+             n_found);
+   }
+   return 0;
+}
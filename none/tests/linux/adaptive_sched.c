@@ -0,0 +1,53 @@
+/* Run threads with different habits under --adaptive-sched=yes and
+   --sched-spin=yes: some compute without making syscalls, which get
+   long timeslices, and some make a syscall every few iterations, which
+   get short ones.  They all also take a shared mutex now and then, so
+   that the threads wait for each other as well as for the lock. */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define N_THREADS 4
+#define N_ITERS   200000
+
+static long            shared = 0;
+static pthread_mutex_t mx = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int    results[N_THREADS];
+
+static void* worker ( void* arg )
+{
+   long         me = (long)arg;
+   unsigned int x  = (unsigned int)me * 2654435761u;
+   long         i;
+
+   for (i = 0; i < N_ITERS; i++) {
+      x = x * 1103515245u + 12345u;
+      /* Odd threads make syscalls; even ones only compute. */
+      if ((me & 1) && i % 64 == 0 && getppid() < 0)
+         x = 0;
+      if (i % 1000 == 0) {
+         pthread_mutex_lock(&mx);
+         shared += me + 1;
+         pthread_mutex_unlock(&mx);
+      }
+   }
+   results[me] = x;
+   return NULL;
+}
+
+int main ( void )
+{
+   pthread_t th[N_THREADS];
+   long      i;
+
+   for (i = 0; i < N_THREADS; i++)
+      pthread_create(&th[i], NULL, worker, (void*)i);
+   for (i = 0; i < N_THREADS; i++)
+      pthread_join(th[i], NULL);
+
+   for (i = 0; i < N_THREADS; i++)
+      printf("thread %ld: %08x\n", i, results[i]);
+   printf("shared %ld\n", shared);
+   return 0;
+}
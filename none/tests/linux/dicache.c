@@ -0,0 +1,34 @@
+/* Runs twice under --debuginfo-cache-dir: the first run saves the
+   debug info of this program, then execs it again, and the second run
+   must load it back and print the same backtrace. */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "valgrind.h"
+
+__attribute__((noinline))
+static void show ( const char* which )
+{
+   VALGRIND_PRINTF_BACKTRACE("%s run\n", which);
+}
+
+__attribute__((noinline))
+static void caller ( const char* which )
+{
+   show(which);
+   __asm__ __volatile__("" ::: "memory");
+}
+
+int main ( int argc, char** argv )
+{
+   if (argc > 1 && strcmp(argv[1], "again") == 0) {
+      caller("second");
+      return 0;
+   }
+   caller("first");
+   fflush(stdout);
+   execl(argv[0], argv[0], "again", (char*)NULL);
+   perror("execl");
+   return 1;
+}
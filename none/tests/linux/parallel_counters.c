@@ -0,0 +1,66 @@
+/* With --parallel-threads=yes, threads run generated code at the same
+   time.  Have several of them update shared counters with atomic
+   instructions, compare-and-swap loops and a mutex, all at once, and
+   check that no update is lost. */
+
+#include <pthread.h>
+#include <stdio.h>
+
+#define N_THREADS 4
+#define N_ITERS   100000
+
+static volatile int go = 0;
+static int          n_ready = 0;
+
+static long         atomic_count = 0;
+static long         cas_count    = 0;
+static long         locked_count = 0;
+static unsigned int xor_all      = 0;
+static pthread_mutex_t mx = PTHREAD_MUTEX_INITIALIZER;
+
+static void* worker ( void* arg )
+{
+   long         me = (long)arg;
+   unsigned int x  = (unsigned int)me * 2654435761u;
+   long         i, old;
+
+   /* Start together, so that the threads overlap as much as they can. */
+   __sync_fetch_and_add(&n_ready, 1);
+   while (!go)
+      ;
+
+   for (i = 0; i < N_ITERS; i++) {
+      __sync_fetch_and_add(&atomic_count, 1);
+      do {
+         old = cas_count;
+      } while (!__sync_bool_compare_and_swap(&cas_count, old, old + 2));
+      x = x * 1103515245u + 12345u;
+      if (i % 100 == 0) {
+         pthread_mutex_lock(&mx);
+         locked_count += 3;
+         pthread_mutex_unlock(&mx);
+      }
+   }
+   __sync_fetch_and_xor(&xor_all, x);
+   return NULL;
+}
+
+int main ( void )
+{
+   pthread_t t[N_THREADS];
+   long      i;
+
+   for (i = 0; i < N_THREADS; i++)
+      pthread_create(&t[i], NULL, worker, (void*)i);
+   while (__sync_fetch_and_add(&n_ready, 0) < N_THREADS)
+      ;
+   go = 1;
+   for (i = 0; i < N_THREADS; i++)
+      pthread_join(t[i], NULL);
+
+   printf("atomic: %ld\n", atomic_count);
+   printf("cas:    %ld\n", cas_count);
+   printf("locked: %ld\n", locked_count);
+   printf("xor:    %08x\n", xor_all);
+   return 0;
+}
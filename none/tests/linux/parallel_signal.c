@@ -0,0 +1,97 @@
+/* With --parallel-threads=yes, take synchronous signals -- SIGSEGV
+   from a protected page, SIGFPE from a division by zero -- in one
+   thread while others are running generated code at the same time,
+   and check that each is delivered to the thread that caused it and
+   that the others are not disturbed. */
+
+#include <pthread.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/sys_mman.h"
+
+#define N_BUSY    3
+#define N_ITERS   200000
+#define N_FAULTS  100
+
+static volatile int go = 0;
+static volatile int faults_done = 0;
+static long         busy_count = 0;
+
+static __thread sigjmp_buf  env;
+static __thread int         n_segv, n_fpe;
+static pthread_t            faulter;
+static volatile int         wrong_thread = 0;
+
+static void handler ( int sig )
+{
+   if (!pthread_equal(pthread_self(), faulter))
+      wrong_thread = 1;
+   if (sig == SIGSEGV)
+      n_segv++;
+   else
+      n_fpe++;
+   siglongjmp(env, 1);
+}
+
+static void* busy ( void* arg )
+{
+   long i;
+   while (!go)
+      ;
+   for (i = 0; i < N_ITERS || !faults_done; i++)
+      __sync_fetch_and_add(&busy_count, 1);
+   return NULL;
+}
+
+static void* fault ( void* arg )
+{
+   volatile char* page = arg;
+   volatile int   zero = 0, r = 0;
+   int            i;
+
+   while (!go)
+      ;
+   for (i = 0; i < N_FAULTS; i++) {
+      if (sigsetjmp(env, 1) == 0)
+         page[i] = 1;
+      if (sigsetjmp(env, 1) == 0)
+         r += 100 / zero;
+   }
+   printf("segv: %d, fpe: %d\n", n_segv, n_fpe);
+   faults_done = 1;
+   return NULL;
+}
+
+int main ( void )
+{
+   pthread_t        t[N_BUSY];
+   struct sigaction sa;
+   char*            page;
+   int              i;
+
+   memset(&sa, 0, sizeof(sa));
+   sa.sa_handler = handler;
+   sigemptyset(&sa.sa_mask);
+   sigaction(SIGSEGV, &sa, NULL);
+   sigaction(SIGFPE, &sa, NULL);
+
+   page = mmap(NULL, 4096, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+   if (page == MAP_FAILED) {
+      perror("mmap");
+      return 1;
+   }
+
+   for (i = 0; i < N_BUSY; i++)
+      pthread_create(&t[i], NULL, busy, NULL);
+   pthread_create(&faulter, NULL, fault, page);
+   go = 1;
+   pthread_join(faulter, NULL);
+   for (i = 0; i < N_BUSY; i++)
+      pthread_join(t[i], NULL);
+
+   printf("busy: %s\n", busy_count >= N_BUSY * N_ITERS ? "ok" : "short");
+   printf("wrong thread: %d\n", wrong_thread);
+   return 0;
+}
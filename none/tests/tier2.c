@@ -0,0 +1,36 @@
+/* With --tier2-threshold=1, the blocks of the loops below are made
+   hot within the first few million blocks run and retranslated with
+   superblock chasing while the loops are still going.  The results
+   must not change when the translations are swapped. */
+
+#include <stdio.h>
+
+static unsigned int collatz_steps ( unsigned long n )
+{
+   unsigned int steps = 0;
+   while (n != 1) {
+      if (n & 1)
+         n = 3 * n + 1;
+      else
+         n /= 2;
+      steps++;
+   }
+   return steps;
+}
+
+int main ( void )
+{
+   unsigned long i, total = 0, longest = 1;
+   unsigned int  steps, max_steps = 0;
+
+   for (i = 1; i < 100000; i++) {
+      steps = collatz_steps(i);
+      total += steps;
+      if (steps > max_steps) {
+         max_steps = steps;
+         longest   = i;
+      }
+   }
+   printf("total %lu, longest %lu (%u steps)\n", total, longest, max_steps);
+   return 0;
+}
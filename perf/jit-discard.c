@@ -0,0 +1,113 @@
+// This artificial program behaves like a JIT compiler: it keeps
+// "emitting" small functions into a code buffer, tells Valgrind to
+// discard any translations of the bytes it has just overwritten, runs
+// the new code a few times, and every so often throws the whole
+// buffer away and starts again.
+//
+// It's a stress test for VG_(discard_translations), which has to find
+// the translations for each discarded range among all the others.  To
+// make that hard, a big block of other code is kept translated
+// throughout, and the functions are laid out so that many of them
+// straddle the boundaries that the translation table uses to index
+// code by address.
+//
+// As with bigcode.c, "emitting" means copying the compiled f(), which
+// only works on targets where it happens to be position independent;
+// see the comments there.
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+#if defined(__mips__)
+#include <asm/cachectl.h>
+#include <sys/syscall.h>
+#elif defined(__tilegx__)
+#include <asm/cachectl.h>
+#endif
+#include "tests/sys_mman.h"
+#include "../include/valgrind.h"
+
+#define FN_SIZE    1280    // Must be big enough to hold the compiled f()
+                           // and any literal pool that might be used
+#define FN_STRIDE  3000    // Not a power of two, so functions land
+                           // across 8k boundaries
+#define N_SLOTS    256     // Functions in the code buffer
+#define N_ROUNDS   40      // Times round the code buffer
+#define N_CALLS    4       // Calls of each newly emitted function
+#define N_STATIC   2000    // Copies of f() kept translated throughout
+
+int f(int x, int y)
+{
+   int i;
+   for (i = 0; i < 50; i++) {
+      switch (x % 8) {
+       case 1:  y += 3;
+       case 2:  y += x;
+       case 3:  y *= 2;
+       default: y--;
+      }
+   }
+   return y;
+}
+
+static void flush_icache(char* a, int len)
+{
+#if defined(__mips__)
+   syscall(__NR_cacheflush, a, len, ICACHE);
+#elif defined(__tilegx__)
+   cacheflush(a, len, ICACHE);
+#else
+   (void)a; (void)len;
+#endif
+}
+
+static char* map_code(int len)
+{
+   char* a = mmap(0, len, PROT_EXEC|PROT_WRITE|PROT_READ,
+                  MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+   assert(a != (char*)MAP_FAILED);
+   return a;
+}
+
+int main(void)
+{
+   int i, j, r, sum = 0;
+
+   // The long-lived code.  Run it all once, so it all gets translated,
+   // then again now and then.
+   char* s = map_code(FN_SIZE * N_STATIC);
+   for (i = 0; i < N_STATIC; i++)
+      memcpy(&s[FN_SIZE*i], f, FN_SIZE);
+   flush_icache(s, FN_SIZE * N_STATIC);
+   for (i = 0; i < N_STATIC; i++) {
+      int(*g)(int,int) = (void*)&s[FN_SIZE*i];
+      sum += g(i, 1);
+   }
+
+   // The JIT code buffer.
+   char* a = map_code(FN_STRIDE * N_SLOTS);
+
+   for (r = 0; r < N_ROUNDS; r++) {
+      for (i = 0; i < N_SLOTS; i++) {
+         char* fn = &a[FN_STRIDE*i];
+         memcpy(fn, f, FN_SIZE);
+         flush_icache(fn, FN_SIZE);
+         VALGRIND_DISCARD_TRANSLATIONS(fn, FN_SIZE);
+         for (j = 0; j < N_CALLS; j++) {
+            int(*g)(int,int) = (void*)fn;
+            sum += g(i+j, r);
+         }
+      }
+      // "Garbage collect" the whole buffer.
+      VALGRIND_DISCARD_TRANSLATIONS(a, FN_STRIDE * N_SLOTS);
+      for (i = r; i < N_STATIC; i += N_ROUNDS) {
+         int(*g)(int,int) = (void*)&s[FN_SIZE*i];
+         sum += g(i, r);
+      }
+      if (r % 10 == 0)
+         printf(".");
+   }
+   printf("result = %d\n", sum);
+   return 0;
+}